@@ -0,0 +1,57 @@
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include "./logger.h"
+
+// CPU 列表字符串的最大长度
+#define AFFINITY_LIST_SIZE 64
+
+/**
+ * @brief ThreadRole 线程角色, 每种角色绑定到各自的CPU集合
+ */
+typedef enum ThreadRole
+{
+    ROLE_CAPTURE = 0, // 事件循环 负责 VIDIOC_DQBUF
+    ROLE_WORKER = 1,  // 共享线程池 执行解码与编码任务
+    ROLE_ENCODE = 2,  // 编码器内部线程
+    ROLE_IO = 3,      // 文件写入与同步线程
+    ROLE_NUM = 4,
+} ThreadRole;
+
+/**
+ * @brief AffinityConfig 线程绑核配置
+ * @property cpus 各角色的CPU列表 如 "0-3,6", 为空时不限制
+ * @property capture_priority 采集线程的 SCHED_FIFO 优先级 1~99, 为0时不使用实时调度
+ * @property avoid_smt 是否将采集CPU及其超线程兄弟从线程池与编码器的CPU集合中排除
+ */
+typedef struct AffinityConfig
+{
+    char cpus[ROLE_NUM][AFFINITY_LIST_SIZE];
+    int capture_priority;
+    int avoid_smt;
+} AffinityConfig;
+
+/**
+ * @brief init_affinity 解析并计算各角色的CPU集合
+ * @note 在创建任何线程之前调用, 未调用时 apply_affinity 不做任何事
+ * @param config 绑核配置
+ * @return int 成功返回0, CPU列表无效返回-1
+ */
+int init_affinity(AffinityConfig config);
+
+/**
+ * @brief apply_affinity 将调用线程绑定到角色对应的CPU集合并设置调度策略
+ * @note 新线程继承创建者的CPU集合与调度策略, 因此非采集角色会显式恢复为 SCHED_OTHER
+ * @param role 线程角色
+ * @return int 成功返回0, 失败返回-1
+ */
+int apply_affinity(ThreadRole role);
+
+/**
+ * @brief get_thread_role 获取调用线程最近一次设置的角色
+ * @note 未设置过的线程视为 ROLE_CAPTURE
+ * @return ThreadRole 线程角色
+ */
+ThreadRole get_thread_role(void);
+
+#endif
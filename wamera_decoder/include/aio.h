@@ -0,0 +1,141 @@
+#ifndef AIO_H
+#define AIO_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+#ifdef WAMERA_HAVE_URING
+#include <liburing.h>
+#endif
+
+#include "./logger.h"
+#include "./tool.h"
+#include "./affinity.h"
+
+// 后备线程池的线程数
+#define AIO_THREAD_NUM 2
+
+// 写入延迟直方图的桶数 按 2 的幂划分 单位:us
+#define AIO_HIST_SIZE 32
+
+/**
+ * @brief AioBackend 异步写入后端
+ */
+typedef enum AioBackend
+{
+    AIO_SYNC = 0,   // 在调用线程上直接 pwrite
+    AIO_URING = 1,  // io_uring 注册缓冲区写入, 不可用时退化为 AIO_THREAD
+    AIO_THREAD = 2, // 线程池 pwrite
+} AioBackend;
+
+/**
+ * @brief AioJob 一次写入请求, 与缓冲区一一对应
+ * @property index 缓冲区索引
+ * @property length 待写入长度
+ * @property done 已写入长度
+ * @property offset 文件偏移
+ * @property submit_time 提交时间 单位:us
+ * @property writer 所属的写入器
+ * @property next 线程池队列中的下一个请求
+ */
+typedef struct AioJob
+{
+    int index;
+    unsigned int length;
+    unsigned int done;
+    int64_t offset;
+    int64_t submit_time;
+    struct AioWriter *writer;
+    struct AioJob *next;
+} AioJob;
+
+/**
+ * @brief AioStat 写入统计
+ * @property bytes 已完成写入的字节数
+ * @property writes 已完成的写入次数
+ * @property max_latency 最大写入延迟 单位:us
+ * @property histogram 写入延迟直方图, 第 i 个桶统计 [2^(i-1), 2^i) us
+ * @property start_time 写入器创建时间 单位:us
+ */
+typedef struct AioStat
+{
+    int64_t bytes;
+    int64_t writes;
+    int64_t max_latency;
+    int64_t histogram[AIO_HIST_SIZE];
+    int64_t start_time;
+} AioStat;
+
+/**
+ * @brief AioWriter 异步文件写入器, 管理一组对齐的写入缓冲区
+ * @property fd 文件描述符
+ * @property backend 实际使用的后端
+ * @property buf_num 缓冲区数量
+ * @property buf_size 单个缓冲区大小
+ * @property arena 缓冲区内存
+ * @property jobs 每个缓冲区对应的写入请求
+ * @property buffers 以 arena 为存储的缓冲区对象池
+ * @property in_flight 未完成的写入数量
+ * @property error 写入过程中出现的错误
+ */
+typedef struct AioWriter
+{
+    int fd;
+    AioBackend backend;
+    unsigned int buf_num;
+    unsigned int buf_size;
+    uint8_t *arena;
+    AioJob *jobs;
+    ObjectPool *buffers;
+    unsigned int in_flight;
+    int error;
+    AioStat stat;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+#ifdef WAMERA_HAVE_URING
+    struct io_uring ring;
+#endif
+} AioWriter;
+
+/**
+ * @brief open_aio_writer 创建异步写入器
+ * @param fd 文件描述符 由调用方负责关闭
+ * @param backend 期望的后端
+ * @param buf_num 缓冲区数量 同步后端固定为1
+ * @param buf_size 单个缓冲区大小 需按页对齐
+ * @return AioWriter* 失败返回NULL
+ */
+AioWriter *open_aio_writer(int fd, AioBackend backend, unsigned int buf_num, unsigned int buf_size);
+
+/**
+ * @brief acquire_aio_buffer 获取一个空闲缓冲区, 没有空闲时等待写入完成
+ * @param writer 写入器
+ * @return uint8_t* 缓冲区 出错返回NULL
+ */
+uint8_t *acquire_aio_buffer(AioWriter *writer);
+
+/**
+ * @brief submit_aio_buffer 提交缓冲区写入, 写入完成后缓冲区自动回收
+ * @param writer 写入器
+ * @param buf 由 acquire_aio_buffer 获取的缓冲区
+ * @param length 写入长度
+ * @param offset 文件偏移
+ * @return int 成功返回0, 失败返回-1
+ */
+int submit_aio_buffer(AioWriter *writer, uint8_t *buf, unsigned int length, int64_t offset);
+
+/**
+ * @brief drain_aio_writer 等待所有已提交的写入完成
+ * @param writer 写入器
+ * @return int 成功返回0, 有写入失败返回-1
+ */
+int drain_aio_writer(AioWriter *writer);
+
+/**
+ * @brief close_aio_writer 等待写入完成, 输出统计信息并释放写入器
+ * @param writer 写入器
+ * @return int 成功返回0, 有写入失败返回-1
+ */
+int close_aio_writer(AioWriter *writer);
+
+#endif
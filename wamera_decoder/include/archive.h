@@ -0,0 +1,155 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <libavutil/time.h>
+
+#include "./logger.h"
+#include "./tool.h"
+#include "./affinity.h"
+
+// 请求头的最大长度
+#define ARCHIVE_REQUEST_SIZE 4096
+
+// 单次 sendfile 的最大字节数 各连接轮流发送, 一个连接不会长时间占用磁盘
+#define ARCHIVE_CHUNK (1 << 20)
+
+// 连接无进展多久后关闭 单位:us
+#define ARCHIVE_TIMEOUT 30000000
+
+// 服务线程的 nice 值
+#define ARCHIVE_NICE 10
+
+// glibc 没有 ioprio_set 的封装, 常量取自 linux/ioprio.h
+#define ARCHIVE_IOPRIO_CLASS_IDLE 3
+#define ARCHIVE_IOPRIO_WHO_PROCESS 1
+#define ARCHIVE_IOPRIO_CLASS_SHIFT 13
+
+/**
+ * @brief ArchiveConfig 录像回放服务配置
+ * @property port 监听端口 为0时不启用
+ * @property connections 同时服务的连接数 超出的连接在监听队列中等待
+ * @property address 监听地址
+ * @property dir 录像目录 为空时使用第一路相机的录像目录
+ */
+typedef struct ArchiveConfig
+{
+    unsigned int port;
+    unsigned int connections;
+    char address[64];
+    char dir[256];
+} ArchiveConfig;
+
+/**
+ * @brief ArchiveState 连接的状态
+ */
+typedef enum ArchiveState
+{
+    ARCHIVE_REQUEST = 0,  // 读取请求头
+    ARCHIVE_RESPONSE = 1, // 发送响应头与内存中的响应体
+    ARCHIVE_FILE = 2,     // 以 sendfile 发送文件区间
+} ArchiveState;
+
+/**
+ * @brief ArchiveConnection 一个连接 每个连接只处理一个请求
+ * @property fd 套接字 空闲槽为-1
+ * @property state 状态
+ * @property request 请求头
+ * @property received 已读取的请求头长度
+ * @property response 响应头与内存中的响应体
+ * @property response_size 响应的长度
+ * @property response_sent 已发送的响应长度
+ * @property file 文件 无文件体时为-1
+ * @property offset 文件下一个发送的位置
+ * @property end 文件区间的结束位置 不含
+ * @property active 最近一次有进展的时间 单位:us
+ */
+typedef struct ArchiveConnection
+{
+    int fd;
+    ArchiveState state;
+    char request[ARCHIVE_REQUEST_SIZE];
+    size_t received;
+    char *response;
+    size_t response_size;
+    size_t response_sent;
+    int file;
+    off_t offset;
+    off_t end;
+    int64_t active;
+} ArchiveConnection;
+
+/**
+ * @brief ArchiveStat 回放服务统计
+ * @property requests 处理的请求数
+ * @property ranges 其中的范围请求数
+ * @property bytes 以 sendfile 发送的字节数
+ */
+typedef struct ArchiveStat
+{
+    int64_t requests;
+    int64_t ranges;
+    int64_t bytes;
+} ArchiveStat;
+
+/**
+ * @brief ArchiveServer 录像回放服务
+ * @note 独立线程在 epoll 上服务固定数量的连接, 以空闲 IO 优先级和较低的 CPU 优先级运行,
+ *       回放不影响采集与录像; 文件体以 sendfile 零拷贝发送, 支持单个字节范围
+ * @property config 配置
+ * @property dir_fd 录像目录
+ * @property listen_fd 监听套接字
+ * @property epoll_fd epoll
+ * @property stop_fd 停止通知
+ * @property listening 监听套接字是否在 epoll 中 连接数满时移出
+ * @property active 正在服务的连接数
+ * @property connections 连接槽 共 config.connections 个
+ * @property stat 统计
+ */
+typedef struct ArchiveServer
+{
+    ArchiveConfig config;
+    int dir_fd;
+    int listen_fd;
+    int epoll_fd;
+    int stop_fd;
+    int listening;
+    unsigned int active;
+    ArchiveConnection *connections;
+    ArchiveStat stat;
+    pthread_t thread;
+} ArchiveServer;
+
+/**
+ * @brief open_archive_server 打开录像目录并开始监听
+ * @param config 配置
+ * @return ArchiveServer* 失败返回NULL
+ */
+ArchiveServer *open_archive_server(ArchiveConfig config);
+
+/**
+ * @brief close_archive_server 停止服务线程并关闭所有连接
+ * @param server 回放服务
+ */
+void close_archive_server(ArchiveServer *server);
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include <libavcodec/avcodec.h>
+
+#include "./logger.h"
+#include "./tool.h"
+
+// 行跨度对齐 满足 AVX-512 与 NEON 的对齐要求
+#define ARENA_STRIDE_ALIGN 64
+
+// 大页大小
+#define ARENA_HUGE_PAGE (2 << 20)
+
+/**
+ * @brief FrameArenaStat 帧内存池统计
+ * @property size 槽数量
+ * @property slot_size 单个槽的大小 单位:字节
+ * @property in_use 正在使用的槽数量
+ * @property high_water 同时使用槽数量的最大值
+ * @property fallback 退回默认分配器的次数
+ * @property huge 是否由 MAP_HUGETLB 大页提供
+ */
+typedef struct FrameArenaStat
+{
+    unsigned int size;
+    size_t slot_size;
+    unsigned int in_use;
+    unsigned int high_water;
+    int64_t fallback;
+    int huge;
+} FrameArenaStat;
+
+/**
+ * @brief FrameArena 解码帧内存池, 预先映射并触碰全部内存
+ * @note 作为解码器上下文的 get_buffer2, 帧引用全部释放后槽自动回收
+ * @property base 映射的内存起始
+ * @property mapped 映射的大小
+ * @property format 槽布局对应的像素格式
+ * @property width 槽布局对应的宽
+ * @property height 槽布局对应的高
+ * @property linesize 各平面的行跨度
+ * @property offset 各平面在槽内的偏移
+ * @property planes 平面数量
+ * @property slots 以映射内存为存储的槽对象池
+ * @property refs 引用计数 持有者与每个在用的槽各占一个
+ * @property use_huge 是否尝试使用大页
+ */
+typedef struct FrameArena
+{
+    uint8_t *base;
+    size_t mapped;
+    enum AVPixelFormat format;
+    int width;
+    int height;
+    int linesize[4];
+    size_t offset[4];
+    int planes;
+    ObjectPool *slots;
+    unsigned int refs;
+    int use_huge;
+    FrameArenaStat stat;
+    pthread_mutex_t mutex;
+} FrameArena;
+
+/**
+ * @brief open_frame_arena 创建帧内存池并按解码器上下文的尺寸和格式预分配
+ * @param ctx 已打开的解码器上下文 用于计算对齐
+ * @param num 槽数量
+ * @param use_huge 是否尝试使用 MAP_HUGETLB, 失败时退化为透明大页
+ * @return FrameArena* 失败返回NULL
+ */
+FrameArena *open_frame_arena(AVCodecContext *ctx, unsigned int num, int use_huge);
+
+/**
+ * @brief attach_frame_arena 将内存池设置为解码器上下文的帧分配器
+ * @param arena 内存池
+ * @param ctx 解码器上下文
+ */
+void attach_frame_arena(FrameArena *arena, AVCodecContext *ctx);
+
+/**
+ * @brief get_frame_arena_stat 获取内存池统计
+ * @param arena 内存池
+ * @return FrameArenaStat 统计信息
+ */
+FrameArenaStat get_frame_arena_stat(FrameArena *arena);
+
+/**
+ * @brief close_frame_arena 释放持有者的引用, 仍在使用的帧释放后再解除映射
+ * @param arena 内存池
+ */
+void close_frame_arena(FrameArena *arena);
+
+#endif
@@ -1,15 +1,24 @@
 #ifndef CAMERA_H
-#define CMAERA_H
+#define CAMERA_H
 
 #include <stdio.h>
+#include <errno.h>
+#include <ctype.h>
+#include <limits.h>
+#include <string.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <memory.h>
+#include <math.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/ioctl.h>
 #include <sys/types.h>
+#include <sys/inotify.h>
 #include <linux/videodev2.h>
 #include <libavutil/mathematics.h>
+#include <libavutil/rational.h>
+#include <libavutil/time.h>
 
 #include "./logger.h"
 #include "./tool.h"
@@ -17,16 +26,90 @@
 // 用户层缓冲区大小
 #define BUF_NUM 4
 
+// 能力缓存文件的格式版本 格式变化时加一, 旧缓存被忽略
+#define CAPS_VERSION 1
+
+// 能力缓存路径的最大长度
+#define CAPS_PATH_SIZE 512
+
+// 热插拔监视的目录数上限 设备通常都在 /dev 下
+#define HOTPLUG_MAX_WATCHES 8
+
+// 监视的设备数上限
+#define HOTPLUG_MAX_DEVICES 16
+
+/**
+ * @brief ModeConfig 采集模式校准配置
+ * @property enabled 是否在启动时实测各采集模式并选择开销最低的模式
+ * @property min_fps 实测帧率的下限 为0时取配置的帧率
+ * @property duration 每个模式的测量时长 不含预热 单位:ms 不能为0
+ */
+typedef struct ModeConfig
+{
+    int enabled;
+    unsigned int min_fps;
+    unsigned int duration;
+} ModeConfig;
+
+/**
+ * @brief HotplugFill 相机断开期间的补帧方式
+ */
+typedef enum HotplugFill
+{
+    FILL_NONE = 0,   // 不补帧, 恢复后时间戳跳过断开的时长
+    FILL_REPEAT = 1, // 重复断开前的最后一帧 尚无帧时补黑帧
+    FILL_BLACK = 2,  // 补黑帧
+} HotplugFill;
+
+/**
+ * @brief HotplugConfig 相机热插拔恢复配置
+ * @property enable 断开后是否保留编码器与输出器并等待设备重新出现 否则关闭该路相机
+ * @property fill 断开期间的补帧方式
+ * @property retry 未收到设备出现的通知时重试打开的间隔 单位:ms
+ */
+typedef struct HotplugConfig
+{
+    int enable;
+    HotplugFill fill;
+    unsigned int retry;
+} HotplugConfig;
+
+/**
+ * @brief HotplugWatcher 以 inotify 监视设备节点的出现
+ * @property fd inotify 文件描述符 可加入 epoll
+ * @property wds 各目录的监视描述符
+ * @property watches 监视的目录数
+ * @property device_wds 各设备所在目录的监视描述符
+ * @property names 各设备的文件名
+ * @property devices 监视的设备数
+ */
+typedef struct HotplugWatcher
+{
+    int fd;
+    int wds[HOTPLUG_MAX_WATCHES];
+    unsigned int watches;
+    int device_wds[HOTPLUG_MAX_DEVICES];
+    char names[HOTPLUG_MAX_DEVICES][NAME_MAX + 1];
+    unsigned int devices;
+} HotplugWatcher;
+
 /**
  * @brief 相机
- * @property fd 设备索引号
- * @property config 相机配置信息
+ * @property fd 设备索引号 设备断开后释放时为-1
+ * @property cap 设备属性 能力缓存以其中的驱动 总线 名称与版本为键
  * @property user_buf 用户层缓冲区
+ * @property sequence 期望的下一帧驱动序号
+ * @property lost 驱动缓冲区溢出丢失的帧数 由序号间隔统计
+ * @property disconnected 设备是否已断开 出队或入队返回 ENODEV EIO 或 ENXIO 时置位
  */
 typedef struct Camera
 {
     int fd;
+    struct v4l2_capability cap;
     BufType *usr_buf;
+    uint32_t sequence;
+    int64_t lost;
+    int disconnected;
 } Camera;
 
 /**
@@ -59,19 +142,104 @@ int set_camera_config(Camera *camera, Config config);
 Config get_config(Camera *camera);
 
 /**
- * @brief get_available_configs 获取相机所有可用设置
+ * @brief get_available_configs 枚举相机所有可用的格式 分辨率与帧间隔
+ * @note 连续或步进的分辨率取最小 最大值及范围内的常用分辨率, 连续或步进的帧间隔
+ *       取最小 最大值及范围内的常用帧率; 驱动不支持枚举帧间隔时 time_base 为 {0, 1}.
+ *       只保留 MJPEG 与 YUYV 格式
+ * @param camera 相机设备
+ * @return Array* 设置信息 元素为 Config, 只填写分辨率 格式与帧间隔
+ */
+Array *get_available_configs(Camera *camera);
+
+/**
+ * @brief load_camera_configs 从缓存读取相机可用设置, 缓存不存在时枚举并写入缓存
+ * @note 缓存以驱动 总线 名称与驱动版本为键, 同一设备重启后不再逐个查询
+ * @param camera 相机设备
+ * @param cache_dir 缓存目录 为空时不使用缓存
+ * @return Array* 设置信息 元素为 Config
+ */
+Array *load_camera_configs(Camera *camera, const char *cache_dir);
+
+/**
+ * @brief read_camera_mode 读取缓存的采集模式校准结果
  * @param camera 相机设备
- * @return LinkedList* 设置信息
+ * @param cache_dir 缓存目录 为空时不使用缓存
+ * @param request 校准条件 分辨率下限
+ * @param min_fps 帧率下限
+ * @param mode 校准选出的模式 只写入分辨率 格式与帧间隔
+ * @return int 命中返回0, 否则返回-1
+ */
+int read_camera_mode(Camera *camera, const char *cache_dir, Config request, unsigned int min_fps, Config *mode);
+
+/**
+ * @brief write_camera_mode 缓存采集模式校准结果
+ * @param camera 相机设备
+ * @param cache_dir 缓存目录 为空时不缓存
+ * @param request 校准条件 分辨率下限
+ * @param min_fps 帧率下限
+ * @param mode 校准选出的模式
+ * @return int 成功返回0, 失败返回-1
+ */
+int write_camera_mode(Camera *camera, const char *cache_dir, Config request, unsigned int min_fps, Config mode);
+
+/**
+ * @brief match_camera_config 在可用设置中查找与配置相符的项
+ * @param configs 可用设置 元素为 Config
+ * @param config 配置 分辨率与格式可用但帧间隔不可用时改为最接近的可用帧间隔
+ * @return int 完全相符返回0, 修改了帧间隔返回1, 分辨率或格式不可用返回-1
  */
-LinkedList *get_available_configs(Camera *camera);
+int match_camera_config(Array *configs, Config *config);
 
 /**
- * @brief get_frame 读取一帧图像
+ * @brief get_frame 读取一帧图像, 不等待
  * @param camera 相机设备
- * @return BufType* 返回图像帧的指针
+ * @return BufType* 返回图像帧的指针 没有就绪的帧或出错返回NULL, 设备断开时同时置位 disconnected
  */
 BufType *get_frame(Camera *camera);
 
+/**
+ * @brief release_camera 设备断开后释放缓冲区并关闭文件描述符, 结构保留供重新打开
+ * @param camera 相机设备
+ */
+void release_camera(Camera *camera);
+
+/**
+ * @brief reopen_camera 重新打开已释放的设备, 设置配置并开始采集
+ * @note 设备节点尚不存在时直接返回, 不输出日志; 丢帧统计延续
+ * @param camera 已释放的相机设备
+ * @param dev 设备路径
+ * @param config 配置信息
+ * @return int 成功返回0, 失败返回-1
+ */
+int reopen_camera(Camera *camera, const char *dev, Config config);
+
+/**
+ * @brief open_hotplug_watcher 创建设备节点监视器
+ * @return HotplugWatcher* 失败返回NULL
+ */
+HotplugWatcher *open_hotplug_watcher(void);
+
+/**
+ * @brief watch_hotplug_device 监视一个设备节点的出现
+ * @param watcher 监视器
+ * @param dev 设备路径
+ * @return int 成功返回0, 失败返回-1
+ */
+int watch_hotplug_device(HotplugWatcher *watcher, const char *dev);
+
+/**
+ * @brief read_hotplug_watcher 读取所有待处理的通知, 不等待
+ * @param watcher 监视器
+ * @return int 监视的设备出现或权限变化的通知数
+ */
+int read_hotplug_watcher(HotplugWatcher *watcher);
+
+/**
+ * @brief close_hotplug_watcher 关闭监视器
+ * @param watcher 监视器
+ */
+void close_hotplug_watcher(HotplugWatcher *watcher);
+
 /**
  * @brief close_camera 关闭设备
  * @return 关闭成功返回0, 失败返回-1
@@ -2,28 +2,92 @@
 #define CODEC_H
 
 #include <stdlib.h>
+#include <limits.h>
 
 #include <libavformat/avformat.h>
 #include <libavcodec/avcodec.h>
 #include <libavutil/opt.h>
 #include <libavutil/imgutils.h>
+#include <libswscale/swscale.h>
 
 #include "./tool.h"
 #include "./logger.h"
+#include "./sink.h"
+#include "./decoder.h"
+#include "./live.h"
+#include "./udp.h"
+#include "./hls.h"
+#include "./motion.h"
+#include "./encoder.h"
 
+/**
+ * @brief PacketStat 编码输出的包大小统计
+ * @note 方差由 square / packets - (bytes / packets)^2 得到, 周期性关键帧会显著抬高方差
+ * @property packets 包数
+ * @property bytes 字节数之和
+ * @property square 字节数的平方和
+ * @property max 最大的包 单位:字节
+ */
+typedef struct PacketStat
+{
+    int64_t packets;
+    int64_t bytes;
+    double square;
+    int64_t max;
+} PacketStat;
+
+/**
+ * @brief Codec 编解码器
+ * @property in_codec 解码器
+ * @property out_codec 编码器
+ * @property backend 编码器后端
+ * @property out_codec_ctx 编码器上下文
+ * @property decoder 解码池 持有各解码器上下文
+ * @property scaler 输入尺寸与编码器不一致时的缩放器
+ * @property scaled 缩放后的图像
+ * @property since_key 当前GOP已输出的帧数 包含关键帧
+ * @property motion 按运动区域分配码率的活动图 未启用时为NULL
+ * @property vbv_latency VBV 缓冲对应的时长 单位:ms 调整码率时沿用
+ * @property packet 包大小统计
+ */
 typedef struct Codec
 {
     AVCodec *in_codec;
     AVCodec *out_codec;
-    AVCodecContext *in_codec_ctx;
+    const EncoderBackend *backend;
     AVCodecContext *out_codec_ctx;
-    AVFrame *decoded_frame;
+    DecodePool *decoder;
+    struct SwsContext *scaler;
+    AVFrame *scaled;
+    unsigned int since_key;
+    MotionMap *motion;
+    unsigned int vbv_latency;
+    PacketStat packet;
 } Codec;
 
+/**
+ * @brief Output 输出器
+ * @property frm_ctx 封装上下文
+ * @property stream 输出流
+ * @property sink 文件写入器 网络输出时为NULL
+ * @property live 直播发送线程 同步写入时为NULL
+ * @property udp UDP 匀速发送线程 非 UDP 输出时为NULL
+ * @property hls 低延迟 HLS 写入器 非 HLS 输出时为NULL
+ * @property abort 置位后中断阻塞中的网络IO
+ * @property extradata 编码器重新打开后待随下一个包发送的参数集 没有时为NULL
+ * @property extradata_size 参数集的长度
+ */
 typedef struct Output
 {
     AVFormatContext *frm_ctx;
     AVStream *stream;
+    FileSink *sink;
+    LiveWriter *live;
+    UdpSender *udp;
+    HlsWriter *hls;
+    volatile int abort;
+    uint8_t *extradata;
+    int extradata_size;
 } Output;
 
 /**
@@ -39,24 +103,97 @@ Codec *init_codec(LogLevel level);
  */
 void destroy_codec(Codec *codec);
 
+/**
+ * @brief find_input_decoder 查找采集格式对应的解码器
+ * @note MJPEG 使用 mjpeg 解码器, YUYV 使用 rawvideo 解码器, 像素格式见 get_input_pix_fmt
+ * @param pix_format 采集格式
+ * @return AVCodec* 不存在时返回NULL
+ */
+AVCodec *find_input_decoder(PixFormat pix_format);
+
+/**
+ * @brief create_black_frame 生成一帧采集格式的黑帧 用于相机断开期间补帧
+ * @note MJPEG 以编码器生成一次, 之后复制使用
+ * @param config 采集配置 使用分辨率与格式
+ * @return BufType* 失败返回NULL
+ */
+BufType *create_black_frame(Config config);
+
 /**
  * @brief open_codec 打开编解码器
  * @param codec 待打开的编解码器
  * @param config 设置
+ * @param workers 执行解码任务的线程池
+ * @param on_ready 有帧解码完成时的回调 可为NULL
+ * @param opaque 回调参数
  * @return int 启动成功返回0, 失败返回1
  */
-int open_codec(Codec *codec, Config config);
+int open_codec(Codec *codec, Config config, WorkerPool *workers, void (*on_ready)(void *), void *opaque);
 
 /**
- * @brief dispose_codec 处理编解码
+ * @brief submit_codec 提交一帧到解码池异步解码, 不等待
  * @param codec 工作的编解码器
- * @param output 输出器的数组
+ * @param frame 处理帧 由编解码器负责释放
+ * @param time_stamp 处理帧的时间戳
+ * @return int 提交成功返回0, 解码窗口已满丢弃该帧返回-1
+ */
+int submit_codec(Codec *codec, BufType *frame, int64_t time_stamp);
+
+/**
+ * @brief receive_codec 按采集顺序取出下一帧解码结果, 不等待
+ * @param codec 工作的编解码器
+ * @param decoded 解码结果 图像由调用方释放
+ * @return int 成功返回0, 该帧解码失败返回-1, 下一帧尚未完成返回-2
+ */
+int receive_codec(Codec *codec, DecodedFrame *decoded);
+
+/**
+ * @brief dispose_codec 编码一帧解码后的图像并写入所有输出器
+ * @note 图像尺寸与编码器不一致时先缩放, 启用活动图时附加 ROI
+ * @param codec 工作的编解码器
+ * @param output 输出器的数组 元素可为NULL
  * @param length 输出器的长度
- * @param frame 处理帧
+ * @param frame 解码后的图像
  * @param time_stamp 处理帧的时间戳
- * @return int 处理成功返回0, 失败返回-1, 跳过返回-2
+ * @param key 是否强制编码为关键帧
+ * @return int 处理成功返回0, 失败返回-1
+ */
+int dispose_codec(Codec *codec, Output **output, unsigned int length, AVFrame *frame, int64_t time_stamp, int key);
+
+/**
+ * @brief set_codec_bit_rate 调整编码器的目标码率, 从下一帧开始生效
+ * @note 只有 live_bit_rate 的后端支持, 其余后端须重新打开编码器
+ * @param codec 工作的编解码器
+ * @param bit_rate 码率
+ * @return int 成功返回0, 后端不支持运行时修改返回-1 编码器不变
+ */
+int set_codec_bit_rate(Codec *codec, int64_t bit_rate);
+
+/**
+ * @brief set_codec_motion 启用或关闭按运动区域分配码率
+ * @note 依赖 libx264 的自适应量化, 重新打开编码器后继续生效
+ * @param codec 工作的编解码器
+ * @param config 配置 enable 为0时关闭
+ * @return int 成功返回0, 失败返回-1
  */
-int dispose_codec(Codec *codec, Output **output, unsigned int length, BufType frame, int64_t time_stamp);
+int set_codec_motion(Codec *codec, MotionConfig config);
+
+/**
+ * @brief is_codec_gop_end 编码器的下一帧是否本来就会是关键帧
+ * @note 在此时重新打开编码器不会额外增加关键帧
+ * @param codec 工作的编解码器
+ * @return int 是返回1
+ */
+int is_codec_gop_end(Codec *codec);
+
+/**
+ * @brief reconfig_codec 按新的尺寸 码率与档位重新打开编码器, 下一帧为关键帧
+ * @note 参数集变化后输出器需要以新的 extradata 重新写入文件头
+ * @param codec 工作的编解码器
+ * @param config 新的配置
+ * @return int 参数集不变返回0, 参数集变化返回1, 失败返回-1
+ */
+int reconfig_codec(Codec *codec, Config config);
 
 /**
  * @brief close_codec 关闭编解码器
@@ -66,12 +203,75 @@ void close_codec(Codec *codec);
 
 /**
  * @brief open_output 配置输出上下文
+ * @note 输出流的编码参数与 extradata 取自编码器上下文
+ * @param config 配置
+ * @param encoder 编码器上下文
+ * @param path 输出地址
+ * @param format 输出格式
+ * @return Output 输出器
+ */
+Output *open_output(Config config, const AVCodecContext *encoder, const char *path, const char *format);
+
+/**
+ * @brief open_live_output 配置异步发送的直播输出上下文
+ * @note 编码线程只将包放入有界队列, 由独立线程写入网络; 连接也在该线程中进行, 不阻塞调用方,
+ *       连接完成前的包被丢弃, 连接失败时 LiveStat.state 为 LIVE_FAILED
  * @param config 配置
+ * @param encoder 编码器上下文
  * @param path 输出地址
  * @param format 输出格式
+ * @param queue_size 发送队列容量 单位:包
+ * @return Output 输出器
+ */
+Output *open_live_output(Config config, const AVCodecContext *encoder, const char *path, const char *format,
+                         unsigned int queue_size);
+
+/**
+ * @brief open_file_output 配置写入本地文件的输出上下文
+ * @note 使用 FileSink 按大块对齐写入, 并按 bit_rate * save_time 预分配空间
+ * @param config 配置
+ * @param encoder 编码器上下文
+ * @param path 文件路径
+ * @param format 输出格式
+ * @param sink_config 文件写入器配置
+ * @return Output 输出器
+ */
+Output *open_file_output(Config config, const AVCodecContext *encoder, const char *path, const char *format,
+                         SinkConfig sink_config);
+
+/**
+ * @brief open_udp_output 配置以 MPEG-TS 经 UDP 发送的输出上下文
+ * @note 每个包写入后立即刷新, TS 数据按数据报入队, 由发送线程在帧间隔内匀速发出
+ * @param config 配置
+ * @param encoder 编码器上下文
+ * @param address 目的地址 格式为 host:port 可为组播地址
  * @return Output 输出器
  */
-Output *open_output(Config config, const char *path, const char *format);
+Output *open_udp_output(Config config, const AVCodecContext *encoder, const char *address);
+
+/**
+ * @brief open_hls_output 配置写入 CMAF 分片与低延迟 HLS 播放列表的输出上下文
+ * @note 包经 HlsWriter 写入, 由其在部分段边界切出分片
+ * @param config 配置
+ * @param encoder 编码器上下文
+ * @param hls_config HLS 配置
+ * @param name 相机名称 作为输出子目录名
+ * @param sequence 第一个分段的媒体序号
+ * @param discontinuity 不连续序号 重新打开时加一
+ * @return Output 输出器
+ */
+Output *open_hls_output(Config config, const AVCodecContext *encoder, HlsConfig hls_config, const char *name,
+                        unsigned int sequence, unsigned int discontinuity);
+
+/**
+ * @brief rebind_output 编码器重新打开后继续使用直播输出器, 不断开连接
+ * @note 新的参数集作为 AV_PKT_DATA_NEW_EXTRADATA 随下一个包交给封装器, FLV 封装器据此
+ *       在流中写入新的序列头, 播放器按新的尺寸继续播放; 编码器的时间基须不变
+ * @param output 输出器
+ * @param encoder 重新打开的编码器
+ * @return int 成功返回0, 不是 H.264 的 FLV 直播输出返回-1 须重新打开
+ */
+int rebind_output(Output *output, const AVCodecContext *encoder);
 
 /**
  * @brief close_output 关闭输出上下文
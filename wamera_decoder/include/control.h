@@ -0,0 +1,71 @@
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/eventfd.h>
+
+#include "./logger.h"
+#include "./affinity.h"
+
+// 单条命令与回复的最大长度
+#define CONTROL_LINE_SIZE 512
+
+// 等待客户端发送命令的超时 单位:ms
+#define CONTROL_TIMEOUT 1000
+
+/**
+ * @brief ControlHandler 执行一条命令
+ * @param opaque 注册时传入的参数
+ * @param command 去掉换行的命令 可被修改
+ * @param reply 回复的缓冲 不含换行
+ * @param size 回复缓冲的大小
+ * @return int 成功返回0, 失败返回-1
+ */
+typedef int (*ControlHandler)(void *opaque, char *command, char *reply, size_t size);
+
+/**
+ * @brief ControlServer 控制接口
+ * @note 独立线程在 Unix 套接字上依次服务连接, 每个连接发送一行命令, 收到
+ *       `OK` 或 `ERR` 开头的一行回复后关闭; 命令在控制线程中执行
+ * @property path 套接字路径
+ * @property listen_fd 监听套接字
+ * @property stop_fd 停止通知
+ * @property handler 命令处理函数
+ * @property opaque 处理函数的参数
+ * @property thread 控制线程
+ */
+typedef struct ControlServer
+{
+    char path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+    int listen_fd;
+    int stop_fd;
+    ControlHandler handler;
+    void *opaque;
+    pthread_t thread;
+} ControlServer;
+
+/**
+ * @brief open_control_server 监听控制套接字并启动控制线程
+ * @param path 套接字路径 已存在的旧套接字文件被替换
+ * @param handler 命令处理函数
+ * @param opaque 处理函数的参数
+ * @return ControlServer* 失败返回NULL
+ */
+ControlServer *open_control_server(const char *path, ControlHandler handler, void *opaque);
+
+/**
+ * @brief close_control_server 停止控制线程并删除套接字文件
+ * @param server 控制接口
+ */
+void close_control_server(ControlServer *server);
+
+#endif
@@ -0,0 +1,182 @@
+#ifndef DECODER_H
+#define DECODER_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include <libavcodec/avcodec.h>
+#include <libswscale/swscale.h>
+
+#include "./tool.h"
+#include "./logger.h"
+#include "./arena.h"
+#include "./worker.h"
+
+/**
+ * @brief SlotState 重排序槽的状态
+ */
+typedef enum SlotState
+{
+    SLOT_EMPTY = 0,   // 空闲
+    SLOT_PENDING = 1, // 已提交, 等待解码
+    SLOT_READY = 2,   // 解码完成
+    SLOT_FAILED = 3,  // 解码失败
+} SlotState;
+
+/**
+ * @brief DecodeSlot 重排序槽, 按采集序号保存解码结果
+ * @property state 槽状态
+ * @property buf 待解码的压缩帧
+ * @property frame 解码后的图像
+ * @property time_stamp 采集时间戳
+ * @property capture_time 采集时刻 单位:us
+ */
+typedef struct DecodeSlot
+{
+    SlotState state;
+    BufType *buf;
+    AVFrame *frame;
+    int64_t time_stamp;
+    int64_t capture_time;
+} DecodeSlot;
+
+/**
+ * @brief DecodeContext 解码器上下文, 同一时刻只由一个解码任务使用
+ * @property in_codec_ctx 解码器上下文
+ * @property packet 解码输入
+ * @property packed YUYV 采集时 rawvideo 输出的打包帧
+ * @property unpacker 打包的 YUYV 转为平面 4:2:2 的转换器
+ */
+typedef struct DecodeContext
+{
+    AVCodecContext *in_codec_ctx;
+    AVPacket *packet;
+    AVFrame *packed;
+    struct SwsContext *unpacker;
+} DecodeContext;
+
+/**
+ * @brief DecodedFrame 按采集顺序取出的解码结果
+ * @property frame 解码后的图像
+ * @property time_stamp 采集时间戳
+ * @property capture_time 采集时刻 单位:us
+ */
+typedef struct DecodedFrame
+{
+    AVFrame *frame;
+    int64_t time_stamp;
+    int64_t capture_time;
+} DecodedFrame;
+
+/**
+ * @brief DecodePool 多上下文并行解码池
+ * @note 解码任务在共享线程池上执行, 每个任务占用一个空闲的解码器上下文,
+ *       每解码一帧后重新排队以便与其他相机的任务轮流执行,
+ *       解码结果经重排序窗口按序取出
+ * @property num 解码器上下文数 即同时执行的解码任务数上限
+ * @property contexts 解码器上下文
+ * @property idle 空闲的解码器上下文索引 元素为 unsigned int
+ * @property active 执行中的解码任务数
+ * @property workers 执行解码任务的线程池
+ * @property on_ready 有帧解码完成时的回调 在线程池中调用
+ * @property opaque 回调参数
+ * @property window 重排序窗口大小
+ * @property slots 重排序槽 按序号对 window 取模索引
+ * @property queue 待解码的序号队列 元素为 uint64_t
+ * @property next_submit 下一个提交的序号
+ * @property next_receive 下一个取出的序号
+ * @property arena 各解码器上下文共用的帧内存池
+ * @property cpu_time 解码累计消耗的CPU时间 单位:us
+ */
+typedef struct DecodePool
+{
+    unsigned int num;
+    DecodeContext *contexts;
+    RingBuffer *idle;
+    unsigned int active;
+    WorkerPool *workers;
+    void (*on_ready)(void *opaque);
+    void *opaque;
+    unsigned int window;
+    DecodeSlot *slots;
+    RingBuffer *queue;
+    uint64_t next_submit;
+    uint64_t next_receive;
+    FrameArena *arena;
+    int64_t cpu_time;
+    int stop;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} DecodePool;
+
+/**
+ * @brief get_input_pix_fmt 采集格式在解码器上下文中的像素格式
+ * @note YUYV 以 rawvideo 解码为打包的 4:2:2, 解码池再转为平面格式,
+ *       遮挡 水印 降噪与运动检测只处理平面格式
+ * @param pix_format 采集格式
+ * @return enum AVPixelFormat 像素格式
+ */
+enum AVPixelFormat get_input_pix_fmt(PixFormat pix_format);
+
+/**
+ * @brief open_decode_pool 创建并打开解码池
+ * @param codec 解码器
+ * @param config 配置
+ * @param num 解码器上下文数 为0时使用在线CPU数
+ * @param workers 执行解码任务的线程池
+ * @param on_ready 有帧解码完成时的回调 可为NULL
+ * @param opaque 回调参数
+ * @return DecodePool* 失败返回NULL
+ */
+DecodePool *open_decode_pool(const AVCodec *codec, Config config, unsigned int num,
+                             WorkerPool *workers, void (*on_ready)(void *), void *opaque);
+
+/**
+ * @brief resize_decode_pool 采集分辨率变化后以新的宽高重新打开解码器上下文
+ * @note 只在提交帧的线程中调用, 先等待已提交的帧解码完成;
+ *       失败时解码池不再接收新的帧
+ * @param pool 解码池
+ * @param config 新的采集配置
+ * @return int 成功返回0, 失败返回-1
+ */
+int resize_decode_pool(DecodePool *pool, Config config);
+
+/**
+ * @brief drain_decode_pool 停止接收新任务并等待执行中的解码任务结束
+ * @note 未开始解码的帧标记为失败, 已完成的帧仍可取出
+ * @param pool 解码池
+ */
+void drain_decode_pool(DecodePool *pool);
+
+/**
+ * @brief close_decode_pool 等待解码任务结束并释放解码池
+ * @param pool 解码池
+ */
+void close_decode_pool(DecodePool *pool);
+
+/**
+ * @brief submit_decode_pool 提交一帧待解码
+ * @note 窗口已满时返回-1, 由调用方决定丢帧
+ * @param pool 解码池
+ * @param buf 压缩帧 提交成功后由解码池负责释放
+ * @param time_stamp 采集时间戳
+ * @return int 成功返回0, 失败返回-1
+ */
+int submit_decode_pool(DecodePool *pool, BufType *buf, int64_t time_stamp);
+
+/**
+ * @brief get_decode_pool_cpu_time 获取解码累计消耗的CPU时间
+ * @param pool 解码池
+ * @return int64_t CPU时间 单位:us
+ */
+int64_t get_decode_pool_cpu_time(DecodePool *pool);
+
+/**
+ * @brief receive_decode_pool 按采集顺序取出下一帧解码结果, 不等待
+ * @param pool 解码池
+ * @param decoded 解码结果 图像由调用方释放
+ * @return int 成功返回0, 该帧解码失败返回-1, 下一帧尚未完成返回-2
+ */
+int receive_decode_pool(DecodePool *pool, DecodedFrame *decoded);
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef DENOISE_H
+#define DENOISE_H
+
+#include <stdint.h>
+
+#include <libavutil/frame.h>
+#include <libavutil/pixdesc.h>
+#include <libavutil/time.h>
+
+#include "./logger.h"
+#include "./tool.h"
+
+// 混合权重的精度 权重取值 0~DENOISE_WEIGHT_ONE
+#define DENOISE_WEIGHT_ONE 128
+
+// 静止像素当前帧权重的下限 避免历史帧长期残留
+#define DENOISE_MIN_WEIGHT 16
+
+/**
+ * @brief DenoiseConfig 时域降噪配置
+ * @property enable 是否启用
+ * @property strength 降噪强度 0~100 越大静止区域越平滑
+ * @property threshold 判定为运动的像素差 差值达到该值时直接使用当前帧
+ */
+typedef struct DenoiseConfig
+{
+    int enable;
+    unsigned int strength;
+    unsigned int threshold;
+} DenoiseConfig;
+
+/**
+ * @brief DenoiseStat 降噪统计
+ * @property frames 已处理的帧数
+ * @property time 累计耗时 单位:us
+ */
+typedef struct DenoiseStat
+{
+    int64_t frames;
+    int64_t time;
+} DenoiseStat;
+
+/**
+ * @brief Denoiser 运动自适应的时域递归降噪器
+ * @note 每个像素与上一帧的输出按差值混合: 差值小时视为噪声偏向历史,
+ *       差值达到阈值时视为运动直接使用当前帧
+ * @property config 配置
+ * @property base 差值为0时当前帧的权重
+ * @property slope 差值每增加1当前帧权重的增量
+ * @property format 历史帧对应的像素格式
+ * @property width 历史帧对应的宽
+ * @property height 历史帧对应的高
+ * @property history Y/U/V 平面上一帧的输出 行跨度等于平面宽
+ * @property plane_w 各平面的宽
+ * @property plane_h 各平面的高
+ * @property primed 历史帧是否有效
+ * @property stat 统计
+ */
+typedef struct Denoiser
+{
+    DenoiseConfig config;
+    int base;
+    int slope;
+    int format;
+    int width;
+    int height;
+    uint8_t *history[3];
+    int plane_w[3];
+    int plane_h[3];
+    int primed;
+    DenoiseStat stat;
+} Denoiser;
+
+/**
+ * @brief open_denoiser 创建降噪器 历史帧在第一帧时分配
+ * @param config 配置
+ * @return Denoiser* 失败返回NULL
+ */
+Denoiser *open_denoiser(DenoiseConfig config);
+
+/**
+ * @brief denoise_frame 原地降噪一帧
+ * @note 只支持 8 位平面 YUV 格式; 尺寸或格式变化后的第一帧原样输出并作为历史
+ * @param denoiser 降噪器
+ * @param frame 解码后的图像 不可写时先复制
+ * @return int 成功返回0, 格式不支持或失败返回-1
+ */
+int denoise_frame(Denoiser *denoiser, AVFrame *frame);
+
+/**
+ * @brief get_denoiser_stat 获取统计
+ * @param denoiser 降噪器
+ * @return DenoiseStat 统计
+ */
+DenoiseStat get_denoiser_stat(Denoiser *denoiser);
+
+/**
+ * @brief close_denoiser 释放降噪器
+ * @param denoiser 降噪器
+ */
+void close_denoiser(Denoiser *denoiser);
+
+#endif
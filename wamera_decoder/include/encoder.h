@@ -0,0 +1,97 @@
+#ifndef ENCODER_H
+#define ENCODER_H
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <limits.h>
+
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/opt.h>
+#include <libavutil/pixdesc.h>
+#include <libavutil/time.h>
+
+#include "./logger.h"
+#include "./tool.h"
+
+// 校准时每个候选编码的合成帧数 前 ENCODER_WARMUP 帧不计入
+#define ENCODER_CALIBRATE_FRAMES 24
+#define ENCODER_WARMUP 4
+
+// 维持帧率时单帧编码耗时最多占帧间隔的比例 为解码与抖动留出余量
+#define ENCODER_HEADROOM 0.8
+
+/**
+ * @brief EncoderBackend 编码器后端
+ * @property name ffmpeg 中的编码器名
+ * @property preset_option 速度档位对应的私有选项名 为NULL时不支持档位
+ * @property presets 速度档位 按编码代价从低到高排列
+ * @property preset_num 档位数
+ * @property default_preset 未配置档位时使用的档位索引
+ * @property pix_fmt 编码使用的像素格式
+ * @property options 低延迟相关的私有选项 格式为 key=value:key=value
+ * @property refresh_options 以周期性帧内刷新代替关键帧的私有选项 为NULL时不支持
+ * @property slice_format 限制 slice 字节数的私有选项 以 %u 代入字节数 为NULL时不支持
+ * @property live_bit_rate 打开后修改码率是否在下一帧生效 否则只在重新打开时生效
+ */
+typedef struct EncoderBackend
+{
+    const char *name;
+    const char *preset_option;
+    const char *const *presets;
+    int preset_num;
+    int default_preset;
+    enum AVPixelFormat pix_fmt;
+    const char *options;
+    const char *refresh_options;
+    const char *slice_format;
+    int live_bit_rate;
+} EncoderBackend;
+
+/**
+ * @brief find_encoder_backend 按名称查找当前 ffmpeg 中可用的后端
+ * @param name 编码器名 为空或 auto 时返回第一个可用的后端
+ * @return const EncoderBackend* 不存在或不可用时返回NULL
+ */
+const EncoderBackend *find_encoder_backend(const char *name);
+
+/**
+ * @brief find_encoder_preset 查找档位在后端档位表中的索引
+ * @param backend 后端
+ * @param preset 档位名
+ * @return int 不存在时返回默认档位的索引
+ */
+int find_encoder_preset(const EncoderBackend *backend, const char *preset);
+
+/**
+ * @brief open_encoder_context 按后端与配置打开编码器上下文
+ * @note 总是输出全局头, 参数集只在 extradata 中, 由输出器写入文件头;
+ *       后端不支持帧内刷新或 slice 限制时忽略该项并警告
+ * @param backend 后端
+ * @param config 配置 preset 为空时使用后端默认档位
+ * @return AVCodecContext* 失败返回NULL
+ */
+AVCodecContext *open_encoder_context(const EncoderBackend *backend, Config config);
+
+/**
+ * @brief set_encoder_bit_rate 设置目标码率 以 VBV 缓冲约束峰值
+ * @note 缓冲越小单个包越不能超出平均大小, 发送端的排队延迟越低
+ * @param ctx 编码器上下文
+ * @param bit_rate 码率
+ * @param vbv_latency 缓冲对应的时长 单位:ms 为0时为一秒
+ */
+void set_encoder_bit_rate(AVCodecContext *ctx, int64_t bit_rate, unsigned int vbv_latency);
+
+/**
+ * @brief calibrate_encoder 在合成帧上测量可用的后端与档位, 选出能维持帧率且CPU最低的组合
+ * @note 每个后端从配置的档位起逐级加快, 取第一个能维持帧率的档位作为该后端的候选,
+ *       再在各后端的候选中选CPU最低的; 测量的是进程CPU时间, 需在流水线启动前调用
+ * @param config 配置 选出的后端与档位写回 encoder 与 preset
+ * @param formats 需要支持的封装格式 以NULL结尾
+ * @param budget 单路相机的CPU预算 单位:核 为0时不限制
+ * @return int 成功返回0, 没有可用的后端返回-1
+ */
+int calibrate_encoder(Config *config, const char *const *formats, double budget);
+
+#endif
@@ -0,0 +1,102 @@
+#ifndef GOVERNOR_H
+#define GOVERNOR_H
+
+#include <stdint.h>
+
+#include "./logger.h"
+#include "./tool.h"
+#include "./encoder.h"
+
+// CPU占用的统计窗口, 也是两次降级之间的最小间隔 单位:us
+#define GOVERNOR_WINDOW 2000000
+
+// 占用持续低于预算的 GOVERNOR_LOW 多久后才逐级恢复 单位:us
+#define GOVERNOR_UP_HOLD 10000000
+
+// 允许恢复的占用比例 与预算之间留出滞回区间
+#define GOVERNOR_LOW 0.7
+
+// 最大抽帧间隔
+#define GOVERNOR_MAX_DECIMATE 4
+
+/**
+ * @brief GovernorConfig CPU预算调节配置
+ * @property budget 单路相机解码与编码的CPU预算 单位:核 为0时不启用
+ * @property max_decimate 最大抽帧间隔 1为不抽帧 不超过 GOVERNOR_MAX_DECIMATE
+ * @property scale_steps 最多降低分辨率的级数 不超过 RATE_MAX_STEPS
+ */
+typedef struct GovernorConfig
+{
+    double budget;
+    unsigned int max_decimate;
+    unsigned int scale_steps;
+} GovernorConfig;
+
+/**
+ * @brief GovernorLevel 一级调节对应的编码参数
+ * @property preset 编码器速度档位
+ * @property decimate 抽帧间隔 每 decimate 帧编码一帧
+ * @property step 分辨率级数
+ */
+typedef struct GovernorLevel
+{
+    const char *preset;
+    unsigned int decimate;
+    unsigned int step;
+} GovernorLevel;
+
+/**
+ * @brief Governor CPU预算调节器
+ * @note 调节级数按代价从低到高依次为: 逐级加快档位至最快, 逐级增大抽帧间隔,
+ *       逐级降低分辨率; 超出预算时升一级, 持续低于预算一段时间后降一级
+ * @property config 配置
+ * @property backend 编码器后端 提供档位表
+ * @property base_preset 配置的档位在档位表中的索引
+ * @property level 当前级数 0为配置的原始参数
+ * @property max_level 最大级数
+ * @property window_start 当前统计窗口的开始时间 单位:us
+ * @property window_cpu 当前统计窗口内的CPU时间 单位:us
+ * @property usage 上一个统计窗口的CPU占用 单位:核
+ * @property last_change 上次调节的时间 单位:us
+ * @property low_since 占用开始低于恢复阈值的时间 为0表示当前不低于
+ */
+typedef struct Governor
+{
+    GovernorConfig config;
+    const EncoderBackend *backend;
+    int base_preset;
+    unsigned int level;
+    unsigned int max_level;
+    int64_t window_start;
+    int64_t window_cpu;
+    double usage;
+    int64_t last_change;
+    int64_t low_since;
+} Governor;
+
+/**
+ * @brief init_governor 初始化调节器
+ * @param governor 调节器
+ * @param config 配置
+ * @param backend 编码器后端
+ * @param preset 配置的档位 为空时使用后端的默认档位
+ */
+void init_governor(Governor *governor, GovernorConfig config, const EncoderBackend *backend, const char *preset);
+
+/**
+ * @brief update_governor 累计一帧的CPU时间, 统计窗口结束时评估是否调节
+ * @param governor 调节器
+ * @param cpu_time 该帧解码与编码消耗的CPU时间 单位:us
+ * @param now 当前时间 单位:us
+ * @return int 级数改变返回1, 否则返回0
+ */
+int update_governor(Governor *governor, int64_t cpu_time, int64_t now);
+
+/**
+ * @brief get_governor_level 获取当前级数对应的编码参数
+ * @param governor 调节器
+ * @return GovernorLevel 编码参数
+ */
+GovernorLevel get_governor_level(Governor *governor);
+
+#endif
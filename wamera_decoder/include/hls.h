@@ -0,0 +1,161 @@
+#ifndef HLS_H
+#define HLS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <libavformat/avformat.h>
+#include <libavformat/avio.h>
+#include <libavutil/mem.h>
+
+#include "./logger.h"
+#include "./tool.h"
+
+// 目录路径的最大长度
+#define HLS_PATH_SIZE 256
+
+// 每个分段最多的部分段数 达到后提前结束分段
+#define HLS_MAX_PARTS 32
+
+// 播放列表中保留部分段的已完成分段数, 更早分段的部分段文件被删除
+#define HLS_PART_SEGMENTS 2
+
+// 等不到关键帧时分段时长的上限 相对于目标时长; 帧内刷新模式下没有周期性关键帧
+#define HLS_SEGMENT_LIMIT 1.5
+
+// 播放列表的缓冲大小
+#define HLS_PLAYLIST_SIZE 16384
+
+// IO 缓冲大小
+#define HLS_IO_SIZE 65536
+
+/**
+ * @brief HlsConfig 低延迟 HLS 输出配置
+ * @property segment 分段目标时长 单位:ms
+ * @property part 部分段目标时长 单位:ms
+ * @property window 播放列表保留的已完成分段数 更早的分段文件被删除
+ * @property dir 输出目录 应位于 tmpfs, 每路相机写入以相机名称命名的子目录; 为空时不输出
+ */
+typedef struct HlsConfig
+{
+    unsigned int segment;
+    unsigned int part;
+    unsigned int window;
+    char dir[HLS_PATH_SIZE];
+} HlsConfig;
+
+/**
+ * @brief HlsSegment 一个分段
+ * @property sequence 媒体序号
+ * @property duration 时长 单位:us
+ * @property parts 部分段数 为0时部分段文件已删除
+ * @property part_duration 各部分段的时长 单位:us
+ * @property independent 以关键帧开始的部分段 按位标记
+ */
+typedef struct HlsSegment
+{
+    unsigned int sequence;
+    int64_t duration;
+    unsigned int parts;
+    int64_t part_duration[HLS_MAX_PARTS];
+    uint32_t independent;
+} HlsSegment;
+
+/**
+ * @brief HlsWriter 低延迟 HLS 写入器
+ * @note 封装器以 frag_custom 输出 CMAF 分片, 每个部分段是一个 moof+mdat 分片,
+ *       分段由部分段依次拼接而成; 所有文件先写临时文件再重命名, 静态文件服务器
+ *       不会读到写了一半的文件. 在编码线程中同步写入, 目录应位于 tmpfs
+ * @property config 配置
+ * @property dir 本路相机的输出目录
+ * @property frm_ctx 封装上下文
+ * @property pb 交给 libavformat 使用的 IO 上下文
+ * @property buffer 当前部分段的数据
+ * @property size 当前部分段的大小
+ * @property capacity buffer 的容量
+ * @property segments 已完成的分段 元素为 HlsSegment
+ * @property current 正在写入的分段
+ * @property segment_fd 正在写入的分段的临时文件 未打开时为-1
+ * @property frame 帧间隔 单位:us
+ * @property segment_start 当前分段的起始时间 单位:us
+ * @property part_start 当前部分段的起始时间 单位:us
+ * @property last_pts 最后写入的包的时间 单位:us
+ * @property started 当前部分段是否已有包
+ * @property part_key 当前部分段是否以关键帧开始
+ * @property discontinuity 不连续序号 每次重新打开加一, 初始化段的文件名随之变化
+ * @property finished 已结束, 之后封装器写出的数据被丢弃
+ * @property playlist 播放列表的缓冲
+ */
+typedef struct HlsWriter
+{
+    HlsConfig config;
+    char dir[HLS_PATH_SIZE + 64];
+    AVFormatContext *frm_ctx;
+    AVIOContext *pb;
+    uint8_t *buffer;
+    size_t size;
+    size_t capacity;
+    RingBuffer *segments;
+    HlsSegment current;
+    int segment_fd;
+    int64_t frame;
+    int64_t segment_start;
+    int64_t part_start;
+    int64_t last_pts;
+    int started;
+    int part_key;
+    unsigned int discontinuity;
+    int finished;
+    char *playlist;
+} HlsWriter;
+
+/**
+ * @brief open_hls_writer 创建输出目录并清除旧文件
+ * @param config 配置
+ * @param name 相机名称
+ * @param time_base 帧间隔
+ * @param sequence 第一个分段的媒体序号 重新打开时接续之前的序号
+ * @param discontinuity 不连续序号
+ * @return HlsWriter* 失败返回NULL
+ */
+HlsWriter *open_hls_writer(HlsConfig config, const char *name, AVRational time_base, unsigned int sequence,
+                           unsigned int discontinuity);
+
+/**
+ * @brief start_hls_writer 文件头写入后调用, 将其写为初始化段
+ * @param writer 写入器
+ * @param frm_ctx 已写入文件头的封装上下文 使用 writer->pb
+ * @return int 成功返回0, 失败返回-1
+ */
+int start_hls_writer(HlsWriter *writer, AVFormatContext *frm_ctx);
+
+/**
+ * @brief write_hls_packet 写入一个包, 到达部分段或分段边界时先切出分片并更新播放列表
+ * @note 分段在目标时长后的第一个关键帧处切分
+ * @param writer 写入器
+ * @param packet 包 时间戳为输出流的时间基, 不转移所有权
+ * @return int 成功返回0, 失败返回-1
+ */
+int write_hls_packet(HlsWriter *writer, AVPacket *packet);
+
+/**
+ * @brief finish_hls_writer 写出最后的部分段与分段并更新播放列表
+ * @param writer 写入器
+ * @return int 成功返回0, 失败返回-1
+ */
+int finish_hls_writer(HlsWriter *writer);
+
+/**
+ * @brief close_hls_writer 释放写入器 已写出的文件保留
+ * @param writer 写入器
+ */
+void close_hls_writer(HlsWriter *writer);
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef LIVE_H
+#define LIVE_H
+
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <libavformat/avformat.h>
+#include <libavutil/time.h>
+
+#include "./logger.h"
+#include "./tool.h"
+#include "./affinity.h"
+
+/**
+ * @brief LiveState 直播链路的状态
+ */
+typedef enum LiveState
+{
+    LIVE_CONNECTING = 0, // 发送线程正在连接并写入文件头
+    LIVE_CONNECTED = 1,  // 已连接 正常发送
+    LIVE_FAILED = 2,     // 连接失败
+} LiveState;
+
+/**
+ * @brief LiveStat 直播发送队列的状态
+ * @property state 链路状态
+ * @property connect_time 连接并写入文件头的耗时 未连接时为0 单位:us
+ * @property depth 队列中的包数
+ * @property latency 写入延迟 取平滑值与当前写入已耗时的较大者 单位:us
+ * @property need_key 是否因丢包需要编码器尽快输出关键帧 读取后清除
+ * @property dropped 丢弃的包数
+ * @property written 已发送的包数
+ */
+typedef struct LiveStat
+{
+    LiveState state;
+    int64_t connect_time;
+    unsigned int depth;
+    int64_t latency;
+    int need_key;
+    int64_t dropped;
+    int64_t written;
+} LiveStat;
+
+/**
+ * @brief LiveWriter 直播输出的异步发送线程
+ * @note 编码线程只入队, 网络写入在发送线程中进行; 队列满时丢弃新包
+ *       并一直丢弃到下一个关键帧, 保证积压有界且解码端不花屏.
+ *       连接也在发送线程中进行, 连接完成前的包直接丢弃, 连接后请求关键帧
+ * @property frm_ctx 封装上下文 发送线程启动后只由发送线程访问
+ * @property url 由发送线程连接的地址 不需要连接时为NULL
+ * @property state 链路状态
+ * @property connect_time 连接并写入文件头的耗时 单位:us
+ * @property packets 待发送的包 元素为 AVPacket*
+ * @property latency 写入延迟的指数平滑值 单位:us
+ * @property write_start 当前写入的开始时间 空闲时为0 单位:us
+ * @property skip 是否正在丢弃到下一个关键帧
+ * @property error 写入是否出错
+ */
+typedef struct LiveWriter
+{
+    AVFormatContext *frm_ctx;
+    char *url;
+    LiveState state;
+    int64_t connect_time;
+    RingBuffer *packets;
+    pthread_t thread;
+    int64_t latency;
+    int64_t write_start;
+    int skip;
+    int need_key;
+    int64_t dropped;
+    int64_t written;
+    int error;
+    int stop;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} LiveWriter;
+
+/**
+ * @brief open_live_writer 创建发送线程
+ * @param frm_ctx 封装上下文 url 为NULL时已写入文件头, 否则已添加流并初始化封装器
+ * @param capacity 队列容量 单位:包
+ * @param url 由发送线程打开并写入文件头的地址 为NULL时不连接
+ * @return LiveWriter* 失败返回NULL
+ */
+LiveWriter *open_live_writer(AVFormatContext *frm_ctx, unsigned int capacity, const char *url);
+
+/**
+ * @brief push_live_writer 将包加入发送队列
+ * @param writer 发送线程
+ * @param packet 待发送的包 由发送线程负责释放
+ * @return int 成功或按策略丢弃返回0, 链路已出错返回-1; 连接失败时丢弃并返回0
+ */
+int push_live_writer(LiveWriter *writer, AVPacket *packet);
+
+/**
+ * @brief get_live_writer_stat 获取发送队列状态
+ * @param writer 发送线程
+ * @return LiveStat 状态
+ */
+LiveStat get_live_writer_stat(LiveWriter *writer);
+
+/**
+ * @brief close_live_writer 停止发送线程, 丢弃未发送的包
+ * @param writer 发送线程
+ * @return int 发送过程中没有出错返回0, 否则返回-1
+ */
+int close_live_writer(LiveWriter *writer);
+
+#endif
@@ -0,0 +1,157 @@
+#ifndef MASK_H
+#define MASK_H
+
+#include <stdint.h>
+
+#include <libavutil/frame.h>
+#include <libavutil/pixdesc.h>
+
+#include "./logger.h"
+#include "./tool.h"
+
+// 单路相机最多的遮挡区域数
+#define MASK_MAX_SHAPES 8
+
+// 单个多边形最多的顶点数
+#define MASK_MAX_POINTS 16
+
+// 块大小的对齐 块内按8字节向量求和
+#define MASK_BLOCK_ALIGN 8
+
+/**
+ * @brief MaskMode 遮挡方式
+ */
+typedef enum MaskMode
+{
+    MASK_PIXELATE = 0, // 马赛克 以块均值填充
+    MASK_BLUR = 1,     // 方框模糊
+    MASK_FILL = 2,     // 纯黑填充
+} MaskMode;
+
+/**
+ * @brief MaskShape 遮挡区域 按顶点顺序围成的多边形
+ * @property num 顶点数
+ * @property x 顶点横坐标 单位:像素 相对于采集分辨率
+ * @property y 顶点纵坐标
+ */
+typedef struct MaskShape
+{
+    unsigned int num;
+    int x[MASK_MAX_POINTS];
+    int y[MASK_MAX_POINTS];
+} MaskShape;
+
+/**
+ * @brief MaskConfig 隐私遮挡配置
+ * @property mode 遮挡方式
+ * @property block 马赛克块大小或模糊窗口宽度 单位:像素 按 MASK_BLOCK_ALIGN 向上对齐
+ * @property num 遮挡区域数 为0时不启用
+ * @property shapes 遮挡区域
+ */
+typedef struct MaskConfig
+{
+    MaskMode mode;
+    unsigned int block;
+    unsigned int num;
+    MaskShape shapes[MASK_MAX_SHAPES];
+} MaskConfig;
+
+/**
+ * @brief MaskSpan 一行内连续的遮挡像素 [x0, x1)
+ */
+typedef struct MaskSpan
+{
+    int y;
+    int x0;
+    int x1;
+} MaskSpan;
+
+/**
+ * @brief MaskPlane 单个平面的遮挡覆盖
+ * @property spans 按行排列的遮挡区间 同一行内不重叠 元素为 MaskSpan
+ * @property width 平面宽
+ * @property height 平面高
+ * @property top 覆盖范围的上边界
+ * @property bottom 覆盖范围的下边界 不含
+ * @property left 覆盖范围的左边界
+ * @property right 覆盖范围的右边界 不含
+ * @property block_w 该平面上块或模糊窗口的宽
+ * @property block_h 该平面上块或模糊窗口的高
+ */
+typedef struct MaskPlane
+{
+    Array *spans;
+    int width;
+    int height;
+    int top;
+    int bottom;
+    int left;
+    int right;
+    int block_w;
+    int block_h;
+} MaskPlane;
+
+/**
+ * @brief PrivacyMask 隐私遮挡器
+ * @note 遮挡区域在布局时栅格化为每行的区间, 每帧只处理区间覆盖的像素
+ * @property config 配置
+ * @property ref_width 坐标对应的宽
+ * @property ref_height 坐标对应的高
+ * @property format 布局对应的像素格式
+ * @property width 布局对应的帧宽
+ * @property height 布局对应的帧高
+ * @property planes Y/U/V 平面的覆盖 U/V 共用同一组区间
+ * @property sums 马赛克一行块的均值 或模糊的列和
+ * @property rows 模糊的行和 环形存放窗口内的行
+ * @property pixels 每帧遮挡的亮度像素数
+ * @property frames 已遮挡的帧数
+ */
+typedef struct PrivacyMask
+{
+    MaskConfig config;
+    int ref_width;
+    int ref_height;
+    int format;
+    int width;
+    int height;
+    MaskPlane planes[3];
+    uint32_t *sums;
+    uint16_t *rows;
+    int64_t pixels;
+    int64_t frames;
+} PrivacyMask;
+
+/**
+ * @brief parse_mask_shape 解析遮挡区域
+ * @note 矩形写作 `x,y,w,h`, 多边形写作以空格分隔的顶点 `x1,y1 x2,y2 x3,y3 ...`
+ * @param shape 解析结果
+ * @param value 文本
+ * @return int 成功返回0, 格式错误返回-1
+ */
+int parse_mask_shape(MaskShape *shape, const char *value);
+
+/**
+ * @brief open_privacy_mask 创建隐私遮挡器 覆盖在第一帧时按帧尺寸栅格化
+ * @param config 配置
+ * @param width 遮挡区域坐标对应的宽
+ * @param height 遮挡区域坐标对应的高
+ * @return PrivacyMask* 失败返回NULL
+ */
+PrivacyMask *open_privacy_mask(MaskConfig config, int width, int height);
+
+/**
+ * @brief apply_privacy_mask 在解码后的图像上原地遮挡
+ * @note 只支持 8 位平面 YUV 格式; 图像不可写时先复制
+ * @param mask 遮挡器
+ * @param frame 解码后的图像
+ * @return int 成功返回0, 格式不支持或失败返回-1
+ */
+int apply_privacy_mask(PrivacyMask *mask, AVFrame *frame);
+
+/**
+ * @brief close_privacy_mask 释放隐私遮挡器
+ * @param mask 遮挡器
+ */
+void close_privacy_mask(PrivacyMask *mask);
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef MOTION_H
+#define MOTION_H
+
+#include <stdint.h>
+
+#include <libavutil/frame.h>
+
+#include "./logger.h"
+#include "./tool.h"
+
+// 活动检测的块大小 与 H.264 宏块一致
+#define MOTION_BLOCK 16
+
+// 块检测到运动后保持为运动状态的帧数, 避免运动物体边缘反复切换
+#define MOTION_HOLD 15
+
+// ROI 质量偏移的分母
+#define MOTION_QOFFSET_DEN 1000
+
+/**
+ * @brief MotionConfig 按运动区域分配码率的配置
+ * @property enable 是否启用
+ * @property threshold 判定为运动的块内平均像素差 0~255
+ * @property static_qoffset 静止区域的质量偏移 0~1 越大码率越低
+ * @property motion_qoffset 运动区域的质量偏移 0~1 越大码率越高
+ */
+typedef struct MotionConfig
+{
+    int enable;
+    unsigned int threshold;
+    double static_qoffset;
+    double motion_qoffset;
+} MotionConfig;
+
+/**
+ * @brief MotionStat 运动检测统计
+ * @property frames 已检测的帧数
+ * @property blocks 已检测的块数
+ * @property active 其中处于运动状态的块数
+ */
+typedef struct MotionStat
+{
+    int64_t frames;
+    int64_t blocks;
+    int64_t active;
+} MotionStat;
+
+/**
+ * @brief MotionMap 块级活动图
+ * @note 与上一帧亮度逐块求绝对差之和, 结果作为 AV_FRAME_DATA_REGIONS_OF_INTEREST
+ *       附加到帧上, 同一行内状态相同的相邻块合并为一个区域
+ * @property config 配置
+ * @property width 上一帧的宽
+ * @property height 上一帧的高
+ * @property cols 每行的块数
+ * @property rows 块的行数
+ * @property prev 上一帧的亮度 行跨度为 stride
+ * @property stride prev 的行跨度
+ * @property hold 各块剩余的运动保持帧数
+ * @property stat 统计
+ */
+typedef struct MotionMap
+{
+    MotionConfig config;
+    int width;
+    int height;
+    int cols;
+    int rows;
+    uint8_t *prev;
+    int stride;
+    uint8_t *hold;
+    MotionStat stat;
+} MotionMap;
+
+/**
+ * @brief open_motion_map 创建活动图 尺寸在第一帧时确定
+ * @param config 配置
+ * @return MotionMap* 失败返回NULL
+ */
+MotionMap *open_motion_map(MotionConfig config);
+
+/**
+ * @brief mark_motion_map 对比上一帧计算活动图并附加 ROI 到帧上
+ * @note 尺寸变化后的第一帧没有参考, 整帧视为运动; 只使用 8 位亮度平面
+ * @param map 活动图
+ * @param frame 待编码的帧 已有的 ROI 会被替换
+ * @return int 成功返回0, 失败返回-1
+ */
+int mark_motion_map(MotionMap *map, AVFrame *frame);
+
+/**
+ * @brief get_motion_map_stat 获取统计
+ * @param map 活动图
+ * @return MotionStat 统计
+ */
+MotionStat get_motion_map_stat(MotionMap *map);
+
+/**
+ * @brief close_motion_map 释放活动图
+ * @param map 活动图
+ */
+void close_motion_map(MotionMap *map);
+
+#endif
@@ -0,0 +1,115 @@
+#ifndef OSD_H
+#define OSD_H
+
+#include <stdint.h>
+#include <time.h>
+
+#include <libavutil/frame.h>
+#include <libavutil/pixdesc.h>
+
+#include "./logger.h"
+#include "./tool.h"
+
+// 叠加的时间格式 strftime 格式
+#define OSD_FORMAT "%Y-%m-%d %H:%M:%S"
+
+// 叠加文本的最大长度
+#define OSD_TEXT_SIZE 32
+
+// 内置点阵字体的字形宽高 单位:点
+#define OSD_GLYPH_WIDTH 5
+#define OSD_GLYPH_HEIGHT 7
+
+// 字符单元的宽高 字形四周各留一点描边 单位:点
+#define OSD_CELL_WIDTH (OSD_GLYPH_WIDTH + 2)
+#define OSD_CELL_HEIGHT (OSD_GLYPH_HEIGHT + 2)
+
+// 混合使用的透明度精度 画布的透明度取值 0~OSD_ALPHA_ONE
+#define OSD_ALPHA_ONE 128
+
+/**
+ * @brief OsdConfig 时间水印配置
+ * @property enable 是否启用
+ * @property x 左上角横坐标 单位:像素
+ * @property y 左上角纵坐标 单位:像素
+ * @property scale 每个字形点的像素数 为0时按帧高自动选择
+ */
+typedef struct OsdConfig
+{
+    int enable;
+    int x;
+    int y;
+    unsigned int scale;
+} OsdConfig;
+
+/**
+ * @brief Osd 时间水印叠加器
+ * @note 字形在布局时一次栅格化到图集, 画布只重画与上一帧相比变化的字符,
+ *       每帧将画布按透明度混合到图像的 Y/U/V 平面
+ * @property config 配置
+ * @property format 布局对应的像素格式
+ * @property width 布局对应的帧宽
+ * @property height 布局对应的帧高
+ * @property scale 实际使用的缩放
+ * @property cell_width 字符单元的宽 单位:像素
+ * @property cell_height 字符单元的高 单位:像素
+ * @property log2_chroma_w 色度平面水平下采样
+ * @property log2_chroma_h 色度平面垂直下采样
+ * @property atlas_alpha 字形图集的透明度 每个字形一个单元, 按字形顺序横向排列
+ * @property atlas_value 字形图集的亮度
+ * @property canvas_width 画布宽 单位:像素
+ * @property canvas_alpha 画布的亮度透明度
+ * @property canvas_value 画布的亮度
+ * @property chroma_alpha 画布的色度透明度 按色度平面下采样
+ * @property chroma_value 色度平面混合的目标值 均为中性色
+ * @property text 画布上当前的文本
+ * @property second 当前文本对应的秒
+ * @property redrawn 已重画的字符数
+ */
+typedef struct Osd
+{
+    OsdConfig config;
+    int format;
+    int width;
+    int height;
+    unsigned int scale;
+    int cell_width;
+    int cell_height;
+    int log2_chroma_w;
+    int log2_chroma_h;
+    uint8_t *atlas_alpha;
+    uint8_t *atlas_value;
+    int canvas_width;
+    uint8_t *canvas_alpha;
+    uint8_t *canvas_value;
+    uint8_t *chroma_alpha;
+    uint8_t *chroma_value;
+    char text[OSD_TEXT_SIZE];
+    time_t second;
+    int64_t redrawn;
+} Osd;
+
+/**
+ * @brief open_osd 创建时间水印叠加器 图集与画布在第一帧时布局
+ * @param config 配置
+ * @return Osd* 失败返回NULL
+ */
+Osd *open_osd(OsdConfig config);
+
+/**
+ * @brief draw_osd 将时间叠加到图像上
+ * @note 只支持 8 位平面 YUV 格式; 图像不可写时先复制
+ * @param osd 叠加器
+ * @param frame 解码后的图像
+ * @param wall_time 该帧的采集时刻 单位:us 自 Unix 纪元
+ * @return int 成功返回0, 格式不支持或失败返回-1
+ */
+int draw_osd(Osd *osd, AVFrame *frame, int64_t wall_time);
+
+/**
+ * @brief close_osd 释放叠加器
+ * @param osd 叠加器
+ */
+void close_osd(Osd *osd);
+
+#endif
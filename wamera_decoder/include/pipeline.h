@@ -0,0 +1,266 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include <math.h>
+#include <poll.h>
+
+#include "./logger.h"
+#include "./tool.h"
+#include "./camera.h"
+#include "./codec.h"
+#include "./worker.h"
+#include "./settings.h"
+#include "./rate.h"
+#include "./governor.h"
+#include "./osd.h"
+#include "./mask.h"
+#include "./denoise.h"
+#include "./snapshot.h"
+#include "./tap.h"
+
+// 编码任务单次最多编码的帧数, 超过后重新排队让出线程
+#define PIPELINE_BATCH 4
+
+// 采集模式校准时每个模式丢弃的预热时长 曝光收敛后帧率才稳定 单位:us
+#define MODE_WARMUP 1000000
+
+// 采集模式校准最多实测的模式数 按像素数从小到大取
+#define MODE_MAX_CANDIDATES 6
+
+// 实测帧率达到下限的该比例即视为满足, 容忍驱动时钟的误差
+#define MODE_FPS_TOLERANCE 0.95
+
+// 两个模式单帧CPU相差在该比例内时, 选单帧字节数更少的模式 降低总线带宽
+#define MODE_CPU_MARGIN 0.05
+
+// 相机断开且不补帧时事件循环的最长等待 单位:us
+#define PIPELINE_IDLE_WAIT 1000000
+
+/**
+ * @brief PipelineStat 单路相机的统计
+ * @property captured 采集的帧数
+ * @property lost 驱动缓冲区溢出丢失的帧数
+ * @property dropped 解码窗口已满丢弃的帧数
+ * @property decode_failed 解码失败的帧数
+ * @property encoded 编码输出的帧数
+ * @property latency_sum 采集到编码完成的延迟总和 单位:us
+ * @property latency_max 采集到编码完成的最大延迟 单位:us
+ * @property cpu_usage 最近一个统计窗口的解码与编码CPU占用 单位:核
+ * @property level CPU预算调节的级数
+ * @property motion 运动检测统计
+ * @property denoise 降噪统计
+ * @property tap 共享内存帧旁路统计
+ * @property udp UDP 发送统计 max_depth 为统计间隔内的最大值
+ * @property packet 编码输出的包大小统计 max 为统计间隔内的最大值
+ * @property first_frame 打开流水线到第一帧写入录像的耗时 不录像时到第一帧编码输出 尚无时为0 单位:us
+ * @property filled 相机断开期间补的帧数
+ * @property reconnects 相机断开后重新打开的次数
+ */
+typedef struct PipelineStat
+{
+    int64_t captured;
+    int64_t lost;
+    int64_t dropped;
+    int64_t decode_failed;
+    int64_t encoded;
+    int64_t latency_sum;
+    int64_t latency_max;
+    double cpu_usage;
+    unsigned int level;
+    MotionStat motion;
+    DenoiseStat denoise;
+    TapStat tap;
+    UdpStat udp;
+    PacketStat packet;
+    int64_t first_frame;
+    int64_t filled;
+    int64_t reconnects;
+} PipelineStat;
+
+/**
+ * @brief Pipeline 单路相机的采集 解码 编码 输出流水线
+ * @note 采集在事件循环线程中进行, 解码和编码作为任务在共享线程池中执行,
+ *       同一路相机的编码任务同一时刻至多一个, 保证编码器与输出器按序单线程访问
+ * @property settings 相机设置
+ * @property sink_config 文件写入器配置
+ * @property camera 相机
+ * @property codec 编解码器
+ * @property snapshot 快照服务 未启用时为NULL
+ * @property denoiser 时域降噪器 未启用时为NULL
+ * @property mask 隐私遮挡器 未配置遮挡区域时为NULL
+ * @property tap 共享内存帧旁路 未启用时为NULL
+ * @property osd 时间水印叠加器 未启用时为NULL
+ * @property workers 共享线程池
+ * @property rtmp_output 推流输出器 不推流时为NULL
+ * @property udp_output MPEG-TS 的 UDP 输出器 不发送时为NULL
+ * @property hls_output 低延迟 HLS 输出器 不输出时为NULL
+ * @property file_output 当前录像输出器 不录像时为NULL
+ * @property current 码率自适应与CPU预算调节后当前使用的配置
+ * @property rate 推流的码率控制器
+ * @property governor CPU预算调节器
+ * @property pending 是否有待到GOP结束时生效的调节
+ * @property decimate 抽帧间隔 由采集线程读取
+ * @property decode_cpu 上次读取的解码累计CPU时间 单位:us
+ * @property force_key 下一帧是否强制编码为关键帧
+ * @property segment 当前录像文件对应的分段序号
+ * @property encoding 是否有编码任务已排队或执行中
+ * @property dirty 编码任务执行期间是否有新帧解码完成
+ * @property failed 输出出错后停止编码
+ * @property open_time 开始打开流水线的时间 单位:us
+ * @property target 运行时修改后的目标设置 由控制线程写入
+ * @property changed 目标设置是否有待编码任务应用的修改
+ * @property recycle 采集分辨率或帧率是否有待采集线程应用的修改
+ * @property configs 相机可用设置 运行时修改分辨率与帧率时据此校验, 读取失败时为NULL
+ * @property capture 相机当前的采集配置 由采集线程读写
+ * @property offline 相机是否已断开 断开期间编码器与输出器保持打开
+ * @property offline_time 相机断开的时间 单位:us
+ * @property fill_time 上一帧补帧的时间 单位:us
+ * @property retry_time 上次尝试重新打开相机的时间 单位:us
+ * @property black 补帧用的黑帧 补帧方式为 none 时为NULL
+ * @property last_frame 补帧方式为 repeat 时最近一帧的副本 尚无帧时为NULL
+ * @property stat 统计
+ * @property last 上次输出统计时的快照
+ */
+typedef struct Pipeline
+{
+    CameraSettings settings;
+    SinkConfig sink_config;
+    Camera *camera;
+    Codec *codec;
+    SnapshotService *snapshot;
+    Denoiser *denoiser;
+    PrivacyMask *mask;
+    FrameTap *tap;
+    Osd *osd;
+    WorkerPool *workers;
+    Output *rtmp_output;
+    Output *udp_output;
+    Output *hls_output;
+    Output *file_output;
+    Config current;
+    RateController rate;
+    Governor governor;
+    int pending;
+    unsigned int decimate;
+    int64_t decode_cpu;
+    int force_key;
+    int64_t segment;
+    int encoding;
+    int dirty;
+    int failed;
+    int64_t open_time;
+    CameraSettings target;
+    int changed;
+    int recycle;
+    Array *configs;
+    Config capture;
+    int offline;
+    int64_t offline_time;
+    int64_t fill_time;
+    int64_t retry_time;
+    BufType *black;
+    BufType *last_frame;
+    PipelineStat stat;
+    PipelineStat last;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} Pipeline;
+
+/**
+ * @brief calibrate_pipeline 编码器后端为 auto 时校准选择后端与档位, 结果写回设置
+ * @note 校准测量进程CPU时间, 需在任何流水线打开之前调用
+ * @param settings 相机设置
+ * @return int 成功返回0, 没有可用的后端返回-1
+ */
+int calibrate_pipeline(CameraSettings *settings);
+
+/**
+ * @brief calibrate_capture 实测各采集模式, 选出满足分辨率与帧率下限且开销最低的模式, 结果写回设置
+ * @note 每个模式短时采集, 测量实际送达的帧率 单帧字节数, 以及解码 转换并按该模式分辨率编码的单帧CPU;
+ *       实际帧率低于标称值时帧间隔取实测值. 需在 calibrate_pipeline 之前调用
+ * @param settings 相机设置 分辨率为下限
+ * @param configs 相机可用设置 元素为 Config
+ * @return int 成功返回0, 没有满足分辨率的模式或全部测量失败返回-1
+ */
+int calibrate_capture(CameraSettings *settings, Array *configs);
+
+/**
+ * @brief open_pipeline 打开相机与编解码器, 开始采集
+ * @param settings 相机设置
+ * @param sink_config 文件写入器配置
+ * @param caps_dir 相机能力缓存目录 为空时重新枚举
+ * @param workers 共享线程池
+ * @return Pipeline* 失败返回NULL
+ */
+Pipeline *open_pipeline(const CameraSettings *settings, SinkConfig sink_config, const char *caps_dir,
+                        WorkerPool *workers);
+
+/**
+ * @brief change_pipeline 运行时修改一项设置, 不中断采集
+ * @note 码率直接作用于运行中的编码器; 推流 UDP HLS 与录像目录只开关对应的输出器;
+ *       分辨率与帧率由采集线程重建驱动缓冲区, 编码器与输出器在GOP结束时切换.
+ *       分辨率以 size 同时修改宽高; 相机不支持的分辨率被拒绝, 不支持的帧率改为最接近的可用帧率.
+ *       修改在下一帧时生效, 可从任意线程调用
+ * @param pipeline 流水线
+ * @param key 设置文件 [camera] 节的键
+ * @param value 值
+ * @return int 成功返回0, 值无效或相机不支持返回-1, 该键需要重启才能修改返回-2
+ */
+int change_pipeline(Pipeline *pipeline, const char *key, const char *value);
+
+/**
+ * @brief get_pipeline_fd 获取用于等待帧就绪的文件描述符
+ * @param pipeline 流水线
+ * @return int 相机的文件描述符 相机断开期间为-1
+ */
+int get_pipeline_fd(Pipeline *pipeline);
+
+/**
+ * @brief feed_pipeline 取出相机所有已就绪的帧, 发布为快照并提交解码
+ * @note 解码窗口已满时丢弃新帧, 不阻塞事件循环; 按CPU预算调节的抽帧间隔在解码前丢弃
+ * @param pipeline 流水线
+ * @return int 成功返回0, 流水线已出错返回-1, 相机已断开返回-2
+ */
+int feed_pipeline(Pipeline *pipeline);
+
+/**
+ * @brief suspend_pipeline 相机断开后释放相机, 编码器与输出器保持打开等待相机重新出现
+ * @note 只在采集线程中调用, 之后由 fill_pipeline 补帧 resume_pipeline 重新打开
+ * @param pipeline 流水线
+ * @return int 成功返回0, 未启用热插拔恢复返回-1 调用方应关闭流水线
+ */
+int suspend_pipeline(Pipeline *pipeline);
+
+/**
+ * @brief resume_pipeline 重新打开断开的相机并恢复采集
+ * @note 只在采集线程中调用; 不补帧时时间戳跳过断开的时长, 时间轴与墙上时间一致
+ * @param pipeline 流水线
+ * @param force 是否忽略重试间隔立即尝试 收到设备出现的通知时为1
+ * @return int 成功返回0, 失败或未到重试时间返回-1, 解码池切换分辨率失败返回-2 调用方应关闭流水线
+ */
+int resume_pipeline(Pipeline *pipeline, int force);
+
+/**
+ * @brief fill_pipeline 相机断开期间按帧间隔提交到期的补帧
+ * @note 只在采集线程中调用, 补帧与采集的帧共用时间戳序列
+ * @param pipeline 流水线
+ * @return int 到下一次补帧或重试的时间 单位:ms, 流水线已出错返回-1
+ */
+int fill_pipeline(Pipeline *pipeline);
+
+/**
+ * @brief log_pipeline_stat 输出自上次调用以来的统计
+ * @param pipeline 流水线
+ * @param interval 统计间隔 单位:s
+ */
+void log_pipeline_stat(Pipeline *pipeline, double interval);
+
+/**
+ * @brief close_pipeline 编码完剩余的帧, 关闭输出器 编解码器与相机
+ * @param pipeline 流水线
+ */
+void close_pipeline(Pipeline *pipeline);
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef RATE_H
+#define RATE_H
+
+#include <stdint.h>
+
+#include "./logger.h"
+#include "./tool.h"
+
+// 两次评估之间的最小间隔 单位:us
+#define RATE_INTERVAL 500000
+
+// 降级后至少保持多久才允许再次降级 单位:us
+#define RATE_DOWN_HOLD 1000000
+
+// 链路持续畅通多久后才逐级恢复 单位:us
+#define RATE_UP_HOLD 10000000
+
+// 最多降低分辨率的级数, 每级宽高缩小为原来的 1/4
+#define RATE_MAX_STEPS 3
+
+/**
+ * @brief RateConfig 直播输出的码率自适应配置
+ * @property enable 是否启用
+ * @property min_bit_rate 码率下限 为0时取 bit_rate 的 1/4
+ * @property queue_size 直播发送队列的容量 单位:包
+ * @property max_latency 单次写入延迟的上限 单位:us
+ * @property scale_steps 码率降到下限后最多降低分辨率的级数 不超过 RATE_MAX_STEPS
+ * @note 编码器由推流与录像共用: 降低的码率同样作用于录像; 录像时不降低分辨率,
+ *       以免录像文件随之轮换且画面缩小
+ */
+typedef struct RateConfig
+{
+    int enable;
+    int64_t min_bit_rate;
+    unsigned int queue_size;
+    int64_t max_latency;
+    unsigned int scale_steps;
+} RateConfig;
+
+/**
+ * @brief RateAction 评估后需要执行的调整
+ */
+typedef enum RateAction
+{
+    RATE_KEEP = 0,       // 保持不变
+    RATE_BITRATE = 1,    // 调整编码器码率
+    RATE_RESOLUTION = 2, // 在关键帧处切换分辨率
+} RateAction;
+
+/**
+ * @brief RateController 码率控制器
+ * @note 队列积压或写入延迟过高时先乘性降低码率, 降到下限后逐级降低分辨率,
+ *       链路畅通一段时间后按相反顺序逐级恢复
+ * @property config 配置
+ * @property max_bit_rate 码率上限 即配置的码率
+ * @property bit_rate 当前码率
+ * @property step 当前分辨率级数 0为原始分辨率
+ * @property last_check 上次评估的时间 单位:us
+ * @property last_change 上次调整的时间 单位:us
+ * @property clear_since 链路开始畅通的时间 为0表示当前拥塞
+ */
+typedef struct RateController
+{
+    RateConfig config;
+    int64_t max_bit_rate;
+    int64_t bit_rate;
+    unsigned int step;
+    int64_t last_check;
+    int64_t last_change;
+    int64_t clear_since;
+} RateController;
+
+/**
+ * @brief init_rate_controller 初始化码率控制器
+ * @param rate 码率控制器
+ * @param config 自适应配置
+ * @param bit_rate 配置的码率 作为上限
+ */
+void init_rate_controller(RateController *rate, RateConfig config, int64_t bit_rate);
+
+/**
+ * @brief set_rate_controller_bit_rate 修改配置的码率 当前码率按比例缩放, 分辨率级数不变
+ * @param rate 码率控制器
+ * @param bit_rate 新的码率 作为上限
+ */
+void set_rate_controller_bit_rate(RateController *rate, int64_t bit_rate);
+
+/**
+ * @brief update_rate_controller 根据发送队列状态评估是否需要调整
+ * @param rate 码率控制器
+ * @param depth 发送队列中的包数
+ * @param latency 写入延迟 单位:us
+ * @param now 当前时间 单位:us
+ * @return RateAction 需要执行的调整
+ */
+RateAction update_rate_controller(RateController *rate, unsigned int depth, int64_t latency, int64_t now);
+
+/**
+ * @brief scale_config 按分辨率级数缩小配置的宽高
+ * @param config 原始配置
+ * @param step 分辨率级数 每级宽高缩小为原来的 1/4
+ * @return Config 缩放后的配置
+ */
+Config scale_config(Config config, unsigned int step);
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+#include "./logger.h"
+#include "./tool.h"
+#include "./camera.h"
+#include "./sink.h"
+#include "./affinity.h"
+#include "./rate.h"
+#include "./governor.h"
+#include "./motion.h"
+#include "./osd.h"
+#include "./mask.h"
+#include "./denoise.h"
+#include "./snapshot.h"
+#include "./tap.h"
+#include "./hls.h"
+#include "./archive.h"
+
+// 设置文件单行的最大长度
+#define SETTINGS_LINE_SIZE 512
+
+/**
+ * @brief CameraSettings 单路相机的设置
+ * @property name 相机名称 用于日志和录像文件名
+ * @property device 设备路径
+ * @property rtmp 推流地址 为空时不推流
+ * @property udp MPEG-TS 的 UDP 目的地址 格式为 host:port 为空时不发送
+ * @property video_dir 录像目录 为空时不录像
+ * @property config 采集与编解码配置
+ * @property rate 推流的码率自适应配置
+ * @property governor CPU预算调节配置
+ * @property motion 按运动区域分配码率的配置
+ * @property osd 时间水印配置
+ * @property mask 隐私遮挡配置
+ * @property denoise 时域降噪配置
+ * @property snapshot 快照配置
+ * @property tap 共享内存帧旁路配置
+ * @property hls 低延迟 HLS 输出配置
+ * @property mode 采集模式校准配置
+ * @property hotplug 热插拔恢复配置
+ */
+typedef struct CameraSettings
+{
+    char name[32];
+    char device[64];
+    char rtmp[256];
+    char udp[256];
+    char video_dir[256];
+    Config config;
+    RateConfig rate;
+    GovernorConfig governor;
+    MotionConfig motion;
+    OsdConfig osd;
+    MaskConfig mask;
+    DenoiseConfig denoise;
+    SnapshotConfig snapshot;
+    TapConfig tap;
+    HlsConfig hls;
+    ModeConfig mode;
+    HotplugConfig hotplug;
+} CameraSettings;
+
+/**
+ * @brief Settings 进程设置
+ * @property workers 共享线程池的线程数 为0时使用在线CPU数
+ * @property sink 文件写入器配置 所有相机共用
+ * @property affinity 线程绑核配置
+ * @property archive 录像回放服务配置
+ * @property caps_dir 相机能力缓存目录 为空时每次启动都枚举
+ * @property control 控制套接字路径 为空时不启用运行时修改
+ * @property cameras 相机设置 元素为 CameraSettings
+ */
+typedef struct Settings
+{
+    unsigned int workers;
+    SinkConfig sink;
+    AffinityConfig affinity;
+    ArchiveConfig archive;
+    char caps_dir[256];
+    char control[108];
+    Array *cameras;
+} Settings;
+
+/**
+ * @brief load_settings 读取 ini 格式的设置文件
+ * @note [global] 节设置 workers 文件写入器 绑核与回放服务, 每个 [camera] 节添加一路相机,
+ *       未出现的键使用默认值
+ * @param path 设置文件路径 为NULL时返回默认的单路相机设置
+ * @return Settings* 失败返回NULL
+ */
+Settings *load_settings(const char *path);
+
+/**
+ * @brief set_camera_setting 按设置文件 [camera] 节的键修改一路相机的设置
+ * @param camera 相机设置
+ * @param key 键
+ * @param value 值
+ * @return int 成功返回0, 未知的键或值返回-1
+ */
+int set_camera_setting(CameraSettings *camera, const char *key, const char *value);
+
+/**
+ * @brief free_settings 释放设置
+ * @param settings 待释放的设置
+ */
+void free_settings(Settings *settings);
+
+#endif
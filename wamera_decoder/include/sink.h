@@ -0,0 +1,92 @@
+#ifndef SINK_H
+#define SINK_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include <libavformat/avio.h>
+
+#include "./logger.h"
+#include "./aio.h"
+
+// 默认单次写入块大小 1MiB
+#define SINK_CHUNK_SIZE (1 << 20)
+
+// 写入块对齐大小
+#define SINK_ALIGN 4096
+
+/**
+ * @brief SinkConfig 文件写入器配置
+ * @property chunk_size 单次写入块大小 单位:字节 会向上对齐到 SINK_ALIGN
+ * @property sync_interval fsync 周期 单位:s 为0时不按时间同步
+ * @property sync_bytes 累计写入多少字节后触发同步 为0时不按字节同步
+ * @property backend 写入后端
+ * @property queue_depth 异步写入的缓冲区数量
+ */
+typedef struct SinkConfig
+{
+    unsigned int chunk_size;
+    unsigned int sync_interval;
+    int64_t sync_bytes;
+    AioBackend backend;
+    unsigned int queue_depth;
+} SinkConfig;
+
+/**
+ * @brief FileSink 基于自定义 AVIOContext 的文件写入器
+ * @property fd 文件描述符
+ * @property pb 交给 libavformat 使用的 IO 上下文
+ * @property aio 异步写入器
+ * @property chunk 当前暂存块 从 aio 获取的对齐缓冲区
+ * @property filled 暂存块已填充的字节数
+ * @property chunk_pos 暂存块起始处在文件中的偏移
+ * @property pos 当前逻辑写入位置
+ * @property size 文件逻辑大小
+ * @property reserved fallocate 预留的大小
+ * @property unsynced 上次同步后写入的字节数
+ * @property sync_thread 后台同步线程
+ */
+typedef struct FileSink
+{
+    int fd;
+    AVIOContext *pb;
+    AioWriter *aio;
+    uint8_t *chunk;
+    unsigned int filled;
+    int64_t chunk_pos;
+    int64_t pos;
+    int64_t size;
+    int64_t reserved;
+    SinkConfig config;
+
+    int64_t unsynced;
+    int stop;
+    pthread_t sync_thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} FileSink;
+
+/**
+ * @brief open_file_sink 打开文件写入器
+ * @param path 文件路径
+ * @param expected_size 预计的文件大小 用于 fallocate 预分配 为0时不预分配
+ * @param config 写入器配置
+ * @return FileSink* 失败返回NULL
+ */
+FileSink *open_file_sink(const char *path, int64_t expected_size, SinkConfig config);
+
+/**
+ * @brief close_file_sink 刷新剩余数据并关闭文件写入器
+ * @note 等待在途写入完成后返回, 截断 同步与关闭文件由同步线程在后台完成, 出错只记录日志
+ * @param sink 待关闭的写入器 返回后不可再访问
+ * @return int 成功返回0, 写入失败返回-1
+ */
+int close_file_sink(FileSink *sink);
+
+/**
+ * @brief wait_file_sinks 等待所有已关闭写入器的文件同步与关闭完成
+ * @note 进程退出前调用
+ */
+void wait_file_sinks(void);
+
+#endif
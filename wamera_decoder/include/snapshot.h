@@ -0,0 +1,158 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <libavcodec/avcodec.h>
+#include <libswscale/swscale.h>
+#include <libavutil/time.h>
+
+#include "./logger.h"
+#include "./tool.h"
+#include "./worker.h"
+
+// 快照槽数量 读者持有的槽不会被覆盖, 其余槽轮流写入
+#define SNAPSHOT_SLOTS 4
+
+// 缩略图的 JPEG 量化参数 2~31 越小质量越高
+#define SNAPSHOT_THUMB_QUALITY 5
+
+/**
+ * @brief SnapshotConfig 快照配置
+ * @property enable 是否启用 只在 MJPEG 采集且未配置隐私遮挡时有效
+ * @property dir 快照文件目录 为空时只保存在内存中供读取
+ * @property interval 写出快照文件的最小间隔 单位:us
+ * @property thumb_width 缩略图宽度 为0时不生成
+ * @property thumb_interval 生成缩略图的最小间隔 单位:us
+ */
+typedef struct SnapshotConfig
+{
+    int enable;
+    char dir[256];
+    int64_t interval;
+    unsigned int thumb_width;
+    int64_t thumb_interval;
+} SnapshotConfig;
+
+/**
+ * @brief Snapshot 一帧采集得到的完整 JPEG
+ * @property refs 持有该槽的读者数
+ * @property data JPEG 数据 尾部留有解码器要求的填充
+ * @property size 数据大小
+ * @property capacity 分配的大小
+ * @property capture_time 采集时刻 单位:us
+ * @property sequence 发布序号
+ */
+typedef struct Snapshot
+{
+    atomic_uint refs;
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+    int64_t capture_time;
+    int64_t sequence;
+} Snapshot;
+
+/**
+ * @brief SnapshotStat 快照统计
+ * @property published 已发布的快照数
+ * @property skipped 所有空闲槽都被读者持有而未发布的快照数
+ * @property written 已写出的快照文件数
+ * @property thumbs 已生成的缩略图数
+ * @property thumb_time 生成缩略图的累计耗时 单位:us
+ */
+typedef struct SnapshotStat
+{
+    int64_t published;
+    int64_t skipped;
+    int64_t written;
+    int64_t thumbs;
+    int64_t thumb_time;
+} SnapshotStat;
+
+/**
+ * @brief SnapshotService 单路相机的快照服务
+ * @note 采集线程把每帧 JPEG 复制到一个没有读者的槽后原子地发布为最新,
+ *       读者无锁地获取最新槽的引用; 快照与缩略图文件由线程池按间隔写出
+ * @property config 配置
+ * @property name 相机名称 用于文件名
+ * @property width 采集宽度 用于选择缩略图的解码缩放
+ * @property workers 写出文件的线程池
+ * @property slots 快照槽
+ * @property latest 最新槽的索引 为-1表示还没有快照
+ * @property last_write 上次写出快照文件的采集时刻
+ * @property last_thumb 上次生成缩略图的采集时刻
+ * @property busy 是否有写出任务已排队或执行中
+ * @property decoder 缩略图的 JPEG 解码器 按比例降采样解码
+ * @property encoder 缩略图的 JPEG 编码器
+ * @property scaler 缩略图的缩放器
+ * @property stat 统计
+ */
+typedef struct SnapshotService
+{
+    SnapshotConfig config;
+    char name[32];
+    int width;
+    WorkerPool *workers;
+    Snapshot slots[SNAPSHOT_SLOTS];
+    atomic_int latest;
+    int64_t last_write;
+    int64_t last_thumb;
+    int busy;
+    AVCodecContext *decoder;
+    AVCodecContext *encoder;
+    struct SwsContext *scaler;
+    SnapshotStat stat;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} SnapshotService;
+
+/**
+ * @brief open_snapshot 创建快照服务
+ * @param config 配置
+ * @param name 相机名称
+ * @param width 采集宽度
+ * @param workers 写出文件的线程池
+ * @return SnapshotService* 失败返回NULL
+ */
+SnapshotService *open_snapshot(SnapshotConfig config, const char *name, int width, WorkerPool *workers);
+
+/**
+ * @brief publish_snapshot 发布一帧采集得到的 JPEG 为最新快照, 到达间隔时安排写出文件
+ * @note 只在采集线程中调用, 不解码不编码
+ * @param service 快照服务
+ * @param frame 采集帧 只读取不释放
+ */
+void publish_snapshot(SnapshotService *service, const BufType *frame);
+
+/**
+ * @brief acquire_snapshot 无锁获取最新快照的引用
+ * @param service 快照服务
+ * @return Snapshot* 还没有快照时返回NULL, 使用后以 release_snapshot 释放
+ */
+Snapshot *acquire_snapshot(SnapshotService *service);
+
+/**
+ * @brief release_snapshot 释放快照的引用
+ * @param snapshot 快照
+ */
+void release_snapshot(Snapshot *snapshot);
+
+/**
+ * @brief get_snapshot_stat 获取统计
+ * @param service 快照服务
+ * @return SnapshotStat 统计
+ */
+SnapshotStat get_snapshot_stat(SnapshotService *service);
+
+/**
+ * @brief close_snapshot 等待写出任务结束后释放快照服务
+ * @param service 快照服务
+ */
+void close_snapshot(SnapshotService *service);
+
+#endif
@@ -0,0 +1,171 @@
+#ifndef TAP_H
+#define TAP_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <libavutil/frame.h>
+#include <libavutil/time.h>
+#include <libswscale/swscale.h>
+
+#include "./logger.h"
+#include "./tool.h"
+
+// 共享内存头部的魔数 "MTAP"
+#define TAP_MAGIC 0x5041544D
+
+// 共享内存布局的版本
+#define TAP_VERSION 1
+
+// 槽与平面的对齐
+#define TAP_ALIGN 64
+
+// 共享内存名称的最大长度
+#define TAP_NAME_SIZE 64
+
+/**
+ * @brief TapFormat 旁路输出的像素格式
+ */
+typedef enum TapFormat
+{
+    TAP_GRAY = 0,    // 8 位灰度 单平面
+    TAP_RGB = 1,     // RGB24 单平面
+    TAP_YUV420P = 2, // YUV420P 三平面
+} TapFormat;
+
+/**
+ * @brief TapConfig 共享内存旁路配置
+ * @property enable 是否启用
+ * @property format 像素格式
+ * @property width 输出宽度 为0时与采集宽度相同, 高度按比例计算
+ * @property slots 环形槽数量
+ * @property name 共享内存名称 为空时使用 /wamera.<相机名称>
+ */
+typedef struct TapConfig
+{
+    int enable;
+    TapFormat format;
+    unsigned int width;
+    unsigned int slots;
+    char name[TAP_NAME_SIZE];
+} TapConfig;
+
+/**
+ * @brief TapHeader 共享内存头部 读者按此布局解析
+ * @note magic 在布局写完后最后写入, 读者看到 magic 后其余字段不再变化
+ * @property magic TAP_MAGIC
+ * @property version TAP_VERSION
+ * @property format TapFormat
+ * @property slots 环形槽数量
+ * @property width 图像宽
+ * @property height 图像高
+ * @property linesize 各平面的行跨度 不存在的平面为0
+ * @property offset 各平面相对于槽数据起点的偏移
+ * @property slot_size 每个槽的大小 包含 TapSlot 头部
+ * @property data_offset 第一个槽相对于共享内存起点的偏移
+ * @property head 最新完整帧的序号加1 为0表示还没有帧
+ */
+typedef struct TapHeader
+{
+    _Atomic uint32_t magic;
+    uint32_t version;
+    uint32_t format;
+    uint32_t slots;
+    uint32_t width;
+    uint32_t height;
+    uint32_t linesize[3];
+    uint32_t offset[3];
+    uint64_t slot_size;
+    uint64_t data_offset;
+    _Atomic uint64_t head;
+} TapHeader;
+
+/**
+ * @brief TapSlot 槽头部 序号为 n 的帧写入第 n % slots 个槽, 数据从槽起点偏移 TAP_ALIGN 处开始
+ * @note 顺序锁: 写入期间 lock 为奇数; 读者读取前后 lock 相同且为偶数时数据完整,
+ *       否则该槽已被更新的帧覆盖, 读者跳过即可, 写入者从不等待读者
+ * @property lock 顺序锁
+ * @property sequence 帧序号
+ * @property capture_time 采集时刻 单位:us CLOCK_MONOTONIC
+ * @property wall_time 采集时刻 单位:us 自 Unix 纪元
+ */
+typedef struct TapSlot
+{
+    _Atomic uint64_t lock;
+    uint64_t sequence;
+    int64_t capture_time;
+    int64_t wall_time;
+} TapSlot;
+
+/**
+ * @brief TapStat 旁路统计
+ * @property published 已发布的帧数
+ * @property time 缩放与写入的累计耗时 单位:us
+ */
+typedef struct TapStat
+{
+    int64_t published;
+    int64_t time;
+} TapStat;
+
+/**
+ * @brief FrameTap 共享内存帧旁路 供本地分析进程零拷贝读取
+ * @property config 配置
+ * @property fd 共享内存的文件描述符
+ * @property base 映射的起点
+ * @property size 映射的大小
+ * @property header 头部
+ * @property scaler 缩放与格式转换器
+ * @property sequence 下一帧的序号
+ * @property stat 统计
+ */
+typedef struct FrameTap
+{
+    TapConfig config;
+    int fd;
+    uint8_t *base;
+    size_t size;
+    TapHeader *header;
+    struct SwsContext *scaler;
+    uint64_t sequence;
+    TapStat stat;
+} FrameTap;
+
+/**
+ * @brief open_frame_tap 创建共享内存并写入布局
+ * @note 同名的旧共享内存先解除链接, 仍映射着旧内存的读者不受影响
+ * @param config 配置
+ * @param name 相机名称
+ * @param width 采集宽度
+ * @param height 采集高度
+ * @return FrameTap* 失败返回NULL
+ */
+FrameTap *open_frame_tap(TapConfig config, const char *name, int width, int height);
+
+/**
+ * @brief publish_frame_tap 将解码后的图像缩放转换后写入下一个槽
+ * @param tap 旁路
+ * @param frame 解码后的图像
+ * @param capture_time 采集时刻 单位:us 单调时钟
+ * @return int 成功返回0, 失败返回-1
+ */
+int publish_frame_tap(FrameTap *tap, const AVFrame *frame, int64_t capture_time);
+
+/**
+ * @brief get_frame_tap_stat 获取统计
+ * @param tap 旁路
+ * @return TapStat 统计
+ */
+TapStat get_frame_tap_stat(FrameTap *tap);
+
+/**
+ * @brief close_frame_tap 解除映射并删除共享内存
+ * @param tap 旁路
+ */
+void close_frame_tap(FrameTap *tap);
+
+#endif
@@ -2,6 +2,7 @@
 #define TOOL_H
 
 #include <stdlib.h>
+#include <stdint.h>
 
 #include <libavutil/mathematics.h>
 
@@ -9,11 +10,12 @@
 
 #pragma region 用户层缓冲区
 
-// 用户层缓冲区
+// 用户层缓冲区 capture_time 为出队时刻 单位:us
 typedef struct BufType
 {
     void *start;
     int length;
+    int64_t capture_time;
 } BufType;
 
 /**
@@ -42,6 +44,15 @@ typedef struct Config
     AVRational time_base;
     unsigned int save_time;
     int64_t bit_rate;
+    unsigned int decode_threads; // 并行解码的上下文数 为0时使用在线CPU数
+    int huge_pages;              // 解码帧内存池是否使用 MAP_HUGETLB 大页
+    unsigned int encode_threads; // 编码器线程数 为0时使用ffmpeg默认值
+    char preset[16];             // 编码器速度档位 为空时使用后端的默认档位
+    char encoder[16];            // 编码器后端 为 auto 时启动时校准选择
+    int intra_refresh;           // 是否以周期性帧内刷新代替周期性关键帧
+    unsigned int slice_max_size; // 单个 slice 的最大字节数 为0时不限制
+    unsigned int vbv_latency;    // VBV 缓冲对应的时长 单位:ms 为0时为一秒
+    int yuv420;                  // 是否强制以 4:2:0 编码 浏览器不能播放 High 4:2:2
 } Config;
 
 /**
@@ -53,58 +64,212 @@ unsigned int get_save_frame(Config config);
 
 #pragma endregion
 
-#pragma region 链表
+#pragma region 系统
 
-typedef struct Node
+/**
+ * @brief get_cpu_count 获取在线CPU数
+ * @return unsigned int 至少为1
+ */
+unsigned int get_cpu_count(void);
+
+/**
+ * @brief get_thread_cpu_time 获取调用线程已消耗的CPU时间
+ * @return int64_t CPU时间 单位:us
+ */
+int64_t get_thread_cpu_time(void);
+
+#pragma endregion
+
+#pragma region 容器
+
+/**
+ * @brief Array 可增长的连续数组, 元素按值存放
+ * @property data 元素存储
+ * @property elem_size 元素大小
+ * @property length 元素数量
+ * @property capacity 容量
+ */
+typedef struct Array
 {
     void *data;
-    struct Node *next;
-} Node;
+    size_t elem_size;
+    unsigned int length;
+    unsigned int capacity;
+} Array;
 
-typedef struct LinkedList
-{
-    Node *head;
-} LinkedList;
+// 按类型访问数组元素
+#define ARRAY_GET(array, type, index) ((type *)get_array(array, index))
 
 /**
- * @brief create_linked_list 创建链表
- * @return LinkedList*
+ * @brief create_array 创建数组
+ * @param elem_size 元素大小
+ * @param capacity 初始容量
+ * @return Array*
  */
-LinkedList *create_linked_list();
+Array *create_array(size_t elem_size, unsigned int capacity);
 
 /**
- * @brief free_linked_list 释放链表
- * @param list 待释放的链表
+ * @brief free_array 释放数组
+ * @param array 待释放的数组
  */
-void free_linked_list(LinkedList *list);
+void free_array(Array *array);
 
 /**
- * @brief append_linked_list 向链表尾部添加元素
- * @param list 待添加的链表
- * @param data 数据
+ * @brief append_array 向数组尾部复制添加元素 容量不足时倍增
+ * @param array 待添加的数组
+ * @param elem 元素的指针
+ * @return int 成功返回0, 内存不足返回-1
  */
-void append_linked_list(LinkedList *list, void *data);
+int append_array(Array *array, const void *elem);
 
 /**
- * @brief foreach_linked_list 遍历链表
- * @param list 待处理的链表
- * @param func 处理函数
+ * @brief get_array 按索引获取数组中的元素
+ * @param array 数组
+ * @param index 索引
+ * @return void* 元素的指针 索引越界返回NULL
  */
-void foreach_linked_list(LinkedList *list, void (*func)(void *));
+void *get_array(Array *array, unsigned int index);
 
 /**
- * @brief get_linked_list 按索引获取链表中的元素
+ * @brief remove_array 按索引移除数组中的元素 保持其余元素顺序
+ * @param array 数组
  * @param index 索引
- * @return void* 数据
+ * @return int 索引越界错误 -1
+ */
+int remove_array(Array *array, unsigned int index);
+
+/**
+ * @brief foreach_array 遍历数组
+ * @param array 待处理的数组
+ * @param func 处理函数
+ */
+void foreach_array(Array *array, void (*func)(void *));
+
+/**
+ * @brief RingBuffer 定长环形队列, 元素按值存放
+ * @note 非线程安全, 由调用方加锁
+ * @property data 元素存储
+ * @property elem_size 元素大小
+ * @property capacity 容量
+ * @property head 队头索引
+ * @property length 元素数量
+ */
+typedef struct RingBuffer
+{
+    void *data;
+    size_t elem_size;
+    unsigned int capacity;
+    unsigned int head;
+    unsigned int length;
+} RingBuffer;
+
+/**
+ * @brief create_ring_buffer 创建环形队列
+ * @param elem_size 元素大小
+ * @param capacity 容量 为0时使用默认容量
+ * @return RingBuffer*
+ */
+RingBuffer *create_ring_buffer(size_t elem_size, unsigned int capacity);
+
+/**
+ * @brief free_ring_buffer 释放环形队列
+ * @param ring 待释放的队列
  */
-void *get_linked_list(LinkedList *list, unsigned int index);
+void free_ring_buffer(RingBuffer *ring);
 
 /**
- * @brief remove_linked_list 按索引移除链表中的元素
+ * @brief push_ring_buffer 向队尾复制添加元素
+ * @param ring 队列
+ * @param elem 元素的指针
+ * @return int 成功返回0, 队列已满返回-1
+ */
+int push_ring_buffer(RingBuffer *ring, const void *elem);
+
+/**
+ * @brief pop_ring_buffer 取出队头元素
+ * @param ring 队列
+ * @param elem 接收元素的指针 可为NULL
+ * @return int 成功返回0, 队列为空返回-1
+ */
+int pop_ring_buffer(RingBuffer *ring, void *elem);
+
+/**
+ * @brief peek_ring_buffer 按距队头的偏移查看元素
+ * @param ring 队列
+ * @param index 距队头的偏移
+ * @return void* 元素的指针 越界返回NULL
+ */
+void *peek_ring_buffer(RingBuffer *ring, unsigned int index);
+
+/**
+ * @brief ObjectPool 定长对象池, 以空闲索引栈管理一块连续存储
+ * @note 非线程安全, 由调用方加锁
+ * @property storage 对象存储
+ * @property owned 存储是否由对象池分配
+ * @property elem_size 对象大小
+ * @property capacity 对象数量
+ * @property free_list 空闲对象索引栈
+ * @property free_num 空闲对象数量
+ */
+typedef struct ObjectPool
+{
+    uint8_t *storage;
+    int owned;
+    size_t elem_size;
+    unsigned int capacity;
+    unsigned int *free_list;
+    unsigned int free_num;
+} ObjectPool;
+
+// 按类型获取对象
+#define POOL_ACQUIRE(pool, type) ((type *)acquire_object_pool(pool))
+// 按类型访问索引处的对象
+#define POOL_GET(pool, type, index) ((type *)get_object_pool(pool, index))
+
+/**
+ * @brief create_object_pool 创建对象池
+ * @param elem_size 对象大小
+ * @param capacity 对象数量
+ * @param storage 外部提供的存储 大小至少为 elem_size * capacity, 为NULL时由对象池分配
+ * @return ObjectPool*
+ */
+ObjectPool *create_object_pool(size_t elem_size, unsigned int capacity, void *storage);
+
+/**
+ * @brief free_object_pool 释放对象池 外部提供的存储由调用方释放
+ * @param pool 待释放的对象池
+ */
+void free_object_pool(ObjectPool *pool);
+
+/**
+ * @brief acquire_object_pool 获取一个空闲对象
+ * @param pool 对象池
+ * @return void* 对象的指针 没有空闲对象返回NULL
+ */
+void *acquire_object_pool(ObjectPool *pool);
+
+/**
+ * @brief release_object_pool 归还对象
+ * @param pool 对象池
+ * @param object 由 acquire_object_pool 获取的对象
+ */
+void release_object_pool(ObjectPool *pool, void *object);
+
+/**
+ * @brief index_object_pool 获取对象在对象池中的索引
+ * @param pool 对象池
+ * @param object 对象的指针
+ * @return unsigned int 索引
+ */
+unsigned int index_object_pool(ObjectPool *pool, const void *object);
+
+/**
+ * @brief get_object_pool 按索引获取对象池中的对象 不论对象是否空闲
+ * @param pool 对象池
  * @param index 索引
- * @return int 索引越界错误 -1
+ * @return void* 对象的指针 索引越界返回NULL
  */
-int remove_linked_list(LinkedList *list, unsigned int index);
+void *get_object_pool(ObjectPool *pool, unsigned int index);
 
 #pragma endregion
 
@@ -0,0 +1,121 @@
+#ifndef UDP_H
+#define UDP_H
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <libavformat/avio.h>
+#include <libavutil/mem.h>
+#include <libavutil/time.h>
+
+#include "./logger.h"
+#include "./tool.h"
+#include "./affinity.h"
+
+// 每个数据报承载 7 个 TS 包, 不超过以太网 MTU
+#define UDP_DATAGRAM_SIZE (188 * 7)
+
+// 发送队列容量 单位:数据报
+#define UDP_QUEUE_SIZE 1024
+
+// 单次 sendmmsg 最多发送的数据报数
+#define UDP_MAX_BATCH 32
+
+// 两次发送之间的最小间隔 积压较多时合并为一批, 限制系统调用频率 单位:us
+#define UDP_MIN_TICK 500
+
+// 积压的数据报在帧间隔的这一比例内均匀发出
+#define UDP_PACE_RATIO 0.8
+
+// 组播的 TTL 只到达本地网络
+#define UDP_MULTICAST_TTL 1
+
+/**
+ * @brief UdpDatagram 一个待发送的数据报
+ * @property size 数据大小
+ * @property data 数据
+ */
+typedef struct UdpDatagram
+{
+    unsigned int size;
+    uint8_t data[UDP_DATAGRAM_SIZE];
+} UdpDatagram;
+
+/**
+ * @brief UdpStat 发送统计
+ * @property sent 已发送的数据报数
+ * @property dropped 队列满丢弃的数据报数
+ * @property failed 发送失败的数据报数
+ * @property batches sendmmsg 调用次数
+ * @property max_depth 队列的最大积压 单位:数据报
+ */
+typedef struct UdpStat
+{
+    int64_t sent;
+    int64_t dropped;
+    int64_t failed;
+    int64_t batches;
+    unsigned int max_depth;
+} UdpStat;
+
+/**
+ * @brief UdpSender 匀速发送数据报的线程
+ * @note 封装器经 pb 写入的 TS 数据按数据报入队, 发送线程把当前积压
+ *       均匀分布在一个帧间隔内以 sendmmsg 分批发出, 避免整帧突发造成接收端丢包
+ * @property fd 套接字
+ * @property address 目的地址
+ * @property address_len 目的地址长度
+ * @property window 积压在多长时间内发完 单位:us
+ * @property datagrams 待发送的数据报 元素为 UdpDatagram
+ * @property pb 交给 libavformat 使用的 IO 上下文 缓冲为一个数据报大小
+ * @property stat 累计统计
+ * @property reported 上次取出统计时的累计值
+ */
+typedef struct UdpSender
+{
+    int fd;
+    struct sockaddr_storage address;
+    socklen_t address_len;
+    int64_t window;
+    RingBuffer *datagrams;
+    AVIOContext *pb;
+    UdpStat stat;
+    UdpStat reported;
+    pthread_t thread;
+    int stop;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} UdpSender;
+
+/**
+ * @brief open_udp_sender 解析地址 创建套接字与发送线程
+ * @param address 目的地址 格式为 host:port, 组播地址自动设置 TTL
+ * @param time_base 帧间隔 决定匀速发送的时间窗
+ * @return UdpSender* 失败返回NULL
+ */
+UdpSender *open_udp_sender(const char *address, AVRational time_base);
+
+/**
+ * @brief get_udp_sender_stat 取出上次调用以来的发送统计
+ * @note 重新打开输出时发送线程随之重建, 调用方累加增量即可得到连续的统计
+ * @param sender 发送线程
+ * @return UdpStat 统计增量 max_depth 为这段时间内的最大积压
+ */
+UdpStat get_udp_sender_stat(UdpSender *sender);
+
+/**
+ * @brief close_udp_sender 按节奏发完积压的数据报后停止发送线程
+ * @note 积压在一个发送时间窗内发完, 最多阻塞约一帧的时长
+ * @param sender 发送线程
+ */
+void close_udp_sender(UdpSender *sender);
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef WORKER_H
+#define WORKER_H
+
+#include <pthread.h>
+
+#include "./tool.h"
+#include "./logger.h"
+#include "./affinity.h"
+
+// 每个工作线程的任务队列容量
+#define WORKER_QUEUE_SIZE 1024
+
+/**
+ * @brief Task 任务
+ * @property func 任务函数
+ * @property arg 任务参数
+ */
+typedef struct Task
+{
+    void (*func)(void *arg);
+    void *arg;
+} Task;
+
+/**
+ * @brief WorkerQueue 工作线程的任务队列
+ * @property tasks 任务 元素为 Task
+ * @property pool 所属的线程池
+ */
+typedef struct WorkerQueue
+{
+    pthread_mutex_t mutex;
+    RingBuffer *tasks;
+    struct WorkerPool *pool;
+} WorkerQueue;
+
+/**
+ * @brief WorkerPool 所有相机共享的工作窃取线程池
+ * @note 外部提交的任务轮流放入各线程的队列, 线程自身提交的任务放入自己的队列,
+ *       线程自己的队列为空时从其他线程的队列头部窃取任务
+ * @property num 线程数
+ * @property running 已启动的线程数
+ * @property threads 线程
+ * @property queues 各线程的任务队列
+ * @property pending 排队中的任务数
+ * @property next 下一个接收外部任务的队列
+ */
+typedef struct WorkerPool
+{
+    unsigned int num;
+    unsigned int running;
+    pthread_t *threads;
+    WorkerQueue *queues;
+    unsigned int pending;
+    unsigned int next;
+    int stop;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} WorkerPool;
+
+/**
+ * @brief open_worker_pool 创建并启动线程池
+ * @param num 线程数 为0时使用在线CPU数
+ * @return WorkerPool* 失败返回NULL
+ */
+WorkerPool *open_worker_pool(unsigned int num);
+
+/**
+ * @brief submit_worker_pool 提交任务
+ * @param pool 线程池
+ * @param func 任务函数
+ * @param arg 任务参数
+ * @return int 成功返回0, 队列已满返回-1
+ */
+int submit_worker_pool(WorkerPool *pool, void (*func)(void *), void *arg);
+
+/**
+ * @brief close_worker_pool 执行完排队的任务后停止线程并释放线程池
+ * @param pool 线程池
+ */
+void close_worker_pool(WorkerPool *pool);
+
+#endif
@@ -0,0 +1,404 @@
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include <libavutil/time.h>
+
+#include "../../include/aio.h"
+
+#pragma region 线程池
+
+/**
+ * @brief AioPool 所有写入器共享的 pwrite 线程池
+ * @property head 请求队列头
+ * @property tail 请求队列尾
+ */
+static struct
+{
+    pthread_once_t once;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    AioJob *head;
+    AioJob *tail;
+    pthread_t threads[AIO_THREAD_NUM];
+    int started;
+} aio_pool = {PTHREAD_ONCE_INIT, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, NULL, NULL, {0}, 0};
+
+static void complete_job(AioWriter *writer, AioJob *job, int error);
+
+static void *pool_loop(void *arg)
+{
+    (void)arg;
+    apply_affinity(ROLE_IO);
+    while (1)
+    {
+        pthread_mutex_lock(&aio_pool.mutex);
+        while (!aio_pool.head)
+            pthread_cond_wait(&aio_pool.cond, &aio_pool.mutex);
+        AioJob *job = aio_pool.head;
+        aio_pool.head = job->next;
+        if (!aio_pool.head)
+            aio_pool.tail = NULL;
+        pthread_mutex_unlock(&aio_pool.mutex);
+
+        AioWriter *writer = job->writer;
+        uint8_t *data = writer->arena + (size_t)job->index * writer->buf_size;
+        int error = 0;
+        while (job->done < job->length)
+        {
+            ssize_t ret = pwrite(writer->fd, data + job->done, job->length - job->done, job->offset + job->done);
+            if (ret < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                error = errno;
+                break;
+            }
+            job->done += ret;
+        }
+        complete_job(writer, job, error);
+    }
+    return NULL;
+}
+
+static void start_pool(void)
+{
+    for (int i = 0; i < AIO_THREAD_NUM; i++)
+    {
+        if (pthread_create(&aio_pool.threads[i], NULL, pool_loop, NULL) != 0)
+        {
+            LOG(logger, LOG_ERROR, "Create aio thread failed");
+            break;
+        }
+        pthread_detach(aio_pool.threads[i]);
+        aio_pool.started++;
+    }
+}
+
+static void push_pool(AioJob *job)
+{
+    job->next = NULL;
+    pthread_mutex_lock(&aio_pool.mutex);
+    if (aio_pool.tail)
+        aio_pool.tail->next = job;
+    else
+        aio_pool.head = job;
+    aio_pool.tail = job;
+    pthread_cond_signal(&aio_pool.cond);
+    pthread_mutex_unlock(&aio_pool.mutex);
+}
+
+#pragma endregion
+
+/**
+ * @brief complete_job 记录统计信息并回收缓冲区
+ * @param error 写入失败时的 errno, 成功为0
+ */
+static void complete_job(AioWriter *writer, AioJob *job, int error)
+{
+    int64_t latency = av_gettime_relative() - job->submit_time;
+    int bucket = 0;
+    while (bucket < AIO_HIST_SIZE - 1 && (1LL << bucket) <= latency)
+        bucket++;
+
+    pthread_mutex_lock(&writer->mutex);
+    if (error)
+        writer->error = error;
+    writer->stat.bytes += job->done;
+    writer->stat.writes++;
+    writer->stat.histogram[bucket]++;
+    if (latency > writer->stat.max_latency)
+        writer->stat.max_latency = latency;
+    release_object_pool(writer->buffers, writer->arena + (size_t)job->index * writer->buf_size);
+    writer->in_flight--;
+    pthread_cond_broadcast(&writer->cond);
+    pthread_mutex_unlock(&writer->mutex);
+}
+
+#pragma region io_uring
+
+#ifdef WAMERA_HAVE_URING
+
+static int queue_uring(AioWriter *writer, AioJob *job)
+{
+    struct io_uring_sqe *sqe = io_uring_get_sqe(&writer->ring);
+    if (!sqe)
+        return -1;
+    uint8_t *data = writer->arena + (size_t)job->index * writer->buf_size;
+    io_uring_prep_write_fixed(sqe, writer->fd, data + job->done, job->length - job->done,
+                              job->offset + job->done, job->index);
+    io_uring_sqe_set_data(sqe, job);
+    return io_uring_submit(&writer->ring) < 0 ? -1 : 0;
+}
+
+/**
+ * @brief reap_uring 处理 io_uring 完成事件
+ * @param wait 没有完成事件时是否等待
+ */
+static void reap_uring(AioWriter *writer, int wait)
+{
+    struct io_uring_cqe *cqe;
+    int ret = wait ? io_uring_wait_cqe(&writer->ring, &cqe) : io_uring_peek_cqe(&writer->ring, &cqe);
+    while (ret == 0)
+    {
+        AioJob *job = (AioJob *)io_uring_cqe_get_data(cqe);
+        int res = cqe->res;
+        io_uring_cqe_seen(&writer->ring, cqe);
+
+        if (res < 0)
+            complete_job(writer, job, -res);
+        else
+        {
+            job->done += res;
+            // 短写时继续提交剩余部分
+            if (job->done < job->length && res > 0)
+            {
+                if (queue_uring(writer, job) < 0)
+                    complete_job(writer, job, EIO);
+            }
+            else
+                complete_job(writer, job, job->done < job->length ? EIO : 0);
+        }
+        ret = io_uring_peek_cqe(&writer->ring, &cqe);
+    }
+}
+
+static int init_uring(AioWriter *writer)
+{
+    if (io_uring_queue_init(writer->buf_num, &writer->ring, 0) < 0)
+        return -1;
+
+    struct iovec *iovecs = (struct iovec *)calloc(writer->buf_num, sizeof(struct iovec));
+    if (!iovecs)
+    {
+        io_uring_queue_exit(&writer->ring);
+        return -1;
+    }
+    for (unsigned int i = 0; i < writer->buf_num; i++)
+    {
+        iovecs[i].iov_base = writer->arena + (size_t)i * writer->buf_size;
+        iovecs[i].iov_len = writer->buf_size;
+    }
+    int ret = io_uring_register_buffers(&writer->ring, iovecs, writer->buf_num);
+    free(iovecs);
+    if (ret < 0)
+    {
+        io_uring_queue_exit(&writer->ring);
+        return -1;
+    }
+    return 0;
+}
+
+#endif
+
+#pragma endregion
+
+AioWriter *open_aio_writer(int fd, AioBackend backend, unsigned int buf_num, unsigned int buf_size)
+{
+    AioWriter *writer = (AioWriter *)calloc(1, sizeof(AioWriter));
+    if (!writer)
+    {
+        LOG(logger, LOG_ERROR, "Memory allocation failed");
+        return NULL;
+    }
+
+    if (backend == AIO_SYNC || buf_num == 0)
+        buf_num = 1;
+    writer->fd = fd;
+    writer->backend = backend;
+    writer->buf_num = buf_num;
+    writer->buf_size = buf_size;
+    writer->stat.start_time = av_gettime_relative();
+
+    writer->jobs = (AioJob *)calloc(buf_num, sizeof(AioJob));
+    if (posix_memalign((void **)&writer->arena, 4096, (size_t)buf_num * buf_size) != 0)
+        writer->arena = NULL;
+    if (writer->arena)
+        writer->buffers = create_object_pool(buf_size, buf_num, writer->arena);
+    if (!writer->jobs || !writer->buffers)
+    {
+        LOG(logger, LOG_ERROR, "Memory allocation failed");
+        free_object_pool(writer->buffers);
+        free(writer->jobs);
+        free(writer->arena);
+        free(writer);
+        return NULL;
+    }
+    for (unsigned int i = 0; i < buf_num; i++)
+    {
+        writer->jobs[i].index = i;
+        writer->jobs[i].writer = writer;
+    }
+
+    if (writer->backend == AIO_URING)
+    {
+#ifdef WAMERA_HAVE_URING
+        if (init_uring(writer) < 0)
+        {
+            LOG(logger, LOG_WARNING, "Io_uring unavailable, fallback to thread pool");
+            writer->backend = AIO_THREAD;
+        }
+#else
+        LOG(logger, LOG_DEBUG, "Io_uring not compiled in, fallback to thread pool");
+        writer->backend = AIO_THREAD;
+#endif
+    }
+    if (writer->backend == AIO_THREAD)
+    {
+        pthread_once(&aio_pool.once, start_pool);
+        if (aio_pool.started == 0)
+            writer->backend = AIO_SYNC;
+    }
+
+    pthread_mutex_init(&writer->mutex, NULL);
+    pthread_cond_init(&writer->cond, NULL);
+    return writer;
+}
+
+uint8_t *acquire_aio_buffer(AioWriter *writer)
+{
+#ifdef WAMERA_HAVE_URING
+    // io_uring 的完成事件由调用线程回收
+    if (writer->backend == AIO_URING)
+    {
+        reap_uring(writer, 0);
+        while (writer->buffers->free_num == 0)
+            reap_uring(writer, 1);
+    }
+#endif
+
+    pthread_mutex_lock(&writer->mutex);
+    uint8_t *buf;
+    while (!(buf = (uint8_t *)acquire_object_pool(writer->buffers)))
+        pthread_cond_wait(&writer->cond, &writer->mutex);
+    pthread_mutex_unlock(&writer->mutex);
+
+    return buf;
+}
+
+int submit_aio_buffer(AioWriter *writer, uint8_t *buf, unsigned int length, int64_t offset)
+{
+    AioJob *job = &writer->jobs[index_object_pool(writer->buffers, buf)];
+    job->length = length;
+    job->done = 0;
+    job->offset = offset;
+    job->submit_time = av_gettime_relative();
+
+    pthread_mutex_lock(&writer->mutex);
+    writer->in_flight++;
+    int error = writer->error;
+    pthread_mutex_unlock(&writer->mutex);
+
+    switch (writer->backend)
+    {
+#ifdef WAMERA_HAVE_URING
+    case AIO_URING:
+        if (queue_uring(writer, job) < 0)
+            complete_job(writer, job, EIO);
+        break;
+#endif
+    case AIO_THREAD:
+        push_pool(job);
+        break;
+    default:
+    {
+        int ret_errno = 0;
+        while (job->done < job->length)
+        {
+            ssize_t ret = pwrite(writer->fd, buf + job->done, job->length - job->done, job->offset + job->done);
+            if (ret < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                ret_errno = errno;
+                break;
+            }
+            job->done += ret;
+        }
+        complete_job(writer, job, ret_errno);
+        break;
+    }
+    }
+
+    if (error)
+    {
+        LOG(logger, LOG_ERROR, "Async write failed: %s", strerror(error));
+        return -1;
+    }
+    return 0;
+}
+
+int drain_aio_writer(AioWriter *writer)
+{
+#ifdef WAMERA_HAVE_URING
+    if (writer->backend == AIO_URING)
+        while (writer->in_flight > 0)
+            reap_uring(writer, 1);
+#endif
+
+    pthread_mutex_lock(&writer->mutex);
+    while (writer->in_flight > 0)
+        pthread_cond_wait(&writer->cond, &writer->mutex);
+    int error = writer->error;
+    writer->error = 0;
+    pthread_mutex_unlock(&writer->mutex);
+
+    if (error)
+    {
+        LOG(logger, LOG_ERROR, "Async write failed: %s", strerror(error));
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief get_latency_percentile 由直方图估算延迟分位数
+ * @return int64_t 所在桶的上界 单位:us
+ */
+static int64_t get_latency_percentile(AioStat *stat, double percentile)
+{
+    int64_t target = (int64_t)(stat->writes * percentile);
+    int64_t count = 0;
+    for (int i = 0; i < AIO_HIST_SIZE; i++)
+    {
+        count += stat->histogram[i];
+        if (count > target)
+            return 1LL << i;
+    }
+    return stat->max_latency;
+}
+
+int close_aio_writer(AioWriter *writer)
+{
+    int ret = drain_aio_writer(writer);
+
+    int64_t elapsed = av_gettime_relative() - writer->stat.start_time;
+    static const char *backend_names[] = {"sync", "io_uring", "thread"};
+    LOG(logger, LOG_INFO,
+        "Aio `%s`: %.2f MB/s, %lld writes, p99 < %lld us, max %lld us",
+        backend_names[writer->backend],
+        elapsed > 0 ? writer->stat.bytes / (double)elapsed : 0.0,
+        (long long)writer->stat.writes,
+        (long long)get_latency_percentile(&writer->stat, 0.99),
+        (long long)writer->stat.max_latency);
+
+#ifdef WAMERA_HAVE_URING
+    if (writer->backend == AIO_URING)
+    {
+        io_uring_unregister_buffers(&writer->ring);
+        io_uring_queue_exit(&writer->ring);
+    }
+#endif
+
+    pthread_cond_destroy(&writer->cond);
+    pthread_mutex_destroy(&writer->mutex);
+    free_object_pool(writer->buffers);
+    free(writer->arena);
+    free(writer->jobs);
+    free(writer);
+    return ret;
+}
@@ -0,0 +1,583 @@
+#define _GNU_SOURCE
+#include "../../include/archive.h"
+
+// epoll 事件中非连接的标识
+#define ARCHIVE_LISTEN_ID UINT32_MAX
+#define ARCHIVE_STOP_ID (UINT32_MAX - 1)
+
+#pragma region Response
+
+/**
+ * @brief respond 生成响应头, 之后附加内存中的响应体
+ * @param status 状态行
+ * @param extra 附加的响应头 以 \r\n 结尾
+ * @param type 内容类型
+ * @param body 响应体 文件体或 HEAD 请求时为NULL
+ * @param body_size 响应体长度
+ * @param length Content-Length
+ * @return int 成功返回0, 失败返回-1
+ */
+static int respond(ArchiveConnection *connection, const char *status, const char *extra, const char *type,
+                   const char *body, size_t body_size, long long length)
+{
+    char header[512];
+    int header_size = snprintf(header, sizeof(header),
+                               "HTTP/1.1 %s\r\n"
+                               "Server: wamera\r\n"
+                               "Content-Type: %s\r\n"
+                               "Content-Length: %lld\r\n"
+                               "Accept-Ranges: bytes\r\n"
+                               "%s"
+                               "Connection: close\r\n\r\n",
+                               status, type, length, extra);
+    if (header_size < 0 || header_size >= (int)sizeof(header))
+        return -1;
+
+    connection->response = (char *)malloc(header_size + body_size);
+    if (!connection->response)
+    {
+        LOG(logger, LOG_ERROR, "Memory allocation failed");
+        return -1;
+    }
+    memcpy(connection->response, header, header_size);
+    if (body)
+        memcpy(connection->response + header_size, body, body_size);
+    connection->response_size = header_size + (body ? body_size : 0);
+    connection->response_sent = 0;
+    return 0;
+}
+
+/**
+ * @brief respond_error 以纯文本响应错误
+ */
+static int respond_error(ArchiveConnection *connection, const char *status, int head)
+{
+    char body[64];
+    int size = snprintf(body, sizeof(body), "%s\n", status);
+    return respond(connection, status, "", "text/plain", head ? NULL : body, size, size);
+}
+
+/**
+ * @brief respond_listing 以 HTML 列出录像目录中的文件
+ */
+static int respond_listing(ArchiveServer *server, ArchiveConnection *connection, int head)
+{
+    int fd = dup(server->dir_fd);
+    DIR *dir = fd >= 0 ? fdopendir(fd) : NULL;
+    if (!dir)
+    {
+        if (fd >= 0)
+            close(fd);
+        return respond_error(connection, "500 Internal Server Error", head);
+    }
+    rewinddir(dir);
+
+    size_t capacity = 4096, size = 0;
+    char *body = (char *)malloc(capacity);
+    if (body)
+        size = snprintf(body, capacity, "<!DOCTYPE html>\n<html><body>\n");
+    struct dirent *entry;
+    while (body && (entry = readdir(dir)))
+    {
+        struct stat st;
+        if (entry->d_name[0] == '.' || fstatat(server->dir_fd, entry->d_name, &st, 0) < 0 || !S_ISREG(st.st_mode))
+            continue;
+        // 单行最长为两倍文件名加数字与标签
+        size_t need = size + 2 * strlen(entry->d_name) + 64;
+        if (need > capacity)
+        {
+            capacity = FFMAX(capacity * 2, need);
+            char *grown = (char *)realloc(body, capacity);
+            if (!grown)
+            {
+                free(body);
+                body = NULL;
+                break;
+            }
+            body = grown;
+        }
+        size += snprintf(body + size, capacity - size, "<a href=\"%s\">%s</a> %lld<br>\n", entry->d_name,
+                         entry->d_name, (long long)st.st_size);
+    }
+    closedir(dir);
+    if (!body)
+    {
+        LOG(logger, LOG_ERROR, "Memory allocation failed");
+        return -1;
+    }
+    if (size + 16 > capacity)
+    {
+        char *grown = (char *)realloc(body, size + 16);
+        if (!grown)
+        {
+            free(body);
+            return -1;
+        }
+        body = grown;
+    }
+    size += snprintf(body + size, 16, "</body></html>\n");
+
+    int ret = respond(connection, "200 OK", "", "text/html; charset=utf-8", head ? NULL : body, size, size);
+    free(body);
+    return ret;
+}
+
+/**
+ * @brief parse_range 解析单个字节范围 bytes=a-b, bytes=a- 或 bytes=-n
+ * @return int 有效范围返回0, 应忽略返回1, 无法满足返回-1
+ */
+static int parse_range(const char *value, off_t size, off_t *start, off_t *end)
+{
+    while (*value == ' ')
+        value++;
+    if (strncasecmp(value, "bytes=", 6) != 0)
+        return 1;
+    value += 6;
+    // 多个范围需要 multipart 响应, 按规范可以忽略而返回整个文件
+    if (strchr(value, ','))
+        return 1;
+
+    char *rest;
+    if (*value == '-')
+    {
+        long long suffix = strtoll(value + 1, &rest, 10);
+        if (rest == value + 1 || suffix < 0)
+            return 1;
+        if (suffix == 0 || size == 0)
+            return -1;
+        *start = size - FFMIN(suffix, (long long)size);
+        *end = size;
+        return 0;
+    }
+
+    long long first = strtoll(value, &rest, 10);
+    if (rest == value || *rest != '-' || first < 0)
+        return 1;
+    value = rest + 1;
+    long long last = size - 1;
+    if (*value >= '0' && *value <= '9')
+    {
+        last = strtoll(value, &rest, 10);
+        if (last < first)
+            return 1;
+    }
+    if (first >= size)
+        return -1;
+    *start = first;
+    *end = FFMIN(last + 1, (long long)size);
+    return 0;
+}
+
+/**
+ * @brief find_header 在请求头中查找字段 大小写不敏感
+ * @return const char* 字段值 不存在时返回NULL
+ */
+static const char *find_header(const char *request, const char *name)
+{
+    size_t length = strlen(name);
+    for (const char *line = strstr(request, "\r\n"); line; line = strstr(line, "\r\n"))
+    {
+        line += 2;
+        if (strncasecmp(line, name, length) == 0 && line[length] == ':')
+            return line + length + 1;
+    }
+    return NULL;
+}
+
+/**
+ * @brief handle_request 解析请求并准备响应
+ * @note 只接受录像目录中的普通文件名, 不含路径分隔符且不以 . 开头
+ * @return int 成功返回0, 需要关闭连接返回-1
+ */
+static int handle_request(ArchiveServer *server, ArchiveConnection *connection)
+{
+    char *request = connection->request;
+    int head = strncmp(request, "HEAD ", 5) == 0;
+    if (!head && strncmp(request, "GET ", 4) != 0)
+        return respond_error(connection, "405 Method Not Allowed", 0);
+
+    char *path = request + (head ? 5 : 4);
+    char *path_end = strpbrk(path, " ?\r");
+    if (*path != '/' || !path_end)
+        return respond_error(connection, "400 Bad Request", head);
+    size_t length = path_end - path - 1;
+    server->stat.requests++;
+    if (length == 0)
+        return respond_listing(server, connection, head);
+    if (length > NAME_MAX)
+        return respond_error(connection, "404 Not Found", head);
+    char name[NAME_MAX + 1];
+    memcpy(name, path + 1, length);
+    name[length] = '\0';
+    if (name[0] == '.' || strchr(name, '/') || strchr(name, '%'))
+        return respond_error(connection, "404 Not Found", head);
+
+    int file = openat(server->dir_fd, name, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (file < 0 || fstat(file, &st) < 0 || !S_ISREG(st.st_mode))
+    {
+        if (file >= 0)
+            close(file);
+        return respond_error(connection, "404 Not Found", head);
+    }
+
+    // 正在录制的文件按打开时的大小发送
+    off_t start = 0, end = st.st_size;
+    const char *range = find_header(request, "Range");
+    int ret = range ? parse_range(range, st.st_size, &start, &end) : 1;
+    const char *dot = strrchr(name, '.');
+    const char *type = dot && strcasecmp(dot, ".mp4") == 0 ? "video/mp4" : "application/octet-stream";
+    char extra[128];
+    if (ret < 0)
+    {
+        close(file);
+        snprintf(extra, sizeof(extra), "Content-Range: bytes */%lld\r\n", (long long)st.st_size);
+        return respond(connection, "416 Range Not Satisfiable", extra, "text/plain", NULL, 0, 0);
+    }
+    if (ret == 0)
+    {
+        server->stat.ranges++;
+        snprintf(extra, sizeof(extra), "Content-Range: bytes %lld-%lld/%lld\r\n", (long long)start,
+                 (long long)end - 1, (long long)st.st_size);
+    }
+    else
+        extra[0] = '\0';
+    if (respond(connection, ret == 0 ? "206 Partial Content" : "200 OK", extra, type, NULL, 0,
+                (long long)(end - start)) < 0)
+    {
+        close(file);
+        return -1;
+    }
+    if (head || start == end)
+    {
+        close(file);
+        return 0;
+    }
+
+    posix_fadvise(file, start, end - start, POSIX_FADV_SEQUENTIAL);
+    connection->file = file;
+    connection->offset = start;
+    connection->end = end;
+    LOG(logger, LOG_DEBUG, "Archive serve `%s` bytes %lld-%lld", name, (long long)start, (long long)end - 1);
+    return 0;
+}
+
+#pragma endregion
+
+#pragma region Connections
+
+/**
+ * @brief close_connection 关闭连接并释放槽, 连接数从满变为未满时恢复监听
+ */
+static void close_connection(ArchiveServer *server, ArchiveConnection *connection)
+{
+    close(connection->fd);
+    connection->fd = -1;
+    if (connection->file >= 0)
+        close(connection->file);
+    connection->file = -1;
+    free(connection->response);
+    connection->response = NULL;
+    server->active--;
+
+    if (!server->listening)
+    {
+        struct epoll_event event = {.events = EPOLLIN, .data.u32 = ARCHIVE_LISTEN_ID};
+        if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, server->listen_fd, &event) == 0)
+            server->listening = 1;
+    }
+}
+
+/**
+ * @brief accept_connections 接受等待中的连接直到槽用尽, 槽用尽时暂停监听
+ * @note 暂停期间新连接留在内核的监听队列中
+ */
+static void accept_connections(ArchiveServer *server)
+{
+    while (server->active < server->config.connections)
+    {
+        int fd = accept4(server->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            if (errno != EAGAIN && errno != EINTR)
+                LOG(logger, LOG_WARNING, "Archive accept failed: %s", strerror(errno));
+            return;
+        }
+
+        unsigned int index = 0;
+        while (server->connections[index].fd >= 0)
+            index++;
+        ArchiveConnection *connection = &server->connections[index];
+        connection->fd = fd;
+        connection->state = ARCHIVE_REQUEST;
+        connection->received = 0;
+        connection->active = av_gettime_relative();
+
+        struct epoll_event event = {.events = EPOLLIN, .data.u32 = index};
+        if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0)
+        {
+            close(fd);
+            connection->fd = -1;
+            continue;
+        }
+        server->active++;
+    }
+
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, server->listen_fd, NULL);
+    server->listening = 0;
+}
+
+/**
+ * @brief read_request 读取请求头, 读完后准备响应并改为等待可写
+ * @return int 继续服务返回0, 需要关闭连接返回-1
+ */
+static int read_request(ArchiveServer *server, ArchiveConnection *connection)
+{
+    while (1)
+    {
+        ssize_t ret = recv(connection->fd, connection->request + connection->received,
+                           ARCHIVE_REQUEST_SIZE - 1 - connection->received, 0);
+        if (ret < 0)
+            return errno == EAGAIN || errno == EINTR ? 0 : -1;
+        if (ret == 0)
+            return -1;
+        connection->received += ret;
+        connection->request[connection->received] = '\0';
+        if (strstr(connection->request, "\r\n\r\n"))
+            break;
+        if (connection->received == ARCHIVE_REQUEST_SIZE - 1)
+        {
+            if (respond_error(connection, "431 Request Header Fields Too Large", 0) < 0)
+                return -1;
+            break;
+        }
+    }
+
+    if (!connection->response && handle_request(server, connection) < 0)
+        return -1;
+    connection->state = ARCHIVE_RESPONSE;
+    struct epoll_event event = {.events = EPOLLOUT, .data.u32 = connection - server->connections};
+    return epoll_ctl(server->epoll_fd, EPOLL_CTL_MOD, connection->fd, &event);
+}
+
+/**
+ * @brief write_response 发送响应头, 之后以 sendfile 发送文件区间
+ * @note 每次最多发送 ARCHIVE_CHUNK 字节后让出, 各连接轮流推进
+ * @return int 继续服务返回0, 发送完成或需要关闭连接返回-1
+ */
+static int write_response(ArchiveServer *server, ArchiveConnection *connection)
+{
+    if (connection->state == ARCHIVE_RESPONSE)
+    {
+        while (connection->response_sent < connection->response_size)
+        {
+            // 响应头与随后的文件体合并为同一批 TCP 段
+            int flags = MSG_NOSIGNAL | (connection->file >= 0 ? MSG_MORE : 0);
+            ssize_t ret = send(connection->fd, connection->response + connection->response_sent,
+                               connection->response_size - connection->response_sent, flags);
+            if (ret < 0)
+                return errno == EAGAIN || errno == EINTR ? 0 : -1;
+            connection->response_sent += ret;
+        }
+        if (connection->file < 0)
+            return -1;
+        connection->state = ARCHIVE_FILE;
+    }
+
+    size_t count = FFMIN(connection->end - connection->offset, ARCHIVE_CHUNK);
+    ssize_t ret = sendfile(connection->fd, connection->file, &connection->offset, count);
+    if (ret < 0)
+        return errno == EAGAIN || errno == EINTR ? 0 : -1;
+    // 文件在打开后被截断
+    if (ret == 0)
+        return -1;
+    server->stat.bytes += ret;
+    return connection->offset < connection->end ? 0 : -1;
+}
+
+#pragma endregion
+
+/**
+ * @brief lower_priority 以空闲 IO 优先级与较低的 CPU 优先级运行调用线程
+ * @note IO 优先级只在 BFQ 等支持优先级的 IO 调度器上生效
+ */
+static void lower_priority(void)
+{
+    pid_t tid = syscall(SYS_gettid);
+    int ioprio = ARCHIVE_IOPRIO_CLASS_IDLE << ARCHIVE_IOPRIO_CLASS_SHIFT;
+    if (syscall(SYS_ioprio_set, ARCHIVE_IOPRIO_WHO_PROCESS, tid, ioprio) < 0)
+        LOG(logger, LOG_WARNING, "Set archive io priority failed: %s", strerror(errno));
+    if (setpriority(PRIO_PROCESS, tid, ARCHIVE_NICE) < 0)
+        LOG(logger, LOG_WARNING, "Set archive nice failed: %s", strerror(errno));
+}
+
+static void *archive_loop(void *arg)
+{
+    ArchiveServer *server = (ArchiveServer *)arg;
+    apply_affinity(ROLE_IO);
+    lower_priority();
+
+    struct epoll_event events[16];
+    while (1)
+    {
+        int num = epoll_wait(server->epoll_fd, events, 16, 1000);
+        if (num < 0 && errno != EINTR)
+        {
+            LOG(logger, LOG_ERROR, "Archive epoll wait failed");
+            break;
+        }
+
+        int64_t now = av_gettime_relative();
+        for (int i = 0; i < num; i++)
+        {
+            uint32_t id = events[i].data.u32;
+            if (id == ARCHIVE_STOP_ID)
+                return NULL;
+            if (id == ARCHIVE_LISTEN_ID)
+            {
+                accept_connections(server);
+                continue;
+            }
+
+            ArchiveConnection *connection = &server->connections[id];
+            if (connection->fd < 0)
+                continue;
+            off_t offset = connection->offset;
+            size_t sent = connection->response_sent;
+            int ret = connection->state == ARCHIVE_REQUEST ? read_request(server, connection)
+                                                           : write_response(server, connection);
+            if (ret < 0 || (events[i].events & (EPOLLERR | EPOLLHUP)))
+                close_connection(server, connection);
+            else if (connection->offset != offset || connection->response_sent != sent ||
+                     connection->state == ARCHIVE_REQUEST)
+                connection->active = now;
+        }
+
+        // 关闭长时间没有进展的连接, 慢速或失联的客户端不能一直占用槽
+        for (unsigned int i = 0; i < server->config.connections; i++)
+        {
+            ArchiveConnection *connection = &server->connections[i];
+            if (connection->fd >= 0 && now - connection->active > ARCHIVE_TIMEOUT)
+                close_connection(server, connection);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief open_listen_socket 创建非阻塞的监听套接字
+ * @return int 成功返回套接字, 失败返回-1
+ */
+static int open_listen_socket(ArchiveConfig config)
+{
+    struct sockaddr_in address = {0};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(config.port);
+    if (inet_pton(AF_INET, config.address, &address.sin_addr) != 1)
+    {
+        LOG(logger, LOG_ERROR, "Invalid archive address `%s`", config.address);
+        return -1;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        LOG(logger, LOG_ERROR, "Create archive socket failed: %s", strerror(errno));
+        return -1;
+    }
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) < 0 || listen(fd, 64) < 0)
+    {
+        LOG(logger, LOG_ERROR, "Listen on %s:%u failed: %s", config.address, config.port, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+ArchiveServer *open_archive_server(ArchiveConfig config)
+{
+    ArchiveServer *server = (ArchiveServer *)calloc(1, sizeof(ArchiveServer));
+    if (!server)
+    {
+        LOG(logger, LOG_ERROR, "Memory allocation failed");
+        return NULL;
+    }
+    config.connections = FFMAX(config.connections, 1);
+    server->config = config;
+    server->listen_fd = server->epoll_fd = server->stop_fd = -1;
+
+    server->dir_fd = open(config.dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (server->dir_fd < 0)
+    {
+        LOG(logger, LOG_ERROR, "Open archive dir `%s` failed: %s", config.dir, strerror(errno));
+        free(server);
+        return NULL;
+    }
+    server->connections = (ArchiveConnection *)calloc(config.connections, sizeof(ArchiveConnection));
+    if (!server->connections)
+    {
+        LOG(logger, LOG_ERROR, "Memory allocation failed");
+        goto fail;
+    }
+    for (unsigned int i = 0; i < config.connections; i++)
+        server->connections[i].fd = server->connections[i].file = -1;
+
+    server->listen_fd = open_listen_socket(config);
+    server->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    server->stop_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (server->listen_fd < 0 || server->epoll_fd < 0 || server->stop_fd < 0)
+        goto fail;
+    struct epoll_event listen_event = {.events = EPOLLIN, .data.u32 = ARCHIVE_LISTEN_ID};
+    struct epoll_event stop_event = {.events = EPOLLIN, .data.u32 = ARCHIVE_STOP_ID};
+    if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, server->listen_fd, &listen_event) < 0 ||
+        epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, server->stop_fd, &stop_event) < 0)
+    {
+        LOG(logger, LOG_ERROR, "Add archive socket to epoll failed");
+        goto fail;
+    }
+    server->listening = 1;
+
+    if (pthread_create(&server->thread, NULL, archive_loop, server) != 0)
+    {
+        LOG(logger, LOG_ERROR, "Create archive thread failed");
+        goto fail;
+    }
+    LOG(logger, LOG_INFO, "Serve archive `%s` on %s:%u, %u connections", config.dir, config.address, config.port,
+        config.connections);
+    return server;
+
+fail:
+    if (server->stop_fd >= 0)
+        close(server->stop_fd);
+    if (server->epoll_fd >= 0)
+        close(server->epoll_fd);
+    if (server->listen_fd >= 0)
+        close(server->listen_fd);
+    free(server->connections);
+    close(server->dir_fd);
+    free(server);
+    return NULL;
+}
+
+void close_archive_server(ArchiveServer *server)
+{
+    uint64_t one = 1;
+    if (write(server->stop_fd, &one, sizeof(one)) < 0)
+        LOG(logger, LOG_WARNING, "Notify archive thread failed: %s", strerror(errno));
+    pthread_join(server->thread, NULL);
+
+    for (unsigned int i = 0; i < server->config.connections; i++)
+        if (server->connections[i].fd >= 0)
+            close_connection(server, &server->connections[i]);
+    LOG(logger, LOG_INFO, "Archive server: %lld requests, %lld ranges, %lld bytes sent",
+        (long long)server->stat.requests, (long long)server->stat.ranges, (long long)server->stat.bytes);
+
+    close(server->stop_fd);
+    close(server->epoll_fd);
+    close(server->listen_fd);
+    free(server->connections);
+    close(server->dir_fd);
+    free(server);
+}
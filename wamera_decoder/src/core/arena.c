@@ -0,0 +1,219 @@
+#define _GNU_SOURCE
+
+#include <string.h>
+#include <sys/mman.h>
+
+#include <libavutil/pixdesc.h>
+
+#include "../../include/arena.h"
+
+/**
+ * @brief unmap_arena 解除内存映射
+ */
+static void unmap_arena(FrameArena *arena)
+{
+    free_object_pool(arena->slots);
+    arena->slots = NULL;
+    if (arena->base)
+        munmap(arena->base, arena->mapped);
+    arena->base = NULL;
+    arena->mapped = 0;
+}
+
+/**
+ * @brief layout_arena 按像素格式和尺寸计算槽布局并重新映射内存
+ * @note 调用时不能有在用的槽
+ * @return 成功返回0, 格式不支持或映射失败返回-1
+ */
+static int layout_arena(FrameArena *arena, AVCodecContext *ctx, enum AVPixelFormat format, int width, int height)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(format);
+    int planes = av_pix_fmt_count_planes(format);
+    if (!desc || planes <= 0 || planes > 4 || planes != desc->nb_components)
+        return -1;
+
+    // 按解码器要求的宏块对齐补齐宽高
+    int w = width, h = height;
+    int align[AV_NUM_DATA_POINTERS];
+    enum AVPixelFormat ctx_format = ctx->pix_fmt;
+    ctx->pix_fmt = format;
+    avcodec_align_dimensions2(ctx, &w, &h, align);
+    ctx->pix_fmt = ctx_format;
+
+    size_t total = 0;
+    for (int p = 0; p < planes; p++)
+    {
+        int chroma = p == 1 || p == 2;
+        int plane_w = chroma ? -((-w) >> desc->log2_chroma_w) : w;
+        int plane_h = chroma ? -((-h) >> desc->log2_chroma_h) : h;
+        arena->linesize[p] = FFALIGN(plane_w * desc->comp[p].step, ARENA_STRIDE_ALIGN);
+        arena->offset[p] = total;
+        total += FFALIGN((size_t)arena->linesize[p] * plane_h, ARENA_STRIDE_ALIGN);
+    }
+    total += AV_INPUT_BUFFER_PADDING_SIZE;
+
+    unmap_arena(arena);
+    arena->stat.huge = 0;
+
+    size_t slot_size = FFALIGN(total, 4096);
+    size_t size = slot_size * arena->stat.size;
+    if (arena->use_huge)
+    {
+        size_t huge_size = FFALIGN(size, ARENA_HUGE_PAGE);
+        void *base = mmap(NULL, huge_size, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+        if (base != MAP_FAILED)
+        {
+            arena->base = (uint8_t *)base;
+            arena->mapped = huge_size;
+            arena->stat.huge = 1;
+        }
+        else
+            LOG(logger, LOG_DEBUG, "Hugetlb mapping unavailable, use transparent huge pages");
+    }
+    if (!arena->base)
+    {
+        void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED)
+        {
+            LOG(logger, LOG_ERROR, "Mmap frame arena failed");
+            return -1;
+        }
+        arena->base = (uint8_t *)base;
+        arena->mapped = size;
+        madvise(base, size, MADV_HUGEPAGE);
+        // 预先触碰全部页面, 避免解码时缺页
+        memset(base, 0, size);
+    }
+
+    arena->format = format;
+    arena->width = width;
+    arena->height = height;
+    arena->planes = planes;
+    arena->stat.slot_size = slot_size;
+    arena->slots = create_object_pool(slot_size, arena->stat.size, arena->base);
+    if (!arena->slots)
+    {
+        LOG(logger, LOG_ERROR, "Memory allocation failed");
+        unmap_arena(arena);
+        return -1;
+    }
+
+    LOG(logger, LOG_DEBUG, "Frame arena %dx%d, %u slots of %zu bytes%s",
+        width, height, arena->stat.size, slot_size, arena->stat.huge ? ", hugetlb" : "");
+    return 0;
+}
+
+/**
+ * @brief release_arena 释放一个引用, 最后一个引用释放时销毁内存池
+ */
+static void release_arena(FrameArena *arena)
+{
+    pthread_mutex_lock(&arena->mutex);
+    int last = --arena->refs == 0;
+    pthread_mutex_unlock(&arena->mutex);
+    if (!last)
+        return;
+
+    unmap_arena(arena);
+    pthread_mutex_destroy(&arena->mutex);
+    free(arena);
+}
+
+static void arena_free_buffer(void *opaque, uint8_t *data)
+{
+    FrameArena *arena = (FrameArena *)opaque;
+
+    pthread_mutex_lock(&arena->mutex);
+    release_object_pool(arena->slots, data);
+    arena->stat.in_use--;
+    pthread_mutex_unlock(&arena->mutex);
+
+    release_arena(arena);
+}
+
+static int arena_get_buffer2(AVCodecContext *ctx, AVFrame *frame, int flags)
+{
+    FrameArena *arena = (FrameArena *)ctx->opaque;
+
+    pthread_mutex_lock(&arena->mutex);
+    if (frame->format != arena->format || frame->width != arena->width || frame->height != arena->height)
+    {
+        // 布局与实际输出不一致时, 在没有在用槽的情况下重新布局
+        if (arena->stat.in_use > 0 ||
+            layout_arena(arena, ctx, (enum AVPixelFormat)frame->format, frame->width, frame->height) < 0)
+        {
+            arena->stat.fallback++;
+            pthread_mutex_unlock(&arena->mutex);
+            return avcodec_default_get_buffer2(ctx, frame, flags);
+        }
+    }
+    uint8_t *slot = (uint8_t *)acquire_object_pool(arena->slots);
+    if (!slot)
+    {
+        arena->stat.fallback++;
+        pthread_mutex_unlock(&arena->mutex);
+        return avcodec_default_get_buffer2(ctx, frame, flags);
+    }
+    arena->stat.in_use++;
+    if (arena->stat.in_use > arena->stat.high_water)
+        arena->stat.high_water = arena->stat.in_use;
+    arena->refs++;
+    pthread_mutex_unlock(&arena->mutex);
+
+    frame->buf[0] = av_buffer_create(slot, arena->stat.slot_size, arena_free_buffer, arena, 0);
+    if (!frame->buf[0])
+    {
+        arena_free_buffer(arena, slot);
+        return AVERROR(ENOMEM);
+    }
+    for (int p = 0; p < arena->planes; p++)
+    {
+        frame->data[p] = slot + arena->offset[p];
+        frame->linesize[p] = arena->linesize[p];
+    }
+    frame->extended_data = frame->data;
+    return 0;
+}
+
+FrameArena *open_frame_arena(AVCodecContext *ctx, unsigned int num, int use_huge)
+{
+    FrameArena *arena = (FrameArena *)calloc(1, sizeof(FrameArena));
+    if (!arena)
+    {
+        LOG(logger, LOG_ERROR, "Memory allocation failed");
+        return NULL;
+    }
+    arena->stat.size = num;
+    arena->use_huge = use_huge;
+    arena->refs = 1;
+    arena->format = AV_PIX_FMT_NONE;
+    pthread_mutex_init(&arena->mutex, NULL);
+
+    // 按预期的输出格式预先布局, 与实际不符时在首帧重新布局
+    if (layout_arena(arena, ctx, ctx->pix_fmt, ctx->width, ctx->height) < 0)
+        LOG(logger, LOG_WARNING, "Frame arena layout deferred to first frame");
+    return arena;
+}
+
+void attach_frame_arena(FrameArena *arena, AVCodecContext *ctx)
+{
+    ctx->opaque = arena;
+    ctx->get_buffer2 = arena_get_buffer2;
+}
+
+FrameArenaStat get_frame_arena_stat(FrameArena *arena)
+{
+    pthread_mutex_lock(&arena->mutex);
+    FrameArenaStat stat = arena->stat;
+    pthread_mutex_unlock(&arena->mutex);
+    return stat;
+}
+
+void close_frame_arena(FrameArena *arena)
+{
+    FrameArenaStat stat = get_frame_arena_stat(arena);
+    LOG(logger, LOG_INFO, "Frame arena: %u slots, high water %u, %lld fallback allocations",
+        stat.size, stat.high_water, (long long)stat.fallback);
+    release_arena(arena);
+}
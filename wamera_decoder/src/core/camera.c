@@ -2,9 +2,10 @@
 
 Camera *init_camera(const char *dev)
 {
-    Camera *camera = (Camera *)malloc(sizeof(Camera));
+    Camera *camera = (Camera *)calloc(1, sizeof(Camera));
 
-    camera->fd = open(dev, O_RDWR);
+    // 非阻塞打开, 由调用方通过 epoll 等待帧就绪
+    camera->fd = open(dev, O_RDWR | O_NONBLOCK);
     if (camera->fd < 0)
     {
         LOG(logger, LOG_ERROR, "Open camera failed: `%s`", dev);
@@ -15,6 +16,7 @@ Camera *init_camera(const char *dev)
 
     // 查询设备属性
     struct v4l2_capability cap;
+    memset(&cap, 0, sizeof(cap));
     if (ioctl(camera->fd, VIDIOC_QUERYCAP, &cap) < 0)
     {
         LOG(logger, LOG_ERROR, "Query capability failed: `%s`", dev);
@@ -30,6 +32,7 @@ Camera *init_camera(const char *dev)
             \tBus: %s\n\
             \tVersion: %d",
         dev, cap.driver, cap.card, cap.bus_info, cap.version);
+    camera->cap = cap;
 
     // 判断是否为视频捕获设备
     if (cap.capabilities & V4L2_BUF_TYPE_VIDEO_CAPTURE)
@@ -51,9 +54,11 @@ Camera *init_camera(const char *dev)
 
 Config get_config(Camera *camera)
 {
-    Config config = {0, 0, MJPEG, {1, 1}, 0, 0};
+    Config config = {0, 0, MJPEG, {1, 1}, 0, 0, 0, 0, 0, "", "", 0, 0, 0, 0};
 
     struct v4l2_format fmt;
+    memset(&fmt, 0, sizeof(fmt));
+    fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
     if (ioctl(camera->fd, VIDIOC_G_FMT, &fmt) < 0)
         LOG(logger, LOG_WARNING, "Get format failed");
     else
@@ -84,48 +89,324 @@ Config get_config(Camera *camera)
     return config;
 }
 
-LinkedList *get_available_configs(Camera *camera)
+#pragma region 能力
+
+// 连续或步进的分辨率范围内尝试的常用分辨率
+static const unsigned int common_sizes[][2] = {
+    {320, 240}, {640, 360}, {640, 480}, {800, 600}, {1024, 768}, {1280, 720},
+    {1280, 960}, {1920, 1080}, {2560, 1440}, {3840, 2160},
+};
+
+// 连续或步进的帧间隔范围内尝试的常用帧率
+static const int common_rates[] = {5, 10, 15, 20, 25, 30, 50, 60, 120};
+
+/**
+ * @brief add_config 加入一项可用设置 已存在时忽略
+ */
+static void add_config(Array *configs, unsigned int width, unsigned int height, PixFormat pix_format,
+                       AVRational time_base)
 {
-    LinkedList *available_configs = create_linked_list();
+    for (unsigned int i = 0; i < configs->length; i++)
+    {
+        Config *config = ARRAY_GET(configs, Config, i);
+        if (config->width == width && config->height == height && config->pix_format == pix_format &&
+            config->time_base.num == time_base.num && config->time_base.den == time_base.den)
+            return;
+    }
+    Config config = {width, height, pix_format, time_base, 0, 0, 0, 0, 0, "", "", 0, 0, 0, 0};
+    append_array(configs, &config);
+}
 
-    LOG(logger, LOG_DEBUG, "Format supported:");
+/**
+ * @brief in_step 判断值是否落在步进范围内
+ */
+static int in_step(unsigned int value, unsigned int min, unsigned int max, unsigned int step)
+{
+    return value >= min && value <= max && (step == 0 || (value - min) % step == 0);
+}
+
+/**
+ * @brief enum_intervals 枚举一个格式与分辨率下的帧间隔
+ */
+static void enum_intervals(Camera *camera, Array *configs, uint32_t pixelformat, unsigned int width,
+                           unsigned int height)
+{
+    PixFormat pix_format = pixelformat == V4L2_PIX_FMT_MJPEG ? MJPEG : YUYV;
+    struct v4l2_frmivalenum frmival;
+    memset(&frmival, 0, sizeof(frmival));
+    frmival.pixel_format = pixelformat;
+    frmival.width = width;
+    frmival.height = height;
+    while (ioctl(camera->fd, VIDIOC_ENUM_FRAMEINTERVALS, &frmival) == 0)
+    {
+        AVRational time_base;
+        if (frmival.type == V4L2_FRMIVAL_TYPE_DISCRETE)
+        {
+            av_reduce(&time_base.num, &time_base.den, frmival.discrete.numerator, frmival.discrete.denominator,
+                      INT_MAX);
+            add_config(configs, width, height, pix_format, time_base);
+            frmival.index++;
+            continue;
+        }
+
+        // 连续与步进类型只有一项
+        AVRational min = {frmival.stepwise.min.numerator, frmival.stepwise.min.denominator};
+        AVRational max = {frmival.stepwise.max.numerator, frmival.stepwise.max.denominator};
+        av_reduce(&time_base.num, &time_base.den, min.num, min.den, INT_MAX);
+        add_config(configs, width, height, pix_format, time_base);
+        for (unsigned int i = 0; i < sizeof(common_rates) / sizeof(common_rates[0]); i++)
+        {
+            AVRational rate = {1, common_rates[i]};
+            if (av_cmp_q(rate, min) > 0 && av_cmp_q(rate, max) < 0)
+                add_config(configs, width, height, pix_format, rate);
+        }
+        av_reduce(&time_base.num, &time_base.den, max.num, max.den, INT_MAX);
+        add_config(configs, width, height, pix_format, time_base);
+        return;
+    }
+
+    // 驱动不支持枚举帧间隔
+    if (frmival.index == 0)
+        add_config(configs, width, height, pix_format, (AVRational){0, 1});
+}
+
+Array *get_available_configs(Camera *camera)
+{
+    Array *available_configs = create_array(sizeof(Config), 16);
+    if (!available_configs)
+    {
+        LOG(logger, LOG_ERROR, "Memory allocation failed");
+        return NULL;
+    }
 
     struct v4l2_fmtdesc fmtdesc;
-    fmtdesc.index = 0;
+    memset(&fmtdesc, 0, sizeof(fmtdesc));
     fmtdesc.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    while (ioctl(camera->fd, VIDIOC_ENUM_FMT, &fmtdesc) == 0)
+    for (; ioctl(camera->fd, VIDIOC_ENUM_FMT, &fmtdesc) == 0; fmtdesc.index++)
     {
-        LOG(logger, LOG_DEBUG, "%d %s %s", fmtdesc.index + 1, fmtdesc.description, (char *)&fmtdesc.pixelformat);
+        LOG(logger, LOG_DEBUG, "Format %u: %s", fmtdesc.index + 1, fmtdesc.description);
+        if (fmtdesc.pixelformat != V4L2_PIX_FMT_MJPEG && fmtdesc.pixelformat != V4L2_PIX_FMT_YUYV)
+            continue;
 
         struct v4l2_frmsizeenum frmsize;
-        frmsize.index = 0;
+        memset(&frmsize, 0, sizeof(frmsize));
         frmsize.pixel_format = fmtdesc.pixelformat;
         while (ioctl(camera->fd, VIDIOC_ENUM_FRAMESIZES, &frmsize) == 0)
         {
             if (frmsize.type == V4L2_FRMSIZE_TYPE_DISCRETE)
             {
-                LOG(logger, LOG_DEBUG,
-                    "\t%d. Width: %u, Height: %u",
-                    frmsize.index + 1, frmsize.discrete.width, frmsize.discrete.height);
-                PixFormat pfrm = (fmtdesc.pixelformat == V4L2_PIX_FMT_MJPEG) ? MJPEG : YUYV;
-                Config config = {frmsize.discrete.width, frmsize.discrete.height, pfrm, {1, 1}, 0, 0};
-                Config *config_copy = (Config *)malloc(sizeof(Config));
-                if (config_copy)
-                {
-                    memcpy(config_copy, &config, sizeof(Config));
-                    append_linked_list(available_configs, (void *)config_copy);
-                }
-                else
-                    LOG(logger, LOG_ERROR, "Memory allocation failed");
+                enum_intervals(camera, available_configs, fmtdesc.pixelformat, frmsize.discrete.width,
+                               frmsize.discrete.height);
+                frmsize.index++;
+                continue;
             }
-            frmsize.index++;
+
+            // 连续与步进类型只有一项
+            struct v4l2_frmsize_stepwise *step = &frmsize.stepwise;
+            enum_intervals(camera, available_configs, fmtdesc.pixelformat, step->min_width, step->min_height);
+            for (unsigned int i = 0; i < sizeof(common_sizes) / sizeof(common_sizes[0]); i++)
+            {
+                if (in_step(common_sizes[i][0], step->min_width, step->max_width, step->step_width) &&
+                    in_step(common_sizes[i][1], step->min_height, step->max_height, step->step_height))
+                    enum_intervals(camera, available_configs, fmtdesc.pixelformat, common_sizes[i][0],
+                                   common_sizes[i][1]);
+            }
+            enum_intervals(camera, available_configs, fmtdesc.pixelformat, step->max_width, step->max_height);
+            break;
         }
-        fmtdesc.index++;
     }
 
+    for (unsigned int i = 0; i < available_configs->length; i++)
+    {
+        Config *config = ARRAY_GET(available_configs, Config, i);
+        LOG(logger, LOG_DEBUG, "\t%s %ux%u %d/%d", config->pix_format == MJPEG ? "MJPG" : "YUYV", config->width,
+            config->height, config->time_base.num, config->time_base.den);
+    }
     return available_configs;
 }
 
+/**
+ * @brief get_caps_path 由设备属性生成缓存文件路径, 非字母数字的字符替换为下划线
+ * @param suffix 文件名后缀
+ */
+static void get_caps_path(Camera *camera, const char *cache_dir, const char *suffix, char *path, size_t size)
+{
+    int length = snprintf(path, size, "%s/", cache_dir);
+    char *name = path + length;
+    snprintf(name, size - length, "%s_%s_%s_%08x%s", (const char *)camera->cap.driver,
+             (const char *)camera->cap.bus_info, (const char *)camera->cap.card, camera->cap.version, suffix);
+    for (; *name; name++)
+    {
+        if (!isalnum((unsigned char)*name) && *name != '.' && *name != '-')
+            *name = '_';
+    }
+}
+
+/**
+ * @brief read_caps 读取缓存文件
+ * @return Array* 缓存不存在 版本不符或为空时返回NULL
+ */
+static Array *read_caps(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (!file)
+        return NULL;
+
+    char line[128];
+    unsigned int version = 0;
+    if (!fgets(line, sizeof(line), file) || sscanf(line, "wamera-caps %u", &version) != 1 ||
+        version != CAPS_VERSION)
+    {
+        fclose(file);
+        return NULL;
+    }
+
+    Array *configs = create_array(sizeof(Config), 16);
+    while (configs && fgets(line, sizeof(line), file))
+    {
+        char fourcc[5];
+        unsigned int width, height;
+        AVRational time_base;
+        if (sscanf(line, "%4s %u %u %d %d", fourcc, &width, &height, &time_base.num, &time_base.den) != 5)
+            continue;
+        add_config(configs, width, height, strcmp(fourcc, "MJPG") == 0 ? MJPEG : YUYV, time_base);
+    }
+    fclose(file);
+    if (configs && configs->length == 0)
+    {
+        free_array(configs);
+        configs = NULL;
+    }
+    return configs;
+}
+
+/**
+ * @brief write_caps 写入缓存文件 先写临时文件再重命名, 多个进程同时写入时不会读到不完整的文件
+ * @return int 成功返回0, 失败返回-1
+ */
+static int write_caps(Array *configs, const char *cache_dir, const char *path)
+{
+    if (mkdir(cache_dir, 0755) < 0 && errno != EEXIST)
+        return -1;
+
+    char tmp[CAPS_PATH_SIZE + 16];
+    snprintf(tmp, sizeof(tmp), "%s.%d.tmp", path, (int)getpid());
+    FILE *file = fopen(tmp, "w");
+    if (!file)
+        return -1;
+    fprintf(file, "wamera-caps %u\n", CAPS_VERSION);
+    for (unsigned int i = 0; i < configs->length; i++)
+    {
+        Config *config = ARRAY_GET(configs, Config, i);
+        fprintf(file, "%s %u %u %d %d\n", config->pix_format == MJPEG ? "MJPG" : "YUYV", config->width,
+                config->height, config->time_base.num, config->time_base.den);
+    }
+    if (fclose(file) != 0 || rename(tmp, path) < 0)
+    {
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+Array *load_camera_configs(Camera *camera, const char *cache_dir)
+{
+    char path[CAPS_PATH_SIZE];
+    int cached = cache_dir && cache_dir[0] != '\0';
+    if (cached)
+    {
+        get_caps_path(camera, cache_dir, ".caps", path, sizeof(path));
+        Array *configs = read_caps(path);
+        if (configs)
+        {
+            LOG(logger, LOG_DEBUG, "Load %u camera modes from `%s`", configs->length, path);
+            return configs;
+        }
+    }
+
+    int64_t start = av_gettime_relative();
+    Array *configs = get_available_configs(camera);
+    if (!configs)
+        return NULL;
+    LOG(logger, LOG_INFO, "Probe %u camera modes of `%s` in %.1f ms", configs->length,
+        (const char *)camera->cap.card, (av_gettime_relative() - start) / 1000.0);
+    // 枚举不到任何设置时不缓存, 下次启动重新枚举
+    if (cached && configs->length > 0 && write_caps(configs, cache_dir, path) < 0)
+        LOG(logger, LOG_WARNING, "Write capability cache `%s` failed: %s", path, strerror(errno));
+    return configs;
+}
+
+/**
+ * @brief get_mode_path 校准结果的缓存路径 校准条件不同的结果分别缓存
+ */
+static void get_mode_path(Camera *camera, const char *cache_dir, Config request, unsigned int min_fps, char *path,
+                          size_t size)
+{
+    char suffix[64];
+    snprintf(suffix, sizeof(suffix), "_%ux%u_%ufps.mode", request.width, request.height, min_fps);
+    get_caps_path(camera, cache_dir, suffix, path, size);
+}
+
+int read_camera_mode(Camera *camera, const char *cache_dir, Config request, unsigned int min_fps, Config *mode)
+{
+    if (!cache_dir || cache_dir[0] == '\0')
+        return -1;
+    char path[CAPS_PATH_SIZE];
+    get_mode_path(camera, cache_dir, request, min_fps, path, sizeof(path));
+    // 校准结果与能力缓存格式相同, 只有一项
+    Array *configs = read_caps(path);
+    if (!configs)
+        return -1;
+    Config *cached = ARRAY_GET(configs, Config, 0);
+    mode->width = cached->width;
+    mode->height = cached->height;
+    mode->pix_format = cached->pix_format;
+    mode->time_base = cached->time_base;
+    free_array(configs);
+    LOG(logger, LOG_DEBUG, "Load camera mode from `%s`", path);
+    return 0;
+}
+
+int write_camera_mode(Camera *camera, const char *cache_dir, Config request, unsigned int min_fps, Config mode)
+{
+    if (!cache_dir || cache_dir[0] == '\0')
+        return 0;
+    Array *configs = create_array(sizeof(Config), 1);
+    if (!configs)
+        return -1;
+    char path[CAPS_PATH_SIZE];
+    get_mode_path(camera, cache_dir, request, min_fps, path, sizeof(path));
+    int ret = append_array(configs, &mode) < 0 ? -1 : write_caps(configs, cache_dir, path);
+    if (ret < 0)
+        LOG(logger, LOG_WARNING, "Write camera mode cache `%s` failed: %s", path, strerror(errno));
+    free_array(configs);
+    return ret;
+}
+
+int match_camera_config(Array *configs, Config *config)
+{
+    Config *nearest = NULL;
+    double rate = av_q2d(config->time_base);
+    for (unsigned int i = 0; i < configs->length; i++)
+    {
+        Config *available = ARRAY_GET(configs, Config, i);
+        if (available->width != config->width || available->height != config->height ||
+            available->pix_format != config->pix_format)
+            continue;
+        // 帧间隔未知时视为相符
+        if (available->time_base.num == 0 || av_cmp_q(available->time_base, config->time_base) == 0)
+            return 0;
+        if (!nearest || fabs(av_q2d(available->time_base) - rate) < fabs(av_q2d(nearest->time_base) - rate))
+            nearest = available;
+    }
+    if (!nearest)
+        return -1;
+    config->time_base = nearest->time_base;
+    return 1;
+}
+
+#pragma endregion
+
 int set_camera_config(Camera *camera, Config config)
 {
     struct v4l2_format fmt;
@@ -256,6 +537,10 @@ int close_stream(Camera *camera)
  */
 int munmap_buffer(Camera *camera)
 {
+    // 切换分辨率失败后关闭时缓冲区已释放
+    if (!camera->usr_buf)
+        return 0;
+
     /*解除内核缓冲区到用户缓冲区的映射*/
     for (unsigned int i = 0; i < BUF_NUM; i++)
     {
@@ -267,11 +552,23 @@ int munmap_buffer(Camera *camera)
         }
     }
     free(camera->usr_buf); // 释放用户缓冲区内存
+    camera->usr_buf = NULL;
+
+    // 释放驱动缓冲区, 之后才能修改格式并重新开启
+    struct v4l2_requestbuffers req;
+    memset(&req, 0, sizeof(req));
+    req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    req.memory = V4L2_MEMORY_MMAP;
+    // 已断开的设备在关闭文件描述符时释放
+    if (!camera->disconnected && ioctl(camera->fd, VIDIOC_REQBUFS, &req) < 0)
+        LOG(logger, LOG_WARNING, "Release buffer failed");
     return 0;
 }
 
 int open_camera(Camera *camera)
 {
+    // 重新开启后驱动序号从0开始
+    camera->sequence = 0;
     int ret = mmap_buffer(camera) | open_stream(camera);
     if (ret < 0)
         LOG(logger, LOG_ERROR, "Open camera failed");
@@ -282,6 +579,9 @@ int open_camera(Camera *camera)
 
 int close_camera(Camera *camera)
 {
+    // 断开后已释放
+    if (camera->fd < 0)
+        return 0;
     int ret = close_stream(camera) | munmap_buffer(camera);
     if (ret < 0)
         LOG(logger, LOG_ERROR, "Close camera failed");
@@ -292,7 +592,8 @@ int close_camera(Camera *camera)
 
 void destroy_camera(Camera *camera)
 {
-    close(camera->fd);
+    if (camera->fd >= 0)
+        close(camera->fd);
     free(camera);
     LOG(logger, LOG_INFO, "Destroy camera successfully");
 }
@@ -304,10 +605,19 @@ BufType *get_frame(Camera *camera)
     v4l2_buf.memory = V4L2_MEMORY_MMAP;
     if (ioctl(camera->fd, VIDIOC_DQBUF, &v4l2_buf) < 0) // 内核缓冲区出队列
     {
-        LOG(logger, LOG_ERROR, "Failed to destroy camera");
+        // 非阻塞模式下暂无就绪的帧
+        if (errno == ENODEV || errno == EIO || errno == ENXIO)
+            camera->disconnected = 1;
+        else if (errno != EAGAIN)
+            LOG(logger, LOG_ERROR, "Failed to VIDIOC_DQBUF");
         return NULL;
     }
 
+    // 序号不连续说明缓冲区全部被占用期间驱动丢弃了帧
+    if (v4l2_buf.sequence > camera->sequence)
+        camera->lost += v4l2_buf.sequence - camera->sequence;
+    camera->sequence = v4l2_buf.sequence + 1;
+
     /*
      * 内核缓冲区与用户缓冲区建立的映射，通过用户空间缓冲区直接访问这个缓冲区的数据
      */
@@ -318,7 +628,9 @@ BufType *get_frame(Camera *camera)
         return NULL;
     }
 
-    frame_data->start = malloc(camera->usr_buf[v4l2_buf.index].length);
+    // MJPEG 每帧长度不同, 只复制驱动实际写入的部分
+    size_t length = v4l2_buf.bytesused > 0 ? (size_t)v4l2_buf.bytesused : (size_t)camera->usr_buf[v4l2_buf.index].length;
+    frame_data->start = malloc(length);
     if (frame_data->start == NULL)
     {
         LOG(logger, LOG_ERROR, "Memory allocation failed");
@@ -326,15 +638,163 @@ BufType *get_frame(Camera *camera)
         return NULL;
     }
 
-    frame_data->length = camera->usr_buf[v4l2_buf.index].length;
+    frame_data->length = length;
+    frame_data->capture_time = av_gettime_relative();
 
-    memcpy(frame_data->start, camera->usr_buf[v4l2_buf.index].start,
-           camera->usr_buf[v4l2_buf.index].length);
+    memcpy(frame_data->start, camera->usr_buf[v4l2_buf.index].start, length);
 
     if (ioctl(camera->fd, VIDIOC_QBUF, &v4l2_buf) < 0) // 缓冲区重新入队
     {
+        if (errno == ENODEV || errno == EIO || errno == ENXIO)
+            camera->disconnected = 1;
         LOG(logger, LOG_ERROR, "Failed to VIDIOC_QBUF, dropped frame");
+        destroy_buf(frame_data);
         return NULL;
     }
     return frame_data;
-}
\ No newline at end of file
+}
+
+#pragma region 热插拔
+
+void release_camera(Camera *camera)
+{
+    if (camera->fd < 0)
+        return;
+    // 设备已不存在, 停止视频流与释放驱动缓冲区都会失败, 关闭文件描述符即可
+    camera->disconnected = 1;
+    munmap_buffer(camera);
+    close(camera->fd);
+    camera->fd = -1;
+    LOG(logger, LOG_INFO, "Release camera successfully");
+}
+
+int reopen_camera(Camera *camera, const char *dev, Config config)
+{
+    // 设备节点出现之前每次重试都会失败, 不输出日志
+    if (access(dev, F_OK) < 0)
+        return -1;
+
+    Camera *fresh = init_camera(dev);
+    if (!fresh)
+        return -1;
+    if (set_camera_config(fresh, config) < 0)
+        LOG(logger, LOG_WARNING, "Set camera config failed");
+    if (open_camera(fresh) < 0)
+    {
+        destroy_camera(fresh);
+        return -1;
+    }
+
+    int64_t lost = camera->lost;
+    *camera = *fresh;
+    camera->lost = lost;
+    free(fresh);
+    return 0;
+}
+
+HotplugWatcher *open_hotplug_watcher(void)
+{
+    HotplugWatcher *watcher = (HotplugWatcher *)calloc(1, sizeof(HotplugWatcher));
+    if (!watcher)
+    {
+        LOG(logger, LOG_ERROR, "Memory allocation failed");
+        return NULL;
+    }
+    watcher->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watcher->fd < 0)
+    {
+        LOG(logger, LOG_ERROR, "Create inotify failed: %s", strerror(errno));
+        free(watcher);
+        return NULL;
+    }
+    return watcher;
+}
+
+int watch_hotplug_device(HotplugWatcher *watcher, const char *dev)
+{
+    if (watcher->devices == HOTPLUG_MAX_DEVICES)
+    {
+        LOG(logger, LOG_WARNING, "Too many hotplug devices, `%s` not watched", dev);
+        return -1;
+    }
+
+    // 设备节点由 udev 创建 改名或修改权限, 监视其所在目录
+    char dir[PATH_MAX];
+    const char *name = strrchr(dev, '/');
+    if (name)
+        snprintf(dir, sizeof(dir), "%.*s", name == dev ? 1 : (int)(name - dev), dev);
+    else
+        snprintf(dir, sizeof(dir), ".");
+    name = name ? name + 1 : dev;
+    if (strlen(name) > NAME_MAX)
+        return -1;
+
+    // 同一目录重复添加时返回相同的监视描述符
+    int wd = inotify_add_watch(watcher->fd, dir, IN_CREATE | IN_ATTRIB | IN_MOVED_TO);
+    if (wd < 0)
+    {
+        LOG(logger, LOG_WARNING, "Watch `%s` failed: %s", dir, strerror(errno));
+        return -1;
+    }
+    unsigned int i = 0;
+    while (i < watcher->watches && watcher->wds[i] != wd)
+        i++;
+    if (i == watcher->watches)
+    {
+        if (watcher->watches == HOTPLUG_MAX_WATCHES)
+        {
+            inotify_rm_watch(watcher->fd, wd);
+            LOG(logger, LOG_WARNING, "Too many hotplug directories, `%s` not watched", dir);
+            return -1;
+        }
+        watcher->wds[watcher->watches++] = wd;
+    }
+
+    watcher->device_wds[watcher->devices] = wd;
+    snprintf(watcher->names[watcher->devices], sizeof(watcher->names[0]), "%s", name);
+    watcher->devices++;
+    LOG(logger, LOG_DEBUG, "Watch `%s` for hotplug", dev);
+    return 0;
+}
+
+int read_hotplug_watcher(HotplugWatcher *watcher)
+{
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    int count = 0;
+    while (1)
+    {
+        ssize_t length = read(watcher->fd, buf, sizeof(buf));
+        if (length < 0 && errno == EINTR)
+            continue;
+        if (length <= 0)
+            break;
+        for (char *ptr = buf; ptr < buf + length;)
+        {
+            const struct inotify_event *event = (const struct inotify_event *)ptr;
+            ptr += sizeof(struct inotify_event) + event->len;
+            // 通知队列溢出时无法得知丢失了哪些通知
+            if (event->mask & IN_Q_OVERFLOW)
+            {
+                count++;
+                continue;
+            }
+            if (event->len == 0)
+                continue;
+            for (unsigned int i = 0; i < watcher->devices; i++)
+                if (watcher->device_wds[i] == event->wd && strcmp(watcher->names[i], event->name) == 0)
+                {
+                    count++;
+                    break;
+                }
+        }
+    }
+    return count;
+}
+
+void close_hotplug_watcher(HotplugWatcher *watcher)
+{
+    close(watcher->fd);
+    free(watcher);
+}
+
+#pragma endregion
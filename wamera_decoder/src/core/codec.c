@@ -6,8 +6,14 @@ Codec *init_codec(LogLevel level)
 
     codec->in_codec = NULL;
     codec->out_codec = NULL;
-    codec->in_codec_ctx = NULL;
+    codec->backend = NULL;
     codec->out_codec_ctx = NULL;
+    codec->decoder = NULL;
+    codec->scaler = NULL;
+    codec->scaled = NULL;
+    codec->motion = NULL;
+    codec->vbv_latency = 0;
+    memset(&codec->packet, 0, sizeof(codec->packet));
 
     // 初始化FFmpeg
     if (avformat_network_init() < 0)
@@ -48,108 +54,264 @@ void destroy_codec(Codec *codec)
     free(codec);
 }
 
-int open_codec(Codec *codec, Config config)
+/**
+ * @brief open_encoder 按配置打开编码器上下文
+ * @return 成功返回0, 失败返回-1
+ */
+static int open_encoder(Codec *codec, Config config)
 {
-    // 配置编码器
-    codec->out_codec = avcodec_find_encoder(AV_CODEC_ID_H264);
-    if (!codec->out_codec)
+    codec->out_codec_ctx = open_encoder_context(codec->backend, config);
+    codec->since_key = 0;
+    codec->vbv_latency = config.vbv_latency;
+    return codec->out_codec_ctx ? 0 : -1;
+}
+
+int set_codec_bit_rate(Codec *codec, int64_t bit_rate)
+{
+    // 其余后端只在打开时读取码率
+    if (!codec->backend->live_bit_rate)
+        return -1;
+    set_encoder_bit_rate(codec->out_codec_ctx, bit_rate, codec->vbv_latency);
+    return 0;
+}
+
+int reconfig_codec(Codec *codec, Config config)
+{
+    AVCodecContext *old = codec->out_codec_ctx;
+    if (open_encoder(codec, config) < 0)
     {
-        LOG(logger, LOG_ERROR, "Find `H264` encoder failed");
+        avcodec_free_context(&old);
         return -1;
     }
+    AVCodecContext *ctx = codec->out_codec_ctx;
+    int changed = ctx->extradata_size != old->extradata_size ||
+                  (ctx->extradata_size > 0 && memcmp(ctx->extradata, old->extradata, ctx->extradata_size) != 0);
+    avcodec_free_context(&old);
+    LOG(logger, LOG_INFO, "Reopen %s encoder at %ux%u, %lld bps, preset %s",
+        codec->backend->name, config.width, config.height, (long long)config.bit_rate,
+        codec->backend->presets[find_encoder_preset(codec->backend, config.preset)]);
+    return changed;
+}
 
-    // 配置编码器上下文
-    codec->out_codec_ctx = avcodec_alloc_context3(codec->out_codec);
-    if (!codec->out_codec_ctx)
+int set_codec_motion(Codec *codec, MotionConfig config)
+{
+    close_motion_map(codec->motion);
+    codec->motion = NULL;
+    if (!config.enable)
+        return 0;
+    codec->motion = open_motion_map(config);
+    return codec->motion ? 0 : -1;
+}
+
+int is_codec_gop_end(Codec *codec)
+{
+    int gop_size = codec->out_codec_ctx->gop_size;
+    return gop_size <= 0 || codec->since_key >= (unsigned int)gop_size;
+}
+
+AVCodec *find_input_decoder(PixFormat pix_format)
+{
+    enum AVCodecID id = (pix_format == MJPEG) ? AV_CODEC_ID_MJPEG : AV_CODEC_ID_RAWVIDEO;
+    return avcodec_find_decoder(id);
+}
+
+BufType *create_black_frame(Config config)
+{
+    BufType *buf = (BufType *)calloc(1, sizeof(BufType));
+    if (!buf)
     {
-        LOG(logger, LOG_ERROR, "Alloc encoder context failed");
-        return -1;
+        LOG(logger, LOG_ERROR, "Memory allocation failed");
+        return NULL;
+    }
+    if (config.pix_format == YUYV)
+    {
+        // 按 Y U Y V 排列, 亮度取有限范围的黑电平 色度取中值
+        buf->length = config.width * config.height * 2;
+        buf->start = malloc(buf->length);
+        if (!buf->start)
+        {
+            LOG(logger, LOG_ERROR, "Memory allocation failed");
+            free(buf);
+            return NULL;
+        }
+        uint8_t *data = (uint8_t *)buf->start;
+        for (int i = 0; i < buf->length; i += 2)
+        {
+            data[i] = 16;
+            data[i + 1] = 128;
+        }
+        return buf;
     }
-    codec->out_codec_ctx->width = config.width;
-    codec->out_codec_ctx->height = config.height;
-    codec->out_codec_ctx->time_base = config.time_base;
-    codec->out_codec_ctx->framerate = av_inv_q(config.time_base);
-    codec->out_codec_ctx->pix_fmt = AV_PIX_FMT_YUV422P;
 
-    if (av_opt_set(codec->out_codec_ctx->priv_data, "tune", "zerolatency", 0) < 0)
+    int ret = -1;
+    const AVCodec *encoder = avcodec_find_encoder(AV_CODEC_ID_MJPEG);
+    AVCodecContext *ctx = encoder ? avcodec_alloc_context3(encoder) : NULL;
+    AVFrame *frame = av_frame_alloc();
+    AVPacket *packet = av_packet_alloc();
+    if (!ctx || !frame || !packet)
+        goto end;
+    ctx->width = config.width;
+    ctx->height = config.height;
+    ctx->pix_fmt = AV_PIX_FMT_YUVJ422P;
+    ctx->time_base = config.time_base;
+    if (avcodec_open2(ctx, encoder, NULL) < 0)
+        goto end;
+    frame->width = ctx->width;
+    frame->height = ctx->height;
+    frame->format = ctx->pix_fmt;
+    if (av_frame_get_buffer(frame, 0) < 0)
+        goto end;
+
+    // 全范围的黑色 4:2:2 的色度平面与亮度平面同高
+    memset(frame->data[0], 0, frame->linesize[0] * frame->height);
+    memset(frame->data[1], 128, frame->linesize[1] * frame->height);
+    memset(frame->data[2], 128, frame->linesize[2] * frame->height);
+    frame->pts = 0;
+    if (avcodec_send_frame(ctx, frame) < 0 || avcodec_receive_packet(ctx, packet) < 0)
+        goto end;
+    buf->start = malloc(packet->size);
+    if (!buf->start)
+        goto end;
+    memcpy(buf->start, packet->data, packet->size);
+    buf->length = packet->size;
+    ret = 0;
+
+end:
+    av_packet_free(&packet);
+    av_frame_free(&frame);
+    avcodec_free_context(&ctx);
+    if (ret < 0)
     {
-        LOG(logger, LOG_ERROR, "Prev config for codec failed");
-        return -1;
+        LOG(logger, LOG_ERROR, "Create black frame failed");
+        free(buf);
+        return NULL;
     }
+    return buf;
+}
 
-    // 配置解码器
-    enum AVCodecID id = (config.pix_format == MJPEG) ? AV_CODEC_ID_MJPEG : AV_CODEC_ID_YUV4;
-    codec->in_codec = avcodec_find_decoder(id);
+int open_codec(Codec *codec, Config config, WorkerPool *workers, void (*on_ready)(void *), void *opaque)
+{
+    // 配置编码器
+    codec->backend = find_encoder_backend(config.encoder);
+    codec->out_codec = codec->backend ? avcodec_find_encoder_by_name(codec->backend->name) : NULL;
     if (!codec->out_codec)
     {
-        LOG(logger, LOG_ERROR, "Find `%s` decoder failed", (config.pix_format == MJPEG) ? "MJPEG" : "YUYV");
+        LOG(logger, LOG_ERROR, "Find `%s` encoder failed", config.encoder);
         return -1;
     }
 
-    // 配置解码器上下文
-    codec->in_codec_ctx = avcodec_alloc_context3(codec->in_codec);
-    if (!codec->out_codec_ctx)
+    // 配置解码器
+    codec->in_codec = find_input_decoder(config.pix_format);
+    if (!codec->in_codec)
     {
-        LOG(logger, LOG_ERROR, "Alloc decoder context failed");
+        LOG(logger, LOG_ERROR, "Find `%s` decoder failed", (config.pix_format == MJPEG) ? "MJPEG" : "YUYV");
         return -1;
     }
-    codec->in_codec_ctx->width = config.width;
-    codec->in_codec_ctx->height = config.height;
-    codec->in_codec_ctx->time_base = config.time_base;
-    codec->in_codec_ctx->framerate = av_inv_q(config.time_base);
-    codec->in_codec_ctx->pix_fmt = AV_PIX_FMT_YUVJ422P;
 
     // 打开编码器
-    if (avcodec_open2(codec->out_codec_ctx, codec->out_codec, NULL) < 0)
-    {
-        LOG(logger, LOG_ERROR, "Open encoder failed");
+    if (open_encoder(codec, config) < 0)
         return -1;
-    }
 
-    // 打开解码器
-    if (avcodec_open2(codec->in_codec_ctx, codec->in_codec, NULL) < 0)
+    // 打开解码池, 多个解码器上下文并行解码
+    codec->decoder = open_decode_pool(codec->in_codec, config, config.decode_threads, workers, on_ready, opaque);
+    if (!codec->decoder)
     {
         LOG(logger, LOG_ERROR, "Open decoder failed");
         return -1;
     }
 
-    // 创建用于存储解码后图像的AVFrame
-    codec->decoded_frame = av_frame_alloc();
+    return 0;
+}
 
+int submit_codec(Codec *codec, BufType *frame, int64_t time_stamp)
+{
+    if (submit_decode_pool(codec->decoder, frame, time_stamp) < 0)
+    {
+        destroy_buf(frame);
+        return -1;
+    }
     return 0;
 }
 
-int dispose_codec(Codec *codec, Output **output, unsigned int length, BufType frame, int64_t time_stamp)
+int receive_codec(Codec *codec, DecodedFrame *decoded)
 {
-    // 设置解码输入
-    AVPacket *packet = av_packet_alloc();
-    packet->data = (uint8_t *)frame.start;
-    packet->size = frame.length;
+    return receive_decode_pool(codec->decoder, decoded);
+}
 
-    // 解码MJPEG图像
-    int ret = avcodec_send_packet(codec->in_codec_ctx, packet);
-    if (ret < 0)
+/**
+ * @brief need_scale 判断图像的尺寸或色度抽样是否与编码器不同
+ * @note 全范围的 YUVJ 格式与同抽样的 YUV 格式内存布局相同, 无需转换
+ */
+static int need_scale(const AVCodecContext *ctx, const AVFrame *frame)
+{
+    if (frame->width != ctx->width || frame->height != ctx->height)
+        return 1;
+    const AVPixFmtDescriptor *src = av_pix_fmt_desc_get((enum AVPixelFormat)frame->format);
+    const AVPixFmtDescriptor *dst = av_pix_fmt_desc_get(ctx->pix_fmt);
+    return src->log2_chroma_w != dst->log2_chroma_w || src->log2_chroma_h != dst->log2_chroma_h;
+}
+
+/**
+ * @brief scale_frame 将图像缩放到编码器的尺寸与像素格式
+ * @return AVFrame* 缩放后的图像 由编解码器持有, 失败返回NULL
+ */
+static AVFrame *scale_frame(Codec *codec, AVFrame *frame)
+{
+    AVCodecContext *ctx = codec->out_codec_ctx;
+    codec->scaler = sws_getCachedContext(codec->scaler, frame->width, frame->height, frame->format,
+                                         ctx->width, ctx->height, ctx->pix_fmt, SWS_BILINEAR, NULL, NULL, NULL);
+    if (!codec->scaler)
     {
-        LOG(logger, LOG_ERROR, "Sending a packet for decoding failed");
-        return -1;
+        LOG(logger, LOG_ERROR, "Create scaler failed");
+        return NULL;
     }
 
-    ret = avcodec_receive_frame(codec->in_codec_ctx, codec->decoded_frame);
-    if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
+    if (codec->scaled && (codec->scaled->width != ctx->width || codec->scaled->height != ctx->height ||
+                          codec->scaled->format != ctx->pix_fmt))
+        av_frame_free(&codec->scaled);
+    if (!codec->scaled)
     {
-        // 需要更多输入数据或解码完成
-        av_packet_unref(packet);
-        destroy_buf(&frame);
-        return -2;
+        codec->scaled = av_frame_alloc();
+        if (!codec->scaled)
+            return NULL;
+        codec->scaled->width = ctx->width;
+        codec->scaled->height = ctx->height;
+        codec->scaled->format = ctx->pix_fmt;
+        if (av_frame_get_buffer(codec->scaled, 0) < 0)
+        {
+            LOG(logger, LOG_ERROR, "Alloc scaled frame failed");
+            av_frame_free(&codec->scaled);
+            return NULL;
+        }
     }
-    else if (ret < 0)
+    // 编码器可能仍引用上一帧
+    if (av_frame_make_writable(codec->scaled) < 0)
+        return NULL;
+
+    sws_scale(codec->scaler, (const uint8_t *const *)frame->data, frame->linesize, 0, frame->height,
+              codec->scaled->data, codec->scaled->linesize);
+    return codec->scaled;
+}
+
+int dispose_codec(Codec *codec, Output **output, unsigned int length, AVFrame *frame, int64_t time_stamp, int key)
+{
+    if (need_scale(codec->out_codec_ctx, frame))
     {
-        LOG(logger, LOG_ERROR, "Error during decoding");
-        return -1;
+        frame = scale_frame(codec, frame);
+        if (!frame)
+            return -1;
     }
 
-    // 编码H.264图像
-    ret = avcodec_send_frame(codec->out_codec_ctx, codec->decoded_frame);
+    // 活动图按编码尺寸计算, 失败时不附加 ROI 照常编码
+    if (codec->motion && mark_motion_map(codec->motion, frame) < 0)
+        LOG(logger, LOG_WARNING, "Mark motion regions failed");
+
+    // MJPEG 解码出的每帧都标记为I帧, 不清除会使编码器每帧都输出关键帧
+    frame->pict_type = key ? AV_PICTURE_TYPE_I : AV_PICTURE_TYPE_NONE;
+
+    // 编码图像
+    frame->pts = time_stamp;
+    int ret = avcodec_send_frame(codec->out_codec_ctx, frame);
     if (ret < 0)
     {
         LOG(logger, LOG_ERROR, "Error sending a frame for encoding");
@@ -157,60 +319,90 @@ int dispose_codec(Codec *codec, Output **output, unsigned int length, BufType fr
     }
 
     AVPacket *encoded_packet = av_packet_alloc();
-    ret = avcodec_receive_packet(codec->out_codec_ctx, encoded_packet);
-    if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
-    {
-        // 需要更多输入数据或编码完成
-        av_packet_unref(encoded_packet);
-        destroy_buf(&frame);
-        return -2;
-    }
-    else if (ret == 0)
+    while ((ret = avcodec_receive_packet(codec->out_codec_ctx, encoded_packet)) == 0)
     {
+        codec->since_key = (encoded_packet->flags & AV_PKT_FLAG_KEY) ? 1 : codec->since_key + 1;
+        codec->packet.packets++;
+        codec->packet.bytes += encoded_packet->size;
+        codec->packet.square += (double)encoded_packet->size * encoded_packet->size;
+        if (encoded_packet->size > codec->packet.max)
+            codec->packet.max = encoded_packet->size;
+        int64_t pts = encoded_packet->pts;
         for (unsigned int i = 0; i < length; i++)
         {
+            if (!output[i])
+                continue;
+
             // 设置时间戳
-            encoded_packet->pts = av_rescale_q(time_stamp, codec->out_codec_ctx->time_base, output[i]->stream->time_base);
+            encoded_packet->pts = av_rescale_q(pts, codec->out_codec_ctx->time_base, output[i]->stream->time_base);
             encoded_packet->dts = encoded_packet->pts;
             AVPacket *encoded_packet_clone = av_packet_clone(encoded_packet);
+            // 编码器重新打开后的第一个包携带新的参数集, 由发送线程中的封装器写入序列头
+            uint8_t *side;
+            if (output[i]->extradata && encoded_packet_clone &&
+                (side = av_packet_new_side_data(encoded_packet_clone, AV_PKT_DATA_NEW_EXTRADATA,
+                                                output[i]->extradata_size)))
+            {
+                memcpy(side, output[i]->extradata, output[i]->extradata_size);
+                av_freep(&output[i]->extradata);
+            }
 
-            // 写入编码后的帧到输出流
-            ret = av_interleaved_write_frame(output[i]->frm_ctx, encoded_packet_clone);
+            // 写入编码后的帧到输出流, 直播输出交给发送线程
+            if (output[i]->live)
+                ret = push_live_writer(output[i]->live, encoded_packet_clone);
+            else
+            {
+                ret = output[i]->hls ? write_hls_packet(output[i]->hls, encoded_packet_clone)
+                                     : av_interleaved_write_frame(output[i]->frm_ctx, encoded_packet_clone);
+                av_packet_free(&encoded_packet_clone);
+            }
             if (ret < 0)
             {
                 LOG(logger, LOG_ERROR, "Error writing encoded frame");
+                av_packet_free(&encoded_packet);
                 return -1;
             }
-            av_packet_unref(encoded_packet_clone);
-            av_packet_free(&encoded_packet_clone);
         }
+        av_packet_unref(encoded_packet);
     }
-    else if (ret < 0)
-    {
-        LOG(logger, LOG_ERROR, "Error during encoding");
-        return -1;
-    }
-
-    av_packet_unref(packet);
-    av_packet_unref(encoded_packet);
-    av_packet_free(&packet);
     av_packet_free(&encoded_packet);
 
-    return 0;
+    // 需要更多输入数据或编码完成
+    if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
+        return 0;
+    LOG(logger, LOG_ERROR, "Error during encoding");
+    return -1;
 }
 
 void close_codec(Codec *codec)
 {
-    av_frame_free(&(codec->decoded_frame));
-    avcodec_free_context(&(codec->in_codec_ctx));
+    if (codec->decoder)
+        close_decode_pool(codec->decoder);
+    codec->decoder = NULL;
     avcodec_free_context(&(codec->out_codec_ctx));
+    sws_freeContext(codec->scaler);
+    codec->scaler = NULL;
+    av_frame_free(&codec->scaled);
+    close_motion_map(codec->motion);
+    codec->motion = NULL;
 }
 
-Output *open_output(Config config, const char *path, const char *format)
+/**
+ * @brief alloc_output 创建输出器及其封装上下文
+ * @return Output* 失败返回NULL
+ */
+static Output *alloc_output(const char *path, const char *format)
 {
     Output *output = (Output *)malloc(sizeof(Output));
     output->frm_ctx = NULL;
     output->stream = NULL;
+    output->sink = NULL;
+    output->live = NULL;
+    output->udp = NULL;
+    output->hls = NULL;
+    output->abort = 0;
+    output->extradata = NULL;
+    output->extradata_size = 0;
 
     if (avformat_alloc_output_context2(&(output->frm_ctx), NULL, format, path) < 0)
     {
@@ -228,8 +420,85 @@ Output *open_output(Config config, const char *path, const char *format)
         return NULL;
     }
     output->frm_ctx->oformat = out_fmt;
+    return output;
+}
+
+/**
+ * @brief interrupt_output 网络IO的中断回调
+ * @return 需要中断时返回1
+ */
+static int interrupt_output(void *opaque)
+{
+    return ((Output *)opaque)->abort;
+}
+
+/**
+ * @brief release_output 释放输出器的IO和封装上下文
+ */
+static void release_output(Output *output)
+{
+    if (output->sink)
+        close_file_sink(output->sink);
+    else if (output->udp)
+        close_udp_sender(output->udp);
+    else if (output->hls)
+        close_hls_writer(output->hls);
+    else
+        avio_close(output->frm_ctx->pb);
+    av_free(output->extradata);
+    avformat_free_context(output->frm_ctx);
+    free(output);
+}
+
+/**
+ * @brief add_output_stream 添加输出流 编码参数取自编码器
+ * @return 成功返回0, 失败返回-1
+ */
+static int add_output_stream(Output *output, Config config, const AVCodecContext *encoder)
+{
+    output->stream = avformat_new_stream(output->frm_ctx, NULL);
+    if (!output->stream)
+    {
+        LOG(logger, LOG_ERROR, "Add new out output failed");
+        return -1;
+    }
 
-    if (avio_open(&output->frm_ctx->pb, path, AVIO_FLAG_WRITE) < 0)
+    // 编码参数与参数集都取自编码器, 与实际码流一致
+    if (avcodec_parameters_from_context(output->stream->codecpar, encoder) < 0)
+    {
+        LOG(logger, LOG_ERROR, "Copy encoder parameters failed");
+        return -1;
+    }
+    output->stream->time_base = config.time_base;
+    return 0;
+}
+
+/**
+ * @brief start_output 添加输出流并写入文件头
+ * @return 成功返回0, 失败返回-1
+ */
+static int start_output(Output *output, Config config, const AVCodecContext *encoder)
+{
+    if (add_output_stream(output, config, encoder) < 0)
+        return -1;
+    if (avformat_write_header(output->frm_ctx, NULL) < 0)
+    {
+        LOG(logger, LOG_ERROR, "Write head failed");
+        return -1;
+    }
+    return 0;
+}
+
+Output *open_output(Config config, const AVCodecContext *encoder, const char *path, const char *format)
+{
+    Output *output = alloc_output(path, format);
+    if (!output)
+        return NULL;
+
+    // 网络IO阻塞时可由 abort 中断
+    output->frm_ctx->interrupt_callback.callback = interrupt_output;
+    output->frm_ctx->interrupt_callback.opaque = output;
+    if (avio_open2(&output->frm_ctx->pb, path, AVIO_FLAG_WRITE, &output->frm_ctx->interrupt_callback, NULL) < 0)
     {
         LOG(logger, LOG_ERROR, "Open output `%s` failed", path);
         avformat_free_context(output->frm_ctx);
@@ -237,43 +506,167 @@ Output *open_output(Config config, const char *path, const char *format)
         return NULL;
     }
 
-    output->stream = avformat_new_stream(output->frm_ctx, NULL);
-    if (!output->stream)
+    if (start_output(output, config, encoder) < 0)
     {
-        LOG(logger, LOG_ERROR, "Add new out output failed");
-        avio_close(output->frm_ctx->pb);
+        release_output(output);
+        return NULL;
+    }
+    return output;
+}
+
+Output *open_live_output(Config config, const AVCodecContext *encoder, const char *path, const char *format,
+                         unsigned int queue_size)
+{
+    Output *output = alloc_output(path, format);
+    if (!output)
+        return NULL;
+    output->frm_ctx->interrupt_callback.callback = interrupt_output;
+    output->frm_ctx->interrupt_callback.opaque = output;
+
+    // 连接与写入文件头交给发送线程, 封装器在此初始化, 输出流的时间基从第一个包起就已确定
+    if (add_output_stream(output, config, encoder) < 0 || avformat_init_output(output->frm_ctx, NULL) < 0 ||
+        !(output->live = open_live_writer(output->frm_ctx, queue_size, path)))
+    {
+        LOG(logger, LOG_ERROR, "Open live output `%s` failed", path);
+        release_output(output);
+        return NULL;
+    }
+    return output;
+}
+
+Output *open_file_output(Config config, const AVCodecContext *encoder, const char *path, const char *format,
+                         SinkConfig sink_config)
+{
+    Output *output = alloc_output(path, format);
+    if (!output)
+        return NULL;
+
+    // 按码率与分段时长估算文件大小
+    int64_t expected_size = config.bit_rate / 8 * config.save_time;
+    output->sink = open_file_sink(path, expected_size, sink_config);
+    if (!output->sink)
+    {
+        LOG(logger, LOG_ERROR, "Open output `%s` failed", path);
         avformat_free_context(output->frm_ctx);
         free(output);
         return NULL;
     }
+    output->frm_ctx->pb = output->sink->pb;
+    output->frm_ctx->flags |= AVFMT_FLAG_CUSTOM_IO;
 
-    // 设置视频参数，例如分辨率、帧率、码率等
-    output->stream->codecpar->codec_type = AVMEDIA_TYPE_VIDEO;
-    output->stream->codecpar->codec_id = AV_CODEC_ID_H264;
-    output->stream->codecpar->width = config.width;
-    output->stream->codecpar->height = config.height;
-    output->stream->codecpar->format = AV_PIX_FMT_YUV422P;
-    output->stream->codecpar->bit_rate = config.bit_rate;
-    output->stream->time_base = config.time_base;
-    if (avformat_write_header(output->frm_ctx, NULL) < 0)
+    if (start_output(output, config, encoder) < 0)
     {
-        LOG(logger, LOG_ERROR, "Write head failed");
-        avio_close(output->frm_ctx->pb);
+        release_output(output);
+        return NULL;
+    }
+    return output;
+}
+
+Output *open_udp_output(Config config, const AVCodecContext *encoder, const char *address)
+{
+    Output *output = alloc_output(address, "mpegts");
+    if (!output)
+        return NULL;
+
+    output->udp = open_udp_sender(address, config.time_base);
+    if (!output->udp)
+    {
+        LOG(logger, LOG_ERROR, "Open output `%s` failed", address);
         avformat_free_context(output->frm_ctx);
         free(output);
         return NULL;
     }
+    // 每个包写入后刷新, 一帧的末尾不会滞留在缓冲中等下一帧
+    output->frm_ctx->pb = output->udp->pb;
+    output->frm_ctx->flags |= AVFMT_FLAG_CUSTOM_IO | AVFMT_FLAG_FLUSH_PACKETS;
+
+    if (start_output(output, config, encoder) < 0)
+    {
+        release_output(output);
+        return NULL;
+    }
     return output;
 }
 
+Output *open_hls_output(Config config, const AVCodecContext *encoder, HlsConfig hls_config, const char *name,
+                        unsigned int sequence, unsigned int discontinuity)
+{
+    Output *output = alloc_output(hls_config.dir, "mp4");
+    if (!output)
+        return NULL;
+
+    output->hls = open_hls_writer(hls_config, name, config.time_base, sequence, discontinuity);
+    if (!output->hls)
+    {
+        avformat_free_context(output->frm_ctx);
+        free(output);
+        return NULL;
+    }
+    output->frm_ctx->pb = output->hls->pb;
+    output->frm_ctx->flags |= AVFMT_FLAG_CUSTOM_IO;
+
+    // 文件头只含 moov 作为初始化段, 之后每次切出的 moof+mdat 是一个部分段
+    if (av_opt_set(output->frm_ctx->priv_data, "movflags", "frag_custom+empty_moov+default_base_moof", 0) < 0 ||
+        start_output(output, config, encoder) < 0 || start_hls_writer(output->hls, output->frm_ctx) < 0)
+    {
+        release_output(output);
+        return NULL;
+    }
+    return output;
+}
+
+int rebind_output(Output *output, const AVCodecContext *encoder)
+{
+    if (!output->live || strcmp(output->frm_ctx->oformat->name, "flv") != 0 || encoder->codec_id != AV_CODEC_ID_H264 ||
+        encoder->extradata_size <= 0)
+        return -1;
+
+    uint8_t *extradata = (uint8_t *)av_malloc(encoder->extradata_size);
+    if (!extradata)
+    {
+        LOG(logger, LOG_ERROR, "Memory allocation failed");
+        return -1;
+    }
+    memcpy(extradata, encoder->extradata, encoder->extradata_size);
+    av_free(output->extradata);
+    output->extradata = extradata;
+    output->extradata_size = encoder->extradata_size;
+    return 0;
+}
+
 int close_output(Output *output)
 {
+    if (output->live)
+    {
+        // 直播输出不等待积压的包发送完成, 也不写文件尾
+        output->abort = 1;
+        close_live_writer(output->live);
+        output->live = NULL;
+        release_output(output);
+        return 0;
+    }
+
+    // 封装器的文件尾不属于任何分段, 先写出最后的部分段
+    if (output->hls && finish_hls_writer(output->hls) < 0)
+        LOG(logger, LOG_WARNING, "Finish HLS output failed");
     if (av_write_trailer(output->frm_ctx) < 0)
     {
         LOG(logger, LOG_ERROR, "Write trailer failed");
         return -1;
     }
-    if (avio_close(output->frm_ctx->pb) < 0)
+    if (output->sink)
+    {
+        if (close_file_sink(output->sink) < 0)
+        {
+            LOG(logger, LOG_ERROR, "Close file sink failed");
+            return -1;
+        }
+    }
+    else if (output->udp)
+        close_udp_sender(output->udp);
+    else if (output->hls)
+        close_hls_writer(output->hls);
+    else if (avio_close(output->frm_ctx->pb) < 0)
     {
         LOG(logger, LOG_ERROR, "Close io failed");
         return -1;
@@ -0,0 +1,146 @@
+#define _GNU_SOURCE
+#include "../../include/control.h"
+
+/**
+ * @brief serve_client 读取一行命令, 执行后回复
+ */
+static void serve_client(ControlServer *server, int fd)
+{
+    // 客户端迟迟不发送时不阻塞后续连接
+    struct timeval timeout = {CONTROL_TIMEOUT / 1000, (CONTROL_TIMEOUT % 1000) * 1000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    char command[CONTROL_LINE_SIZE];
+    size_t received = 0;
+    char *end = NULL;
+    while (!end && received < sizeof(command) - 1)
+    {
+        ssize_t ret = recv(fd, command + received, sizeof(command) - 1 - received, 0);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+            break;
+        received += ret;
+        command[received] = '\0';
+        end = strchr(command, '\n');
+    }
+    command[received] = '\0';
+    if (end)
+        *end = '\0';
+    size_t length = strlen(command);
+    if (length > 0 && command[length - 1] == '\r')
+        command[length - 1] = '\0';
+
+    char reply[CONTROL_LINE_SIZE + 8];
+    char message[CONTROL_LINE_SIZE] = "";
+    if (!end && received == 0)
+        return;
+    if (!end && received >= sizeof(command) - 1)
+        snprintf(reply, sizeof(reply), "ERR command too long\n");
+    else if (server->handler(server->opaque, command, message, sizeof(message)) == 0)
+        snprintf(reply, sizeof(reply), message[0] ? "OK %s\n" : "OK\n", message);
+    else
+        snprintf(reply, sizeof(reply), "ERR %s\n", message[0] ? message : "failed");
+    if (send(fd, reply, strlen(reply), MSG_NOSIGNAL) < 0)
+        LOG(logger, LOG_DEBUG, "Send control reply failed: %s", strerror(errno));
+}
+
+static void *control_loop(void *arg)
+{
+    ControlServer *server = (ControlServer *)arg;
+    apply_affinity(ROLE_IO);
+
+    struct pollfd fds[2] = {{server->listen_fd, POLLIN, 0}, {server->stop_fd, POLLIN, 0}};
+    while (1)
+    {
+        if (poll(fds, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            LOG(logger, LOG_ERROR, "Control poll failed: %s", strerror(errno));
+            break;
+        }
+        if (fds[1].revents)
+            break;
+        if (!fds[0].revents)
+            continue;
+
+        int fd = accept4(server->listen_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            if (errno != EAGAIN && errno != EINTR)
+                LOG(logger, LOG_WARNING, "Accept control connection failed: %s", strerror(errno));
+            continue;
+        }
+        serve_client(server, fd);
+        close(fd);
+    }
+    return NULL;
+}
+
+ControlServer *open_control_server(const char *path, ControlHandler handler, void *opaque)
+{
+    ControlServer *server = (ControlServer *)calloc(1, sizeof(ControlServer));
+    if (!server)
+    {
+        LOG(logger, LOG_ERROR, "Memory allocation failed");
+        return NULL;
+    }
+    if (strlen(path) >= sizeof(server->path))
+    {
+        LOG(logger, LOG_ERROR, "Control socket path `%s` too long", path);
+        free(server);
+        return NULL;
+    }
+    snprintf(server->path, sizeof(server->path), "%s", path);
+    server->handler = handler;
+    server->opaque = opaque;
+    server->stop_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    server->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (server->stop_fd < 0 || server->listen_fd < 0)
+    {
+        LOG(logger, LOG_ERROR, "Create control socket failed: %s", strerror(errno));
+        goto fail;
+    }
+
+    // 上次异常退出留下的套接字文件会使 bind 失败
+    struct sockaddr_un address = {0};
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, server->path, sizeof(server->path));
+    unlink(server->path);
+    if (bind(server->listen_fd, (struct sockaddr *)&address, sizeof(address)) < 0 ||
+        listen(server->listen_fd, 8) < 0)
+    {
+        LOG(logger, LOG_ERROR, "Listen control socket `%s` failed: %s", path, strerror(errno));
+        goto fail;
+    }
+
+    if (pthread_create(&server->thread, NULL, control_loop, server) != 0)
+    {
+        LOG(logger, LOG_ERROR, "Create control thread failed");
+        unlink(server->path);
+        goto fail;
+    }
+    LOG(logger, LOG_INFO, "Listen control socket `%s`", path);
+    return server;
+
+fail:
+    if (server->listen_fd >= 0)
+        close(server->listen_fd);
+    if (server->stop_fd >= 0)
+        close(server->stop_fd);
+    free(server);
+    return NULL;
+}
+
+void close_control_server(ControlServer *server)
+{
+    uint64_t one = 1;
+    if (write(server->stop_fd, &one, sizeof(one)) < 0)
+        LOG(logger, LOG_WARNING, "Notify control thread failed: %s", strerror(errno));
+    pthread_join(server->thread, NULL);
+    close(server->listen_fd);
+    close(server->stop_fd);
+    unlink(server->path);
+    free(server);
+}
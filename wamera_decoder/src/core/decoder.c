@@ -0,0 +1,377 @@
+#include "../../include/decoder.h"
+
+enum AVPixelFormat get_input_pix_fmt(PixFormat pix_format)
+{
+    return pix_format == YUYV ? AV_PIX_FMT_YUYV422 : AV_PIX_FMT_YUVJ422P;
+}
+
+/**
+ * @brief unpack_frame 把打包的 YUYV 帧转为平面 4:2:2, 输出缓冲区取自解码器的帧内存池
+ * @return 成功返回0, 失败返回-1
+ */
+static int unpack_frame(DecodeContext *ctx, AVFrame *frame)
+{
+    AVFrame *packed = ctx->packed;
+    ctx->unpacker = sws_getCachedContext(ctx->unpacker, packed->width, packed->height, packed->format,
+                                         packed->width, packed->height, AV_PIX_FMT_YUV422P, SWS_POINT, NULL,
+                                         NULL, NULL);
+    if (!ctx->unpacker)
+    {
+        LOG(logger, LOG_ERROR, "Create unpacker failed");
+        return -1;
+    }
+    frame->width = packed->width;
+    frame->height = packed->height;
+    frame->format = AV_PIX_FMT_YUV422P;
+    if (ctx->in_codec_ctx->get_buffer2(ctx->in_codec_ctx, frame, 0) < 0)
+    {
+        LOG(logger, LOG_ERROR, "Alloc unpacked frame failed");
+        return -1;
+    }
+    av_frame_copy_props(frame, packed);
+    sws_scale(ctx->unpacker, (const uint8_t *const *)packed->data, packed->linesize, 0, packed->height,
+              frame->data, frame->linesize);
+    return 0;
+}
+
+/**
+ * @brief decode_slot 解码一个槽中的压缩帧
+ * @return 成功返回0, 失败返回-1
+ */
+static int decode_slot(DecodeContext *ctx, DecodeSlot *slot, AVFrame *frame)
+{
+    ctx->packet->data = (uint8_t *)slot->buf->start;
+    ctx->packet->size = slot->buf->length;
+
+    int ret = avcodec_send_packet(ctx->in_codec_ctx, ctx->packet);
+    av_packet_unref(ctx->packet);
+    if (ret < 0)
+    {
+        LOG(logger, LOG_ERROR, "Sending a packet for decoding failed");
+        return -1;
+    }
+
+    // 帧内编码的输入每个包恰好产出一帧
+    ret = avcodec_receive_frame(ctx->in_codec_ctx, ctx->packed ? ctx->packed : frame);
+    if (ret < 0)
+    {
+        LOG(logger, LOG_ERROR, "Error during decoding");
+        return -1;
+    }
+    if (ctx->packed)
+    {
+        ret = unpack_frame(ctx, frame);
+        av_frame_unref(ctx->packed);
+    }
+    return ret;
+}
+
+/**
+ * @brief decode_task 解码任务, 每次解码队列中最早的一帧
+ * @note 解码后仍有待解码的帧时重新提交自身, 排队失败时继续在本线程解码
+ */
+static void decode_task(void *arg)
+{
+    DecodePool *pool = (DecodePool *)arg;
+
+    while (1)
+    {
+        pthread_mutex_lock(&pool->mutex);
+        uint64_t seq;
+        if (pool->stop || pop_ring_buffer(pool->queue, &seq) < 0)
+        {
+            pool->active--;
+            pthread_cond_broadcast(&pool->cond);
+            pthread_mutex_unlock(&pool->mutex);
+            return;
+        }
+        // 执行中的任务数不超过上下文数, 一定有空闲的上下文
+        unsigned int index;
+        pop_ring_buffer(pool->idle, &index);
+        DecodeContext *ctx = &pool->contexts[index];
+        DecodeSlot *slot = &pool->slots[seq % pool->window];
+        pthread_mutex_unlock(&pool->mutex);
+
+        // 解码期间不持有锁, 槽在 PENDING 状态下只由本任务访问
+        int64_t cpu_time = get_thread_cpu_time();
+        AVFrame *frame = av_frame_alloc();
+        int ret = frame ? decode_slot(ctx, slot, frame) : -1;
+        destroy_buf(slot->buf);
+        slot->buf = NULL;
+        if (ret < 0)
+            av_frame_free(&frame);
+
+        cpu_time = get_thread_cpu_time() - cpu_time;
+        pthread_mutex_lock(&pool->mutex);
+        pool->cpu_time += cpu_time;
+        slot->frame = frame;
+        slot->state = ret < 0 ? SLOT_FAILED : SLOT_READY;
+        push_ring_buffer(pool->idle, &index);
+        pthread_mutex_unlock(&pool->mutex);
+
+        // 回调在任务计数减少之前执行, 排空解码池后不会再有回调
+        if (pool->on_ready)
+            pool->on_ready(pool->opaque);
+
+        pthread_mutex_lock(&pool->mutex);
+        if (pool->stop || pool->queue->length == 0)
+        {
+            pool->active--;
+            pthread_cond_broadcast(&pool->cond);
+            pthread_mutex_unlock(&pool->mutex);
+            return;
+        }
+        pthread_mutex_unlock(&pool->mutex);
+
+        // 让出线程, 与其他相机的任务轮流执行
+        if (submit_worker_pool(pool->workers, decode_task, pool) == 0)
+            return;
+    }
+}
+
+/**
+ * @brief open_context 打开解码器上下文
+ * @return 成功返回0, 失败返回-1
+ */
+static int open_context(DecodeContext *ctx, const AVCodec *codec, Config config)
+{
+    ctx->in_codec_ctx = avcodec_alloc_context3(codec);
+    if (!ctx->in_codec_ctx)
+    {
+        LOG(logger, LOG_ERROR, "Alloc decoder context failed");
+        return -1;
+    }
+    ctx->in_codec_ctx->width = config.width;
+    ctx->in_codec_ctx->height = config.height;
+    ctx->in_codec_ctx->time_base = config.time_base;
+    ctx->in_codec_ctx->framerate = av_inv_q(config.time_base);
+    ctx->in_codec_ctx->pix_fmt = get_input_pix_fmt(config.pix_format);
+    // 并行度由解码池提供, 单个上下文不再开线程
+    ctx->in_codec_ctx->thread_count = 1;
+
+    if (avcodec_open2(ctx->in_codec_ctx, codec, NULL) < 0)
+    {
+        LOG(logger, LOG_ERROR, "Open decoder failed");
+        avcodec_free_context(&ctx->in_codec_ctx);
+        return -1;
+    }
+
+    ctx->packet = av_packet_alloc();
+    if (config.pix_format == YUYV)
+        ctx->packed = av_frame_alloc();
+    if (!ctx->packet || (config.pix_format == YUYV && !ctx->packed))
+    {
+        LOG(logger, LOG_ERROR, "Memory allocation failed");
+        avcodec_free_context(&ctx->in_codec_ctx);
+        return -1;
+    }
+    return 0;
+}
+
+DecodePool *open_decode_pool(const AVCodec *codec, Config config, unsigned int num,
+                             WorkerPool *workers, void (*on_ready)(void *), void *opaque)
+{
+    if (num == 0)
+        num = get_cpu_count();
+
+    DecodePool *pool = (DecodePool *)calloc(1, sizeof(DecodePool));
+    if (!pool)
+    {
+        LOG(logger, LOG_ERROR, "Memory allocation failed");
+        return NULL;
+    }
+    pool->num = num;
+    pool->workers = workers;
+    pool->on_ready = on_ready;
+    pool->opaque = opaque;
+    // 每个上下文留两帧余量, 一帧解码中, 一帧排队
+    pool->window = num * 2;
+    pool->contexts = (DecodeContext *)calloc(num, sizeof(DecodeContext));
+    pool->slots = (DecodeSlot *)calloc(pool->window, sizeof(DecodeSlot));
+    pool->idle = create_ring_buffer(sizeof(unsigned int), num);
+    pool->queue = create_ring_buffer(sizeof(uint64_t), pool->window);
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+    if (!pool->contexts || !pool->slots || !pool->idle || !pool->queue)
+    {
+        LOG(logger, LOG_ERROR, "Memory allocation failed");
+        close_decode_pool(pool);
+        return NULL;
+    }
+
+    for (unsigned int i = 0; i < num; i++)
+    {
+        if (open_context(&pool->contexts[i], codec, config) < 0)
+        {
+            close_decode_pool(pool);
+            return NULL;
+        }
+        push_ring_buffer(pool->idle, &i);
+    }
+
+    // 所有上下文共用一个帧内存池, 容纳窗口内的帧及编码中的帧
+    pool->arena = open_frame_arena(pool->contexts[0].in_codec_ctx, pool->window + 2, config.huge_pages);
+    if (pool->arena)
+        for (unsigned int i = 0; i < num; i++)
+            attach_frame_arena(pool->arena, pool->contexts[i].in_codec_ctx);
+
+    LOG(logger, LOG_INFO, "Open decode pool with %u contexts", num);
+    return pool;
+}
+
+/**
+ * @brief close_context 释放解码器上下文
+ */
+static void close_context(DecodeContext *ctx)
+{
+    av_packet_free(&ctx->packet);
+    av_frame_free(&ctx->packed);
+    sws_freeContext(ctx->unpacker);
+    ctx->unpacker = NULL;
+    avcodec_free_context(&ctx->in_codec_ctx);
+}
+
+int resize_decode_pool(DecodePool *pool, Config config)
+{
+    pthread_mutex_lock(&pool->mutex);
+    // 任务在队列取空后才退出, 没有执行中的任务时旧尺寸的帧已全部解码
+    while (pool->active > 0)
+        pthread_cond_wait(&pool->cond, &pool->mutex);
+    if (pool->stop)
+    {
+        pthread_mutex_unlock(&pool->mutex);
+        return -1;
+    }
+
+    // rawvideo 按上下文的宽高切分每个包, 只能重新打开
+    const AVCodec *codec = pool->contexts[0].in_codec_ctx->codec;
+    for (unsigned int i = 0; i < pool->num; i++)
+    {
+        close_context(&pool->contexts[i]);
+        if (open_context(&pool->contexts[i], codec, config) < 0)
+        {
+            // 部分上下文已失效, 不再接收新的帧
+            pool->stop = 1;
+            pthread_mutex_unlock(&pool->mutex);
+            return -1;
+        }
+    }
+
+    // 编码中的旧尺寸帧仍占用旧内存池, 换用按新尺寸布局的内存池, 旧池在帧释放后解除映射
+    if (pool->arena)
+        close_frame_arena(pool->arena);
+    pool->arena = open_frame_arena(pool->contexts[0].in_codec_ctx, pool->window + 2, config.huge_pages);
+    if (pool->arena)
+        for (unsigned int i = 0; i < pool->num; i++)
+            attach_frame_arena(pool->arena, pool->contexts[i].in_codec_ctx);
+    pthread_mutex_unlock(&pool->mutex);
+    LOG(logger, LOG_INFO, "Resize decode pool to %ux%u", config.width, config.height);
+    return 0;
+}
+
+void drain_decode_pool(DecodePool *pool)
+{
+    pthread_mutex_lock(&pool->mutex);
+    pool->stop = 1;
+    while (pool->active > 0)
+        pthread_cond_wait(&pool->cond, &pool->mutex);
+
+    // 尚未开始解码的帧不再解码
+    uint64_t seq;
+    while (pool->queue && pop_ring_buffer(pool->queue, &seq) == 0)
+    {
+        DecodeSlot *slot = &pool->slots[seq % pool->window];
+        destroy_buf(slot->buf);
+        slot->buf = NULL;
+        slot->state = SLOT_FAILED;
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+void close_decode_pool(DecodePool *pool)
+{
+    drain_decode_pool(pool);
+
+    if (pool->contexts)
+    {
+        for (unsigned int i = 0; i < pool->num; i++)
+            close_context(&pool->contexts[i]);
+    }
+    if (pool->slots)
+    {
+        for (unsigned int i = 0; i < pool->window; i++)
+        {
+            destroy_buf(pool->slots[i].buf);
+            av_frame_free(&pool->slots[i].frame);
+        }
+    }
+    if (pool->arena)
+        close_frame_arena(pool->arena);
+
+    pthread_cond_destroy(&pool->cond);
+    pthread_mutex_destroy(&pool->mutex);
+    free_ring_buffer(pool->queue);
+    free_ring_buffer(pool->idle);
+    free(pool->slots);
+    free(pool->contexts);
+    free(pool);
+}
+
+int submit_decode_pool(DecodePool *pool, BufType *buf, int64_t time_stamp)
+{
+    pthread_mutex_lock(&pool->mutex);
+    if (pool->stop || pool->next_submit - pool->next_receive >= pool->window)
+    {
+        pthread_mutex_unlock(&pool->mutex);
+        return -1;
+    }
+
+    uint64_t seq = pool->next_submit++;
+    DecodeSlot *slot = &pool->slots[seq % pool->window];
+    slot->state = SLOT_PENDING;
+    slot->buf = buf;
+    slot->frame = NULL;
+    slot->time_stamp = time_stamp;
+    slot->capture_time = buf->capture_time;
+    push_ring_buffer(pool->queue, &seq);
+
+    // 有空闲上下文时启动一个新的解码任务
+    int spawn = pool->active < pool->num;
+    if (spawn)
+        pool->active++;
+    pthread_mutex_unlock(&pool->mutex);
+
+    // 线程池队列已满时在调用线程上解码
+    if (spawn && submit_worker_pool(pool->workers, decode_task, pool) < 0)
+        decode_task(pool);
+    return 0;
+}
+
+int64_t get_decode_pool_cpu_time(DecodePool *pool)
+{
+    pthread_mutex_lock(&pool->mutex);
+    int64_t cpu_time = pool->cpu_time;
+    pthread_mutex_unlock(&pool->mutex);
+    return cpu_time;
+}
+
+int receive_decode_pool(DecodePool *pool, DecodedFrame *decoded)
+{
+    pthread_mutex_lock(&pool->mutex);
+    DecodeSlot *slot = &pool->slots[pool->next_receive % pool->window];
+    if (pool->next_receive == pool->next_submit || slot->state == SLOT_PENDING)
+    {
+        pthread_mutex_unlock(&pool->mutex);
+        return -2;
+    }
+
+    int ret = slot->state == SLOT_READY ? 0 : -1;
+    decoded->frame = slot->frame;
+    decoded->time_stamp = slot->time_stamp;
+    decoded->capture_time = slot->capture_time;
+    slot->frame = NULL;
+    slot->state = SLOT_EMPTY;
+    pool->next_receive++;
+    pthread_mutex_unlock(&pool->mutex);
+    return ret;
+}
@@ -0,0 +1,187 @@
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "../../include/denoise.h"
+
+/**
+ * @brief blend_pixel 按差值计算当前帧的权重并混合
+ */
+static inline uint8_t blend_pixel(int cur, int prev, int base, int slope)
+{
+    int d = cur - prev;
+    int w = FFMIN(base + (d < 0 ? -d : d) * slope, DENOISE_WEIGHT_ONE);
+    return (uint8_t)(prev + ((d * w + DENOISE_WEIGHT_ONE / 2) >> 7));
+}
+
+/**
+ * @brief denoise_row 降噪一行 结果同时写回图像与历史
+ */
+static void denoise_row(uint8_t *cur, uint8_t *prev, int n, int base, int slope)
+{
+    int x = 0;
+#if defined(__SSE2__)
+    // 差值不超过255, 权重不超过128, 乘积在16位有符号范围内
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i vbase = _mm_set1_epi16((short)base);
+    const __m128i vslope = _mm_set1_epi16((short)slope);
+    const __m128i vone = _mm_set1_epi16(DENOISE_WEIGHT_ONE);
+    const __m128i vround = _mm_set1_epi16(DENOISE_WEIGHT_ONE / 2);
+    for (; x + 16 <= n; x += 16)
+    {
+        __m128i c = _mm_loadu_si128((const __m128i *)(cur + x));
+        __m128i p = _mm_loadu_si128((const __m128i *)(prev + x));
+        __m128i out[2];
+        for (int half = 0; half < 2; half++)
+        {
+            __m128i c16 = half ? _mm_unpackhi_epi8(c, zero) : _mm_unpacklo_epi8(c, zero);
+            __m128i p16 = half ? _mm_unpackhi_epi8(p, zero) : _mm_unpacklo_epi8(p, zero);
+            __m128i d = _mm_sub_epi16(c16, p16);
+            __m128i ad = _mm_max_epi16(d, _mm_sub_epi16(zero, d));
+            __m128i w = _mm_min_epi16(_mm_add_epi16(vbase, _mm_mullo_epi16(ad, vslope)), vone);
+            __m128i delta = _mm_srai_epi16(_mm_add_epi16(_mm_mullo_epi16(d, w), vround), 7);
+            out[half] = _mm_add_epi16(p16, delta);
+        }
+        __m128i o = _mm_packus_epi16(out[0], out[1]);
+        _mm_storeu_si128((__m128i *)(cur + x), o);
+        _mm_storeu_si128((__m128i *)(prev + x), o);
+    }
+#elif defined(__ARM_NEON)
+    const int16x8_t vbase = vdupq_n_s16((int16_t)base);
+    const int16x8_t vslope = vdupq_n_s16((int16_t)slope);
+    const int16x8_t vone = vdupq_n_s16(DENOISE_WEIGHT_ONE);
+    for (; x + 16 <= n; x += 16)
+    {
+        uint8x16_t c = vld1q_u8(cur + x);
+        uint8x16_t p = vld1q_u8(prev + x);
+        int16x8_t out[2];
+        for (int half = 0; half < 2; half++)
+        {
+            uint8x8_t c8 = half ? vget_high_u8(c) : vget_low_u8(c);
+            uint8x8_t p8 = half ? vget_high_u8(p) : vget_low_u8(p);
+            int16x8_t d = vreinterpretq_s16_u16(vsubl_u8(c8, p8));
+            int16x8_t w = vminq_s16(vmlaq_s16(vbase, vabsq_s16(d), vslope), vone);
+            out[half] = vaddq_s16(vreinterpretq_s16_u16(vmovl_u8(p8)), vrshrq_n_s16(vmulq_s16(d, w), 7));
+        }
+        uint8x16_t o = vcombine_u8(vqmovun_s16(out[0]), vqmovun_s16(out[1]));
+        vst1q_u8(cur + x, o);
+        vst1q_u8(prev + x, o);
+    }
+#endif
+    for (; x < n; x++)
+        prev[x] = cur[x] = blend_pixel(cur[x], prev[x], base, slope);
+}
+
+/**
+ * @brief free_history 释放历史帧
+ */
+static void free_history(Denoiser *denoiser)
+{
+    for (int p = 0; p < 3; p++)
+    {
+        free(denoiser->history[p]);
+        denoiser->history[p] = NULL;
+    }
+    denoiser->primed = 0;
+    denoiser->width = denoiser->height = 0;
+}
+
+/**
+ * @brief layout_denoiser 按帧尺寸与格式分配历史帧
+ * @return 成功返回0, 格式不支持或内存不足返回-1
+ */
+static int layout_denoiser(Denoiser *denoiser, const AVFrame *frame)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get((enum AVPixelFormat)frame->format);
+    if (!desc || !(desc->flags & AV_PIX_FMT_FLAG_PLANAR) || (desc->flags & AV_PIX_FMT_FLAG_RGB) ||
+        desc->nb_components < 3 || desc->comp[0].depth != 8)
+        return -1;
+
+    free_history(denoiser);
+    for (int p = 0; p < 3; p++)
+    {
+        int lw = p ? desc->log2_chroma_w : 0, lh = p ? desc->log2_chroma_h : 0;
+        denoiser->plane_w[p] = -((-frame->width) >> lw);
+        denoiser->plane_h[p] = -((-frame->height) >> lh);
+        denoiser->history[p] = (uint8_t *)malloc((size_t)denoiser->plane_w[p] * denoiser->plane_h[p]);
+        if (!denoiser->history[p])
+        {
+            LOG(logger, LOG_ERROR, "Memory allocation failed");
+            free_history(denoiser);
+            return -1;
+        }
+    }
+    denoiser->format = frame->format;
+    denoiser->width = frame->width;
+    denoiser->height = frame->height;
+    return 0;
+}
+
+Denoiser *open_denoiser(DenoiseConfig config)
+{
+    Denoiser *denoiser = (Denoiser *)calloc(1, sizeof(Denoiser));
+    if (!denoiser)
+    {
+        LOG(logger, LOG_ERROR, "Memory allocation failed");
+        return NULL;
+    }
+    denoiser->config = config;
+    denoiser->format = -1;
+
+    // 强度决定静止像素当前帧的权重, 权重随差值线性增加, 在阈值处达到1
+    unsigned int strength = FFMIN(config.strength, 100);
+    unsigned int threshold = FFMAX(config.threshold, 1);
+    denoiser->base = FFMAX(DENOISE_WEIGHT_ONE * (100 - (int)strength) / 100, DENOISE_MIN_WEIGHT);
+    denoiser->slope = (DENOISE_WEIGHT_ONE - denoiser->base + threshold - 1) / threshold;
+    return denoiser;
+}
+
+int denoise_frame(Denoiser *denoiser, AVFrame *frame)
+{
+    int64_t start = av_gettime_relative();
+    if ((frame->format != denoiser->format || frame->width != denoiser->width || frame->height != denoiser->height) &&
+        layout_denoiser(denoiser, frame) < 0)
+        return -1;
+
+    if (!denoiser->primed)
+    {
+        for (int p = 0; p < 3; p++)
+            for (int y = 0; y < denoiser->plane_h[p]; y++)
+                memcpy(denoiser->history[p] + (size_t)y * denoiser->plane_w[p],
+                       frame->data[p] + (ptrdiff_t)y * frame->linesize[p], denoiser->plane_w[p]);
+        denoiser->primed = 1;
+        return 0;
+    }
+
+    if (av_frame_make_writable(frame) < 0)
+        return -1;
+    for (int p = 0; p < 3; p++)
+        for (int y = 0; y < denoiser->plane_h[p]; y++)
+            denoise_row(frame->data[p] + (ptrdiff_t)y * frame->linesize[p],
+                        denoiser->history[p] + (size_t)y * denoiser->plane_w[p],
+                        denoiser->plane_w[p], denoiser->base, denoiser->slope);
+
+    denoiser->stat.frames++;
+    denoiser->stat.time += av_gettime_relative() - start;
+    return 0;
+}
+
+DenoiseStat get_denoiser_stat(Denoiser *denoiser)
+{
+    return denoiser->stat;
+}
+
+void close_denoiser(Denoiser *denoiser)
+{
+    if (!denoiser)
+        return;
+    if (denoiser->stat.frames > 0)
+        LOG(logger, LOG_INFO, "Denoiser: %lld frames, %.2f ms per frame",
+            (long long)denoiser->stat.frames, denoiser->stat.time / 1000.0 / denoiser->stat.frames);
+    free_history(denoiser);
+    free(denoiser);
+}
@@ -0,0 +1,325 @@
+#include <stdio.h>
+
+#include "../../include/encoder.h"
+
+// x264 与 x265 的预设
+static const char *const x26x_presets[] = {"ultrafast", "superfast", "veryfast", "faster", "fast", "medium", "slow", "slower", "veryslow"};
+
+// libvpx 的 cpu-used 越大越快
+static const char *const vp9_speeds[] = {"8", "7", "6", "5", "4"};
+static const char *const vp8_speeds[] = {"16", "12", "8", "4"};
+
+// 不支持档位的后端只有一个档位
+static const char *const single_preset[] = {"default"};
+
+// 按优先级排列的后端 查找 auto 时返回第一个可用的
+static const EncoderBackend backends[] = {
+    {"libx264", "preset", x26x_presets, 9, 5, AV_PIX_FMT_YUV422P, "tune=zerolatency",
+     "intra-refresh=1", "x264-params=slice-max-size=%u", 1},
+    {"libopenh264", NULL, single_preset, 1, 0, AV_PIX_FMT_YUV420P, NULL,
+     NULL, "max_nal_size=%u", 0},
+    {"libx265", "preset", x26x_presets, 9, 5, AV_PIX_FMT_YUV420P, "tune=zerolatency",
+     "x265-params=intra-refresh=1", NULL, 0},
+    {"libvpx-vp9", "cpu-used", vp9_speeds, 5, 2, AV_PIX_FMT_YUV420P, "deadline=realtime:lag-in-frames=0:row-mt=1",
+     "aq-mode=3", NULL, 0},
+    {"libvpx", "cpu-used", vp8_speeds, 4, 2, AV_PIX_FMT_YUV420P, "deadline=realtime:lag-in-frames=0",
+     NULL, NULL, 0},
+};
+
+#define BACKEND_NUM (int)(sizeof(backends) / sizeof(backends[0]))
+
+const EncoderBackend *find_encoder_backend(const char *name)
+{
+    int any = !name || name[0] == '\0' || strcmp(name, "auto") == 0;
+    for (int i = 0; i < BACKEND_NUM; i++)
+        if ((any || strcmp(name, backends[i].name) == 0) && avcodec_find_encoder_by_name(backends[i].name))
+            return &backends[i];
+    return NULL;
+}
+
+int find_encoder_preset(const EncoderBackend *backend, const char *preset)
+{
+    for (int i = 0; preset && i < backend->preset_num; i++)
+        if (strcmp(preset, backend->presets[i]) == 0)
+            return i;
+    return backend->default_preset;
+}
+
+void set_encoder_bit_rate(AVCodecContext *ctx, int64_t bit_rate, unsigned int vbv_latency)
+{
+    // 编码器在码率变化时于下一帧重新配置
+    int64_t buffer = vbv_latency > 0 ? bit_rate * vbv_latency / 1000 : bit_rate;
+    ctx->bit_rate = bit_rate;
+    ctx->rc_max_rate = bit_rate;
+    ctx->rc_buffer_size = (int)FFMIN(buffer, INT_MAX);
+}
+
+/**
+ * @brief set_low_latency 启用帧内刷新与 slice 大小限制
+ * @return 成功返回0, 选项设置失败返回-1
+ */
+static int set_low_latency(const EncoderBackend *backend, AVCodecContext *ctx, Config config)
+{
+    // 刷新波在一个GOP内扫过整帧, 之后不再输出周期性的关键帧
+    if (config.intra_refresh && !backend->refresh_options)
+        LOG(logger, LOG_WARNING, "`%s` has no intra refresh, keep periodic keyframes", backend->name);
+    else if (config.intra_refresh && av_set_options_string(ctx->priv_data, backend->refresh_options, "=", ":") < 0)
+    {
+        LOG(logger, LOG_ERROR, "Set `%s` options `%s` failed", backend->name, backend->refresh_options);
+        return -1;
+    }
+
+    if (config.slice_max_size == 0)
+        return 0;
+    if (!backend->slice_format)
+    {
+        LOG(logger, LOG_WARNING, "`%s` has no slice size limit, ignore it", backend->name);
+        return 0;
+    }
+    char options[64];
+    snprintf(options, sizeof(options), backend->slice_format, config.slice_max_size);
+    if (av_set_options_string(ctx->priv_data, options, "=", ":") < 0)
+    {
+        LOG(logger, LOG_ERROR, "Set `%s` options `%s` failed", backend->name, options);
+        return -1;
+    }
+    return 0;
+}
+
+AVCodecContext *open_encoder_context(const EncoderBackend *backend, Config config)
+{
+    const AVCodec *codec = avcodec_find_encoder_by_name(backend->name);
+    AVCodecContext *ctx = codec ? avcodec_alloc_context3(codec) : NULL;
+    if (!ctx)
+    {
+        LOG(logger, LOG_ERROR, "Alloc `%s` encoder context failed", backend->name);
+        return NULL;
+    }
+    ctx->width = config.width;
+    ctx->height = config.height;
+    ctx->time_base = config.time_base;
+    ctx->framerate = av_inv_q(config.time_base);
+    ctx->pix_fmt = config.yuv420 ? AV_PIX_FMT_YUV420P : backend->pix_fmt;
+    // 后端默认输出 4:2:2 时, 4:2:0 码流限定为浏览器普遍支持的 High
+    if (config.yuv420 && backend->pix_fmt != AV_PIX_FMT_YUV420P && codec->id == AV_CODEC_ID_H264)
+        ctx->profile = FF_PROFILE_H264_HIGH;
+    // 多路相机共享CPU时限制每路编码器的线程数
+    if (config.encode_threads > 0)
+        ctx->thread_count = config.encode_threads;
+    // 参数集放在 extradata 中, 推流与录像的文件头都从中取得
+    ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    set_encoder_bit_rate(ctx, config.bit_rate, config.vbv_latency);
+
+    if (backend->options && av_set_options_string(ctx->priv_data, backend->options, "=", ":") < 0)
+    {
+        LOG(logger, LOG_ERROR, "Set `%s` options `%s` failed", backend->name, backend->options);
+        avcodec_free_context(&ctx);
+        return NULL;
+    }
+    if (set_low_latency(backend, ctx, config) < 0)
+    {
+        avcodec_free_context(&ctx);
+        return NULL;
+    }
+    const char *preset = backend->presets[find_encoder_preset(backend, config.preset)];
+    if (backend->preset_option && av_opt_set(ctx->priv_data, backend->preset_option, preset, 0) < 0)
+    {
+        LOG(logger, LOG_ERROR, "Set `%s` %s `%s` failed", backend->name, backend->preset_option, preset);
+        avcodec_free_context(&ctx);
+        return NULL;
+    }
+
+    if (avcodec_open2(ctx, codec, NULL) < 0)
+    {
+        LOG(logger, LOG_ERROR, "Open `%s` encoder failed", backend->name);
+        avcodec_free_context(&ctx);
+        return NULL;
+    }
+    return ctx;
+}
+
+#pragma region 校准
+
+/**
+ * @brief Measure 一个候选的测量结果
+ * @property wall 单帧编码的墙上时间 单位:us
+ * @property cpu 单帧编码的进程CPU时间 包含编码器内部线程 单位:us
+ */
+typedef struct Measure
+{
+    double wall;
+    double cpu;
+} Measure;
+
+/**
+ * @brief get_process_cpu_time 获取进程已消耗的CPU时间
+ * @return int64_t CPU时间 单位:us
+ */
+static int64_t get_process_cpu_time(void)
+{
+    struct timespec ts;
+    if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts) < 0)
+        return 0;
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * @brief fill_synthetic 生成合成帧: 斜向移动的渐变叠加噪声
+ * @note 运动迫使编码器做运动搜索, 噪声使残差不可忽略, 代价接近真实画面
+ */
+static void fill_synthetic(AVFrame *frame, int index, uint32_t *seed)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get((enum AVPixelFormat)frame->format);
+    for (int p = 0; p < 3; p++)
+    {
+        int w = p ? -((-frame->width) >> desc->log2_chroma_w) : frame->width;
+        int h = p ? -((-frame->height) >> desc->log2_chroma_h) : frame->height;
+        for (int y = 0; y < h; y++)
+        {
+            uint8_t *row = frame->data[p] + (ptrdiff_t)y * frame->linesize[p];
+            for (int x = 0; x < w; x++)
+            {
+                *seed = *seed * 1103515245 + 12345;
+                row[x] = (uint8_t)((p ? 128 + ((x - y) >> 3) : x + y + index * 4) + ((*seed >> 24) & 15));
+            }
+        }
+    }
+}
+
+/**
+ * @brief measure_candidate 用一个后端与档位编码合成帧
+ * @return 成功返回0, 无法打开或编码失败返回-1
+ */
+static int measure_candidate(const EncoderBackend *backend, int preset, Config config, Measure *measure)
+{
+    snprintf(config.preset, sizeof(config.preset), "%s", backend->presets[preset]);
+    AVCodecContext *ctx = open_encoder_context(backend, config);
+    if (!ctx)
+        return -1;
+
+    int ret = -1;
+    AVFrame *frame = av_frame_alloc();
+    AVPacket *packet = av_packet_alloc();
+    if (!frame || !packet)
+        goto end;
+    frame->width = ctx->width;
+    frame->height = ctx->height;
+    frame->format = ctx->pix_fmt;
+    if (av_frame_get_buffer(frame, 0) < 0)
+        goto end;
+
+    uint32_t seed = 1;
+    int64_t wall = 0, cpu = 0;
+    for (int i = 0; i < ENCODER_CALIBRATE_FRAMES; i++)
+    {
+        if (av_frame_make_writable(frame) < 0)
+            goto end;
+        fill_synthetic(frame, i, &seed);
+        frame->pts = i;
+
+        int64_t start_wall = av_gettime_relative();
+        int64_t start_cpu = get_process_cpu_time();
+        if (avcodec_send_frame(ctx, frame) < 0)
+            goto end;
+        while (avcodec_receive_packet(ctx, packet) == 0)
+            av_packet_unref(packet);
+        if (i >= ENCODER_WARMUP)
+        {
+            wall += av_gettime_relative() - start_wall;
+            cpu += get_process_cpu_time() - start_cpu;
+        }
+    }
+    measure->wall = (double)wall / (ENCODER_CALIBRATE_FRAMES - ENCODER_WARMUP);
+    measure->cpu = (double)cpu / (ENCODER_CALIBRATE_FRAMES - ENCODER_WARMUP);
+    ret = 0;
+
+end:
+    av_packet_free(&packet);
+    av_frame_free(&frame);
+    avcodec_free_context(&ctx);
+    return ret;
+}
+
+/**
+ * @brief is_backend_muxable 后端的码流能否写入所有封装格式
+ */
+static int is_backend_muxable(const EncoderBackend *backend, const char *const *formats)
+{
+    const AVCodec *codec = avcodec_find_encoder_by_name(backend->name);
+    if (!codec)
+        return 0;
+    for (int i = 0; formats && formats[i]; i++)
+    {
+        AVOutputFormat *format = av_guess_format(formats[i], NULL, NULL);
+        if (!format || avformat_query_codec(format, codec->id, FF_COMPLIANCE_NORMAL) != 1)
+            return 0;
+    }
+    return 1;
+}
+
+int calibrate_encoder(Config *config, const char *const *formats, double budget)
+{
+    // 单帧编码允许的墙上时间与CPU时间 单位:us
+    double interval = av_q2d(config->time_base) * 1000000 * ENCODER_HEADROOM;
+    double cpu_limit = budget > 0 ? budget * interval : 0;
+
+    const EncoderBackend *best = NULL, *fastest = NULL;
+    int best_preset = 0;
+    double best_cpu = 0, fastest_wall = 0;
+    for (int b = 0; b < BACKEND_NUM; b++)
+    {
+        const EncoderBackend *backend = &backends[b];
+        if (!is_backend_muxable(backend, formats))
+            continue;
+
+        // 从配置的档位起逐级加快, 第一个能维持帧率的档位即该后端画质最好的可行档位
+        for (int i = find_encoder_preset(backend, config->preset); i >= 0; i--)
+        {
+            Measure measure;
+            if (measure_candidate(backend, i, *config, &measure) < 0)
+            {
+                LOG(logger, LOG_WARNING, "Calibrate `%s` failed, skip it", backend->name);
+                break;
+            }
+            LOG(logger, LOG_INFO, "Calibrate %s %s at %ux%u: %.2f ms wall, %.2f ms CPU per frame",
+                backend->name, backend->presets[i], config->width, config->height,
+                measure.wall / 1000, measure.cpu / 1000);
+
+            if (measure.wall <= interval && (cpu_limit <= 0 || measure.cpu <= cpu_limit))
+            {
+                if (!best || measure.cpu < best_cpu)
+                {
+                    best = backend;
+                    best_preset = i;
+                    best_cpu = measure.cpu;
+                }
+                break;
+            }
+            if (i == 0 && (!fastest || measure.wall < fastest_wall))
+            {
+                fastest = backend;
+                fastest_wall = measure.wall;
+            }
+        }
+    }
+
+    if (!best)
+    {
+        if (!fastest)
+        {
+            LOG(logger, LOG_ERROR, "No usable encoder backend");
+            return -1;
+        }
+        LOG(logger, LOG_WARNING, "No encoder sustains %.1f fps, use the fastest `%s`",
+            av_q2d(av_inv_q(config->time_base)), fastest->name);
+        best = fastest;
+        best_preset = 0;
+    }
+
+    snprintf(config->encoder, sizeof(config->encoder), "%s", best->name);
+    snprintf(config->preset, sizeof(config->preset), "%s", best->presets[best_preset]);
+    LOG(logger, LOG_INFO, "Select encoder %s %s", best->name, best->presets[best_preset]);
+    return 0;
+}
+
+#pragma endregion
@@ -0,0 +1,87 @@
+#include <string.h>
+
+#include "../../include/governor.h"
+#include "../../include/rate.h"
+
+void init_governor(Governor *governor, GovernorConfig config, const EncoderBackend *backend, const char *preset)
+{
+    if (config.max_decimate == 0)
+        config.max_decimate = 1;
+    if (config.max_decimate > GOVERNOR_MAX_DECIMATE)
+        config.max_decimate = GOVERNOR_MAX_DECIMATE;
+    if (config.scale_steps > RATE_MAX_STEPS)
+        config.scale_steps = RATE_MAX_STEPS;
+
+    memset(governor, 0, sizeof(Governor));
+    governor->config = config;
+    governor->backend = backend;
+    governor->base_preset = find_encoder_preset(backend, preset);
+    governor->max_level = governor->base_preset + (config.max_decimate - 1) + config.scale_steps;
+}
+
+int update_governor(Governor *governor, int64_t cpu_time, int64_t now)
+{
+    if (governor->config.budget <= 0)
+        return 0;
+    if (governor->window_start == 0)
+        governor->window_start = now;
+    governor->window_cpu += cpu_time;
+    if (now - governor->window_start < GOVERNOR_WINDOW)
+        return 0;
+
+    governor->usage = (double)governor->window_cpu / (now - governor->window_start);
+    governor->window_start = now;
+    governor->window_cpu = 0;
+
+    // 调节后的首个窗口包含重新打开编码器的开销, 不作为依据
+    if (now - governor->last_change < GOVERNOR_WINDOW * 2)
+        return 0;
+
+    if (governor->usage > governor->config.budget)
+    {
+        governor->low_since = 0;
+        if (governor->level >= governor->max_level)
+            return 0;
+        governor->level++;
+        governor->last_change = now;
+        return 1;
+    }
+
+    if (governor->usage > governor->config.budget * GOVERNOR_LOW || governor->level == 0)
+    {
+        governor->low_since = 0;
+        return 0;
+    }
+    if (governor->low_since == 0)
+        governor->low_since = now;
+    if (now - governor->low_since < GOVERNOR_UP_HOLD)
+        return 0;
+    governor->level--;
+    governor->last_change = now;
+    governor->low_since = 0;
+    return 1;
+}
+
+GovernorLevel get_governor_level(Governor *governor)
+{
+    unsigned int level = governor->level;
+    unsigned int base = governor->base_preset;
+    const char *const *presets = governor->backend->presets;
+    GovernorLevel result = {presets[base], 1, 0};
+    if (level <= base)
+    {
+        result.preset = presets[base - level];
+        return result;
+    }
+
+    level -= base;
+    result.preset = presets[0];
+    if (level < governor->config.max_decimate)
+    {
+        result.decimate = 1 + level;
+        return result;
+    }
+    result.decimate = governor->config.max_decimate;
+    result.step = level - (governor->config.max_decimate - 1);
+    return result;
+}
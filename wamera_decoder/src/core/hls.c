@@ -0,0 +1,400 @@
+#include "../../include/hls.h"
+
+#pragma region Files
+
+/**
+ * @brief write_all 写入全部数据
+ * @return int 成功返回0, 失败返回-1
+ */
+static int write_all(int fd, const uint8_t *data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t ret = write(fd, data, size);
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        data += ret;
+        size -= ret;
+    }
+    return 0;
+}
+
+/**
+ * @brief publish_file 写入临时文件后重命名, 读者只会看到完整的文件
+ * @return int 成功返回0, 失败返回-1
+ */
+static int publish_file(HlsWriter *writer, const char *name, const uint8_t *data, size_t size)
+{
+    char path[sizeof(writer->dir) + 64], temp[sizeof(writer->dir) + 64];
+    snprintf(path, sizeof(path), "%s/%s", writer->dir, name);
+    snprintf(temp, sizeof(temp), "%s/%s.tmp", writer->dir, name);
+
+    int fd = open(temp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        LOG(logger, LOG_ERROR, "Open `%s` failed: %s", temp, strerror(errno));
+        return -1;
+    }
+    int ret = write_all(fd, data, size);
+    if (close(fd) < 0 || ret < 0 || rename(temp, path) < 0)
+    {
+        LOG(logger, LOG_ERROR, "Publish `%s` failed: %s", path, strerror(errno));
+        unlink(temp);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief remove_file 删除输出目录中的文件
+ */
+static void remove_file(HlsWriter *writer, const char *name)
+{
+    char path[sizeof(writer->dir) + 64];
+    snprintf(path, sizeof(path), "%s/%s", writer->dir, name);
+    if (unlink(path) < 0 && errno != ENOENT)
+        LOG(logger, LOG_WARNING, "Remove `%s` failed: %s", path, strerror(errno));
+}
+
+/**
+ * @brief remove_parts 删除一个分段的部分段文件, 之后播放列表不再列出其部分段
+ */
+static void remove_parts(HlsWriter *writer, HlsSegment *segment)
+{
+    char name[64];
+    for (unsigned int i = 0; i < segment->parts; i++)
+    {
+        snprintf(name, sizeof(name), "seg%u.%u.m4s", segment->sequence, i);
+        remove_file(writer, name);
+    }
+    segment->parts = 0;
+}
+
+/**
+ * @brief clean_dir 清除上次运行留下的分段与播放列表
+ * @return int 成功返回0, 失败返回-1
+ */
+static int clean_dir(HlsWriter *writer)
+{
+    DIR *dir = opendir(writer->dir);
+    if (!dir)
+    {
+        LOG(logger, LOG_ERROR, "Open `%s` failed: %s", writer->dir, strerror(errno));
+        return -1;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)))
+    {
+        const char *ext = strrchr(entry->d_name, '.');
+        if (ext && (strcmp(ext, ".m4s") == 0 || strcmp(ext, ".mp4") == 0 || strcmp(ext, ".m3u8") == 0 ||
+                    strcmp(ext, ".tmp") == 0))
+            remove_file(writer, entry->d_name);
+    }
+    closedir(dir);
+    return 0;
+}
+
+#pragma endregion
+
+#pragma region Playlist
+
+/**
+ * @brief append_segment 在播放列表中追加一个分段 保留部分段时先列出部分段
+ * @param complete 分段是否已完成 未完成时只列出部分段
+ * @return int 追加后的长度
+ */
+static int append_segment(HlsWriter *writer, int length, const HlsSegment *segment, int complete)
+{
+    for (unsigned int i = 0; i < segment->parts; i++)
+        length += snprintf(writer->playlist + length, FFMAX(HLS_PLAYLIST_SIZE - length, 0),
+                           "#EXT-X-PART:DURATION=%.3f,URI=\"seg%u.%u.m4s\"%s\n",
+                           segment->part_duration[i] / 1000000.0, segment->sequence, i,
+                           (segment->independent >> i) & 1 ? ",INDEPENDENT=YES" : "");
+    if (complete)
+        length += snprintf(writer->playlist + length, FFMAX(HLS_PLAYLIST_SIZE - length, 0),
+                           "#EXTINF:%.3f,\nseg%u.m4s\n", segment->duration / 1000000.0, segment->sequence);
+    return length;
+}
+
+/**
+ * @brief write_playlist 按当前窗口重写播放列表
+ * @note 静态文件服务器无法阻塞请求, 不声明 CAN-BLOCK-RELOAD, 播放器按 PART-HOLD-BACK 轮询
+ * @return int 成功返回0, 失败返回-1
+ */
+static int write_playlist(HlsWriter *writer)
+{
+    unsigned int num = writer->segments->length;
+    unsigned int first = num > 0 ? ((HlsSegment *)peek_ring_buffer(writer->segments, 0))->sequence
+                                 : writer->current.sequence;
+    double part = writer->config.part / 1000.0;
+
+    int length = snprintf(writer->playlist, HLS_PLAYLIST_SIZE,
+                          "#EXTM3U\n"
+                          "#EXT-X-VERSION:6\n"
+                          "#EXT-X-TARGETDURATION:%d\n"
+                          "#EXT-X-PART-INF:PART-TARGET=%.3f\n"
+                          "#EXT-X-SERVER-CONTROL:PART-HOLD-BACK=%.3f\n"
+                          "#EXT-X-MEDIA-SEQUENCE:%u\n"
+                          "#EXT-X-DISCONTINUITY-SEQUENCE:%u\n"
+                          "#EXT-X-MAP:URI=\"init%u.mp4\"\n",
+                          (int)ceil(writer->config.segment * HLS_SEGMENT_LIMIT / 1000.0), part, part * 3,
+                          first, writer->discontinuity, writer->discontinuity);
+    for (unsigned int i = 0; i < num; i++)
+        length = append_segment(writer, length, (HlsSegment *)peek_ring_buffer(writer->segments, i), 1);
+    length = append_segment(writer, length, &writer->current, 0);
+    if (length >= HLS_PLAYLIST_SIZE)
+    {
+        LOG(logger, LOG_ERROR, "HLS playlist exceeds %d bytes", HLS_PLAYLIST_SIZE);
+        return -1;
+    }
+    return publish_file(writer, "index.m3u8", (uint8_t *)writer->playlist, length);
+}
+
+#pragma endregion
+
+#pragma region Segments
+
+/**
+ * @brief hls_write_packet AVIOContext 的写回调 缓存当前部分段的数据
+ */
+static int hls_write_packet(void *opaque, uint8_t *data, int size)
+{
+    HlsWriter *writer = (HlsWriter *)opaque;
+    if (writer->finished)
+        return size;
+    if (writer->size + size > writer->capacity)
+    {
+        size_t capacity = FFMAX(writer->capacity * 2, writer->size + size);
+        uint8_t *buffer = (uint8_t *)realloc(writer->buffer, capacity);
+        if (!buffer)
+        {
+            LOG(logger, LOG_ERROR, "Memory allocation failed");
+            return AVERROR(ENOMEM);
+        }
+        writer->buffer = buffer;
+        writer->capacity = capacity;
+    }
+    memcpy(writer->buffer + writer->size, data, size);
+    writer->size += size;
+    return size;
+}
+
+/**
+ * @brief flush_part 切出当前分片, 写为部分段并追加到分段的临时文件
+ * @param end 部分段的结束时间 单位:us
+ * @return int 成功返回0, 失败返回-1
+ */
+static int flush_part(HlsWriter *writer, int64_t end)
+{
+    // frag_custom 模式下以空包切出分片
+    if (av_write_frame(writer->frm_ctx, NULL) < 0)
+    {
+        LOG(logger, LOG_ERROR, "Flush HLS fragment failed");
+        return -1;
+    }
+    avio_flush(writer->pb);
+    writer->started = 0;
+    if (writer->size == 0)
+        return 0;
+
+    HlsSegment *segment = &writer->current;
+    char name[64];
+    snprintf(name, sizeof(name), "seg%u.%u.m4s", segment->sequence, segment->parts);
+    if (publish_file(writer, name, writer->buffer, writer->size) < 0)
+        return -1;
+
+    if (writer->segment_fd < 0)
+    {
+        char temp[sizeof(writer->dir) + 64];
+        snprintf(temp, sizeof(temp), "%s/seg%u.m4s.tmp", writer->dir, segment->sequence);
+        writer->segment_fd = open(temp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (writer->segment_fd < 0)
+        {
+            LOG(logger, LOG_ERROR, "Open `%s` failed: %s", temp, strerror(errno));
+            return -1;
+        }
+    }
+    if (write_all(writer->segment_fd, writer->buffer, writer->size) < 0)
+    {
+        LOG(logger, LOG_ERROR, "Write HLS segment failed: %s", strerror(errno));
+        return -1;
+    }
+
+    segment->part_duration[segment->parts] = end - writer->part_start;
+    if (writer->part_key)
+        segment->independent |= 1u << segment->parts;
+    segment->parts++;
+    segment->duration += end - writer->part_start;
+    writer->size = 0;
+    return 0;
+}
+
+/**
+ * @brief finish_segment 发布当前分段, 移出窗口的分段及过旧的部分段被删除
+ * @return int 成功返回0, 失败返回-1
+ */
+static int finish_segment(HlsWriter *writer)
+{
+    HlsSegment *segment = &writer->current;
+    if (writer->segment_fd < 0)
+        return 0;
+
+    char path[sizeof(writer->dir) + 64], temp[sizeof(writer->dir) + 64];
+    snprintf(path, sizeof(path), "%s/seg%u.m4s", writer->dir, segment->sequence);
+    snprintf(temp, sizeof(temp), "%s/seg%u.m4s.tmp", writer->dir, segment->sequence);
+    int ret = close(writer->segment_fd);
+    writer->segment_fd = -1;
+    if (ret < 0 || rename(temp, path) < 0)
+    {
+        LOG(logger, LOG_ERROR, "Publish `%s` failed: %s", path, strerror(errno));
+        return -1;
+    }
+
+    RingBuffer *segments = writer->segments;
+    if (segments->length == segments->capacity)
+    {
+        HlsSegment oldest;
+        pop_ring_buffer(segments, &oldest);
+        remove_parts(writer, &oldest);
+        snprintf(path, sizeof(path), "seg%u.m4s", oldest.sequence);
+        remove_file(writer, path);
+    }
+    push_ring_buffer(segments, segment);
+    if (segments->length > HLS_PART_SEGMENTS)
+        remove_parts(writer, (HlsSegment *)peek_ring_buffer(segments, segments->length - 1 - HLS_PART_SEGMENTS));
+
+    LOG(logger, LOG_DEBUG, "HLS segment %u: %.3f s in %u parts", segment->sequence, segment->duration / 1000000.0,
+        segment->parts);
+    *segment = (HlsSegment){segment->sequence + 1, 0, 0, {0}, 0};
+    return 0;
+}
+
+#pragma endregion
+
+HlsWriter *open_hls_writer(HlsConfig config, const char *name, AVRational time_base, unsigned int sequence,
+                           unsigned int discontinuity)
+{
+    HlsWriter *writer = (HlsWriter *)calloc(1, sizeof(HlsWriter));
+    if (!writer)
+    {
+        LOG(logger, LOG_ERROR, "Memory allocation failed");
+        return NULL;
+    }
+    // 播放列表至少要保留列出部分段的分段
+    config.window = FFMAX(config.window, HLS_PART_SEGMENTS + 1);
+    config.part = FFMAX(1, FFMIN(config.part, config.segment));
+    writer->config = config;
+    writer->segment_fd = -1;
+    writer->frame = av_rescale_q(1, time_base, AV_TIME_BASE_Q);
+    writer->current.sequence = sequence;
+    writer->discontinuity = discontinuity;
+
+    snprintf(writer->dir, sizeof(writer->dir), "%s/%s", config.dir, name);
+    if (mkdir(writer->dir, 0755) < 0 && errno != EEXIST)
+    {
+        LOG(logger, LOG_ERROR, "Create `%s` failed: %s", writer->dir, strerror(errno));
+        free(writer);
+        return NULL;
+    }
+    if (clean_dir(writer) < 0)
+    {
+        free(writer);
+        return NULL;
+    }
+
+    writer->segments = create_ring_buffer(sizeof(HlsSegment), config.window);
+    writer->playlist = (char *)malloc(HLS_PLAYLIST_SIZE);
+    uint8_t *io_buffer = (uint8_t *)av_malloc(HLS_IO_SIZE);
+    if (writer->segments && writer->playlist && io_buffer)
+        writer->pb = avio_alloc_context(io_buffer, HLS_IO_SIZE, 1, writer, NULL, hls_write_packet, NULL);
+    if (!writer->pb)
+    {
+        LOG(logger, LOG_ERROR, "Alloc io context failed");
+        av_free(io_buffer);
+        if (writer->segments)
+            free_ring_buffer(writer->segments);
+        free(writer->playlist);
+        free(writer);
+        return NULL;
+    }
+    return writer;
+}
+
+int start_hls_writer(HlsWriter *writer, AVFormatContext *frm_ctx)
+{
+    writer->frm_ctx = frm_ctx;
+    avio_flush(writer->pb);
+
+    char name[32];
+    snprintf(name, sizeof(name), "init%u.mp4", writer->discontinuity);
+    int ret = publish_file(writer, name, writer->buffer, writer->size);
+    writer->size = 0;
+    if (ret < 0)
+        return -1;
+    LOG(logger, LOG_DEBUG, "Open HLS output `%s`, segment %u ms, part %u ms", writer->dir, writer->config.segment,
+        writer->config.part);
+    return 0;
+}
+
+int write_hls_packet(HlsWriter *writer, AVPacket *packet)
+{
+    int64_t pts = av_rescale_q(packet->pts, writer->frm_ctx->streams[0]->time_base, AV_TIME_BASE_Q);
+    int key = packet->flags & AV_PKT_FLAG_KEY;
+
+    if (writer->started)
+    {
+        // 部分段不超过目标时长; 分段在目标时长后的关键帧处结束, 部分段数用尽或超过上限时提前结束
+        int64_t segment = pts - writer->segment_start;
+        int end = (key && segment >= writer->config.segment * 1000LL) ||
+                  segment >= writer->config.segment * 1000LL * HLS_SEGMENT_LIMIT ||
+                  writer->current.parts + 1 >= HLS_MAX_PARTS;
+        if (end || pts + writer->frame - writer->part_start > writer->config.part * 1000LL)
+        {
+            if (flush_part(writer, pts) < 0 || (end && finish_segment(writer) < 0) || write_playlist(writer) < 0)
+                return -1;
+        }
+    }
+    if (!writer->started)
+    {
+        if (writer->current.parts == 0)
+            writer->segment_start = pts;
+        writer->part_start = pts;
+        writer->part_key = key;
+        writer->started = 1;
+    }
+    writer->last_pts = pts;
+
+    if (av_write_frame(writer->frm_ctx, packet) < 0)
+    {
+        LOG(logger, LOG_ERROR, "Write HLS packet failed");
+        return -1;
+    }
+    return 0;
+}
+
+int finish_hls_writer(HlsWriter *writer)
+{
+    int ret = 0;
+    if (writer->started && flush_part(writer, writer->last_pts + writer->frame) < 0)
+        ret = -1;
+    if (finish_segment(writer) < 0 || write_playlist(writer) < 0)
+        ret = -1;
+    writer->finished = 1;
+    return ret;
+}
+
+void close_hls_writer(HlsWriter *writer)
+{
+    if (writer->segment_fd >= 0)
+        close(writer->segment_fd);
+    av_freep(&writer->pb->buffer);
+    avio_context_free(&writer->pb);
+    free_ring_buffer(writer->segments);
+    free(writer->buffer);
+    free(writer->playlist);
+    free(writer);
+}
@@ -0,0 +1,190 @@
+#include "../../include/live.h"
+
+/**
+ * @brief connect_live 打开网络IO并写入文件头 可被封装上下文的中断回调打断
+ * @return int 成功返回0, 失败返回-1
+ */
+static int connect_live(LiveWriter *writer)
+{
+    AVFormatContext *frm_ctx = writer->frm_ctx;
+    if (avio_open2(&frm_ctx->pb, writer->url, AVIO_FLAG_WRITE, &frm_ctx->interrupt_callback, NULL) < 0)
+    {
+        LOG(logger, LOG_ERROR, "Open live output `%s` failed", writer->url);
+        return -1;
+    }
+    if (avformat_write_header(frm_ctx, NULL) < 0)
+    {
+        LOG(logger, LOG_ERROR, "Write live head failed");
+        return -1;
+    }
+    return 0;
+}
+
+static void *live_loop(void *arg)
+{
+    LiveWriter *writer = (LiveWriter *)arg;
+    apply_affinity(ROLE_IO);
+
+    if (writer->url)
+    {
+        int64_t start = av_gettime_relative();
+        int ret = connect_live(writer);
+        pthread_mutex_lock(&writer->mutex);
+        writer->connect_time = av_gettime_relative() - start;
+        writer->state = ret < 0 ? LIVE_FAILED : LIVE_CONNECTED;
+        // 连接前的包都已丢弃, 从关键帧开始发送
+        writer->need_key = ret == 0;
+        pthread_mutex_unlock(&writer->mutex);
+        if (ret < 0)
+            return NULL;
+        LOG(logger, LOG_INFO, "Live output `%s` connected in %.1f ms", writer->url, writer->connect_time / 1000.0);
+    }
+
+    pthread_mutex_lock(&writer->mutex);
+    while (1)
+    {
+        AVPacket *packet;
+        while (!writer->stop && pop_ring_buffer(writer->packets, &packet) < 0)
+            pthread_cond_wait(&writer->cond, &writer->mutex);
+        if (writer->stop)
+            break;
+        writer->write_start = av_gettime_relative();
+        pthread_mutex_unlock(&writer->mutex);
+
+        int ret = av_interleaved_write_frame(writer->frm_ctx, packet);
+        av_packet_free(&packet);
+
+        pthread_mutex_lock(&writer->mutex);
+        int64_t latency = av_gettime_relative() - writer->write_start;
+        writer->write_start = 0;
+        writer->latency = (writer->latency * 7 + latency) / 8;
+        if (ret < 0)
+        {
+            LOG(logger, LOG_ERROR, "Error writing live packet");
+            writer->error = 1;
+            break;
+        }
+        writer->written++;
+    }
+    pthread_mutex_unlock(&writer->mutex);
+    return NULL;
+}
+
+LiveWriter *open_live_writer(AVFormatContext *frm_ctx, unsigned int capacity, const char *url)
+{
+    LiveWriter *writer = (LiveWriter *)calloc(1, sizeof(LiveWriter));
+    if (!writer)
+    {
+        LOG(logger, LOG_ERROR, "Memory allocation failed");
+        return NULL;
+    }
+    writer->frm_ctx = frm_ctx;
+    writer->state = url ? LIVE_CONNECTING : LIVE_CONNECTED;
+    writer->url = url ? strdup(url) : NULL;
+    writer->packets = create_ring_buffer(sizeof(AVPacket *), capacity);
+    if (!writer->packets || (url && !writer->url))
+    {
+        LOG(logger, LOG_ERROR, "Memory allocation failed");
+        if (writer->packets)
+            free_ring_buffer(writer->packets);
+        free(writer->url);
+        free(writer);
+        return NULL;
+    }
+    pthread_mutex_init(&writer->mutex, NULL);
+    pthread_cond_init(&writer->cond, NULL);
+
+    if (pthread_create(&writer->thread, NULL, live_loop, writer) != 0)
+    {
+        LOG(logger, LOG_ERROR, "Create live writer thread failed");
+        pthread_cond_destroy(&writer->cond);
+        pthread_mutex_destroy(&writer->mutex);
+        free_ring_buffer(writer->packets);
+        free(writer->url);
+        free(writer);
+        return NULL;
+    }
+    return writer;
+}
+
+int push_live_writer(LiveWriter *writer, AVPacket *packet)
+{
+    int key = packet->flags & AV_PKT_FLAG_KEY;
+
+    pthread_mutex_lock(&writer->mutex);
+    if (writer->error)
+    {
+        pthread_mutex_unlock(&writer->mutex);
+        av_packet_free(&packet);
+        return -1;
+    }
+    // 连接完成前不积压, 连接失败时由调用方关闭输出
+    if (writer->state != LIVE_CONNECTED)
+    {
+        writer->skip = 1;
+        writer->dropped++;
+        pthread_mutex_unlock(&writer->mutex);
+        av_packet_free(&packet);
+        return 0;
+    }
+
+    // 丢包后的非关键帧无法解码, 一直丢弃到下一个关键帧
+    if ((writer->skip && !key) || push_ring_buffer(writer->packets, &packet) < 0)
+    {
+        if (!writer->skip || key)
+            writer->need_key = 1;
+        writer->skip = 1;
+        writer->dropped++;
+        pthread_mutex_unlock(&writer->mutex);
+        av_packet_free(&packet);
+        return 0;
+    }
+    if (key)
+        writer->skip = 0;
+    pthread_cond_signal(&writer->cond);
+    pthread_mutex_unlock(&writer->mutex);
+    return 0;
+}
+
+LiveStat get_live_writer_stat(LiveWriter *writer)
+{
+    pthread_mutex_lock(&writer->mutex);
+    LiveStat stat = {
+        writer->state,
+        writer->connect_time,
+        writer->packets->length,
+        writer->latency,
+        writer->need_key,
+        writer->dropped,
+        writer->written,
+    };
+    // 当前写入被链路阻塞时, 以已耗时反映拥塞
+    if (writer->write_start > 0)
+        stat.latency = FFMAX(stat.latency, av_gettime_relative() - writer->write_start);
+    writer->need_key = 0;
+    pthread_mutex_unlock(&writer->mutex);
+    return stat;
+}
+
+int close_live_writer(LiveWriter *writer)
+{
+    pthread_mutex_lock(&writer->mutex);
+    writer->stop = 1;
+    pthread_cond_signal(&writer->cond);
+    pthread_mutex_unlock(&writer->mutex);
+    pthread_join(writer->thread, NULL);
+
+    AVPacket *packet;
+    while (pop_ring_buffer(writer->packets, &packet) == 0)
+        av_packet_free(&packet);
+
+    LOG(logger, LOG_INFO, "Live writer: %lld packets sent, %lld dropped",
+        (long long)writer->written, (long long)writer->dropped);
+    int ret = writer->error ? -1 : 0;
+    pthread_cond_destroy(&writer->cond);
+    pthread_mutex_destroy(&writer->mutex);
+    free_ring_buffer(writer->packets);
+    free(writer->url);
+    free(writer);
+    return ret;
+}
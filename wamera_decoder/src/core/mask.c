@@ -0,0 +1,496 @@
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "../../include/mask.h"
+
+// 单行最多的区间数 色度行合并多行亮度区间
+#define MASK_ROW_SPANS (MASK_MAX_SHAPES * MASK_MAX_POINTS * 4)
+
+// 马赛克块均值的未计算标记
+#define MASK_UNSET UINT32_MAX
+
+int parse_mask_shape(MaskShape *shape, const char *value)
+{
+    shape->num = 0;
+    if (!strchr(value, ' '))
+    {
+        int x, y, w, h;
+        char tail;
+        if (sscanf(value, "%d,%d,%d,%d%c", &x, &y, &w, &h, &tail) != 4 || w <= 0 || h <= 0)
+            return -1;
+        int xs[4] = {x, x + w, x + w, x};
+        int ys[4] = {y, y, y + h, y + h};
+        memcpy(shape->x, xs, sizeof(xs));
+        memcpy(shape->y, ys, sizeof(ys));
+        shape->num = 4;
+        return 0;
+    }
+
+    const char *p = value;
+    while (*p)
+    {
+        while (*p == ' ')
+            p++;
+        if (*p == '\0')
+            break;
+        int x, y, n;
+        if (shape->num == MASK_MAX_POINTS || sscanf(p, "%d,%d%n", &x, &y, &n) != 2)
+            return -1;
+        shape->x[shape->num] = x;
+        shape->y[shape->num] = y;
+        shape->num++;
+        p += n;
+    }
+    return shape->num >= 3 ? 0 : -1;
+}
+
+#pragma region 栅格化
+
+/**
+ * @brief ceil_int 向上取整
+ */
+static int ceil_int(double v)
+{
+    int i = (int)v;
+    return i < v ? i + 1 : i;
+}
+
+/**
+ * @brief add_row 合并一行内的区间并追加到平面 区间按左端排序后合并重叠与相邻的部分
+ * @return 成功返回0, 内存不足返回-1
+ */
+static int add_row(MaskPlane *plane, int y, int *x0, int *x1, int n)
+{
+    for (int i = 1; i < n; i++)
+        for (int j = i; j > 0 && x0[j] < x0[j - 1]; j--)
+        {
+            int t0 = x0[j], t1 = x1[j];
+            x0[j] = x0[j - 1], x1[j] = x1[j - 1];
+            x0[j - 1] = t0, x1[j - 1] = t1;
+        }
+
+    for (int i = 0; i < n;)
+    {
+        MaskSpan span = {y, FFMAX(x0[i], 0), x1[i]};
+        for (i++; i < n && x0[i] <= span.x1; i++)
+            span.x1 = FFMAX(span.x1, x1[i]);
+        span.x1 = FFMIN(span.x1, plane->width);
+        if (span.x1 <= span.x0)
+            continue;
+        if (append_array(plane->spans, &span) < 0)
+            return -1;
+        plane->top = FFMIN(plane->top, y);
+        plane->bottom = FFMAX(plane->bottom, y + 1);
+        plane->left = FFMIN(plane->left, span.x0);
+        plane->right = FFMAX(plane->right, span.x1);
+    }
+    return 0;
+}
+
+/**
+ * @brief init_plane 初始化空的平面覆盖
+ * @return 成功返回0, 内存不足返回-1
+ */
+static int init_plane(MaskPlane *plane, int width, int height, int block_w, int block_h)
+{
+    plane->spans = create_array(sizeof(MaskSpan), 64);
+    plane->width = width;
+    plane->height = height;
+    plane->top = plane->left = INT32_MAX;
+    plane->bottom = plane->right = 0;
+    plane->block_w = FFMAX(block_w, 1);
+    plane->block_h = FFMAX(block_h, 1);
+    return plane->spans ? 0 : -1;
+}
+
+/**
+ * @brief rasterize_luma 按像素中心是否落在多边形内 逐行求各遮挡区域的区间
+ * @return 成功返回0, 内存不足返回-1
+ */
+static int rasterize_luma(PrivacyMask *mask, MaskPlane *plane)
+{
+    double sx = (double)plane->width / mask->ref_width;
+    double sy = (double)plane->height / mask->ref_height;
+    int x0[MASK_ROW_SPANS], x1[MASK_ROW_SPANS];
+    for (int y = 0; y < plane->height; y++)
+    {
+        double yc = y + 0.5;
+        int n = 0;
+        for (unsigned int s = 0; s < mask->config.num; s++)
+        {
+            const MaskShape *shape = &mask->config.shapes[s];
+            double xs[MASK_MAX_POINTS];
+            int num = 0;
+            for (unsigned int i = 0; i < shape->num; i++)
+            {
+                unsigned int j = (i + 1) % shape->num;
+                double xi = shape->x[i] * sx, yi = shape->y[i] * sy;
+                double xj = shape->x[j] * sx, yj = shape->y[j] * sy;
+                if ((yi <= yc) == (yj <= yc))
+                    continue;
+                double x = xi + (yc - yi) * (xj - xi) / (yj - yi);
+                int k = num++;
+                for (; k > 0 && xs[k - 1] > x; k--)
+                    xs[k] = xs[k - 1];
+                xs[k] = x;
+            }
+            // 奇偶规则 交点两两成对
+            for (int i = 0; i + 1 < num; i += 2)
+            {
+                x0[n] = ceil_int(xs[i] - 0.5);
+                x1[n] = ceil_int(xs[i + 1] - 0.5);
+                if (x1[n] > x0[n])
+                    n++;
+            }
+        }
+        if (n > 0 && add_row(plane, y, x0, x1, n) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief rasterize_chroma 由亮度区间求色度平面的区间 色度像素覆盖的任一亮度像素被遮挡即遮挡
+ * @return 成功返回0, 内存不足返回-1
+ */
+static int rasterize_chroma(const MaskPlane *luma, MaskPlane *plane, int log2_w, int log2_h)
+{
+    int x0[MASK_ROW_SPANS], x1[MASK_ROW_SPANS];
+    unsigned int i = 0;
+    while (i < luma->spans->length)
+    {
+        int cy = ARRAY_GET(luma->spans, MaskSpan, i)->y >> log2_h;
+        int n = 0;
+        for (; i < luma->spans->length; i++)
+        {
+            MaskSpan *span = ARRAY_GET(luma->spans, MaskSpan, i);
+            if (span->y >> log2_h != cy)
+                break;
+            if (n == MASK_ROW_SPANS)
+                continue;
+            x0[n] = span->x0 >> log2_w;
+            x1[n] = -((-span->x1) >> log2_w);
+            n++;
+        }
+        if (add_row(plane, cy, x0, x1, n) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+#pragma endregion
+
+#pragma region 遮挡
+
+/**
+ * @brief sum_block 求块内像素之和
+ */
+static uint32_t sum_block(const uint8_t *p, int linesize, int w, int h)
+{
+    uint32_t sum = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = zero;
+#endif
+    for (int y = 0; y < h; y++, p += linesize)
+    {
+        int x = 0;
+#if defined(__SSE2__)
+        for (; x + 8 <= w; x += 8)
+            acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_loadl_epi64((const __m128i *)(p + x)), zero));
+#elif defined(__ARM_NEON)
+        uint16x8_t acc = vdupq_n_u16(0);
+        for (; x + 8 <= w; x += 8)
+            acc = vaddw_u8(acc, vld1_u8(p + x));
+        uint64x2_t total = vpaddlq_u32(vpaddlq_u16(acc));
+        sum += (uint32_t)(vgetq_lane_u64(total, 0) + vgetq_lane_u64(total, 1));
+#endif
+        for (; x < w; x++)
+            sum += p[x];
+    }
+#if defined(__SSE2__)
+    sum += (uint32_t)_mm_cvtsi128_si32(acc);
+#endif
+    return sum;
+}
+
+/**
+ * @brief pixelate_plane 以块均值填充遮挡像素 只计算区间触及的块
+ */
+static void pixelate_plane(PrivacyMask *mask, const MaskPlane *plane, uint8_t *data, int linesize)
+{
+    int bw = plane->block_w, bh = plane->block_h;
+    uint32_t *avg = mask->sums;
+    unsigned int i = 0;
+    while (i < plane->spans->length)
+    {
+        int top = ARRAY_GET(plane->spans, MaskSpan, i)->y / bh * bh;
+        int h = FFMIN(bh, plane->height - top);
+        unsigned int end = i;
+        while (end < plane->spans->length && ARRAY_GET(plane->spans, MaskSpan, end)->y < top + h)
+            end++;
+
+        // 先求该块行内被触及的块的均值, 再写入遮挡像素
+        for (unsigned int k = i; k < end; k++)
+        {
+            MaskSpan *span = ARRAY_GET(plane->spans, MaskSpan, k);
+            for (int bx = span->x0 / bw; bx * bw < span->x1; bx++)
+            {
+                if (avg[bx] != MASK_UNSET)
+                    continue;
+                int w = FFMIN(bw, plane->width - bx * bw);
+                uint32_t sum = sum_block(data + (ptrdiff_t)top * linesize + bx * bw, linesize, w, h);
+                avg[bx] = (sum + w * h / 2) / (w * h);
+            }
+        }
+        for (unsigned int k = i; k < end; k++)
+        {
+            MaskSpan *span = ARRAY_GET(plane->spans, MaskSpan, k);
+            uint8_t *row = data + (ptrdiff_t)span->y * linesize;
+            for (int bx = span->x0 / bw; bx * bw < span->x1; bx++)
+            {
+                int x0 = FFMAX(span->x0, bx * bw), x1 = FFMIN(span->x1, (bx + 1) * bw);
+                memset(row + x0, (int)avg[bx], x1 - x0);
+            }
+        }
+        for (unsigned int k = i; k < end; k++)
+        {
+            MaskSpan *span = ARRAY_GET(plane->spans, MaskSpan, k);
+            for (int bx = span->x0 / bw; bx * bw < span->x1; bx++)
+                avg[bx] = MASK_UNSET;
+        }
+        i = end;
+    }
+}
+
+/**
+ * @brief sum_row 求覆盖范围内一行的水平窗口和 超出平面的像素取边缘值
+ */
+static void sum_row(const MaskPlane *plane, const uint8_t *data, int linesize, int y, int radius, uint16_t *out)
+{
+    const uint8_t *row = data + (ptrdiff_t)FFMIN(FFMAX(y, 0), plane->height - 1) * linesize;
+    int last = plane->width - 1;
+    uint32_t sum = 0;
+    for (int i = -radius; i <= radius; i++)
+        sum += row[FFMIN(FFMAX(plane->left + i, 0), last)];
+    for (int x = plane->left; x < plane->right; x++)
+    {
+        out[x - plane->left] = (uint16_t)sum;
+        sum += row[FFMIN(x + radius + 1, last)];
+        sum -= row[FFMAX(x - radius, 0)];
+    }
+}
+
+/**
+ * @brief accumulate_row 将一行的水平窗口和加到列和上 sign 为负时减去
+ */
+static void accumulate_row(uint32_t *cols, const uint16_t *row, int n, int sign)
+{
+    int x = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    for (; x + 8 <= n; x += 8)
+    {
+        __m128i r = _mm_loadu_si128((const __m128i *)(row + x));
+        __m128i lo = _mm_unpacklo_epi16(r, zero), hi = _mm_unpackhi_epi16(r, zero);
+        __m128i c0 = _mm_loadu_si128((const __m128i *)(cols + x));
+        __m128i c1 = _mm_loadu_si128((const __m128i *)(cols + x + 4));
+        c0 = sign > 0 ? _mm_add_epi32(c0, lo) : _mm_sub_epi32(c0, lo);
+        c1 = sign > 0 ? _mm_add_epi32(c1, hi) : _mm_sub_epi32(c1, hi);
+        _mm_storeu_si128((__m128i *)(cols + x), c0);
+        _mm_storeu_si128((__m128i *)(cols + x + 4), c1);
+    }
+#elif defined(__ARM_NEON)
+    for (; x + 8 <= n; x += 8)
+    {
+        uint16x8_t r = vld1q_u16(row + x);
+        uint32x4_t c0 = vld1q_u32(cols + x), c1 = vld1q_u32(cols + x + 4);
+        c0 = sign > 0 ? vaddw_u16(c0, vget_low_u16(r)) : vsubw_u16(c0, vget_low_u16(r));
+        c1 = sign > 0 ? vaddw_u16(c1, vget_high_u16(r)) : vsubw_u16(c1, vget_high_u16(r));
+        vst1q_u32(cols + x, c0);
+        vst1q_u32(cols + x + 4, c1);
+    }
+#endif
+    for (; x < n; x++)
+        cols[x] = sign > 0 ? cols[x] + row[x] : cols[x] - row[x];
+}
+
+/**
+ * @brief blur_plane 以方框模糊替换遮挡像素
+ * @note 自上而下滑动窗口, 每行的水平和在该行被改写之前求出, 原地处理不影响结果
+ */
+static void blur_plane(PrivacyMask *mask, const MaskPlane *plane, uint8_t *data, int linesize)
+{
+    int rw = plane->block_w / 2, rh = plane->block_h / 2;
+    int window = 2 * rh + 1, width = plane->right - plane->left;
+    uint64_t area = (uint64_t)(2 * rw + 1) * window;
+    uint64_t scale = (((uint64_t)1 << 32) + area - 1) / area;
+    uint32_t *cols = mask->sums;
+    memset(cols, 0, width * sizeof(uint32_t));
+
+    // 环形存放窗口内各行的水平和, 行 y 存放在 (y - top + rh) % window
+    for (int y = plane->top - rh; y < plane->top + rh; y++)
+    {
+        uint16_t *row = mask->rows + (size_t)((y - plane->top + rh) % window) * width;
+        sum_row(plane, data, linesize, y, rw, row);
+        accumulate_row(cols, row, width, 1);
+    }
+
+    unsigned int i = 0;
+    for (int y = plane->top; y < plane->bottom; y++)
+    {
+        uint16_t *next = mask->rows + (size_t)((y + rh - plane->top + rh) % window) * width;
+        sum_row(plane, data, linesize, y + rh, rw, next);
+        accumulate_row(cols, next, width, 1);
+
+        uint8_t *row = data + (ptrdiff_t)y * linesize;
+        for (; i < plane->spans->length && ARRAY_GET(plane->spans, MaskSpan, i)->y == y; i++)
+        {
+            MaskSpan *span = ARRAY_GET(plane->spans, MaskSpan, i);
+            for (int x = span->x0; x < span->x1; x++)
+                row[x] = (uint8_t)((cols[x - plane->left] * scale) >> 32);
+        }
+
+        uint16_t *prev = mask->rows + (size_t)((y - plane->top) % window) * width;
+        accumulate_row(cols, prev, width, -1);
+    }
+}
+
+/**
+ * @brief fill_plane 以固定值填充遮挡像素
+ */
+static void fill_plane(const MaskPlane *plane, uint8_t *data, int linesize, int value)
+{
+    for (unsigned int i = 0; i < plane->spans->length; i++)
+    {
+        MaskSpan *span = ARRAY_GET(plane->spans, MaskSpan, i);
+        memset(data + (ptrdiff_t)span->y * linesize + span->x0, value, span->x1 - span->x0);
+    }
+}
+
+#pragma endregion
+
+/**
+ * @brief free_layout 释放各平面的覆盖与缓冲
+ */
+static void free_layout(PrivacyMask *mask)
+{
+    // U/V 共用 planes[1] 的区间
+    free_array(mask->planes[0].spans);
+    free_array(mask->planes[1].spans);
+    memset(mask->planes, 0, sizeof(mask->planes));
+    free(mask->sums);
+    free(mask->rows);
+    mask->sums = NULL;
+    mask->rows = NULL;
+    mask->width = mask->height = 0;
+}
+
+/**
+ * @brief layout_mask 按帧尺寸与格式栅格化遮挡区域
+ * @return 成功返回0, 格式不支持或内存不足返回-1
+ */
+static int layout_mask(PrivacyMask *mask, const AVFrame *frame)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get((enum AVPixelFormat)frame->format);
+    if (!desc || !(desc->flags & AV_PIX_FMT_FLAG_PLANAR) || (desc->flags & AV_PIX_FMT_FLAG_RGB) ||
+        desc->nb_components < 3 || desc->comp[0].depth != 8)
+        return -1;
+
+    free_layout(mask);
+    int lw = desc->log2_chroma_w, lh = desc->log2_chroma_h;
+    int block = FFALIGN(FFMAX(mask->config.block, 1), MASK_BLOCK_ALIGN);
+    if (init_plane(&mask->planes[0], frame->width, frame->height, block, block) < 0 ||
+        init_plane(&mask->planes[1], -((-frame->width) >> lw), -((-frame->height) >> lh), block >> lw, block >> lh) < 0 ||
+        rasterize_luma(mask, &mask->planes[0]) < 0 ||
+        rasterize_chroma(&mask->planes[0], &mask->planes[1], lw, lh) < 0)
+        goto fail;
+    mask->planes[2] = mask->planes[1];
+
+    // 列和与块均值按亮度宽度分配, 模糊的环形行缓冲按窗口高度分配
+    mask->sums = (uint32_t *)malloc((frame->width + 1) * sizeof(uint32_t));
+    mask->rows = (uint16_t *)malloc((size_t)(block + 1) * frame->width * sizeof(uint16_t));
+    if (!mask->sums || !mask->rows)
+        goto fail;
+    for (int i = 0; i <= frame->width; i++)
+        mask->sums[i] = MASK_UNSET;
+
+    mask->pixels = 0;
+    for (unsigned int i = 0; i < mask->planes[0].spans->length; i++)
+    {
+        MaskSpan *span = ARRAY_GET(mask->planes[0].spans, MaskSpan, i);
+        mask->pixels += span->x1 - span->x0;
+    }
+    mask->format = frame->format;
+    mask->width = frame->width;
+    mask->height = frame->height;
+    LOG(logger, LOG_INFO, "Privacy mask %dx%d: %u spans, %lld pixels",
+        frame->width, frame->height, mask->planes[0].spans->length, (long long)mask->pixels);
+    return 0;
+
+fail:
+    LOG(logger, LOG_ERROR, "Memory allocation failed");
+    free_layout(mask);
+    return -1;
+}
+
+PrivacyMask *open_privacy_mask(MaskConfig config, int width, int height)
+{
+    if (width <= 0 || height <= 0)
+        return NULL;
+    PrivacyMask *mask = (PrivacyMask *)calloc(1, sizeof(PrivacyMask));
+    if (!mask)
+    {
+        LOG(logger, LOG_ERROR, "Memory allocation failed");
+        return NULL;
+    }
+    mask->config = config;
+    mask->ref_width = width;
+    mask->ref_height = height;
+    mask->format = -1;
+    return mask;
+}
+
+int apply_privacy_mask(PrivacyMask *mask, AVFrame *frame)
+{
+    if ((frame->format != mask->format || frame->width != mask->width || frame->height != mask->height) &&
+        layout_mask(mask, frame) < 0)
+        return -1;
+    if (mask->pixels == 0)
+        return 0;
+    if (av_frame_make_writable(frame) < 0)
+        return -1;
+
+    for (int p = 0; p < 3; p++)
+    {
+        const MaskPlane *plane = &mask->planes[p];
+        switch (mask->config.mode)
+        {
+        case MASK_PIXELATE:
+            pixelate_plane(mask, plane, frame->data[p], frame->linesize[p]);
+            break;
+        case MASK_BLUR:
+            blur_plane(mask, plane, frame->data[p], frame->linesize[p]);
+            break;
+        default:
+            fill_plane(plane, frame->data[p], frame->linesize[p], p == 0 ? 16 : 128);
+            break;
+        }
+    }
+    mask->frames++;
+    return 0;
+}
+
+void close_privacy_mask(PrivacyMask *mask)
+{
+    if (!mask)
+        return;
+    LOG(logger, LOG_DEBUG, "Privacy mask applied to %lld frames", (long long)mask->frames);
+    free_layout(mask);
+    free(mask);
+}
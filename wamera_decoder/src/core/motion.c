@@ -0,0 +1,217 @@
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "../../include/motion.h"
+
+#pragma region 块差值
+
+/**
+ * @brief block_sad_scalar 求块内逐像素绝对差之和 用于不足一个块宽的边缘
+ */
+static uint32_t block_sad_scalar(const uint8_t *a, int a_stride, const uint8_t *b, int b_stride, int w, int h)
+{
+    uint32_t sad = 0;
+    for (int y = 0; y < h; y++, a += a_stride, b += b_stride)
+        for (int x = 0; x < w; x++)
+            sad += a[x] > b[x] ? a[x] - b[x] : b[x] - a[x];
+    return sad;
+}
+
+/**
+ * @brief block_sad 求 MOTION_BLOCK 宽的块内逐像素绝对差之和
+ */
+static uint32_t block_sad(const uint8_t *a, int a_stride, const uint8_t *b, int b_stride, int h)
+{
+#if defined(__SSE2__)
+    __m128i acc = _mm_setzero_si128();
+    for (int y = 0; y < h; y++, a += a_stride, b += b_stride)
+    {
+        __m128i va = _mm_loadu_si128((const __m128i *)a);
+        __m128i vb = _mm_loadu_si128((const __m128i *)b);
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(va, vb));
+    }
+    return (uint32_t)(_mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_srli_si128(acc, 8)));
+#elif defined(__ARM_NEON)
+    // 每个通道最多累加 2 * MOTION_BLOCK 个差值, 不会溢出16位
+    uint16x8_t acc = vdupq_n_u16(0);
+    for (int y = 0; y < h; y++, a += a_stride, b += b_stride)
+    {
+        uint8x16_t va = vld1q_u8(a);
+        uint8x16_t vb = vld1q_u8(b);
+        acc = vabal_u8(acc, vget_low_u8(va), vget_low_u8(vb));
+        acc = vabal_u8(acc, vget_high_u8(va), vget_high_u8(vb));
+    }
+    uint64x2_t sum = vpaddlq_u32(vpaddlq_u16(acc));
+    return (uint32_t)(vgetq_lane_u64(sum, 0) + vgetq_lane_u64(sum, 1));
+#else
+    return block_sad_scalar(a, a_stride, b, b_stride, MOTION_BLOCK, h);
+#endif
+}
+
+#pragma endregion
+
+/**
+ * @brief resize_motion_map 按新的尺寸重新分配参考帧与保持计数
+ * @return 成功返回0, 失败返回-1
+ */
+static int resize_motion_map(MotionMap *map, int width, int height)
+{
+    free(map->prev);
+    free(map->hold);
+    map->cols = (width + MOTION_BLOCK - 1) / MOTION_BLOCK;
+    map->rows = (height + MOTION_BLOCK - 1) / MOTION_BLOCK;
+    map->stride = map->cols * MOTION_BLOCK;
+    map->prev = (uint8_t *)malloc((size_t)map->stride * height);
+    map->hold = (uint8_t *)malloc((size_t)map->cols * map->rows);
+    if (!map->prev || !map->hold)
+    {
+        LOG(logger, LOG_ERROR, "Memory allocation failed");
+        free(map->prev);
+        free(map->hold);
+        map->prev = NULL;
+        map->hold = NULL;
+        map->width = map->height = 0;
+        return -1;
+    }
+    map->width = width;
+    map->height = height;
+    return 0;
+}
+
+/**
+ * @brief attach_regions 将同一行内状态相同的相邻块合并为区域并附加到帧上
+ * @return 成功返回0, 失败返回-1
+ */
+static int attach_regions(MotionMap *map, AVFrame *frame)
+{
+    int qoffset[2] = {
+        (int)(map->config.static_qoffset * MOTION_QOFFSET_DEN + 0.5),
+        -(int)(map->config.motion_qoffset * MOTION_QOFFSET_DEN + 0.5),
+    };
+
+    // 先统计区域数量, 偏移为0的状态不生成区域
+    int num = 0;
+    for (int r = 0; r < map->rows; r++)
+    {
+        const uint8_t *hold = map->hold + r * map->cols;
+        for (int c = 0; c < map->cols; c++)
+            if ((c == 0 || !hold[c] != !hold[c - 1]) && qoffset[hold[c] > 0] != 0)
+                num++;
+    }
+    av_frame_remove_side_data(frame, AV_FRAME_DATA_REGIONS_OF_INTEREST);
+    if (num == 0)
+        return 0;
+
+    AVFrameSideData *side = av_frame_new_side_data(frame, AV_FRAME_DATA_REGIONS_OF_INTEREST,
+                                                   num * sizeof(AVRegionOfInterest));
+    if (!side)
+        return -1;
+    AVRegionOfInterest *roi = (AVRegionOfInterest *)side->data;
+    for (int r = 0; r < map->rows; r++)
+    {
+        const uint8_t *hold = map->hold + r * map->cols;
+        for (int c = 0; c < map->cols;)
+        {
+            int active = hold[c] > 0, end = c + 1;
+            while (end < map->cols && (hold[end] > 0) == active)
+                end++;
+            if (qoffset[active] != 0)
+            {
+                roi->self_size = sizeof(AVRegionOfInterest);
+                roi->top = r * MOTION_BLOCK;
+                roi->bottom = FFMIN((r + 1) * MOTION_BLOCK, map->height);
+                roi->left = c * MOTION_BLOCK;
+                roi->right = FFMIN(end * MOTION_BLOCK, map->width);
+                roi->qoffset = (AVRational){qoffset[active], MOTION_QOFFSET_DEN};
+                roi++;
+            }
+            c = end;
+        }
+    }
+    return 0;
+}
+
+MotionMap *open_motion_map(MotionConfig config)
+{
+    MotionMap *map = (MotionMap *)calloc(1, sizeof(MotionMap));
+    if (!map)
+    {
+        LOG(logger, LOG_ERROR, "Memory allocation failed");
+        return NULL;
+    }
+    map->config = config;
+    return map;
+}
+
+int mark_motion_map(MotionMap *map, AVFrame *frame)
+{
+    int fresh = 0;
+    if (frame->width != map->width || frame->height != map->height)
+    {
+        if (resize_motion_map(map, frame->width, frame->height) < 0)
+            return -1;
+        fresh = 1;
+    }
+
+    const uint8_t *luma = frame->data[0];
+    int linesize = frame->linesize[0];
+    uint32_t threshold = map->config.threshold;
+    int64_t active = 0;
+    for (int r = 0; r < map->rows; r++)
+    {
+        int top = r * MOTION_BLOCK;
+        int h = FFMIN(MOTION_BLOCK, map->height - top);
+        uint8_t *hold = map->hold + r * map->cols;
+        for (int c = 0; c < map->cols; c++)
+        {
+            if (fresh)
+            {
+                hold[c] = MOTION_HOLD;
+                active++;
+                continue;
+            }
+            int left = c * MOTION_BLOCK;
+            int w = FFMIN(MOTION_BLOCK, map->width - left);
+            const uint8_t *cur = luma + (ptrdiff_t)top * linesize + left;
+            const uint8_t *prev = map->prev + (size_t)top * map->stride + left;
+            uint32_t sad = w == MOTION_BLOCK ? block_sad(cur, linesize, prev, map->stride, h)
+                                             : block_sad_scalar(cur, linesize, prev, map->stride, w, h);
+            if (sad > threshold * (uint32_t)(w * h))
+                hold[c] = MOTION_HOLD;
+            else if (hold[c] > 0)
+                hold[c]--;
+            if (hold[c] > 0)
+                active++;
+        }
+    }
+
+    for (int y = 0; y < map->height; y++)
+        memcpy(map->prev + (size_t)y * map->stride, luma + (ptrdiff_t)y * linesize, map->width);
+
+    map->stat.frames++;
+    map->stat.blocks += map->cols * map->rows;
+    map->stat.active += active;
+    return attach_regions(map, frame);
+}
+
+MotionStat get_motion_map_stat(MotionMap *map)
+{
+    return map->stat;
+}
+
+void close_motion_map(MotionMap *map)
+{
+    if (!map)
+        return;
+    if (map->stat.blocks > 0)
+        LOG(logger, LOG_INFO, "Motion map: %lld frames, %.1f%% blocks active",
+            (long long)map->stat.frames, 100.0 * map->stat.active / map->stat.blocks);
+    free(map->prev);
+    free(map->hold);
+    free(map);
+}
@@ -0,0 +1,305 @@
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "../../include/osd.h"
+
+#pragma region 字体
+
+// 内置字体包含的字符 不在其中的字符按空格绘制
+static const char glyph_chars[] = "0123456789-:/. ";
+
+// 5x7 点阵 每行低5位从左到右
+static const uint8_t glyph_rows[][OSD_GLYPH_HEIGHT] = {
+    {0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E}, // 0
+    {0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E}, // 1
+    {0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F}, // 2
+    {0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E}, // 3
+    {0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02}, // 4
+    {0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E}, // 5
+    {0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E}, // 6
+    {0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08}, // 7
+    {0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E}, // 8
+    {0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C}, // 9
+    {0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00}, // -
+    {0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00}, // :
+    {0x01, 0x01, 0x02, 0x04, 0x08, 0x10, 0x10}, // /
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C}, // .
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // 空格
+};
+
+#define GLYPH_NUM ((int)sizeof(glyph_chars) - 1)
+
+// 字形与描边的亮度
+#define GLYPH_FILL 235
+#define GLYPH_OUTLINE 16
+
+/**
+ * @brief glyph_index 字符在字体中的序号
+ */
+static int glyph_index(char c)
+{
+    const char *p = c ? strchr(glyph_chars, c) : NULL;
+    return p ? (int)(p - glyph_chars) : GLYPH_NUM - 1;
+}
+
+/**
+ * @brief glyph_dot 字符单元内的一点是否属于字形 单元坐标包含描边
+ */
+static int glyph_dot(int glyph, int ux, int uy)
+{
+    int gx = ux - 1, gy = uy - 1;
+    if (gx < 0 || gx >= OSD_GLYPH_WIDTH || gy < 0 || gy >= OSD_GLYPH_HEIGHT)
+        return 0;
+    return (glyph_rows[glyph][gy] >> (OSD_GLYPH_WIDTH - 1 - gx)) & 1;
+}
+
+#pragma endregion
+
+#pragma region 混合
+
+/**
+ * @brief blend_row 按透明度将一行混合到图像 dst = (dst * (ONE - a) + value * a) / ONE
+ */
+static void blend_row(uint8_t *dst, const uint8_t *value, const uint8_t *alpha, int n)
+{
+    int i = 0;
+#if defined(__SSE2__)
+    // 加权和不超过 255 * OSD_ALPHA_ONE, 16位无符号乘法不会溢出
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi16(OSD_ALPHA_ONE);
+    for (; i + 8 <= n; i += 8)
+    {
+        __m128i d = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(dst + i)), zero);
+        __m128i v = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(value + i)), zero);
+        __m128i a = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(alpha + i)), zero);
+        __m128i sum = _mm_add_epi16(_mm_mullo_epi16(d, _mm_sub_epi16(one, a)), _mm_mullo_epi16(v, a));
+        _mm_storel_epi64((__m128i *)(dst + i), _mm_packus_epi16(_mm_srli_epi16(sum, 7), zero));
+    }
+#elif defined(__ARM_NEON)
+    const uint8x8_t one = vdup_n_u8(OSD_ALPHA_ONE);
+    for (; i + 8 <= n; i += 8)
+    {
+        uint8x8_t d = vld1_u8(dst + i);
+        uint8x8_t a = vld1_u8(alpha + i);
+        uint16x8_t sum = vmull_u8(d, vsub_u8(one, a));
+        sum = vmlal_u8(sum, vld1_u8(value + i), a);
+        vst1_u8(dst + i, vshrn_n_u16(sum, 7));
+    }
+#endif
+    for (; i < n; i++)
+        dst[i] = (uint8_t)((dst[i] * (OSD_ALPHA_ONE - alpha[i]) + value[i] * alpha[i]) >> 7);
+}
+
+#pragma endregion
+
+/**
+ * @brief free_layout 释放图集与画布
+ */
+static void free_layout(Osd *osd)
+{
+    free(osd->atlas_alpha);
+    free(osd->atlas_value);
+    free(osd->canvas_alpha);
+    free(osd->canvas_value);
+    free(osd->chroma_alpha);
+    free(osd->chroma_value);
+    osd->atlas_alpha = osd->atlas_value = NULL;
+    osd->canvas_alpha = osd->canvas_value = NULL;
+    osd->chroma_alpha = osd->chroma_value = NULL;
+    osd->width = osd->height = 0;
+}
+
+/**
+ * @brief rasterize_atlas 按缩放栅格化全部字形 每个字形占一块连续的单元
+ */
+static void rasterize_atlas(Osd *osd)
+{
+    int scale = (int)osd->scale;
+    size_t cell_size = (size_t)osd->cell_width * osd->cell_height;
+    for (int g = 0; g < GLYPH_NUM; g++)
+    {
+        uint8_t *alpha = osd->atlas_alpha + g * cell_size;
+        uint8_t *value = osd->atlas_value + g * cell_size;
+        for (int py = 0; py < osd->cell_height; py++)
+            for (int px = 0; px < osd->cell_width; px++)
+            {
+                int ux = px / scale, uy = py / scale, i = py * osd->cell_width + px;
+                int outline = 0;
+                for (int dy = -1; dy <= 1; dy++)
+                    for (int dx = -1; dx <= 1; dx++)
+                        outline |= glyph_dot(g, ux + dx, uy + dy);
+                if (glyph_dot(g, ux, uy))
+                {
+                    alpha[i] = OSD_ALPHA_ONE;
+                    value[i] = GLYPH_FILL;
+                }
+                else
+                {
+                    alpha[i] = outline ? OSD_ALPHA_ONE : 0;
+                    value[i] = GLYPH_OUTLINE;
+                }
+            }
+    }
+}
+
+/**
+ * @brief layout_osd 按图像尺寸与格式重新栅格化图集并清空画布
+ * @return 成功返回0, 格式不支持或分配失败返回-1
+ */
+static int layout_osd(Osd *osd, const AVFrame *frame)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get((enum AVPixelFormat)frame->format);
+    if (!desc || !(desc->flags & AV_PIX_FMT_FLAG_PLANAR) || (desc->flags & AV_PIX_FMT_FLAG_RGB) ||
+        desc->nb_components < 3 || desc->comp[0].depth != 8 || desc->log2_chroma_w > 2 || desc->log2_chroma_h > 2)
+        return -1;
+
+    free_layout(osd);
+    osd->scale = osd->config.scale > 0 ? osd->config.scale : (unsigned int)FFMAX(1, frame->height / 360);
+    // 单元宽高按最大的色度下采样对齐, 每个字符在色度平面上也占整数个像素
+    osd->cell_width = FFALIGN(OSD_CELL_WIDTH * (int)osd->scale, 4);
+    osd->cell_height = FFALIGN(OSD_CELL_HEIGHT * (int)osd->scale, 4);
+    osd->log2_chroma_w = desc->log2_chroma_w;
+    osd->log2_chroma_h = desc->log2_chroma_h;
+    osd->canvas_width = (OSD_TEXT_SIZE - 1) * osd->cell_width;
+
+    size_t cell_size = (size_t)osd->cell_width * osd->cell_height;
+    size_t canvas_size = (size_t)osd->canvas_width * osd->cell_height;
+    int chroma_width = osd->canvas_width >> osd->log2_chroma_w;
+    osd->atlas_alpha = (uint8_t *)malloc(GLYPH_NUM * cell_size);
+    osd->atlas_value = (uint8_t *)malloc(GLYPH_NUM * cell_size);
+    osd->canvas_alpha = (uint8_t *)calloc(canvas_size, 1);
+    osd->canvas_value = (uint8_t *)calloc(canvas_size, 1);
+    osd->chroma_alpha = (uint8_t *)calloc(canvas_size >> (osd->log2_chroma_w + osd->log2_chroma_h), 1);
+    osd->chroma_value = (uint8_t *)malloc(chroma_width);
+    if (!osd->atlas_alpha || !osd->atlas_value || !osd->canvas_alpha || !osd->canvas_value ||
+        !osd->chroma_alpha || !osd->chroma_value)
+    {
+        LOG(logger, LOG_ERROR, "Memory allocation failed");
+        free_layout(osd);
+        return -1;
+    }
+    memset(osd->chroma_value, 128, chroma_width);
+    rasterize_atlas(osd);
+
+    osd->format = frame->format;
+    osd->width = frame->width;
+    osd->height = frame->height;
+    osd->text[0] = '\0';
+    osd->second = -1;
+    LOG(logger, LOG_DEBUG, "OSD layout %dx%d, cell %dx%d", frame->width, frame->height, osd->cell_width, osd->cell_height);
+    return 0;
+}
+
+/**
+ * @brief draw_cell 将一个字形从图集复制到画布的第 index 个单元, 并更新该单元的色度透明度
+ */
+static void draw_cell(Osd *osd, int index, int glyph)
+{
+    size_t cell_size = (size_t)osd->cell_width * osd->cell_height;
+    int left = index * osd->cell_width;
+    for (int r = 0; r < osd->cell_height; r++)
+    {
+        size_t offset = (size_t)r * osd->canvas_width + left;
+        memcpy(osd->canvas_alpha + offset, osd->atlas_alpha + glyph * cell_size + r * osd->cell_width, osd->cell_width);
+        memcpy(osd->canvas_value + offset, osd->atlas_value + glyph * cell_size + r * osd->cell_width, osd->cell_width);
+    }
+
+    // 色度取对应亮度块内的最大透明度, 保证细笔画的描边不被下采样抹去
+    int sw = 1 << osd->log2_chroma_w, sh = 1 << osd->log2_chroma_h;
+    int chroma_stride = osd->canvas_width >> osd->log2_chroma_w;
+    for (int cy = 0; cy < osd->cell_height / sh; cy++)
+        for (int cx = 0; cx < osd->cell_width / sw; cx++)
+        {
+            uint8_t alpha = 0;
+            for (int y = 0; y < sh; y++)
+                for (int x = 0; x < sw; x++)
+                    alpha = FFMAX(alpha, osd->canvas_alpha[(size_t)(cy * sh + y) * osd->canvas_width + left + cx * sw + x]);
+            osd->chroma_alpha[(size_t)cy * chroma_stride + (left >> osd->log2_chroma_w) + cx] = alpha;
+        }
+}
+
+/**
+ * @brief update_text 生成新的文本并只重画变化的字符
+ */
+static void update_text(Osd *osd, int64_t wall_time)
+{
+    time_t second = (time_t)(wall_time / 1000000);
+    if (second == osd->second)
+        return;
+    osd->second = second;
+
+    struct tm timeinfo;
+    char text[OSD_TEXT_SIZE] = {0};
+    localtime_r(&second, &timeinfo);
+    strftime(text, sizeof(text), OSD_FORMAT, &timeinfo);
+
+    for (int i = 0; i < OSD_TEXT_SIZE - 1 && (text[i] || osd->text[i]); i++)
+    {
+        if (text[i] == osd->text[i])
+            continue;
+        draw_cell(osd, i, glyph_index(text[i]));
+        osd->redrawn++;
+    }
+    memcpy(osd->text, text, sizeof(text));
+}
+
+Osd *open_osd(OsdConfig config)
+{
+    Osd *osd = (Osd *)calloc(1, sizeof(Osd));
+    if (!osd)
+    {
+        LOG(logger, LOG_ERROR, "Memory allocation failed");
+        return NULL;
+    }
+    osd->config = config;
+    // 左上角对齐到色度采样, 画布在色度平面上也从整数像素开始
+    osd->config.x = FFMAX(0, config.x) & ~3;
+    osd->config.y = FFMAX(0, config.y) & ~3;
+    osd->format = -1;
+    return osd;
+}
+
+int draw_osd(Osd *osd, AVFrame *frame, int64_t wall_time)
+{
+    if ((frame->format != osd->format || frame->width != osd->width || frame->height != osd->height) &&
+        layout_osd(osd, frame) < 0)
+        return -1;
+    update_text(osd, wall_time);
+
+    int x = osd->config.x, y = osd->config.y;
+    int width = FFMIN((int)strlen(osd->text) * osd->cell_width, frame->width - x);
+    int height = FFMIN(osd->cell_height, frame->height - y);
+    if (width <= 0 || height <= 0)
+        return 0;
+    if (av_frame_make_writable(frame) < 0)
+        return -1;
+
+    for (int r = 0; r < height; r++)
+        blend_row(frame->data[0] + (ptrdiff_t)(y + r) * frame->linesize[0] + x,
+                  osd->canvas_value + (size_t)r * osd->canvas_width,
+                  osd->canvas_alpha + (size_t)r * osd->canvas_width, width);
+
+    int lw = osd->log2_chroma_w, lh = osd->log2_chroma_h;
+    int chroma_stride = osd->canvas_width >> lw;
+    int chroma_width = FFMIN(-((-width) >> lw), (-((-frame->width) >> lw)) - (x >> lw));
+    int chroma_height = FFMIN(-((-height) >> lh), (-((-frame->height) >> lh)) - (y >> lh));
+    for (int p = 1; p <= 2; p++)
+        for (int r = 0; r < chroma_height; r++)
+            blend_row(frame->data[p] + (ptrdiff_t)((y >> lh) + r) * frame->linesize[p] + (x >> lw),
+                      osd->chroma_value, osd->chroma_alpha + (size_t)r * chroma_stride, chroma_width);
+    return 0;
+}
+
+void close_osd(Osd *osd)
+{
+    if (!osd)
+        return;
+    LOG(logger, LOG_DEBUG, "OSD redrew %lld characters", (long long)osd->redrawn);
+    free_layout(osd);
+    free(osd);
+}
@@ -0,0 +1,1358 @@
+#include "../../include/pipeline.h"
+
+/**
+ * @brief open_record 关闭当前录像文件并按当前配置开始新的文件
+ * @note 只在编码任务中调用
+ */
+static void open_record(Pipeline *pipeline)
+{
+    if (pipeline->file_output)
+        close_output(pipeline->file_output);
+    pipeline->file_output = NULL;
+
+    time_t rawtime;
+    struct tm timeinfo;
+    char timestamp[20];
+    time(&rawtime);
+    localtime_r(&rawtime, &timeinfo);
+    strftime(timestamp, sizeof(timestamp), "%Y%m%d_%H%M%S", &timeinfo);
+    char path[512];
+    snprintf(path, sizeof(path), "%s/out_%s_%s.mp4", pipeline->settings.video_dir, pipeline->settings.name, timestamp);
+    pipeline->file_output = open_file_output(pipeline->current, pipeline->codec->out_codec_ctx, path, "mp4", pipeline->sink_config);
+    if (pipeline->file_output)
+        LOG(logger, LOG_INFO, "[%s] Start write file: %s", pipeline->settings.name, path);
+}
+
+/**
+ * @brief build_config 合并码率控制器与CPU预算调节器的结果得到编码配置
+ */
+static Config build_config(Pipeline *pipeline)
+{
+    GovernorLevel level = get_governor_level(&pipeline->governor);
+    Config config = scale_config(pipeline->settings.config, FFMAX(pipeline->rate.step, level.step));
+    config.bit_rate = pipeline->rate.bit_rate;
+    config.yuv420 = pipeline->settings.hls.dir[0] != '\0';
+    if (pipeline->governor.config.budget > 0)
+        snprintf(config.preset, sizeof(config.preset), "%s", level.preset);
+    return config;
+}
+
+/**
+ * @brief reconfig_pipeline 按当前调节结果重新打开编码器, 尺寸或参数集变化时一并重新打开输出器
+ * @note 新的编码器从关键帧开始; 推流在帧率不变时保持连接, 新的参数集随关键帧发送,
+ *       其余输出器与录像以新的参数集重新写入文件头
+ */
+static void reconfig_pipeline(Pipeline *pipeline)
+{
+    Config config = build_config(pipeline);
+    // 帧率变化时输出流的时间基随之变化, 与尺寸变化一样重新打开输出器
+    int retime = av_cmp_q(config.time_base, pipeline->current.time_base) != 0;
+    int resize = config.width != pipeline->current.width || config.height != pipeline->current.height || retime;
+
+    // 编码器内部线程继承调用线程的CPU集合
+    ThreadRole role = get_thread_role();
+    apply_affinity(ROLE_ENCODE);
+    int ret = reconfig_codec(pipeline->codec, config);
+    apply_affinity(role);
+    if (ret < 0)
+    {
+        pipeline->failed = 1;
+        return;
+    }
+    pipeline->current = config;
+    pipeline->pending = 0;
+    // 运行时启用的 HLS 输出等到编码器改为 4:2:0 后才打开
+    int hls = pipeline->settings.hls.dir[0] != '\0';
+    if (!resize && ret == 0 && (pipeline->hls_output || !hls))
+        return;
+
+    // 重新连接会中断直播会话, 能在流中更新参数集时保持连接
+    if (pipeline->rtmp_output && !retime && rebind_output(pipeline->rtmp_output, pipeline->codec->out_codec_ctx) == 0)
+        LOG(logger, LOG_INFO, "[%s] Keep rtmp connection at %ux%u", pipeline->settings.name, config.width,
+            config.height);
+    else if (pipeline->settings.rtmp[0] != '\0')
+    {
+        if (pipeline->rtmp_output)
+            close_output(pipeline->rtmp_output);
+        pipeline->rtmp_output = open_live_output(config, pipeline->codec->out_codec_ctx, pipeline->settings.rtmp, "flv",
+                                                 pipeline->settings.rate.queue_size);
+        if (!pipeline->rtmp_output)
+            LOG(logger, LOG_WARNING, "[%s] Reopen rtmp output failed", pipeline->settings.name);
+    }
+    if (pipeline->udp_output)
+        close_output(pipeline->udp_output);
+    pipeline->udp_output = NULL;
+    if (pipeline->settings.udp[0] != '\0')
+    {
+        pipeline->udp_output = open_udp_output(config, pipeline->codec->out_codec_ctx, pipeline->settings.udp);
+        if (!pipeline->udp_output)
+            LOG(logger, LOG_WARNING, "[%s] Reopen udp output failed", pipeline->settings.name);
+    }
+    if (hls)
+    {
+        // 接续媒体序号, 新的初始化段以不连续序号区分
+        unsigned int sequence = 0, discontinuity = 0;
+        if (pipeline->hls_output)
+        {
+            sequence = pipeline->hls_output->hls->current.sequence + 1;
+            discontinuity = pipeline->hls_output->hls->discontinuity + 1;
+            close_output(pipeline->hls_output);
+        }
+        pipeline->hls_output = open_hls_output(config, pipeline->codec->out_codec_ctx, pipeline->settings.hls,
+                                               pipeline->settings.name, sequence, discontinuity);
+        if (!pipeline->hls_output)
+            LOG(logger, LOG_WARNING, "[%s] Open HLS output failed", pipeline->settings.name);
+    }
+    if (pipeline->file_output)
+        open_record(pipeline);
+}
+
+/**
+ * @brief adapt_rate 根据直播发送队列的状态调整码率与分辨率
+ * @note 只在编码任务中调用
+ */
+static void adapt_rate(Pipeline *pipeline)
+{
+    LiveStat live = get_live_writer_stat(pipeline->rtmp_output->live);
+    if (live.state == LIVE_FAILED)
+    {
+        LOG(logger, LOG_WARNING, "[%s] Connect rtmp output failed, record only", pipeline->settings.name);
+        close_output(pipeline->rtmp_output);
+        pipeline->rtmp_output = NULL;
+        return;
+    }
+    if (live.need_key)
+        pipeline->force_key = 1;
+    // 连接期间队列为空, 不能据此调节码率
+    if (live.state != LIVE_CONNECTED)
+        return;
+
+    // 编码器由推流与录像共用, 录像时不为直播链路降低分辨率, 否则录像文件随之轮换且画面缩小;
+    // 降低的码率同样作用于录像
+    pipeline->rate.config.scale_steps = pipeline->settings.video_dir[0] != '\0'
+                                            ? 0
+                                            : FFMIN(pipeline->settings.rate.scale_steps, RATE_MAX_STEPS);
+
+    switch (update_rate_controller(&pipeline->rate, live.depth, live.latency, av_gettime_relative()))
+    {
+    case RATE_BITRATE:
+        if (set_codec_bit_rate(pipeline->codec, pipeline->rate.bit_rate) < 0)
+        {
+            // 码率在下次重新打开编码器时生效, 拥塞持续时控制器转而降低分辨率
+            LOG(logger, LOG_DEBUG, "[%s] %s cannot change bit rate at runtime, skip", pipeline->settings.name,
+                pipeline->codec->backend->name);
+            break;
+        }
+        pipeline->current.bit_rate = pipeline->rate.bit_rate;
+        LOG(logger, LOG_INFO, "[%s] Live queue %u, latency %lld ms, bit rate -> %lld",
+            pipeline->settings.name, live.depth, (long long)(live.latency / 1000), (long long)pipeline->rate.bit_rate);
+        break;
+    case RATE_RESOLUTION:
+        // 与CPU预算调节一样推迟到GOP结束, 在本来就会输出的关键帧处切换
+        LOG(logger, LOG_INFO, "[%s] Live queue %u, latency %lld ms, resolution step -> %u at next GOP",
+            pipeline->settings.name, live.depth, (long long)(live.latency / 1000), pipeline->rate.step);
+        pipeline->pending = 1;
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief govern_cpu 累计一帧的CPU时间, 调节级数改变时安排在GOP结束时重新配置
+ * @note 只在编码任务中调用
+ */
+static void govern_cpu(Pipeline *pipeline, int64_t encode_cpu)
+{
+    int64_t decode_cpu = get_decode_pool_cpu_time(pipeline->codec->decoder);
+    int64_t cpu_time = encode_cpu + decode_cpu - pipeline->decode_cpu;
+    pipeline->decode_cpu = decode_cpu;
+    if (!update_governor(&pipeline->governor, cpu_time, av_gettime_relative()))
+        return;
+
+    GovernorLevel level = get_governor_level(&pipeline->governor);
+    LOG(logger, LOG_INFO, "[%s] CPU %.2f / %.2f cores, level %u: preset %s, decimate %u, resolution step %u",
+        pipeline->settings.name, pipeline->governor.usage, pipeline->governor.config.budget,
+        pipeline->governor.level, level.preset, level.decimate, level.step);
+
+    pthread_mutex_lock(&pipeline->mutex);
+    pipeline->decimate = level.decimate;
+    pthread_mutex_unlock(&pipeline->mutex);
+
+    Config config = build_config(pipeline);
+    if (strcmp(config.preset, pipeline->current.preset) != 0 || config.width != pipeline->current.width)
+        pipeline->pending = 1;
+}
+
+/**
+ * @brief apply_changes 应用控制接口的修改, 只重建受影响的部分
+ * @note 只在编码任务中调用; 新打开的输出器从关键帧开始
+ */
+static void apply_changes(Pipeline *pipeline)
+{
+    pthread_mutex_lock(&pipeline->mutex);
+    if (!pipeline->changed)
+    {
+        pthread_mutex_unlock(&pipeline->mutex);
+        return;
+    }
+    CameraSettings target = pipeline->target;
+    pipeline->changed = 0;
+    pthread_mutex_unlock(&pipeline->mutex);
+
+    CameraSettings *settings = &pipeline->settings;
+    const AVCodecContext *encoder = pipeline->codec->out_codec_ctx;
+    if (target.config.bit_rate != settings->config.bit_rate)
+    {
+        settings->config.bit_rate = target.config.bit_rate;
+        set_rate_controller_bit_rate(&pipeline->rate, target.config.bit_rate);
+        // 不支持运行时修改码率的后端在GOP结束时重新打开编码器
+        int deferred = set_codec_bit_rate(pipeline->codec, pipeline->rate.bit_rate) < 0;
+        if (deferred)
+            pipeline->pending = 1;
+        else
+            pipeline->current.bit_rate = pipeline->rate.bit_rate;
+        LOG(logger, LOG_INFO, "[%s] Change bit rate to %lld%s", settings->name, (long long)target.config.bit_rate,
+            deferred ? " at next GOP" : "");
+    }
+
+    if (strcmp(target.rtmp, settings->rtmp) != 0)
+    {
+        memcpy(settings->rtmp, target.rtmp, sizeof(settings->rtmp));
+        if (pipeline->rtmp_output)
+            close_output(pipeline->rtmp_output);
+        pipeline->rtmp_output = NULL;
+        if (settings->rtmp[0] != '\0' &&
+            !(pipeline->rtmp_output = open_live_output(pipeline->current, encoder, settings->rtmp, "flv",
+                                                       settings->rate.queue_size)))
+            LOG(logger, LOG_WARNING, "[%s] Open rtmp output failed", settings->name);
+        LOG(logger, LOG_INFO, "[%s] Change rtmp output to `%s`", settings->name, settings->rtmp);
+    }
+    if (strcmp(target.udp, settings->udp) != 0)
+    {
+        memcpy(settings->udp, target.udp, sizeof(settings->udp));
+        if (pipeline->udp_output)
+            close_output(pipeline->udp_output);
+        pipeline->udp_output = NULL;
+        if (settings->udp[0] != '\0' &&
+            !(pipeline->udp_output = open_udp_output(pipeline->current, encoder, settings->udp)))
+            LOG(logger, LOG_WARNING, "[%s] Open udp output failed", settings->name);
+        pipeline->force_key = 1;
+        LOG(logger, LOG_INFO, "[%s] Change udp output to `%s`", settings->name, settings->udp);
+    }
+    if (strcmp(target.hls.dir, settings->hls.dir) != 0)
+    {
+        memcpy(settings->hls.dir, target.hls.dir, sizeof(settings->hls.dir));
+        if (pipeline->hls_output)
+            close_output(pipeline->hls_output);
+        pipeline->hls_output = NULL;
+        // 编码器输出 4:2:2 时先在GOP结束时改为 4:2:0, 重新配置时再打开
+        int deferred = settings->hls.dir[0] != '\0' && encoder->pix_fmt != AV_PIX_FMT_YUV420P;
+        if (deferred)
+            pipeline->pending = 1;
+        else if (settings->hls.dir[0] != '\0' &&
+                 !(pipeline->hls_output =
+                       open_hls_output(pipeline->current, encoder, settings->hls, settings->name, 0, 0)))
+            LOG(logger, LOG_WARNING, "[%s] Open HLS output failed", settings->name);
+        pipeline->force_key = 1;
+        LOG(logger, LOG_INFO, "[%s] Change HLS output to `%s`%s", settings->name, settings->hls.dir,
+            deferred ? " at next GOP" : "");
+    }
+    if (strcmp(target.video_dir, settings->video_dir) != 0)
+    {
+        // 新的录像文件在本帧开始
+        memcpy(settings->video_dir, target.video_dir, sizeof(settings->video_dir));
+        if (pipeline->file_output)
+            close_output(pipeline->file_output);
+        pipeline->file_output = NULL;
+        pipeline->segment = -1;
+        pipeline->force_key = 1;
+        LOG(logger, LOG_INFO, "[%s] Change video dir to `%s`", settings->name, settings->video_dir);
+    }
+
+    // 采集线程已切换驱动缓冲区, 切换前的帧按旧尺寸缩放; 编码器推迟到GOP结束时切换
+    if (target.config.width != settings->config.width || target.config.height != settings->config.height ||
+        av_cmp_q(target.config.time_base, settings->config.time_base) != 0)
+    {
+        settings->config.width = target.config.width;
+        settings->config.height = target.config.height;
+        settings->config.time_base = target.config.time_base;
+        pipeline->pending = 1;
+    }
+}
+
+/**
+ * @brief encode_ready 按序编码已解码完成的帧
+ * @param max 最多编码的帧数 为0时不限制
+ * @return 取出的帧数
+ */
+static unsigned int encode_ready(Pipeline *pipeline, unsigned int max)
+{
+    unsigned int save_frame = get_save_frame(pipeline->settings.config);
+    unsigned int num = 0;
+    DecodedFrame decoded;
+    int ret;
+    while ((max == 0 || num < max) && (ret = receive_codec(pipeline->codec, &decoded)) != -2)
+    {
+        num++;
+        if (ret == -1)
+        {
+            pthread_mutex_lock(&pipeline->mutex);
+            pipeline->stat.decode_failed++;
+            pthread_mutex_unlock(&pipeline->mutex);
+            continue;
+        }
+        if (pipeline->failed)
+        {
+            av_frame_free(&decoded.frame);
+            continue;
+        }
+
+        apply_changes(pipeline);
+        if (pipeline->rtmp_output && pipeline->rtmp_output->live)
+            adapt_rate(pipeline);
+        // 预设与分辨率的调节推迟到本来就会输出关键帧时
+        if (pipeline->pending && is_codec_gop_end(pipeline->codec))
+            reconfig_pipeline(pipeline);
+        if (pipeline->failed)
+        {
+            av_frame_free(&decoded.frame);
+            continue;
+        }
+
+        // 按采集序号分段, 抽帧与丢帧不影响文件时长
+        int64_t segment = decoded.time_stamp / save_frame;
+        if (pipeline->settings.video_dir[0] != '\0' && segment != pipeline->segment)
+        {
+            open_record(pipeline);
+            pipeline->segment = segment;
+        }
+
+        int64_t encode_cpu = get_thread_cpu_time();
+        // 降噪在遮挡与水印之前, 历史帧中不会混入叠加的内容
+        if (pipeline->denoiser && denoise_frame(pipeline->denoiser, decoded.frame) < 0)
+        {
+            LOG(logger, LOG_WARNING, "[%s] Denoise failed, disable it", pipeline->settings.name);
+            close_denoiser(pipeline->denoiser);
+            pipeline->denoiser = NULL;
+        }
+        // 遮挡失败时不能输出未遮挡的画面, 停止编码
+        if (pipeline->mask && apply_privacy_mask(pipeline->mask, decoded.frame) < 0)
+        {
+            LOG(logger, LOG_ERROR, "[%s] Apply privacy mask failed, stop pipeline", pipeline->settings.name);
+            pthread_mutex_lock(&pipeline->mutex);
+            pipeline->failed = 1;
+            pthread_mutex_unlock(&pipeline->mutex);
+            av_frame_free(&decoded.frame);
+            continue;
+        }
+        // 旁路在遮挡之后 水印之前, 分析进程拿到的画面不含叠加的内容
+        if (pipeline->tap && publish_frame_tap(pipeline->tap, decoded.frame, decoded.capture_time) < 0)
+        {
+            LOG(logger, LOG_WARNING, "[%s] Publish frame tap failed, disable it", pipeline->settings.name);
+            close_frame_tap(pipeline->tap);
+            pipeline->tap = NULL;
+        }
+        // 采集时刻由单调时钟换算为墙上时间
+        if (pipeline->osd &&
+            draw_osd(pipeline->osd, decoded.frame, av_gettime() - (av_gettime_relative() - decoded.capture_time)) < 0)
+        {
+            LOG(logger, LOG_WARNING, "[%s] Draw OSD failed, disable it", pipeline->settings.name);
+            close_osd(pipeline->osd);
+            pipeline->osd = NULL;
+        }
+        Output *output[4] = {pipeline->rtmp_output, pipeline->udp_output, pipeline->hls_output, pipeline->file_output};
+        ret = dispose_codec(pipeline->codec, output, 4, decoded.frame, decoded.time_stamp, pipeline->force_key);
+        pipeline->force_key = 0;
+        av_frame_free(&decoded.frame);
+        encode_cpu = get_thread_cpu_time() - encode_cpu;
+        int64_t latency = av_gettime_relative() - decoded.capture_time;
+
+        pthread_mutex_lock(&pipeline->mutex);
+        if (ret < 0)
+            pipeline->failed = 1;
+        else
+        {
+            pipeline->stat.encoded++;
+            pipeline->stat.latency_sum += latency;
+            if (latency > pipeline->stat.latency_max)
+                pipeline->stat.latency_max = latency;
+            pipeline->stat.packet.packets = pipeline->codec->packet.packets;
+            pipeline->stat.packet.bytes = pipeline->codec->packet.bytes;
+            pipeline->stat.packet.square = pipeline->codec->packet.square;
+            pipeline->stat.packet.max = FFMAX(pipeline->stat.packet.max, pipeline->codec->packet.max);
+            pipeline->codec->packet.max = 0;
+            // 录像时以第一帧写入文件为准, 不录像时以第一帧编码输出为准
+            if (pipeline->stat.first_frame == 0 &&
+                (pipeline->file_output || pipeline->settings.video_dir[0] == '\0'))
+            {
+                pipeline->stat.first_frame = av_gettime_relative() - pipeline->open_time;
+                LOG(logger, LOG_INFO, "[%s] First frame %s %.1f ms after open", pipeline->settings.name,
+                    pipeline->file_output ? "recorded" : "encoded", pipeline->stat.first_frame / 1000.0);
+            }
+        }
+        pthread_mutex_unlock(&pipeline->mutex);
+        if (ret < 0)
+        {
+            LOG(logger, LOG_ERROR, "[%s] Encode failed, stop pipeline", pipeline->settings.name);
+            continue;
+        }
+
+        govern_cpu(pipeline, encode_cpu);
+        pthread_mutex_lock(&pipeline->mutex);
+        pipeline->stat.cpu_usage = pipeline->governor.usage;
+        pipeline->stat.level = pipeline->governor.level;
+        if (pipeline->codec->motion)
+            pipeline->stat.motion = get_motion_map_stat(pipeline->codec->motion);
+        if (pipeline->denoiser)
+            pipeline->stat.denoise = get_denoiser_stat(pipeline->denoiser);
+        if (pipeline->tap)
+            pipeline->stat.tap = get_frame_tap_stat(pipeline->tap);
+        if (pipeline->udp_output)
+        {
+            UdpStat udp = get_udp_sender_stat(pipeline->udp_output->udp);
+            pipeline->stat.udp.sent += udp.sent;
+            pipeline->stat.udp.dropped += udp.dropped;
+            pipeline->stat.udp.failed += udp.failed;
+            pipeline->stat.udp.batches += udp.batches;
+            pipeline->stat.udp.max_depth = FFMAX(pipeline->stat.udp.max_depth, udp.max_depth);
+        }
+        pthread_mutex_unlock(&pipeline->mutex);
+    }
+    return num;
+}
+
+/**
+ * @brief encode_task 编码任务
+ * @note 每次最多编码 PIPELINE_BATCH 帧, 仍有帧时重新排队, 让其他相机的任务轮流执行
+ */
+static void encode_task(void *arg)
+{
+    Pipeline *pipeline = (Pipeline *)arg;
+
+    while (1)
+    {
+        unsigned int num = encode_ready(pipeline, PIPELINE_BATCH);
+
+        pthread_mutex_lock(&pipeline->mutex);
+        if (num < PIPELINE_BATCH && !pipeline->dirty)
+        {
+            pipeline->encoding = 0;
+            pthread_cond_broadcast(&pipeline->cond);
+            pthread_mutex_unlock(&pipeline->mutex);
+            return;
+        }
+        pipeline->dirty = 0;
+        pthread_mutex_unlock(&pipeline->mutex);
+
+        // 排队失败时继续在本线程编码
+        if (submit_worker_pool(pipeline->workers, encode_task, pipeline) == 0)
+            return;
+    }
+}
+
+/**
+ * @brief on_decoded 有帧解码完成时调度编码任务
+ */
+static void on_decoded(void *opaque)
+{
+    Pipeline *pipeline = (Pipeline *)opaque;
+
+    pthread_mutex_lock(&pipeline->mutex);
+    if (pipeline->encoding)
+    {
+        // 由执行中的编码任务处理
+        pipeline->dirty = 1;
+        pthread_mutex_unlock(&pipeline->mutex);
+        return;
+    }
+    pipeline->encoding = 1;
+    pthread_mutex_unlock(&pipeline->mutex);
+
+    if (submit_worker_pool(pipeline->workers, encode_task, pipeline) < 0)
+        encode_task(pipeline);
+}
+
+/**
+ * @brief CameraStartup 并行打开相机的参数与结果
+ * @property device 设备路径
+ * @property name 相机名称
+ * @property config 采集配置
+ * @property camera 打开的相机 失败时为NULL
+ * @property time 打开耗时 单位:us
+ */
+typedef struct CameraStartup
+{
+    const char *device;
+    const char *name;
+    Config config;
+    Camera *camera;
+    int64_t time;
+} CameraStartup;
+
+/**
+ * @brief start_camera 初始化 配置并打开相机 与编码器的初始化并行执行
+ */
+static void *start_camera(void *arg)
+{
+    CameraStartup *startup = (CameraStartup *)arg;
+    int64_t start = av_gettime_relative();
+    Camera *camera = init_camera(startup->device);
+    if (camera)
+    {
+        if (set_camera_config(camera, startup->config) < 0)
+            LOG(logger, LOG_WARNING, "[%s] Set camera config failed", startup->name);
+        if (open_camera(camera) < 0)
+        {
+            destroy_camera(camera);
+            camera = NULL;
+        }
+    }
+    startup->camera = camera;
+    startup->time = av_gettime_relative() - start;
+    return NULL;
+}
+
+/**
+ * @brief ModeMeasure 一个采集模式的实测结果
+ * @property fps 实际送达的帧率
+ * @property bytes 平均单帧字节数
+ * @property cpu 解码 转换为编码格式并编码的平均单帧CPU时间 单位:us
+ */
+typedef struct ModeMeasure
+{
+    double fps;
+    double bytes;
+    double cpu;
+} ModeMeasure;
+
+/**
+ * @brief measure_mode 以一个模式采集, 测量帧率 单帧字节数与单帧CPU
+ * @note 在调用线程中同步解码并单线程编码, 编码器按模式的分辨率运行, 与选中后的流水线一致;
+ *       没有可用的编码器时只测量解码与转换
+ * @param backend 编码器后端 为NULL时不编码
+ * @param encode 编码配置 分辨率与帧率取自模式
+ * @return int 成功返回0, 相机或编解码器打开失败返回-1
+ */
+static int measure_mode(const char *device, Config mode, unsigned int duration, const EncoderBackend *backend,
+                        Config encode, ModeMeasure *measure)
+{
+    AVCodec *decoder = find_input_decoder(mode.pix_format);
+    AVCodecContext *ctx = decoder ? avcodec_alloc_context3(decoder) : NULL;
+    AVCodecContext *encoder = NULL;
+    AVPacket *packet = av_packet_alloc();
+    AVPacket *encoded = av_packet_alloc();
+    AVFrame *frame = av_frame_alloc();
+    AVFrame *converted = av_frame_alloc();
+    struct SwsContext *scaler = NULL;
+    Camera *camera = NULL;
+    int ret = -1;
+    if (!ctx || !packet || !encoded || !frame || !converted || duration == 0)
+        goto end;
+    ctx->width = mode.width;
+    ctx->height = mode.height;
+    ctx->pix_fmt = get_input_pix_fmt(mode.pix_format);
+    ctx->thread_count = 1;
+    if (avcodec_open2(ctx, decoder, NULL) < 0)
+        goto end;
+    // 编码器单线程运行, 编码的CPU时间全部计入调用线程
+    encode.width = mode.width;
+    encode.height = mode.height;
+    encode.time_base = mode.time_base;
+    encode.encode_threads = 1;
+    if (backend && !(encoder = open_encoder_context(backend, encode)))
+        goto end;
+    converted->width = mode.width;
+    converted->height = mode.height;
+    converted->format = encoder ? encoder->pix_fmt : AV_PIX_FMT_YUV420P;
+    if (av_frame_get_buffer(converted, 0) < 0)
+        goto end;
+
+    camera = init_camera(device);
+    if (!camera)
+        goto end;
+    if (set_camera_config(camera, mode) < 0 || open_camera(camera) < 0)
+    {
+        destroy_camera(camera);
+        camera = NULL;
+        goto end;
+    }
+
+    int64_t begin = av_gettime_relative() + MODE_WARMUP;
+    int64_t finish = begin + (int64_t)duration * 1000;
+    int64_t frames = 0, bytes = 0, cpu = 0, frames_sent = 0;
+    struct pollfd pfd = {camera->fd, POLLIN, 0};
+    while (av_gettime_relative() < finish)
+    {
+        if (poll(&pfd, 1, 100) <= 0)
+            continue;
+        BufType *buf = get_frame(camera);
+        if (!buf)
+            continue;
+
+        int64_t start = get_thread_cpu_time();
+        packet->data = (uint8_t *)buf->start;
+        packet->size = buf->length;
+        if (avcodec_send_packet(ctx, packet) == 0 && avcodec_receive_frame(ctx, frame) == 0)
+        {
+            scaler = sws_getCachedContext(scaler, frame->width, frame->height, frame->format, converted->width,
+                                          converted->height, converted->format, SWS_BILINEAR, NULL, NULL, NULL);
+            // 编码器可能仍引用上一帧
+            if (scaler && av_frame_make_writable(converted) == 0)
+            {
+                sws_scale(scaler, (const uint8_t *const *)frame->data, frame->linesize, 0, frame->height,
+                          converted->data, converted->linesize);
+                converted->pts = frames_sent++;
+                if (encoder && avcodec_send_frame(encoder, converted) == 0)
+                    while (avcodec_receive_packet(encoder, encoded) == 0)
+                        av_packet_unref(encoded);
+            }
+            av_frame_unref(frame);
+        }
+        av_packet_unref(packet);
+        if (buf->capture_time >= begin)
+        {
+            frames++;
+            bytes += buf->length;
+            cpu += get_thread_cpu_time() - start;
+        }
+        destroy_buf(buf);
+    }
+    close_camera(camera);
+    destroy_camera(camera);
+
+    measure->fps = frames * 1000.0 / duration;
+    measure->bytes = frames > 0 ? (double)bytes / frames : 0;
+    measure->cpu = frames > 0 ? (double)cpu / frames : 0;
+    ret = 0;
+
+end:
+    sws_freeContext(scaler);
+    av_frame_free(&converted);
+    av_frame_free(&frame);
+    av_packet_free(&encoded);
+    av_packet_free(&packet);
+    avcodec_free_context(&encoder);
+    avcodec_free_context(&ctx);
+    return ret;
+}
+
+/**
+ * @brief add_mode_candidate 加入一个候选模式, 按像素数从小到大排列;
+ *        同一格式与分辨率只保留满足帧率下限的最低标称帧率
+ */
+static void add_mode_candidate(Array *candidates, Config mode)
+{
+    for (unsigned int i = 0; i < candidates->length; i++)
+    {
+        Config *candidate = ARRAY_GET(candidates, Config, i);
+        if (candidate->width == mode.width && candidate->height == mode.height &&
+            candidate->pix_format == mode.pix_format)
+        {
+            if (av_cmp_q(mode.time_base, candidate->time_base) > 0)
+                candidate->time_base = mode.time_base;
+            return;
+        }
+    }
+    if (append_array(candidates, &mode) < 0)
+        return;
+    for (unsigned int i = candidates->length - 1; i > 0; i--)
+    {
+        Config *prev = ARRAY_GET(candidates, Config, i - 1);
+        Config *curr = ARRAY_GET(candidates, Config, i);
+        if ((int64_t)prev->width * prev->height <= (int64_t)curr->width * curr->height)
+            break;
+        Config tmp = *prev;
+        *prev = *curr;
+        *curr = tmp;
+    }
+}
+
+int calibrate_capture(CameraSettings *settings, Array *configs)
+{
+    Config request = settings->config;
+    unsigned int min_fps = settings->mode.min_fps;
+    if (min_fps == 0)
+        min_fps = (unsigned int)lrint(av_q2d(av_inv_q(request.time_base)));
+    double fps_floor = min_fps * MODE_FPS_TOLERANCE;
+
+    Array *candidates = create_array(sizeof(Config), 8);
+    if (!candidates)
+        return -1;
+    for (unsigned int i = 0; i < configs->length; i++)
+    {
+        Config mode = *ARRAY_GET(configs, Config, i);
+        if (mode.width < request.width || mode.height < request.height)
+            continue;
+        // 帧间隔未知时按下限请求
+        if (mode.time_base.num == 0)
+            mode.time_base = (AVRational){1, (int)min_fps};
+        else if (av_q2d(av_inv_q(mode.time_base)) < fps_floor)
+            continue;
+        add_mode_candidate(candidates, mode);
+    }
+    if (candidates->length == 0)
+    {
+        LOG(logger, LOG_WARNING, "[%s] No camera mode reaches %ux%u at %u fps", settings->name, request.width,
+            request.height, min_fps);
+        free_array(candidates);
+        return -1;
+    }
+
+    // 选中的模式决定编码的分辨率, 编码的开销随模式计入; 编码器后端尚未校准时取首个可用的后端
+    const EncoderBackend *backend = find_encoder_backend(request.encoder);
+    Config encode = request;
+    encode.yuv420 = settings->hls.dir[0] != '\0';
+    if (!backend)
+        LOG(logger, LOG_WARNING, "[%s] Encoder `%s` not available, calibrate capture without encoding",
+            settings->name, request.encoder);
+
+    Config best = {0}, fastest = {0};
+    ModeMeasure best_measure = {0}, fastest_measure = {0};
+    int found = 0, measured = 0;
+    for (unsigned int i = 0; i < candidates->length && i < MODE_MAX_CANDIDATES; i++)
+    {
+        Config mode = *ARRAY_GET(candidates, Config, i);
+        ModeMeasure measure;
+        if (measure_mode(settings->device, mode, settings->mode.duration, backend, encode, &measure) < 0)
+        {
+            LOG(logger, LOG_WARNING, "[%s] Measure camera mode %ux%u failed", settings->name, mode.width,
+                mode.height);
+            continue;
+        }
+        LOG(logger, LOG_INFO, "[%s] Calibrate %s %ux%u at %.2f fps: %.2f fps delivered, %.0f bytes, %.2f ms CPU per frame",
+            settings->name, mode.pix_format == MJPEG ? "MJPEG" : "YUYV", mode.width, mode.height,
+            av_q2d(av_inv_q(mode.time_base)), measure.fps, measure.bytes, measure.cpu / 1000);
+
+        // 实际帧率低于标称值时按实测帧率打时间戳
+        if (measure.fps < av_q2d(av_inv_q(mode.time_base)) * MODE_FPS_TOLERANCE && measure.fps >= 1)
+            mode.time_base = (AVRational){1, (int)lrint(measure.fps)};
+        if (!measured || measure.fps > fastest_measure.fps)
+        {
+            fastest = mode;
+            fastest_measure = measure;
+        }
+        measured = 1;
+        if (measure.fps < fps_floor)
+            continue;
+        if (!found || measure.cpu < best_measure.cpu * (1 - MODE_CPU_MARGIN) ||
+            (measure.cpu <= best_measure.cpu * (1 + MODE_CPU_MARGIN) && measure.bytes < best_measure.bytes))
+        {
+            best = mode;
+            best_measure = measure;
+            found = 1;
+        }
+    }
+    free_array(candidates);
+
+    if (!measured)
+        return -1;
+    if (!found)
+    {
+        LOG(logger, LOG_WARNING, "[%s] No camera mode delivers %u fps, use the fastest", settings->name, min_fps);
+        best = fastest;
+    }
+    settings->config.width = best.width;
+    settings->config.height = best.height;
+    settings->config.pix_format = best.pix_format;
+    settings->config.time_base = best.time_base;
+    LOG(logger, LOG_INFO, "[%s] Select camera mode %s %ux%u at %.2f fps", settings->name,
+        best.pix_format == MJPEG ? "MJPEG" : "YUYV", best.width, best.height, av_q2d(av_inv_q(best.time_base)));
+    return 0;
+}
+
+int calibrate_pipeline(CameraSettings *settings)
+{
+    if (settings->config.encoder[0] != '\0' && strcmp(settings->config.encoder, "auto") != 0)
+        return 0;
+
+    // 推流与录像的封装格式都要能容纳选出的码流
+    const char *formats[4] = {NULL, NULL, NULL, NULL};
+    int num = 0;
+    if (settings->rtmp[0] != '\0')
+        formats[num++] = "flv";
+    if (settings->udp[0] != '\0')
+        formats[num++] = "mpegts";
+    if (settings->video_dir[0] != '\0' || settings->hls.dir[0] != '\0')
+        formats[num++] = "mp4";
+
+    // 与 open_pipeline 一致: 启用CPU预算时编码器单线程运行
+    Config config = settings->config;
+    config.yuv420 = settings->hls.dir[0] != '\0';
+    if (settings->governor.budget > 0)
+        config.encode_threads = 1;
+
+    ThreadRole role = get_thread_role();
+    apply_affinity(ROLE_ENCODE);
+    int ret = calibrate_encoder(&config, formats, settings->governor.budget);
+    apply_affinity(role);
+    if (ret < 0)
+        return -1;
+    memcpy(settings->config.encoder, config.encoder, sizeof(config.encoder));
+    memcpy(settings->config.preset, config.preset, sizeof(config.preset));
+    return 0;
+}
+
+Pipeline *open_pipeline(const CameraSettings *settings, SinkConfig sink_config, const char *caps_dir,
+                        WorkerPool *workers)
+{
+    Pipeline *pipeline = (Pipeline *)calloc(1, sizeof(Pipeline));
+    if (!pipeline)
+    {
+        LOG(logger, LOG_ERROR, "Memory allocation failed");
+        return NULL;
+    }
+    const EncoderBackend *backend = find_encoder_backend(settings->config.encoder);
+    if (!backend)
+    {
+        LOG(logger, LOG_ERROR, "[%s] Encoder `%s` not available", settings->name, settings->config.encoder);
+        free(pipeline);
+        return NULL;
+    }
+    pipeline->settings = *settings;
+    pipeline->sink_config = sink_config;
+    pipeline->workers = workers;
+    pipeline->current = settings->config;
+    pipeline->current.yuv420 = settings->hls.dir[0] != '\0';
+    pipeline->decimate = 1;
+    pipeline->segment = -1;
+    pipeline->open_time = av_gettime_relative();
+    init_rate_controller(&pipeline->rate, settings->rate, settings->config.bit_rate);
+    init_governor(&pipeline->governor, settings->governor, backend, settings->config.preset);
+    // 编码器单线程运行时, 编码线程的CPU时间即为编码的全部开销
+    if (settings->governor.budget > 0 && pipeline->current.encode_threads != 1)
+    {
+        LOG(logger, LOG_INFO, "[%s] CPU budget enabled, encode with one thread", settings->name);
+        pipeline->current.encode_threads = 1;
+        pipeline->settings.config.encode_threads = 1;
+    }
+    pipeline->target = pipeline->settings;
+    pthread_mutex_init(&pipeline->mutex, NULL);
+    pthread_cond_init(&pipeline->cond, NULL);
+
+    // 相机的格式协商与缓冲区映射和编码器的初始化互不依赖, 并行进行
+    Config config = pipeline->current;
+    pipeline->capture = config;
+    CameraStartup startup = {settings->device, settings->name, config, NULL, 0};
+    pthread_t camera_thread;
+    int threaded = pthread_create(&camera_thread, NULL, start_camera, &startup) == 0;
+    if (!threaded)
+        start_camera(&startup);
+
+    int64_t codec_time = av_gettime_relative();
+    pipeline->codec = init_codec(LOG_INFO);
+    int ret = -1;
+    if (pipeline->codec)
+    {
+        // 编码器内部线程在打开时创建并继承调用线程的CPU集合与调度策略
+        ThreadRole role = get_thread_role();
+        apply_affinity(ROLE_ENCODE);
+        ret = open_codec(pipeline->codec, config, workers, on_decoded, pipeline);
+        apply_affinity(role);
+    }
+    codec_time = av_gettime_relative() - codec_time;
+
+    if (threaded)
+        pthread_join(camera_thread, NULL);
+    pipeline->camera = startup.camera;
+    if (ret)
+    {
+        if (pipeline->codec)
+        {
+            close_codec(pipeline->codec);
+            destroy_codec(pipeline->codec);
+        }
+        if (pipeline->camera)
+            goto fail_camera;
+        goto fail;
+    }
+    if (!pipeline->camera)
+    {
+        close_codec(pipeline->codec);
+        destroy_codec(pipeline->codec);
+        goto fail;
+    }
+    // 启动前已检查过能力, 有缓存时只读取缓存文件
+    pipeline->configs = load_camera_configs(pipeline->camera, caps_dir);
+    if (pipeline->configs && pipeline->configs->length == 0)
+    {
+        free_array(pipeline->configs);
+        pipeline->configs = NULL;
+    }
+    if (!pipeline->configs)
+        LOG(logger, LOG_WARNING, "[%s] Camera modes unknown, runtime changes are not checked", settings->name);
+
+    if (settings->mask.num > 0 &&
+        !(pipeline->mask = open_privacy_mask(settings->mask, settings->config.width, settings->config.height)))
+    {
+        close_codec(pipeline->codec);
+        destroy_codec(pipeline->codec);
+        goto fail_camera;
+    }
+    // 快照直接发布采集的 JPEG, 遮挡区域无法在其中抹去
+    if (settings->snapshot.enable && settings->mask.num > 0)
+        LOG(logger, LOG_WARNING, "[%s] Snapshot would bypass the privacy mask, disabled", settings->name);
+    else if (settings->snapshot.enable && settings->config.pix_format != MJPEG)
+        LOG(logger, LOG_WARNING, "[%s] Snapshot needs MJPEG capture, disabled", settings->name);
+    else if (settings->snapshot.enable &&
+             !(pipeline->snapshot = open_snapshot(settings->snapshot, settings->name, settings->config.width, workers)))
+        LOG(logger, LOG_WARNING, "[%s] Open snapshot failed", settings->name);
+    if (settings->tap.enable &&
+        !(pipeline->tap = open_frame_tap(settings->tap, settings->name, settings->config.width, settings->config.height)))
+        LOG(logger, LOG_WARNING, "[%s] Open frame tap failed", settings->name);
+    if (settings->denoise.enable && !(pipeline->denoiser = open_denoiser(settings->denoise)))
+        LOG(logger, LOG_WARNING, "[%s] Open denoiser failed", settings->name);
+    if (settings->osd.enable && !(pipeline->osd = open_osd(settings->osd)))
+        LOG(logger, LOG_WARNING, "[%s] Open OSD failed", settings->name);
+    if (set_codec_motion(pipeline->codec, settings->motion) < 0)
+        LOG(logger, LOG_WARNING, "[%s] Enable motion regions failed", settings->name);
+
+    if (settings->rtmp[0] != '\0')
+    {
+        pipeline->rtmp_output = open_live_output(config, pipeline->codec->out_codec_ctx, settings->rtmp, "flv",
+                                                 settings->rate.queue_size);
+        if (!pipeline->rtmp_output)
+            LOG(logger, LOG_WARNING, "[%s] Open rtmp output failed, record only", settings->name);
+    }
+    if (settings->udp[0] != '\0' &&
+        !(pipeline->udp_output = open_udp_output(config, pipeline->codec->out_codec_ctx, settings->udp)))
+        LOG(logger, LOG_WARNING, "[%s] Open udp output failed", settings->name);
+    if (settings->hls.dir[0] != '\0' &&
+        !(pipeline->hls_output =
+              open_hls_output(config, pipeline->codec->out_codec_ctx, settings->hls, settings->name, 0, 0)))
+        LOG(logger, LOG_WARNING, "[%s] Open HLS output failed", settings->name);
+
+    LOG(logger, LOG_INFO, "[%s] Open pipeline on `%s` in %.1f ms: camera %.1f ms, codec %.1f ms", settings->name,
+        settings->device, (av_gettime_relative() - pipeline->open_time) / 1000.0, startup.time / 1000.0,
+        codec_time / 1000.0);
+    return pipeline;
+
+fail_camera:
+    free_array(pipeline->configs);
+    close_camera(pipeline->camera);
+    destroy_camera(pipeline->camera);
+fail:
+    LOG(logger, LOG_ERROR, "[%s] Open pipeline failed", settings->name);
+    pthread_cond_destroy(&pipeline->cond);
+    pthread_mutex_destroy(&pipeline->mutex);
+    free(pipeline);
+    return NULL;
+}
+
+int get_pipeline_fd(Pipeline *pipeline)
+{
+    return pipeline->camera->fd;
+}
+
+/**
+ * @brief submit_frame 以下一个时间戳提交一帧, 按抽帧间隔丢弃
+ * @note 采集的帧与补帧都经此提交, 时间戳连续
+ * @return int 成功返回0, 流水线已出错返回-1
+ */
+static int submit_frame(Pipeline *pipeline, BufType *frame, int filled)
+{
+    pthread_mutex_lock(&pipeline->mutex);
+    int failed = pipeline->failed;
+    int64_t time_stamp = pipeline->stat.captured++;
+    unsigned int decimate = pipeline->decimate;
+    if (filled)
+        pipeline->stat.filled++;
+    pthread_mutex_unlock(&pipeline->mutex);
+    if (failed)
+    {
+        destroy_buf(frame);
+        return -1;
+    }
+    if (time_stamp % decimate != 0)
+    {
+        destroy_buf(frame);
+        return 0;
+    }
+
+    if (submit_codec(pipeline->codec, frame, time_stamp) < 0)
+    {
+        pthread_mutex_lock(&pipeline->mutex);
+        pipeline->stat.dropped++;
+        pthread_mutex_unlock(&pipeline->mutex);
+    }
+    return 0;
+}
+
+/**
+ * @brief keep_last_frame 保存最近一帧的副本, 相机断开期间重复该帧
+ */
+static void keep_last_frame(Pipeline *pipeline, const BufType *frame)
+{
+    BufType *last = pipeline->last_frame;
+    if (!last && !(last = pipeline->last_frame = (BufType *)calloc(1, sizeof(BufType))))
+        return;
+    // MJPEG 每帧长度不同, 按需扩大
+    if (last->length < frame->length)
+    {
+        void *start = realloc(last->start, frame->length);
+        if (!start)
+            return;
+        last->start = start;
+    }
+    memcpy(last->start, frame->start, frame->length);
+    last->length = frame->length;
+}
+
+/**
+ * @brief adopt_camera_config 驱动可能调整或拒绝请求的格式, 以实际格式为准
+ * @param config 请求的配置 改为驱动实际采用的分辨率与帧率
+ * @return int 与请求不同返回1, 否则返回0
+ */
+static int adopt_camera_config(Pipeline *pipeline, Config *config)
+{
+    Config actual = get_config(pipeline->camera);
+    if (actual.width == 0 || actual.height == 0 || actual.time_base.num <= 0 ||
+        (actual.width == config->width && actual.height == config->height &&
+         av_cmp_q(actual.time_base, config->time_base) == 0))
+        return 0;
+    LOG(logger, LOG_WARNING, "[%s] Camera uses %ux%u at %.2f fps instead of %ux%u at %.2f fps",
+        pipeline->settings.name, actual.width, actual.height, av_q2d(av_inv_q(actual.time_base)), config->width,
+        config->height, av_q2d(av_inv_q(config->time_base)));
+    config->width = actual.width;
+    config->height = actual.height;
+    config->time_base = actual.time_base;
+    return 1;
+}
+
+/**
+ * @brief recycle_camera 以新的分辨率与帧率重建驱动缓冲区 文件描述符不变
+ * @note 只在采集线程中调用; 缓冲区中的帧已复制出来, 解码池随后由 resize_decoder 切换
+ * @param config 请求的配置 改为驱动实际采用的分辨率与帧率
+ * @return int 成功返回0, 失败返回-1
+ */
+static int recycle_camera(Pipeline *pipeline, Config *config)
+{
+    int64_t start = av_gettime_relative();
+    if (close_camera(pipeline->camera) < 0)
+        return -1;
+    if (set_camera_config(pipeline->camera, *config) < 0)
+        LOG(logger, LOG_WARNING, "[%s] Set camera config failed", pipeline->settings.name);
+    adopt_camera_config(pipeline, config);
+    if (open_camera(pipeline->camera) < 0)
+        return -1;
+    LOG(logger, LOG_INFO, "[%s] Switch camera to %ux%u at %.2f fps in %.1f ms", pipeline->settings.name,
+        config->width, config->height, av_q2d(av_inv_q(config->time_base)),
+        (av_gettime_relative() - start) / 1000.0);
+    return 0;
+}
+
+/**
+ * @brief resize_decoder 采集分辨率变化时按新的宽高重新打开解码池的上下文
+ * @note 只在采集线程中调用, 已提交的旧尺寸帧先解码完成
+ * @param config 新的采集配置
+ * @return int 成功返回0, 失败返回-1
+ */
+static int resize_decoder(Pipeline *pipeline, Config config)
+{
+    if (config.width == pipeline->capture.width && config.height == pipeline->capture.height)
+        return 0;
+    if (resize_decode_pool(pipeline->codec->decoder, config) < 0)
+    {
+        LOG(logger, LOG_ERROR, "[%s] Resize decoder to %ux%u failed", pipeline->settings.name, config.width,
+            config.height);
+        return -1;
+    }
+    // 保存的最近一帧是旧尺寸, 不能再作为补帧
+    destroy_buf(pipeline->last_frame);
+    pipeline->last_frame = NULL;
+    return 0;
+}
+
+int change_pipeline(Pipeline *pipeline, const char *key, const char *value)
+{
+    // 其余的键影响解码池或各处理模块的初始化, 需要重启
+    static const char *const live_keys[] = {"bit_rate", "size", "width", "height", "fps",
+                                            "rtmp", "udp", "hls", "video_dir"};
+    unsigned int i = 0;
+    while (i < sizeof(live_keys) / sizeof(live_keys[0]) && strcmp(key, live_keys[i]) != 0)
+        i++;
+    if (i == sizeof(live_keys) / sizeof(live_keys[0]))
+        return -2;
+
+    pthread_mutex_lock(&pipeline->mutex);
+    CameraSettings target = pipeline->target;
+    if (set_camera_setting(&target, key, value) < 0 || target.config.width == 0 || target.config.height == 0 ||
+        target.config.bit_rate <= 0)
+    {
+        pthread_mutex_unlock(&pipeline->mutex);
+        return -1;
+    }
+    if (target.config.width != pipeline->target.config.width ||
+        target.config.height != pipeline->target.config.height ||
+        av_cmp_q(target.config.time_base, pipeline->target.config.time_base) != 0)
+    {
+        // 与启动时一致: 分辨率须可用, 帧率改为最接近的可用帧率
+        int ret = pipeline->configs ? match_camera_config(pipeline->configs, &target.config) : 0;
+        if (ret < 0)
+        {
+            pthread_mutex_unlock(&pipeline->mutex);
+            LOG(logger, LOG_WARNING, "[%s] Control: %ux%u is not supported by `%s`", pipeline->settings.name,
+                target.config.width, target.config.height, pipeline->settings.device);
+            return -1;
+        }
+        if (ret > 0)
+            LOG(logger, LOG_INFO, "[%s] Control: use %.2f fps", pipeline->settings.name,
+                av_q2d(av_inv_q(target.config.time_base)));
+        pipeline->recycle = 1;
+    }
+    pipeline->target = target;
+    pipeline->changed = 1;
+    pthread_mutex_unlock(&pipeline->mutex);
+    LOG(logger, LOG_INFO, "[%s] Control: %s = %s", pipeline->settings.name, key, value);
+    return 0;
+}
+
+int feed_pipeline(Pipeline *pipeline)
+{
+    pthread_mutex_lock(&pipeline->mutex);
+    int recycle = pipeline->recycle;
+    Config config = pipeline->target.config;
+    pipeline->recycle = 0;
+    pthread_mutex_unlock(&pipeline->mutex);
+    if (recycle)
+    {
+        Config request = config;
+        if (recycle_camera(pipeline, &config) < 0)
+        {
+            LOG(logger, LOG_ERROR, "[%s] Switch camera failed", pipeline->settings.name);
+            return -1;
+        }
+        if (resize_decoder(pipeline, config) < 0)
+            return -1;
+        pipeline->capture = config;
+        // 驱动改用了其他格式时, 编码器按实际采集的分辨率与帧率切换
+        if (config.width != request.width || config.height != request.height ||
+            av_cmp_q(config.time_base, request.time_base) != 0)
+        {
+            pthread_mutex_lock(&pipeline->mutex);
+            pipeline->target.config.width = config.width;
+            pipeline->target.config.height = config.height;
+            pipeline->target.config.time_base = config.time_base;
+            pipeline->changed = 1;
+            pthread_mutex_unlock(&pipeline->mutex);
+        }
+    }
+
+    BufType *frame;
+    while ((frame = get_frame(pipeline->camera)))
+    {
+        // 快照不受抽帧与解码窗口影响
+        if (pipeline->snapshot)
+            publish_snapshot(pipeline->snapshot, frame);
+        if (pipeline->settings.hotplug.fill == FILL_REPEAT)
+            keep_last_frame(pipeline, frame);
+        if (submit_frame(pipeline, frame, 0) < 0)
+            return -1;
+    }
+
+    pthread_mutex_lock(&pipeline->mutex);
+    pipeline->stat.lost = pipeline->camera->lost;
+    pthread_mutex_unlock(&pipeline->mutex);
+    return pipeline->camera->disconnected ? -2 : 0;
+}
+
+int suspend_pipeline(Pipeline *pipeline)
+{
+    if (!pipeline->settings.hotplug.enable)
+        return -1;
+    release_camera(pipeline->camera);
+    pipeline->offline = 1;
+    pipeline->offline_time = av_gettime_relative();
+    pipeline->fill_time = pipeline->offline_time;
+    pipeline->retry_time = pipeline->offline_time;
+
+    // 断开前的分辨率可能已被运行时修改, 黑帧每次断开时重新生成
+    HotplugFill fill = pipeline->settings.hotplug.fill;
+    destroy_buf(pipeline->black);
+    pipeline->black = NULL;
+    if (fill == FILL_BLACK || (fill == FILL_REPEAT && !pipeline->last_frame))
+    {
+        pipeline->black = create_black_frame(pipeline->capture);
+        if (!pipeline->black)
+            LOG(logger, LOG_WARNING, "[%s] Create filler failed, skip filling", pipeline->settings.name);
+    }
+    LOG(logger, LOG_WARNING, "[%s] Camera disconnected, wait for `%s`", pipeline->settings.name,
+        pipeline->settings.device);
+    return 0;
+}
+
+int resume_pipeline(Pipeline *pipeline, int force)
+{
+    int64_t now = av_gettime_relative();
+    if (!force && now - pipeline->retry_time < (int64_t)pipeline->settings.hotplug.retry * 1000)
+        return -1;
+    pipeline->retry_time = now;
+
+    // 断开期间修改的分辨率与帧率在重新打开时一并应用
+    pthread_mutex_lock(&pipeline->mutex);
+    Config config = pipeline->recycle ? pipeline->target.config : pipeline->capture;
+    pthread_mutex_unlock(&pipeline->mutex);
+    if (reopen_camera(pipeline->camera, pipeline->settings.device, config) < 0)
+        return -1;
+    // 重新插入的相机可能不支持原来的格式, 编码器按实际采集的分辨率与帧率切换
+    if (adopt_camera_config(pipeline, &config))
+    {
+        pthread_mutex_lock(&pipeline->mutex);
+        pipeline->target.config.width = config.width;
+        pipeline->target.config.height = config.height;
+        pipeline->target.config.time_base = config.time_base;
+        pipeline->changed = 1;
+        pthread_mutex_unlock(&pipeline->mutex);
+    }
+    // 补帧与断开前的帧按旧尺寸解码完成后再切换解码池
+    if (resize_decoder(pipeline, config) < 0)
+        return -2;
+
+    pthread_mutex_lock(&pipeline->mutex);
+    pipeline->recycle = 0;
+    // 不补帧时时间戳跳过断开的时长
+    if (pipeline->settings.hotplug.fill == FILL_NONE)
+        pipeline->stat.captured += av_rescale_q(now - pipeline->offline_time, AV_TIME_BASE_Q, config.time_base);
+    pipeline->stat.reconnects++;
+    pthread_mutex_unlock(&pipeline->mutex);
+    pipeline->capture = config;
+    pipeline->offline = 0;
+    LOG(logger, LOG_INFO, "[%s] Camera reconnected after %.1f ms", pipeline->settings.name,
+        (now - pipeline->offline_time) / 1000.0);
+    return 0;
+}
+
+int fill_pipeline(Pipeline *pipeline)
+{
+    int64_t now = av_gettime_relative();
+    int64_t interval = av_rescale_q(1, pipeline->capture.time_base, AV_TIME_BASE_Q);
+    BufType *source = pipeline->black;
+    if (pipeline->settings.hotplug.fill == FILL_REPEAT && pipeline->last_frame)
+        source = pipeline->last_frame;
+
+    if (source && interval > 0)
+    {
+        // 事件循环被长时间阻塞时不补发积压的帧
+        if (now - pipeline->fill_time > interval * BUF_NUM)
+            pipeline->fill_time = now - interval;
+        while (pipeline->fill_time + interval <= now)
+        {
+            pipeline->fill_time += interval;
+            BufType *frame = (BufType *)malloc(sizeof(BufType));
+            if (!frame || !(frame->start = malloc(source->length)))
+            {
+                LOG(logger, LOG_ERROR, "Memory allocation failed");
+                free(frame);
+                break;
+            }
+            memcpy(frame->start, source->start, source->length);
+            frame->length = source->length;
+            frame->capture_time = now;
+            if (submit_frame(pipeline, frame, 1) < 0)
+                return -1;
+        }
+    }
+
+    // 等待到下一次补帧与下一次重试中较早的一个, 重试间隔为0时每次唤醒都重试
+    int64_t next = now + PIPELINE_IDLE_WAIT;
+    if (pipeline->settings.hotplug.retry > 0)
+        next = FFMIN(next, pipeline->retry_time + (int64_t)pipeline->settings.hotplug.retry * 1000);
+    if (source && interval > 0)
+        next = FFMIN(next, pipeline->fill_time + interval);
+    return next > now ? (int)((next - now + 999) / 1000) : 0;
+}
+
+void log_pipeline_stat(Pipeline *pipeline, double interval)
+{
+    pthread_mutex_lock(&pipeline->mutex);
+    PipelineStat stat = pipeline->stat;
+    PipelineStat last = pipeline->last;
+    pipeline->last = stat;
+    pipeline->stat.latency_max = 0;
+    pipeline->stat.packet.max = 0;
+    pipeline->stat.udp.max_depth = 0;
+    pthread_mutex_unlock(&pipeline->mutex);
+
+    int64_t encoded = stat.encoded - last.encoded;
+    double latency = encoded > 0 ? (stat.latency_sum - last.latency_sum) / 1000.0 / encoded : 0;
+    LOG(logger, LOG_INFO, "[%s] capture %.1f fps, encode %.1f fps, lost %lld, dropped %lld, decode failed %lld, latency avg %.1f ms max %.1f ms, cpu %.2f level %u",
+        pipeline->settings.name,
+        (stat.captured - last.captured) / interval, encoded / interval,
+        (long long)(stat.lost - last.lost), (long long)(stat.dropped - last.dropped), (long long)(stat.decode_failed - last.decode_failed),
+        latency, stat.latency_max / 1000.0, stat.cpu_usage, stat.level);
+
+    // 包大小的标准差反映关键帧造成的突发, 与延迟一起比较不同编码模式
+    int64_t packets = stat.packet.packets - last.packet.packets;
+    if (packets > 0)
+    {
+        double mean = (double)(stat.packet.bytes - last.packet.bytes) / packets;
+        double variance = (stat.packet.square - last.packet.square) / packets - mean * mean;
+        LOG(logger, LOG_INFO, "[%s] packet avg %.0f B stddev %.0f B max %lld B",
+            pipeline->settings.name, mean, sqrt(FFMAX(variance, 0)), (long long)stat.packet.max);
+    }
+    int64_t blocks = stat.motion.blocks - last.motion.blocks;
+    if (blocks > 0)
+        LOG(logger, LOG_INFO, "[%s] motion %.1f%% blocks active",
+            pipeline->settings.name, 100.0 * (stat.motion.active - last.motion.active) / blocks);
+    int64_t denoised = stat.denoise.frames - last.denoise.frames;
+    if (denoised > 0)
+        LOG(logger, LOG_INFO, "[%s] denoise %.2f ms per frame",
+            pipeline->settings.name, (stat.denoise.time - last.denoise.time) / 1000.0 / denoised);
+    int64_t tapped = stat.tap.published - last.tap.published;
+    if (tapped > 0)
+        LOG(logger, LOG_INFO, "[%s] tap %lld frames, %.2f ms per frame", pipeline->settings.name,
+            (long long)tapped, (stat.tap.time - last.tap.time) / 1000.0 / tapped);
+    int64_t datagrams = stat.udp.sent - last.udp.sent;
+    if (datagrams > 0 || stat.udp.dropped > last.udp.dropped || stat.udp.failed > last.udp.failed)
+        LOG(logger, LOG_INFO, "[%s] udp %lld datagrams in %lld batches, %lld dropped, %lld failed, max queue %u",
+            pipeline->settings.name, (long long)datagrams, (long long)(stat.udp.batches - last.udp.batches),
+            (long long)(stat.udp.dropped - last.udp.dropped), (long long)(stat.udp.failed - last.udp.failed),
+            stat.udp.max_depth);
+    int64_t filled = stat.filled - last.filled;
+    int64_t reconnects = stat.reconnects - last.reconnects;
+    if (pipeline->offline || filled > 0 || reconnects > 0)
+        LOG(logger, LOG_INFO, "[%s] camera %s, %lld reconnects, %lld frames filled", pipeline->settings.name,
+            pipeline->offline ? "offline" : "online", (long long)reconnects, (long long)filled);
+}
+
+void close_pipeline(Pipeline *pipeline)
+{
+    // 等待解码任务与编码任务结束, 之后不会再有任务被调度
+    drain_decode_pool(pipeline->codec->decoder);
+    pthread_mutex_lock(&pipeline->mutex);
+    while (pipeline->encoding)
+        pthread_cond_wait(&pipeline->cond, &pipeline->mutex);
+    pipeline->encoding = 1;
+    pthread_mutex_unlock(&pipeline->mutex);
+
+    // 编码剩余已解码的帧
+    encode_ready(pipeline, 0);
+
+    if (pipeline->rtmp_output && close_output(pipeline->rtmp_output) < 0)
+        LOG(logger, LOG_WARNING, "[%s] Close rtmp output failed", pipeline->settings.name);
+    if (pipeline->udp_output && close_output(pipeline->udp_output) < 0)
+        LOG(logger, LOG_WARNING, "[%s] Close udp output failed", pipeline->settings.name);
+    if (pipeline->hls_output && close_output(pipeline->hls_output) < 0)
+        LOG(logger, LOG_WARNING, "[%s] Close HLS output failed", pipeline->settings.name);
+    if (pipeline->file_output && close_output(pipeline->file_output) < 0)
+        LOG(logger, LOG_WARNING, "[%s] Close file output failed", pipeline->settings.name);
+
+    close_snapshot(pipeline->snapshot);
+    close_osd(pipeline->osd);
+    close_privacy_mask(pipeline->mask);
+    close_frame_tap(pipeline->tap);
+    close_denoiser(pipeline->denoiser);
+    close_codec(pipeline->codec);
+    destroy_codec(pipeline->codec);
+    close_camera(pipeline->camera);
+    destroy_camera(pipeline->camera);
+    destroy_buf(pipeline->black);
+    destroy_buf(pipeline->last_frame);
+    free_array(pipeline->configs);
+    LOG(logger, LOG_INFO, "[%s] Close pipeline, %lld frames encoded",
+        pipeline->settings.name, (long long)pipeline->stat.encoded);
+
+    pthread_cond_destroy(&pipeline->cond);
+    pthread_mutex_destroy(&pipeline->mutex);
+    free(pipeline);
+}
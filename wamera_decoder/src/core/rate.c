@@ -0,0 +1,90 @@
+#include "../../include/rate.h"
+
+void init_rate_controller(RateController *rate, RateConfig config, int64_t bit_rate)
+{
+    if (config.min_bit_rate <= 0 || config.min_bit_rate > bit_rate)
+        config.min_bit_rate = bit_rate / 4;
+    if (config.scale_steps > RATE_MAX_STEPS)
+        config.scale_steps = RATE_MAX_STEPS;
+    rate->config = config;
+    rate->max_bit_rate = bit_rate;
+    rate->bit_rate = bit_rate;
+    rate->step = 0;
+    rate->last_check = 0;
+    rate->last_change = 0;
+    rate->clear_since = 0;
+}
+
+void set_rate_controller_bit_rate(RateController *rate, int64_t bit_rate)
+{
+    // 拥塞时保持相对于上限的降幅
+    int64_t current = (int64_t)((double)rate->bit_rate * bit_rate / rate->max_bit_rate);
+    if (rate->config.min_bit_rate > bit_rate)
+        rate->config.min_bit_rate = bit_rate / 4;
+    rate->max_bit_rate = bit_rate;
+    rate->bit_rate = FFMIN(FFMAX(current, rate->config.min_bit_rate), bit_rate);
+}
+
+RateAction update_rate_controller(RateController *rate, unsigned int depth, int64_t latency, int64_t now)
+{
+    if (!rate->config.enable || now - rate->last_check < RATE_INTERVAL)
+        return RATE_KEEP;
+    rate->last_check = now;
+
+    // 队列超过一半或写入过慢视为拥塞, 队列低于八分之一且写入较快视为畅通
+    int congested = depth > rate->config.queue_size / 2 || latency > rate->config.max_latency;
+    int clear = depth <= rate->config.queue_size / 8 && latency < rate->config.max_latency / 2;
+
+    if (congested)
+    {
+        rate->clear_since = 0;
+        if (now - rate->last_change < RATE_DOWN_HOLD)
+            return RATE_KEEP;
+        if (rate->bit_rate > rate->config.min_bit_rate)
+        {
+            rate->bit_rate = FFMAX(rate->config.min_bit_rate, rate->bit_rate * 3 / 4);
+            rate->last_change = now;
+            return RATE_BITRATE;
+        }
+        if (rate->step < rate->config.scale_steps)
+        {
+            rate->step++;
+            rate->last_change = now;
+            return RATE_RESOLUTION;
+        }
+        return RATE_KEEP;
+    }
+
+    if (!clear)
+    {
+        rate->clear_since = 0;
+        return RATE_KEEP;
+    }
+    if (rate->clear_since == 0)
+        rate->clear_since = now;
+    if (now - rate->clear_since < RATE_UP_HOLD || now - rate->last_change < RATE_UP_HOLD)
+        return RATE_KEEP;
+
+    // 按降级的相反顺序恢复 先恢复分辨率再加性提高码率
+    rate->last_change = now;
+    if (rate->step > 0)
+    {
+        rate->step--;
+        return RATE_RESOLUTION;
+    }
+    if (rate->bit_rate < rate->max_bit_rate)
+    {
+        rate->bit_rate = FFMIN(rate->max_bit_rate, rate->bit_rate + rate->max_bit_rate / 8);
+        return RATE_BITRATE;
+    }
+    return RATE_KEEP;
+}
+
+Config scale_config(Config config, unsigned int step)
+{
+    unsigned int scale = 4 - FFMIN(step, RATE_MAX_STEPS);
+    // 宽高保持偶数 满足色度抽样要求
+    config.width = (config.width * scale / 4) & ~1u;
+    config.height = (config.height * scale / 4) & ~1u;
+    return config;
+}
@@ -0,0 +1,284 @@
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+#include "../../include/sink.h"
+
+// 交给 libavformat 的 IO 缓冲区大小
+#define SINK_IO_SIZE (64 * 1024)
+
+// 已提交关闭, 同步线程尚未完成收尾的写入器数量
+static unsigned int closing = 0;
+static pthread_mutex_t closing_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t closing_cond = PTHREAD_COND_INITIALIZER;
+
+/**
+ * @brief flush_chunk 提交暂存块写入, 换上新的缓冲区并通知同步线程
+ * @return 成功返回0, 失败返回-1
+ */
+static int flush_chunk(FileSink *sink)
+{
+    if (sink->filled == 0)
+        return 0;
+
+    if (submit_aio_buffer(sink->aio, sink->chunk, sink->filled, sink->chunk_pos) < 0)
+    {
+        LOG(logger, LOG_ERROR, "Write chunk failed");
+        return -1;
+    }
+
+    pthread_mutex_lock(&sink->mutex);
+    sink->unsynced += sink->filled;
+    if (sink->config.sync_bytes > 0 && sink->unsynced >= sink->config.sync_bytes)
+        pthread_cond_signal(&sink->cond);
+    pthread_mutex_unlock(&sink->mutex);
+
+    sink->chunk_pos += sink->filled;
+    sink->filled = 0;
+
+    // 写入出错时没有可用的缓冲区, 之后的写入全部失败
+    sink->chunk = acquire_aio_buffer(sink->aio);
+    if (!sink->chunk)
+    {
+        LOG(logger, LOG_ERROR, "Acquire write buffer failed");
+        return -1;
+    }
+    return 0;
+}
+
+static int sink_write_packet(void *opaque, uint8_t *buf, int buf_size)
+{
+    FileSink *sink = (FileSink *)opaque;
+    if (!sink->chunk)
+        return AVERROR(EIO);
+
+    // 写入位置不连续(例如 mp4 回写文件头)时先落盘暂存块, 并等待在途写入完成以保证覆盖顺序
+    if (sink->pos != sink->chunk_pos + sink->filled)
+    {
+        if (flush_chunk(sink) < 0 || drain_aio_writer(sink->aio) < 0)
+            return AVERROR(EIO);
+        sink->chunk_pos = sink->pos;
+    }
+
+    int remain = buf_size;
+    while (remain > 0)
+    {
+        unsigned int space = sink->config.chunk_size - sink->filled;
+        unsigned int length = (unsigned int)remain < space ? (unsigned int)remain : space;
+        memcpy(sink->chunk + sink->filled, buf, length);
+        sink->filled += length;
+        buf += length;
+        remain -= length;
+        if (sink->filled == sink->config.chunk_size && flush_chunk(sink) < 0)
+            return AVERROR(EIO);
+    }
+
+    sink->pos += buf_size;
+    if (sink->pos > sink->size)
+        sink->size = sink->pos;
+    return buf_size;
+}
+
+static int64_t sink_seek(void *opaque, int64_t offset, int whence)
+{
+    FileSink *sink = (FileSink *)opaque;
+
+    switch (whence & ~AVSEEK_FORCE)
+    {
+    case AVSEEK_SIZE:
+        return sink->size;
+    case SEEK_SET:
+        break;
+    case SEEK_CUR:
+        offset += sink->pos;
+        break;
+    case SEEK_END:
+        offset += sink->size;
+        break;
+    default:
+        return AVERROR(EINVAL);
+    }
+
+    if (offset < 0)
+        return AVERROR(EINVAL);
+    sink->pos = offset;
+    return offset;
+}
+
+/**
+ * @brief finish_file_sink 截断预留空间, 同步并关闭文件, 释放写入器
+ * @note 在同步线程退出前调用, 不阻塞关闭写入器的编码任务
+ */
+static void finish_file_sink(FileSink *sink)
+{
+    // 释放预分配但未使用的尾部空间
+    if (sink->reserved > sink->size && ftruncate(sink->fd, sink->size) < 0)
+        LOG(logger, LOG_WARNING, "Truncate file failed: %s", strerror(errno));
+    if (fdatasync(sink->fd) < 0)
+        LOG(logger, LOG_ERROR, "Fdatasync failed: %s", strerror(errno));
+    if (close(sink->fd) < 0)
+        LOG(logger, LOG_ERROR, "Close file failed: %s", strerror(errno));
+
+    pthread_cond_destroy(&sink->cond);
+    pthread_mutex_destroy(&sink->mutex);
+    free(sink);
+
+    pthread_mutex_lock(&closing_mutex);
+    if (--closing == 0)
+        pthread_cond_broadcast(&closing_cond);
+    pthread_mutex_unlock(&closing_mutex);
+}
+
+/**
+ * @brief sync_loop 后台同步线程, 按时间或累计字节数调用 fdatasync, 停止时完成文件的收尾
+ */
+static void *sync_loop(void *arg)
+{
+    FileSink *sink = (FileSink *)arg;
+    apply_affinity(ROLE_IO);
+
+    pthread_mutex_lock(&sink->mutex);
+    while (!sink->stop)
+    {
+        if (sink->config.sync_interval > 0)
+        {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_sec += sink->config.sync_interval;
+            pthread_cond_timedwait(&sink->cond, &sink->mutex, &deadline);
+        }
+        else
+            pthread_cond_wait(&sink->cond, &sink->mutex);
+
+        if (sink->unsynced == 0)
+            continue;
+        sink->unsynced = 0;
+
+        // 同步期间不持有锁, 避免阻塞写入线程
+        pthread_mutex_unlock(&sink->mutex);
+        if (fdatasync(sink->fd) < 0)
+            LOG(logger, LOG_WARNING, "Fdatasync failed: %s", strerror(errno));
+        pthread_mutex_lock(&sink->mutex);
+    }
+    pthread_mutex_unlock(&sink->mutex);
+    finish_file_sink(sink);
+    return NULL;
+}
+
+FileSink *open_file_sink(const char *path, int64_t expected_size, SinkConfig config)
+{
+    FileSink *sink = (FileSink *)calloc(1, sizeof(FileSink));
+    if (!sink)
+    {
+        LOG(logger, LOG_ERROR, "Memory allocation failed");
+        return NULL;
+    }
+
+    if (config.chunk_size == 0)
+        config.chunk_size = SINK_CHUNK_SIZE;
+    config.chunk_size = (config.chunk_size + SINK_ALIGN - 1) & ~(SINK_ALIGN - 1);
+    sink->config = config;
+
+    sink->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (sink->fd < 0)
+    {
+        LOG(logger, LOG_ERROR, "Open file `%s` failed: %s", path, strerror(errno));
+        free(sink);
+        return NULL;
+    }
+
+    // 预分配空间以减少碎片, 不改变文件大小, 文件系统不支持时忽略
+    if (expected_size > 0)
+    {
+        if (fallocate(sink->fd, FALLOC_FL_KEEP_SIZE, 0, expected_size) == 0)
+            sink->reserved = expected_size;
+        else
+            LOG(logger, LOG_DEBUG, "Fallocate `%s` skipped: %s", path, strerror(errno));
+    }
+
+    sink->aio = open_aio_writer(sink->fd, config.backend, config.queue_depth, config.chunk_size);
+    if (!sink->aio)
+    {
+        close(sink->fd);
+        free(sink);
+        return NULL;
+    }
+    sink->chunk = acquire_aio_buffer(sink->aio);
+    if (!sink->chunk)
+    {
+        LOG(logger, LOG_ERROR, "Acquire write buffer failed");
+        close_aio_writer(sink->aio);
+        close(sink->fd);
+        free(sink);
+        return NULL;
+    }
+
+    uint8_t *io_buffer = (uint8_t *)av_malloc(SINK_IO_SIZE);
+    if (io_buffer)
+        sink->pb = avio_alloc_context(io_buffer, SINK_IO_SIZE, 1, sink, NULL, sink_write_packet, sink_seek);
+    if (!sink->pb)
+    {
+        LOG(logger, LOG_ERROR, "Alloc io context failed");
+        av_free(io_buffer);
+        close_aio_writer(sink->aio);
+        close(sink->fd);
+        free(sink);
+        return NULL;
+    }
+
+    pthread_mutex_init(&sink->mutex, NULL);
+    pthread_cond_init(&sink->cond, NULL);
+    if (pthread_create(&sink->sync_thread, NULL, sync_loop, sink) != 0)
+    {
+        LOG(logger, LOG_ERROR, "Create sync thread failed");
+        pthread_cond_destroy(&sink->cond);
+        pthread_mutex_destroy(&sink->mutex);
+        av_freep(&sink->pb->buffer);
+        avio_context_free(&sink->pb);
+        close_aio_writer(sink->aio);
+        close(sink->fd);
+        free(sink);
+        return NULL;
+    }
+
+    LOG(logger, LOG_DEBUG, "Open file sink `%s`, reserved %lld bytes", path, (long long)sink->reserved);
+    return sink;
+}
+
+int close_file_sink(FileSink *sink)
+{
+    int ret = 0;
+
+    avio_flush(sink->pb);
+    if (flush_chunk(sink) < 0)
+        ret = -1;
+    if (close_aio_writer(sink->aio) < 0)
+        ret = -1;
+
+    av_freep(&sink->pb->buffer);
+    avio_context_free(&sink->pb);
+
+    // 截断 同步与关闭交给同步线程, 分段切换时编码任务不等待落盘; 通知之后同步线程可能随时释放写入器
+    pthread_t sync_thread = sink->sync_thread;
+    pthread_mutex_lock(&closing_mutex);
+    closing++;
+    pthread_mutex_unlock(&closing_mutex);
+    pthread_mutex_lock(&sink->mutex);
+    sink->stop = 1;
+    pthread_cond_signal(&sink->cond);
+    pthread_mutex_unlock(&sink->mutex);
+    pthread_detach(sync_thread);
+    return ret;
+}
+
+void wait_file_sinks(void)
+{
+    pthread_mutex_lock(&closing_mutex);
+    while (closing > 0)
+        pthread_cond_wait(&closing_cond, &closing_mutex);
+    pthread_mutex_unlock(&closing_mutex);
+}
@@ -0,0 +1,331 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "../../include/snapshot.h"
+
+#pragma region 文件
+
+/**
+ * @brief write_file 先写入临时文件再重命名, 读者不会读到写了一半的文件
+ * @return 成功返回0, 失败返回-1
+ */
+static int write_file(const char *path, const uint8_t *data, size_t size)
+{
+    char tmp[520];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        LOG(logger, LOG_ERROR, "Open `%s` failed", tmp);
+        return -1;
+    }
+    size_t written = 0;
+    while (written < size)
+    {
+        ssize_t ret = write(fd, data + written, size - written);
+        if (ret < 0)
+        {
+            LOG(logger, LOG_ERROR, "Write `%s` failed", tmp);
+            close(fd);
+            unlink(tmp);
+            return -1;
+        }
+        written += ret;
+    }
+    close(fd);
+    if (rename(tmp, path) < 0)
+    {
+        LOG(logger, LOG_ERROR, "Rename `%s` failed", tmp);
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+#pragma endregion
+
+#pragma region 缩略图
+
+/**
+ * @brief open_thumb_decoder 打开缩略图的 JPEG 解码器
+ * @note 按缩略图宽度选择最大的 lowres, JPEG 在解码时直接按 1/2 1/4 1/8 降采样
+ * @return 成功返回0, 失败返回-1
+ */
+static int open_thumb_decoder(SnapshotService *service)
+{
+    const AVCodec *codec = avcodec_find_decoder(AV_CODEC_ID_MJPEG);
+    if (!codec || !(service->decoder = avcodec_alloc_context3(codec)))
+        return -1;
+    int lowres = 0;
+    while (lowres < 3 && (service->width >> (lowres + 1)) >= (int)service->config.thumb_width)
+        lowres++;
+    service->decoder->lowres = lowres;
+    service->decoder->thread_count = 1;
+    if (avcodec_open2(service->decoder, codec, NULL) < 0)
+    {
+        avcodec_free_context(&service->decoder);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief open_thumb_encoder 按缩略图尺寸打开 JPEG 编码器 尺寸不变时复用
+ * @return 成功返回0, 失败返回-1
+ */
+static int open_thumb_encoder(SnapshotService *service, int width, int height)
+{
+    if (service->encoder && service->encoder->width == width && service->encoder->height == height)
+        return 0;
+    avcodec_free_context(&service->encoder);
+
+    const AVCodec *codec = avcodec_find_encoder(AV_CODEC_ID_MJPEG);
+    if (!codec || !(service->encoder = avcodec_alloc_context3(codec)))
+        return -1;
+    service->encoder->width = width;
+    service->encoder->height = height;
+    service->encoder->pix_fmt = AV_PIX_FMT_YUVJ420P;
+    service->encoder->time_base = (AVRational){1, 1};
+    service->encoder->flags |= AV_CODEC_FLAG_QSCALE;
+    service->encoder->global_quality = FF_QP2LAMBDA * SNAPSHOT_THUMB_QUALITY;
+    service->encoder->thread_count = 1;
+    if (avcodec_open2(service->encoder, codec, NULL) < 0)
+    {
+        avcodec_free_context(&service->encoder);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief make_thumbnail 解码快照 缩放后重新编码为 JPEG 写出
+ * @return 成功返回0, 失败返回-1
+ */
+static int make_thumbnail(SnapshotService *service, const Snapshot *snapshot, const char *path)
+{
+    if (!service->decoder && open_thumb_decoder(service) < 0)
+    {
+        LOG(logger, LOG_ERROR, "[%s] Open thumbnail decoder failed", service->name);
+        return -1;
+    }
+
+    int ret = -1;
+    AVPacket *packet = av_packet_alloc();
+    AVFrame *decoded = av_frame_alloc();
+    AVFrame *scaled = av_frame_alloc();
+    if (!packet || !decoded || !scaled)
+        goto end;
+
+    packet->data = snapshot->data;
+    packet->size = (int)snapshot->size;
+    if (avcodec_send_packet(service->decoder, packet) < 0 || avcodec_receive_frame(service->decoder, decoded) < 0)
+    {
+        LOG(logger, LOG_WARNING, "[%s] Decode snapshot failed", service->name);
+        goto end;
+    }
+
+    int width = FFMIN((int)service->config.thumb_width, decoded->width) & ~1;
+    int height = (int)((int64_t)decoded->height * width / decoded->width) & ~1;
+    if (width <= 0 || height <= 0 || open_thumb_encoder(service, width, height) < 0)
+        goto end;
+    service->scaler = sws_getCachedContext(service->scaler, decoded->width, decoded->height, decoded->format,
+                                           width, height, AV_PIX_FMT_YUVJ420P, SWS_BILINEAR, NULL, NULL, NULL);
+    scaled->width = width;
+    scaled->height = height;
+    scaled->format = AV_PIX_FMT_YUVJ420P;
+    if (!service->scaler || av_frame_get_buffer(scaled, 0) < 0)
+        goto end;
+    sws_scale(service->scaler, (const uint8_t *const *)decoded->data, decoded->linesize, 0, decoded->height,
+              scaled->data, scaled->linesize);
+
+    scaled->pts = service->stat.thumbs;
+    scaled->quality = service->encoder->global_quality;
+    av_packet_unref(packet);
+    if (avcodec_send_frame(service->encoder, scaled) < 0 || avcodec_receive_packet(service->encoder, packet) < 0)
+    {
+        LOG(logger, LOG_WARNING, "[%s] Encode thumbnail failed", service->name);
+        goto end;
+    }
+    ret = write_file(path, packet->data, packet->size);
+
+end:
+    av_packet_free(&packet);
+    av_frame_free(&decoded);
+    av_frame_free(&scaled);
+    return ret;
+}
+
+#pragma endregion
+
+/**
+ * @brief snapshot_task 写出最新快照, 到达间隔时生成缩略图
+ * @note 同一时刻至多一个任务, 缩略图的编解码器只在任务中访问
+ */
+static void snapshot_task(void *arg)
+{
+    SnapshotService *service = (SnapshotService *)arg;
+    int written = 0, thumb = 0;
+    int64_t thumb_time = 0;
+
+    Snapshot *snapshot = acquire_snapshot(service);
+    if (snapshot)
+    {
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s.jpg", service->config.dir, service->name);
+        written = write_file(path, snapshot->data, snapshot->size) == 0;
+
+        if (service->config.thumb_width > 0 &&
+            snapshot->capture_time - service->last_thumb >= service->config.thumb_interval)
+        {
+            service->last_thumb = snapshot->capture_time;
+            int64_t start = av_gettime_relative();
+            snprintf(path, sizeof(path), "%s/%s_thumb.jpg", service->config.dir, service->name);
+            thumb = make_thumbnail(service, snapshot, path) == 0;
+            thumb_time = av_gettime_relative() - start;
+        }
+        release_snapshot(snapshot);
+    }
+
+    pthread_mutex_lock(&service->mutex);
+    service->stat.written += written;
+    service->stat.thumbs += thumb;
+    service->stat.thumb_time += thumb_time;
+    service->busy = 0;
+    pthread_cond_broadcast(&service->cond);
+    pthread_mutex_unlock(&service->mutex);
+}
+
+SnapshotService *open_snapshot(SnapshotConfig config, const char *name, int width, WorkerPool *workers)
+{
+    SnapshotService *service = (SnapshotService *)calloc(1, sizeof(SnapshotService));
+    if (!service)
+    {
+        LOG(logger, LOG_ERROR, "Memory allocation failed");
+        return NULL;
+    }
+    service->config = config;
+    snprintf(service->name, sizeof(service->name), "%s", name);
+    service->width = width;
+    service->workers = workers;
+    for (int i = 0; i < SNAPSHOT_SLOTS; i++)
+        atomic_init(&service->slots[i].refs, 0);
+    atomic_init(&service->latest, -1);
+    service->last_write = INT64_MIN / 2;
+    service->last_thumb = INT64_MIN / 2;
+    pthread_mutex_init(&service->mutex, NULL);
+    pthread_cond_init(&service->cond, NULL);
+    return service;
+}
+
+void publish_snapshot(SnapshotService *service, const BufType *frame)
+{
+    // 选一个既不是最新也没有读者的槽, 读者在确认槽仍为最新之前不会读取数据
+    int latest = atomic_load(&service->latest);
+    Snapshot *snapshot = NULL;
+    int index = -1;
+    for (int i = 1; i <= SNAPSHOT_SLOTS; i++)
+    {
+        int candidate = (latest + i) % SNAPSHOT_SLOTS;
+        if (candidate != latest && atomic_load(&service->slots[candidate].refs) == 0)
+        {
+            index = candidate;
+            snapshot = &service->slots[candidate];
+            break;
+        }
+    }
+
+    size_t need = (size_t)frame->length + AV_INPUT_BUFFER_PADDING_SIZE;
+    if (snapshot && snapshot->capacity < need)
+    {
+        free(snapshot->data);
+        snapshot->data = (uint8_t *)malloc(need);
+        snapshot->capacity = snapshot->data ? need : 0;
+        if (!snapshot->data)
+            snapshot = NULL;
+    }
+    if (!snapshot)
+    {
+        pthread_mutex_lock(&service->mutex);
+        service->stat.skipped++;
+        pthread_mutex_unlock(&service->mutex);
+        return;
+    }
+
+    memcpy(snapshot->data, frame->start, frame->length);
+    memset(snapshot->data + frame->length, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+    snapshot->size = frame->length;
+    snapshot->capture_time = frame->capture_time;
+    snapshot->sequence = latest >= 0 ? service->slots[latest].sequence + 1 : 0;
+    atomic_store(&service->latest, index);
+
+    pthread_mutex_lock(&service->mutex);
+    service->stat.published++;
+    int submit = service->config.dir[0] != '\0' && !service->busy &&
+                 frame->capture_time - service->last_write >= service->config.interval;
+    if (submit)
+    {
+        service->busy = 1;
+        service->last_write = frame->capture_time;
+    }
+    pthread_mutex_unlock(&service->mutex);
+
+    if (submit && submit_worker_pool(service->workers, snapshot_task, service) < 0)
+    {
+        pthread_mutex_lock(&service->mutex);
+        service->busy = 0;
+        pthread_mutex_unlock(&service->mutex);
+    }
+}
+
+Snapshot *acquire_snapshot(SnapshotService *service)
+{
+    for (;;)
+    {
+        int index = atomic_load(&service->latest);
+        if (index < 0)
+            return NULL;
+        Snapshot *snapshot = &service->slots[index];
+        atomic_fetch_add(&snapshot->refs, 1);
+        // 增加引用后槽仍为最新, 说明写入者不会再选中它
+        if (atomic_load(&service->latest) == index)
+            return snapshot;
+        atomic_fetch_sub(&snapshot->refs, 1);
+    }
+}
+
+void release_snapshot(Snapshot *snapshot)
+{
+    atomic_fetch_sub(&snapshot->refs, 1);
+}
+
+SnapshotStat get_snapshot_stat(SnapshotService *service)
+{
+    pthread_mutex_lock(&service->mutex);
+    SnapshotStat stat = service->stat;
+    pthread_mutex_unlock(&service->mutex);
+    return stat;
+}
+
+void close_snapshot(SnapshotService *service)
+{
+    if (!service)
+        return;
+    pthread_mutex_lock(&service->mutex);
+    while (service->busy)
+        pthread_cond_wait(&service->cond, &service->mutex);
+    pthread_mutex_unlock(&service->mutex);
+
+    SnapshotStat stat = service->stat;
+    LOG(logger, LOG_INFO, "[%s] Snapshot: %lld published, %lld skipped, %lld written, %lld thumbnails (%.1f ms avg)",
+        service->name, (long long)stat.published, (long long)stat.skipped, (long long)stat.written,
+        (long long)stat.thumbs, stat.thumbs > 0 ? stat.thumb_time / 1000.0 / stat.thumbs : 0.0);
+
+    avcodec_free_context(&service->decoder);
+    avcodec_free_context(&service->encoder);
+    sws_freeContext(service->scaler);
+    for (int i = 0; i < SNAPSHOT_SLOTS; i++)
+        free(service->slots[i].data);
+    pthread_cond_destroy(&service->cond);
+    pthread_mutex_destroy(&service->mutex);
+    free(service);
+}
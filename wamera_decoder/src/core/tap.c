@@ -0,0 +1,168 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "../../include/tap.h"
+
+// TapFormat 对应的像素格式
+static const enum AVPixelFormat tap_pix_fmts[] = {AV_PIX_FMT_GRAY8, AV_PIX_FMT_RGB24, AV_PIX_FMT_YUV420P};
+
+/**
+ * @brief align_up 向上对齐到 TAP_ALIGN
+ */
+static inline uint64_t align_up(uint64_t value)
+{
+    return (value + TAP_ALIGN - 1) & ~(uint64_t)(TAP_ALIGN - 1);
+}
+
+/**
+ * @brief layout_header 按输出格式与尺寸计算平面与槽的布局
+ * @return 整个共享内存的大小
+ */
+static size_t layout_header(TapHeader *header, TapFormat format, int width, int height, unsigned int slots)
+{
+    int planes = format == TAP_YUV420P ? 3 : 1;
+    int bytes = format == TAP_RGB ? 3 : 1;
+    uint64_t offset = 0;
+    for (int p = 0; p < planes; p++)
+    {
+        int shift = p ? 1 : 0;
+        header->linesize[p] = (uint32_t)align_up((uint64_t)(width >> shift) * bytes);
+        header->offset[p] = (uint32_t)offset;
+        offset = align_up(offset + (uint64_t)header->linesize[p] * (height >> shift));
+    }
+    header->version = TAP_VERSION;
+    header->format = format;
+    header->slots = slots;
+    header->width = width;
+    header->height = height;
+    header->slot_size = TAP_ALIGN + offset;
+    header->data_offset = align_up(sizeof(TapHeader));
+    atomic_init(&header->head, 0);
+    return header->data_offset + header->slot_size * slots;
+}
+
+FrameTap *open_frame_tap(TapConfig config, const char *name, int width, int height)
+{
+    if (config.format > TAP_YUV420P || width <= 0 || height <= 0)
+    {
+        LOG(logger, LOG_ERROR, "[%s] Invalid tap format or size", name);
+        return NULL;
+    }
+    FrameTap *tap = (FrameTap *)calloc(1, sizeof(FrameTap));
+    if (!tap)
+    {
+        LOG(logger, LOG_ERROR, "Memory allocation failed");
+        return NULL;
+    }
+    tap->config = config;
+    tap->fd = -1;
+    if (config.name[0] == '\0')
+        snprintf(tap->config.name, sizeof(tap->config.name), "/wamera.%s", name);
+    else if (config.name[0] != '/')
+        snprintf(tap->config.name, sizeof(tap->config.name), "/%s", config.name);
+    tap->config.slots = FFMAX(config.slots, 2);
+
+    // 输出保持采集的宽高比, 宽高取偶数以便色度平面减半
+    int out_w = config.width > 0 ? FFMIN((int)config.width, width) : width;
+    out_w &= ~1;
+    int out_h = (int)((int64_t)height * out_w / width) & ~1;
+    if (out_w <= 0 || out_h <= 0)
+    {
+        LOG(logger, LOG_ERROR, "[%s] Invalid tap width %u", name, config.width);
+        free(tap);
+        return NULL;
+    }
+
+    // 解除旧共享内存的链接后独占创建, 旧读者继续使用各自的映射
+    shm_unlink(tap->config.name);
+    tap->fd = shm_open(tap->config.name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (tap->fd < 0)
+    {
+        LOG(logger, LOG_ERROR, "[%s] Create shared memory `%s` failed", name, tap->config.name);
+        free(tap);
+        return NULL;
+    }
+
+    TapHeader layout;
+    memset(&layout, 0, sizeof(layout));
+    tap->size = layout_header(&layout, tap->config.format, out_w, out_h, tap->config.slots);
+    if (ftruncate(tap->fd, (off_t)tap->size) < 0 ||
+        (tap->base = (uint8_t *)mmap(NULL, tap->size, PROT_READ | PROT_WRITE, MAP_SHARED, tap->fd, 0)) == MAP_FAILED)
+    {
+        LOG(logger, LOG_ERROR, "[%s] Map shared memory `%s` failed", name, tap->config.name);
+        tap->base = NULL;
+        close_frame_tap(tap);
+        return NULL;
+    }
+
+    // 新建的共享内存全为0, 槽的顺序锁从0开始; magic 最后写入
+    tap->header = (TapHeader *)tap->base;
+    memcpy(tap->header, &layout, sizeof(layout));
+    atomic_store_explicit(&tap->header->magic, TAP_MAGIC, memory_order_release);
+
+    LOG(logger, LOG_INFO, "[%s] Frame tap `%s`: %dx%d, format %d, %u slots, %zu bytes",
+        name, tap->config.name, out_w, out_h, tap->config.format, tap->config.slots, tap->size);
+    return tap;
+}
+
+int publish_frame_tap(FrameTap *tap, const AVFrame *frame, int64_t capture_time)
+{
+    int64_t start = av_gettime_relative();
+    TapHeader *header = tap->header;
+    tap->scaler = sws_getCachedContext(tap->scaler, frame->width, frame->height, frame->format,
+                                       header->width, header->height, tap_pix_fmts[header->format],
+                                       SWS_FAST_BILINEAR, NULL, NULL, NULL);
+    if (!tap->scaler)
+        return -1;
+
+    uint64_t sequence = tap->sequence++;
+    TapSlot *slot = (TapSlot *)(tap->base + header->data_offset + (sequence % header->slots) * header->slot_size);
+    uint8_t *data = (uint8_t *)slot + TAP_ALIGN;
+    uint8_t *planes[4] = {NULL};
+    int linesize[4] = {0};
+    for (int p = 0; p < 3 && header->linesize[p] > 0; p++)
+    {
+        planes[p] = data + header->offset[p];
+        linesize[p] = (int)header->linesize[p];
+    }
+
+    // 顺序锁置为奇数后直接覆盖槽, 正在读该槽的读者会发现锁已变化
+    uint64_t lock = atomic_load_explicit(&slot->lock, memory_order_relaxed);
+    atomic_store_explicit(&slot->lock, lock + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    sws_scale(tap->scaler, (const uint8_t *const *)frame->data, frame->linesize, 0, frame->height, planes, linesize);
+    slot->sequence = sequence;
+    slot->capture_time = capture_time;
+    slot->wall_time = av_gettime() - (av_gettime_relative() - capture_time);
+
+    atomic_store_explicit(&slot->lock, lock + 2, memory_order_release);
+    atomic_store_explicit(&header->head, sequence + 1, memory_order_release);
+
+    tap->stat.published++;
+    tap->stat.time += av_gettime_relative() - start;
+    return 0;
+}
+
+TapStat get_frame_tap_stat(FrameTap *tap)
+{
+    return tap->stat;
+}
+
+void close_frame_tap(FrameTap *tap)
+{
+    if (!tap)
+        return;
+    if (tap->stat.published > 0)
+        LOG(logger, LOG_INFO, "Frame tap `%s`: %lld frames, %.2f ms per frame", tap->config.name,
+            (long long)tap->stat.published, tap->stat.time / 1000.0 / tap->stat.published);
+    sws_freeContext(tap->scaler);
+    if (tap->base)
+        munmap(tap->base, tap->size);
+    if (tap->fd >= 0)
+    {
+        close(tap->fd);
+        shm_unlink(tap->config.name);
+    }
+    free(tap);
+}
@@ -0,0 +1,269 @@
+#define _GNU_SOURCE
+#include "../../include/udp.h"
+
+#pragma region Socket
+
+/**
+ * @brief open_udp_socket 解析 host:port 并创建套接字, 组播地址限制 TTL
+ * @return int 成功返回0, 失败返回-1
+ */
+static int open_udp_socket(UdpSender *sender, const char *address)
+{
+    char host[256];
+    const char *colon = strrchr(address, ':');
+    if (!colon || colon == address || (size_t)(colon - address) >= sizeof(host) || !colon[1])
+    {
+        LOG(logger, LOG_ERROR, "Invalid udp address `%s`, expected host:port", address);
+        return -1;
+    }
+    // IPv6 地址写作 [addr]:port
+    const char *begin = address;
+    size_t length = colon - address;
+    if (address[0] == '[' && colon[-1] == ']')
+    {
+        begin++;
+        length -= 2;
+    }
+    memcpy(host, begin, length);
+    host[length] = '\0';
+
+    struct addrinfo hints = {0};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags = AI_NUMERICSERV;
+    struct addrinfo *info = NULL;
+    int ret = getaddrinfo(host, colon + 1, &hints, &info);
+    if (ret != 0)
+    {
+        LOG(logger, LOG_ERROR, "Resolve udp address `%s` failed: %s", address, gai_strerror(ret));
+        return -1;
+    }
+    memcpy(&sender->address, info->ai_addr, info->ai_addrlen);
+    sender->address_len = info->ai_addrlen;
+    sender->fd = socket(info->ai_family, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    freeaddrinfo(info);
+    if (sender->fd < 0)
+    {
+        LOG(logger, LOG_ERROR, "Create udp socket failed: %s", strerror(errno));
+        return -1;
+    }
+
+    int ttl = UDP_MULTICAST_TTL;
+    if (sender->address.ss_family == AF_INET)
+    {
+        struct sockaddr_in *in = (struct sockaddr_in *)&sender->address;
+        if (IN_MULTICAST(ntohl(in->sin_addr.s_addr)) &&
+            setsockopt(sender->fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl)) < 0)
+            LOG(logger, LOG_WARNING, "Set multicast ttl failed: %s", strerror(errno));
+    }
+    else if (sender->address.ss_family == AF_INET6)
+    {
+        struct sockaddr_in6 *in6 = (struct sockaddr_in6 *)&sender->address;
+        if (IN6_IS_ADDR_MULTICAST(&in6->sin6_addr) &&
+            setsockopt(sender->fd, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, &ttl, sizeof(ttl)) < 0)
+            LOG(logger, LOG_WARNING, "Set multicast hops failed: %s", strerror(errno));
+    }
+    return 0;
+}
+
+#pragma endregion
+
+#pragma region Pacing
+
+/**
+ * @brief send_batch 以一次 sendmmsg 发出一批数据报, 部分发送时继续发送剩余部分
+ * @return int 成功发送的数据报数
+ */
+static unsigned int send_batch(UdpSender *sender, UdpDatagram *batch, unsigned int count)
+{
+    struct mmsghdr messages[UDP_MAX_BATCH];
+    struct iovec vectors[UDP_MAX_BATCH];
+    memset(messages, 0, sizeof(struct mmsghdr) * count);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        vectors[i].iov_base = batch[i].data;
+        vectors[i].iov_len = batch[i].size;
+        messages[i].msg_hdr.msg_name = &sender->address;
+        messages[i].msg_hdr.msg_namelen = sender->address_len;
+        messages[i].msg_hdr.msg_iov = &vectors[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    unsigned int sent = 0;
+    while (sent < count)
+    {
+        int ret = sendmmsg(sender->fd, messages + sent, count - sent, 0);
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            LOG(logger, LOG_DEBUG, "Sendmmsg failed: %s", strerror(errno));
+            break;
+        }
+        sent += ret;
+    }
+    return sent;
+}
+
+static void *udp_loop(void *arg)
+{
+    UdpSender *sender = (UdpSender *)arg;
+    apply_affinity(ROLE_IO);
+
+    UdpDatagram batch[UDP_MAX_BATCH];
+    int64_t next = 0;
+
+    pthread_mutex_lock(&sender->mutex);
+    while (1)
+    {
+        while (!sender->stop && sender->datagrams->length == 0)
+            pthread_cond_wait(&sender->cond, &sender->mutex);
+        // 停止时仍按节奏发完积压, 最后一帧的数据报不被丢弃
+        if (sender->datagrams->length == 0)
+            break;
+
+        // 当前积压均匀分布在时间窗内, 新的帧到达后按更大的积压加快发送;
+        // 间隔过短时合并为一批, 使每次发送至少相隔 UDP_MIN_TICK
+        unsigned int depth = sender->datagrams->length;
+        int64_t gap = sender->window / depth;
+        unsigned int count = gap > 0 ? (UDP_MIN_TICK + gap - 1) / gap : UDP_MAX_BATCH;
+        count = FFMAX(1, FFMIN(count, FFMIN(depth, UDP_MAX_BATCH)));
+        for (unsigned int i = 0; i < count; i++)
+            pop_ring_buffer(sender->datagrams, &batch[i]);
+        pthread_mutex_unlock(&sender->mutex);
+
+        // 落后于计划时从当前时刻重新起步, 不以突发追赶
+        int64_t now = av_gettime_relative();
+        if (next < now)
+            next = now;
+        unsigned int sent = send_batch(sender, batch, count);
+        next += gap * count;
+
+        pthread_mutex_lock(&sender->mutex);
+        sender->stat.sent += sent;
+        sender->stat.failed += count - sent;
+        sender->stat.batches++;
+        pthread_mutex_unlock(&sender->mutex);
+
+        now = av_gettime_relative();
+        if (next > now)
+            av_usleep(next - now);
+        pthread_mutex_lock(&sender->mutex);
+    }
+    pthread_mutex_unlock(&sender->mutex);
+    return NULL;
+}
+
+/**
+ * @brief udp_write_packet AVIOContext 的写回调 按数据报切分后入队
+ * @note 缓冲为一个数据报大小, 每次回调通常恰好是一个数据报;
+ *       队列满时丢弃, 接收端按 TS 连续计数发现丢失
+ */
+static int udp_write_packet(void *opaque, uint8_t *data, int size)
+{
+    UdpSender *sender = (UdpSender *)opaque;
+    UdpDatagram datagram;
+
+    pthread_mutex_lock(&sender->mutex);
+    for (int offset = 0; offset < size; offset += datagram.size)
+    {
+        datagram.size = FFMIN(size - offset, UDP_DATAGRAM_SIZE);
+        memcpy(datagram.data, data + offset, datagram.size);
+        if (push_ring_buffer(sender->datagrams, &datagram) < 0)
+            sender->stat.dropped++;
+    }
+    if (sender->datagrams->length > sender->stat.max_depth)
+        sender->stat.max_depth = sender->datagrams->length;
+    pthread_cond_signal(&sender->cond);
+    pthread_mutex_unlock(&sender->mutex);
+    return size;
+}
+
+#pragma endregion
+
+UdpSender *open_udp_sender(const char *address, AVRational time_base)
+{
+    UdpSender *sender = (UdpSender *)calloc(1, sizeof(UdpSender));
+    if (!sender)
+    {
+        LOG(logger, LOG_ERROR, "Memory allocation failed");
+        return NULL;
+    }
+    sender->fd = -1;
+    sender->window = (int64_t)(av_q2d(time_base) * UDP_PACE_RATIO * 1000000);
+    if (open_udp_socket(sender, address) < 0)
+    {
+        free(sender);
+        return NULL;
+    }
+
+    sender->datagrams = create_ring_buffer(sizeof(UdpDatagram), UDP_QUEUE_SIZE);
+    uint8_t *io_buffer = (uint8_t *)av_malloc(UDP_DATAGRAM_SIZE);
+    if (sender->datagrams && io_buffer)
+        sender->pb = avio_alloc_context(io_buffer, UDP_DATAGRAM_SIZE, 1, sender, NULL, udp_write_packet, NULL);
+    if (!sender->pb)
+    {
+        LOG(logger, LOG_ERROR, "Alloc io context failed");
+        av_free(io_buffer);
+        if (sender->datagrams)
+            free_ring_buffer(sender->datagrams);
+        close(sender->fd);
+        free(sender);
+        return NULL;
+    }
+
+    pthread_mutex_init(&sender->mutex, NULL);
+    pthread_cond_init(&sender->cond, NULL);
+    if (pthread_create(&sender->thread, NULL, udp_loop, sender) != 0)
+    {
+        LOG(logger, LOG_ERROR, "Create udp sender thread failed");
+        pthread_cond_destroy(&sender->cond);
+        pthread_mutex_destroy(&sender->mutex);
+        av_freep(&sender->pb->buffer);
+        avio_context_free(&sender->pb);
+        free_ring_buffer(sender->datagrams);
+        close(sender->fd);
+        free(sender);
+        return NULL;
+    }
+
+    LOG(logger, LOG_DEBUG, "Open udp sender `%s`, pacing window %lld us", address, (long long)sender->window);
+    return sender;
+}
+
+UdpStat get_udp_sender_stat(UdpSender *sender)
+{
+    pthread_mutex_lock(&sender->mutex);
+    UdpStat stat = {
+        sender->stat.sent - sender->reported.sent,
+        sender->stat.dropped - sender->reported.dropped,
+        sender->stat.failed - sender->reported.failed,
+        sender->stat.batches - sender->reported.batches,
+        sender->stat.max_depth,
+    };
+    sender->reported = sender->stat;
+    sender->stat.max_depth = sender->datagrams->length;
+    pthread_mutex_unlock(&sender->mutex);
+    return stat;
+}
+
+void close_udp_sender(UdpSender *sender)
+{
+    // 缓冲中不足一个数据报的尾部也要入队
+    avio_flush(sender->pb);
+    pthread_mutex_lock(&sender->mutex);
+    sender->stop = 1;
+    pthread_cond_signal(&sender->cond);
+    pthread_mutex_unlock(&sender->mutex);
+    pthread_join(sender->thread, NULL);
+
+    LOG(logger, LOG_INFO, "Udp sender: %lld datagrams sent, %lld dropped, %lld failed",
+        (long long)sender->stat.sent, (long long)sender->stat.dropped, (long long)sender->stat.failed);
+    pthread_cond_destroy(&sender->cond);
+    pthread_mutex_destroy(&sender->mutex);
+    av_freep(&sender->pb->buffer);
+    avio_context_free(&sender->pb);
+    free_ring_buffer(sender->datagrams);
+    close(sender->fd);
+    free(sender);
+}
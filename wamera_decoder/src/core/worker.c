@@ -0,0 +1,166 @@
+#include <sched.h>
+
+#include "../../include/worker.h"
+
+// 当前线程所属的线程池及其队列索引, 非工作线程为NULL
+static __thread WorkerPool *current_pool = NULL;
+static __thread unsigned int current_index = 0;
+
+/**
+ * @brief take_task 从自己的队列开始依次尝试取出任务
+ * @return 成功返回0, 所有队列为空返回-1
+ */
+static int take_task(WorkerPool *pool, unsigned int index, Task *task)
+{
+    for (unsigned int i = 0; i < pool->num; i++)
+    {
+        WorkerQueue *queue = &pool->queues[(index + i) % pool->num];
+        pthread_mutex_lock(&queue->mutex);
+        int ret = pop_ring_buffer(queue->tasks, task);
+        pthread_mutex_unlock(&queue->mutex);
+        if (ret == 0)
+            return 0;
+    }
+    return -1;
+}
+
+static void *worker_loop(void *arg)
+{
+    WorkerQueue *queue = (WorkerQueue *)arg;
+    WorkerPool *pool = queue->pool;
+    unsigned int index = queue - pool->queues;
+    current_pool = pool;
+    current_index = index;
+    apply_affinity(ROLE_WORKER);
+
+    while (1)
+    {
+        pthread_mutex_lock(&pool->mutex);
+        while (pool->pending == 0 && !pool->stop)
+            pthread_cond_wait(&pool->cond, &pool->mutex);
+        if (pool->pending == 0)
+        {
+            pthread_mutex_unlock(&pool->mutex);
+            break;
+        }
+        // 预留一个任务, 预留数不超过队列中的任务总数
+        pool->pending--;
+        pthread_mutex_unlock(&pool->mutex);
+
+        Task task;
+        while (take_task(pool, index, &task) < 0)
+            sched_yield();
+        task.func(task.arg);
+    }
+    return NULL;
+}
+
+WorkerPool *open_worker_pool(unsigned int num)
+{
+    if (num == 0)
+        num = get_cpu_count();
+
+    WorkerPool *pool = (WorkerPool *)calloc(1, sizeof(WorkerPool));
+    if (!pool)
+    {
+        LOG(logger, LOG_ERROR, "Memory allocation failed");
+        return NULL;
+    }
+    pool->num = num;
+    pool->threads = (pthread_t *)calloc(num, sizeof(pthread_t));
+    pool->queues = (WorkerQueue *)calloc(num, sizeof(WorkerQueue));
+    if (!pool->threads || !pool->queues)
+    {
+        LOG(logger, LOG_ERROR, "Memory allocation failed");
+        free(pool->threads);
+        free(pool->queues);
+        free(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+
+    for (unsigned int i = 0; i < num; i++)
+    {
+        pool->queues[i].pool = pool;
+        pthread_mutex_init(&pool->queues[i].mutex, NULL);
+        pool->queues[i].tasks = create_ring_buffer(sizeof(Task), WORKER_QUEUE_SIZE);
+        if (!pool->queues[i].tasks)
+        {
+            LOG(logger, LOG_ERROR, "Memory allocation failed");
+            close_worker_pool(pool);
+            return NULL;
+        }
+    }
+
+    for (; pool->running < num; pool->running++)
+    {
+        if (pthread_create(&pool->threads[pool->running], NULL, worker_loop, &pool->queues[pool->running]) != 0)
+        {
+            LOG(logger, LOG_ERROR, "Create worker thread failed");
+            close_worker_pool(pool);
+            return NULL;
+        }
+    }
+
+    LOG(logger, LOG_INFO, "Open worker pool with %u threads", num);
+    return pool;
+}
+
+int submit_worker_pool(WorkerPool *pool, void (*func)(void *), void *arg)
+{
+    Task task = {func, arg};
+
+    unsigned int index;
+    if (current_pool == pool)
+        index = current_index;
+    else
+    {
+        pthread_mutex_lock(&pool->mutex);
+        index = pool->next++ % pool->num;
+        pthread_mutex_unlock(&pool->mutex);
+    }
+
+    // 首选的队列已满时依次尝试其他队列
+    int ret = -1;
+    for (unsigned int i = 0; i < pool->num && ret < 0; i++)
+    {
+        WorkerQueue *queue = &pool->queues[(index + i) % pool->num];
+        pthread_mutex_lock(&queue->mutex);
+        ret = push_ring_buffer(queue->tasks, &task);
+        pthread_mutex_unlock(&queue->mutex);
+    }
+    if (ret < 0)
+    {
+        LOG(logger, LOG_WARNING, "Worker queues are full");
+        return -1;
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->pending++;
+    pthread_cond_signal(&pool->cond);
+    pthread_mutex_unlock(&pool->mutex);
+    return 0;
+}
+
+void close_worker_pool(WorkerPool *pool)
+{
+    pthread_mutex_lock(&pool->mutex);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (unsigned int i = 0; i < pool->running; i++)
+        pthread_join(pool->threads[i], NULL);
+
+    for (unsigned int i = 0; i < pool->num; i++)
+    {
+        pthread_mutex_destroy(&pool->queues[i].mutex);
+        free_ring_buffer(pool->queues[i].tasks);
+    }
+    pthread_cond_destroy(&pool->cond);
+    pthread_mutex_destroy(&pool->mutex);
+    free(pool->queues);
+    free(pool->threads);
+    free(pool);
+}
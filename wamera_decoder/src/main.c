@@ -1,68 +1,469 @@
+#include <signal.h>
+#include <sys/epoll.h>
+
 #include "../include/logger.h"
-#include "../include/camera.h"
-#include "../include/codec.h"
 #include "../include/tool.h"
+#include "../include/settings.h"
+#include "../include/worker.h"
+#include "../include/pipeline.h"
+#include "../include/control.h"
+
+// 统计输出间隔 单位:s
+#define STAT_INTERVAL 10
+
+// 设备节点监视器在 epoll 中的标识 与相机序号区分
+#define HOTPLUG_EVENT UINT32_MAX
+
+// 事件循环的最长等待 单位:ms
+#define LOOP_TIMEOUT 1000
+
+static volatile sig_atomic_t running = 1;
+
+static void handle_signal(int sig)
+{
+    (void)sig;
+    running = 0;
+}
 
-int main()
+/**
+ * @brief check_cameras 以相机能力检查各路相机的采集设置, 启用采集模式校准的相机实测选择模式
+ * @note 帧率不受支持时改为最接近的可用帧率, 编码器的时间基与实际帧间隔一致;
+ *       能力与校准结果从缓存读取, 只打开设备查询属性, 不逐个枚举
+ */
+static void check_cameras(Array *cameras, const char *caps_dir)
 {
-    Config config = {1920, 1080, MJPEG, {1, 30}, 3600, 500000};
+    for (unsigned int i = 0; i < cameras->length; i++)
+    {
+        CameraSettings *settings = ARRAY_GET(cameras, CameraSettings, i);
+        Camera *camera = init_camera(settings->device);
+        if (!camera)
+            continue;
+        Array *configs = load_camera_configs(camera, caps_dir);
+        if (!configs)
+        {
+            destroy_camera(camera);
+            continue;
+        }
+
+        // 校准选出的帧间隔可能是实测值, 不再按标称帧间隔修正
+        int selected = 0;
+        if (settings->mode.enabled)
+        {
+            // 缓存的模式须仍在能力之中, 否则重新校准
+            Config request = settings->config, mode = settings->config;
+            unsigned int min_fps = settings->mode.min_fps;
+            int cached = read_camera_mode(camera, caps_dir, request, min_fps, &mode) == 0;
+            Config check = mode;
+            if (cached && match_camera_config(configs, &check) >= 0)
+            {
+                settings->config = mode;
+                selected = 1;
+                LOG(logger, LOG_INFO, "[%s] Use cached camera mode %ux%u at %.2f fps", settings->name, mode.width,
+                    mode.height, av_q2d(av_inv_q(mode.time_base)));
+            }
+            else if (calibrate_capture(settings, configs) == 0)
+            {
+                write_camera_mode(camera, caps_dir, request, min_fps, settings->config);
+                selected = 1;
+            }
+            else
+                LOG(logger, LOG_WARNING, "[%s] Calibrate camera mode failed", settings->name);
+        }
+        destroy_camera(camera);
+        if (selected)
+        {
+            free_array(configs);
+            continue;
+        }
+
+        AVRational time_base = settings->config.time_base;
+        int ret = match_camera_config(configs, &settings->config);
+        if (ret < 0)
+            LOG(logger, LOG_WARNING, "[%s] %ux%u %s is not supported by `%s`", settings->name,
+                settings->config.width, settings->config.height, settings->config.pix_format == MJPEG ? "MJPEG" : "YUYV",
+                settings->device);
+        else if (ret > 0)
+            LOG(logger, LOG_WARNING, "[%s] %.2f fps is not supported, use %.2f fps", settings->name,
+                av_q2d(av_inv_q(time_base)), av_q2d(av_inv_q(settings->config.time_base)));
+        free_array(configs);
+    }
+}
+
+/**
+ * @brief same_calibration 两路相机的校准条件是否相同
+ */
+static int same_calibration(const CameraSettings *a, const CameraSettings *b)
+{
+    return a->config.width == b->config.width && a->config.height == b->config.height &&
+           av_cmp_q(a->config.time_base, b->config.time_base) == 0 &&
+           a->config.encode_threads == b->config.encode_threads && strcmp(a->config.preset, b->config.preset) == 0 &&
+           strcmp(a->config.encoder, b->config.encoder) == 0 && a->governor.budget == b->governor.budget &&
+           (a->rtmp[0] != '\0') == (b->rtmp[0] != '\0') && (a->udp[0] != '\0') == (b->udp[0] != '\0') &&
+           (a->hls.dir[0] != '\0') == (b->hls.dir[0] != '\0') &&
+           (a->video_dir[0] != '\0') == (b->video_dir[0] != '\0');
+}
+
+/**
+ * @brief calibrate_cameras 校准所有编码器后端为 auto 的相机, 条件相同的相机复用结果
+ * @note 在线程池执行任务之前调用, 进程CPU时间只包含校准本身
+ */
+static void calibrate_cameras(Array *cameras)
+{
+    unsigned int num = cameras->length;
+    CameraSettings *origin = (CameraSettings *)malloc(num * sizeof(CameraSettings));
+    if (!origin)
+        return;
+    for (unsigned int i = 0; i < num; i++)
+    {
+        CameraSettings *camera = ARRAY_GET(cameras, CameraSettings, i);
+        origin[i] = *camera;
+        unsigned int j = 0;
+        while (j < i && !same_calibration(&origin[j], camera))
+            j++;
+        if (j < i)
+        {
+            CameraSettings *same = ARRAY_GET(cameras, CameraSettings, j);
+            memcpy(camera->config.encoder, same->config.encoder, sizeof(camera->config.encoder));
+            memcpy(camera->config.preset, same->config.preset, sizeof(camera->config.preset));
+        }
+        else if (calibrate_pipeline(camera) < 0)
+            LOG(logger, LOG_WARNING, "[%s] Calibrate encoder failed", camera->name);
+    }
+    free(origin);
+}
 
+/**
+ * @brief ControlContext 控制接口访问的流水线
+ * @property pipelines 各路相机的流水线 已关闭的为NULL
+ * @property num 相机数
+ * @property mutex 保护流水线的关闭, 控制线程不会访问已释放的流水线
+ */
+typedef struct ControlContext
+{
+    Pipeline **pipelines;
+    unsigned int num;
+    pthread_mutex_t mutex;
+} ControlContext;
+
+/**
+ * @brief handle_control 执行控制命令 `<相机名称> <键> = <值>`, 键与设置文件的 [camera] 节相同
+ */
+static int handle_control(void *opaque, char *command, char *reply, size_t size)
+{
+    ControlContext *context = (ControlContext *)opaque;
+    char *name = command + strspn(command, " \t");
+    char *key = name + strcspn(name, " \t");
+    char *eq = strchr(key, '=');
+    if (*key == '\0' || !eq)
+    {
+        snprintf(reply, size, "usage: <camera> <key> = <value>");
+        return -1;
+    }
+    *key++ = '\0';
+    *eq = '\0';
+    char *value = eq + 1;
+    key += strspn(key, " \t");
+    value += strspn(value, " \t");
+    for (char *end = eq; end > key && (end[-1] == ' ' || end[-1] == '\t');)
+        *--end = '\0';
+    for (char *end = value + strlen(value); end > value && (end[-1] == ' ' || end[-1] == '\t');)
+        *--end = '\0';
+
+    int ret = -3;
+    pthread_mutex_lock(&context->mutex);
+    for (unsigned int i = 0; i < context->num; i++)
+    {
+        Pipeline *pipeline = context->pipelines[i];
+        if (pipeline && strcmp(pipeline->settings.name, name) == 0)
+        {
+            ret = change_pipeline(pipeline, key, value);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&context->mutex);
+
+    if (ret == -3)
+        snprintf(reply, size, "no camera `%s`", name);
+    else if (ret == -2)
+        snprintf(reply, size, "`%s` needs restart", key);
+    else if (ret == -1)
+        snprintf(reply, size, "invalid `%s = %s`", key, value);
+    return ret < 0 ? -1 : 0;
+}
+
+/**
+ * @brief remove_pipeline 关闭出错的一路流水线 与控制线程互斥
+ */
+static void remove_pipeline(ControlContext *context, unsigned int index)
+{
+    pthread_mutex_lock(&context->mutex);
+    close_pipeline(context->pipelines[index]);
+    context->pipelines[index] = NULL;
+    pthread_mutex_unlock(&context->mutex);
+}
+
+/**
+ * @brief PipelineStartup 并行打开一路相机的参数与结果
+ */
+typedef struct PipelineStartup
+{
+    const CameraSettings *camera;
+    SinkConfig sink;
+    const char *caps_dir;
+    WorkerPool *workers;
+    Pipeline *pipeline;
+    pthread_t thread;
+    int started;
+} PipelineStartup;
+
+static void *start_pipeline(void *arg)
+{
+    PipelineStartup *startup = (PipelineStartup *)arg;
+    startup->pipeline = open_pipeline(startup->camera, startup->sink, startup->caps_dir, startup->workers);
+    return NULL;
+}
+
+/**
+ * @brief open_pipelines 各路相机的流水线互不依赖, 同时打开
+ * @note 看门狗重启后录像的中断时长取决于最慢的一路, 而不是所有相机的总和
+ */
+static void open_pipelines(Array *cameras, SinkConfig sink, const char *caps_dir, WorkerPool *workers,
+                           Pipeline **pipelines)
+{
+    unsigned int num = cameras->length;
+    PipelineStartup *startups = (PipelineStartup *)calloc(num, sizeof(PipelineStartup));
+    if (!startups)
+    {
+        LOG(logger, LOG_ERROR, "Memory allocation failed");
+        return;
+    }
+    for (unsigned int i = 0; i < num; i++)
+    {
+        startups[i] = (PipelineStartup){ARRAY_GET(cameras, CameraSettings, i), sink, caps_dir, workers, NULL, 0, 0};
+        startups[i].started = pthread_create(&startups[i].thread, NULL, start_pipeline, &startups[i]) == 0;
+        if (!startups[i].started)
+            start_pipeline(&startups[i]);
+    }
+    for (unsigned int i = 0; i < num; i++)
+    {
+        if (startups[i].started)
+            pthread_join(startups[i].thread, NULL);
+        pipelines[i] = startups[i].pipeline;
+    }
+    free(startups);
+}
+
+int main(int argc, char *argv[])
+{
     logger = init_logger("./log/test.log", LOG_DEBUG);
-    Camera *camera = init_camera("/dev/video2");
 
-    if (set_camera_config(camera, config) < 0)
-        LOG(logger, LOG_WARNING, "Set camera config failed");
-    if (open_camera(camera) < 0)
+    // 参数为设置文件路径, 省略时使用默认的单路相机
+    Settings *settings = load_settings(argc > 1 ? argv[1] : NULL);
+    if (!settings)
+        exit(-1);
+    unsigned int camera_num = settings->cameras->length;
+
+    // 在创建任何线程之前计算绑核集合
+    if (init_affinity(settings->affinity) < 0)
         exit(-1);
 
-    Codec *codec = init_codec(LOG_INFO);
-    if (open_codec(codec, config))
+    WorkerPool *workers = open_worker_pool(settings->workers);
+    if (!workers)
         exit(-1);
 
-    Output *rtmp_output = open_output(config, "rtmp://0.0.0.0:1935/wd_video/123", "flv");
-    Output *file_output = NULL;
-    const unsigned int num = 2;
-    Output *output[num];
-    unsigned int count = 0;
-    LOG(logger, LOG_INFO, "Start push stream");
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0)
+    {
+        LOG(logger, LOG_ERROR, "Create epoll failed");
+        exit(-1);
+    }
+
+    check_cameras(settings->cameras, settings->caps_dir);
+    calibrate_cameras(settings->cameras);
+
+    for (unsigned int i = 0; i < camera_num; i++)
+    {
+        CameraSettings *camera = ARRAY_GET(settings->cameras, CameraSettings, i);
+        // 未指定解码上下文数时按相机数均分线程池
+        if (camera->config.decode_threads == 0)
+        {
+            camera->config.decode_threads = workers->num / camera_num;
+            if (camera->config.decode_threads == 0)
+                camera->config.decode_threads = 1;
+        }
+    }
+
+    Pipeline **pipelines = (Pipeline **)calloc(camera_num, sizeof(Pipeline *));
+    open_pipelines(settings->cameras, settings->sink, settings->caps_dir, workers, pipelines);
+    unsigned int opened = 0;
+    for (unsigned int i = 0; i < camera_num; i++)
+    {
+        CameraSettings *camera = ARRAY_GET(settings->cameras, CameraSettings, i);
+        if (!pipelines[i])
+            continue;
+
+        struct epoll_event event = {.events = EPOLLIN, .data.u32 = i};
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, get_pipeline_fd(pipelines[i]), &event) < 0)
+        {
+            LOG(logger, LOG_ERROR, "[%s] Add camera to epoll failed", camera->name);
+            close_pipeline(pipelines[i]);
+            pipelines[i] = NULL;
+            continue;
+        }
+        opened++;
+    }
+    if (opened == 0)
+    {
+        LOG(logger, LOG_ERROR, "No camera opened");
+        exit(-1);
+    }
 
-    while (1)
+    // 回放服务只读录像目录, 未指定目录时服务第一路相机的录像
+    ArchiveServer *archive = NULL;
+    if (settings->archive.port != 0)
     {
-        if (count % get_save_frame(config) == 0)
+        if (settings->archive.dir[0] == '\0')
         {
-            time_t rawtime;
-            struct tm *timeinfo;
-            char timestamp[20];
-            time(&rawtime);
-            timeinfo = localtime(&rawtime);
-            strftime(timestamp, sizeof(timestamp), "%Y%m%d_%H%M%S", timeinfo);
-            char path[80];
-            sprintf(path, "/home/windlx/Work/Complex/Wamera/video/out_%s.mp4", timestamp);
-            file_output = open_output(config, path, "mp4");
-            LOG(logger, LOG_INFO, "Start write file: %s", path);
+            CameraSettings *first = ARRAY_GET(settings->cameras, CameraSettings, 0);
+            memcpy(settings->archive.dir, first->video_dir, sizeof(settings->archive.dir));
         }
-        BufType *frame = get_frame(camera);
-        output[0] = rtmp_output;
-        output[1] = file_output;
-        if (dispose_codec(codec, output, num, *frame, count) == -1)
+        if (!(archive = open_archive_server(settings->archive)))
+            LOG(logger, LOG_WARNING, "Open archive server failed");
+    }
+
+    // 设备节点出现时立即重新打开断开的相机, 监视器不可用时按重试间隔轮询
+    HotplugWatcher *watcher = NULL;
+    for (unsigned int i = 0; i < camera_num; i++)
+    {
+        CameraSettings *camera = ARRAY_GET(settings->cameras, CameraSettings, i);
+        if (!pipelines[i] || !camera->hotplug.enable || (!watcher && !(watcher = open_hotplug_watcher())))
+            continue;
+        watch_hotplug_device(watcher, camera->device);
+    }
+    if (watcher)
+    {
+        struct epoll_event event = {.events = EPOLLIN, .data.u32 = HOTPLUG_EVENT};
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, watcher->fd, &event) < 0)
+            LOG(logger, LOG_WARNING, "Add hotplug watcher to epoll failed, poll only");
+    }
+
+    ControlContext control_context = {pipelines, camera_num, PTHREAD_MUTEX_INITIALIZER};
+    ControlServer *control = NULL;
+    if (settings->control[0] != '\0' &&
+        !(control = open_control_server(settings->control, handle_control, &control_context)))
+        LOG(logger, LOG_WARNING, "Open control socket failed");
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handle_signal;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    // 所有线程创建完成后再提升采集线程的优先级
+    apply_affinity(ROLE_CAPTURE);
+    LOG(logger, LOG_INFO, "Start push stream with %u cameras", opened);
+
+    struct epoll_event events[16];
+    time_t last_stat = time(NULL);
+    int timeout = LOOP_TIMEOUT;
+    while (running && opened > 0)
+    {
+        int num = epoll_wait(epoll_fd, events, 16, timeout);
+        if (num < 0 && errno != EINTR)
+        {
+            LOG(logger, LOG_ERROR, "Epoll wait failed");
             break;
-        if (count % get_save_frame(config) == get_save_frame(config) - 1)
+        }
+
+        int hotplug = 0;
+        for (int i = 0; i < num; i++)
+        {
+            unsigned int index = events[i].data.u32;
+            if (index == HOTPLUG_EVENT)
+            {
+                hotplug = read_hotplug_watcher(watcher) > 0;
+                continue;
+            }
+            Pipeline *pipeline = pipelines[index];
+            if (!pipeline)
+                continue;
+            int ret = feed_pipeline(pipeline);
+            if (ret == 0 && (events[i].events & (EPOLLERR | EPOLLHUP)))
+                ret = -2;
+            if (ret == 0)
+                continue;
+
+            epoll_ctl(epoll_fd, EPOLL_CTL_DEL, get_pipeline_fd(pipeline), NULL);
+            // 相机断开时保留编码器与输出器, 等待相机重新出现
+            if (ret == -2 && suspend_pipeline(pipeline) == 0)
+                continue;
+            // 单路相机出错时只关闭该路
+            LOG(logger, LOG_ERROR, "[%s] Pipeline failed", pipeline->settings.name);
+            remove_pipeline(&control_context, index);
+            opened--;
+        }
+
+        // 断开的相机补帧并重试打开, 等待时间取最早的下一次补帧或重试
+        timeout = LOOP_TIMEOUT;
+        for (unsigned int i = 0; i < camera_num; i++)
         {
-            close_output(file_output);
+            Pipeline *pipeline = pipelines[i];
+            if (!pipeline || !pipeline->offline)
+                continue;
+            int ret = resume_pipeline(pipeline, hotplug);
+            if (ret == 0)
+            {
+                struct epoll_event event = {.events = EPOLLIN, .data.u32 = i};
+                if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, get_pipeline_fd(pipeline), &event) == 0)
+                    continue;
+                LOG(logger, LOG_ERROR, "[%s] Add camera to epoll failed", pipeline->settings.name);
+            }
+            else if (ret == -2)
+                LOG(logger, LOG_ERROR, "[%s] Pipeline failed", pipeline->settings.name);
+            else
+            {
+                int wait = fill_pipeline(pipeline);
+                if (wait >= 0)
+                {
+                    timeout = FFMIN(timeout, wait);
+                    continue;
+                }
+                LOG(logger, LOG_ERROR, "[%s] Pipeline failed", pipeline->settings.name);
+            }
+            remove_pipeline(&control_context, i);
+            opened--;
+        }
+
+        time_t now = time(NULL);
+        if (now - last_stat >= STAT_INTERVAL)
+        {
+            for (unsigned int i = 0; i < camera_num; i++)
+                if (pipelines[i])
+                    log_pipeline_stat(pipelines[i], (double)(now - last_stat));
+            last_stat = now;
         }
-        count++;
     }
 
-    if (close_output(rtmp_output) < 0)
-        exit(-1);
-    if (file_output)
-        if (close_output(file_output) < 0)
-            exit(-1);
     LOG(logger, LOG_INFO, "End push stream");
-    close_codec(codec);
-    destroy_codec(codec);
-    close_camera(camera);
-    destroy_camera(camera);
+    if (control)
+        close_control_server(control);
+    if (watcher)
+        close_hotplug_watcher(watcher);
+    for (unsigned int i = 0; i < camera_num; i++)
+    {
+        if (!pipelines[i])
+            continue;
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, get_pipeline_fd(pipelines[i]), NULL);
+        close_pipeline(pipelines[i]);
+    }
+    free(pipelines);
+    // 录像文件在后台同步, 退出前确保全部落盘
+    wait_file_sinks();
+    if (archive)
+        close_archive_server(archive);
+    close(epoll_fd);
+    close_worker_pool(workers);
+    free_settings(settings);
     LOG(logger, LOG_INFO, "Close camera");
     destroy_logger(logger);
-}
\ No newline at end of file
+}
@@ -0,0 +1,200 @@
+#define _GNU_SOURCE
+
+#include <sched.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "../../include/affinity.h"
+
+// 调用线程最近一次设置的角色
+static __thread ThreadRole current_role = ROLE_CAPTURE;
+
+static const char *role_names[ROLE_NUM] = {"capture", "worker", "encode", "io"};
+
+// 各角色的CPU集合 初始化后只读
+static struct
+{
+    int initialized;
+    cpu_set_t sets[ROLE_NUM];
+    int restricted[ROLE_NUM];
+    int capture_priority;
+} affinity;
+
+/**
+ * @brief parse_cpu_list 解析形如 "0-3,6" 的CPU列表
+ * @return 成功返回CPU数, 格式错误返回-1
+ */
+static int parse_cpu_list(const char *list, cpu_set_t *set)
+{
+    CPU_ZERO(set);
+    const char *str = list;
+    while (*str)
+    {
+        char *end;
+        long first = strtol(str, &end, 10);
+        if (end == str || first < 0)
+            return -1;
+        long last = first;
+        str = end;
+        if (*str == '-')
+        {
+            last = strtol(str + 1, &end, 10);
+            if (end == str + 1 || last < first)
+                return -1;
+            str = end;
+        }
+        if (last >= CPU_SETSIZE)
+            return -1;
+        for (long cpu = first; cpu <= last; cpu++)
+            CPU_SET(cpu, set);
+        if (*str == ',')
+            str++;
+        else if (*str != '\0')
+            return -1;
+    }
+    return CPU_COUNT(set);
+}
+
+/**
+ * @brief add_siblings 将CPU的超线程兄弟加入集合
+ * @note 拓扑不可读时只加入CPU本身
+ */
+static void add_siblings(int cpu, cpu_set_t *set)
+{
+    CPU_SET(cpu, set);
+
+    char path[96];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", cpu);
+    FILE *file = fopen(path, "r");
+    if (!file)
+        return;
+    char list[AFFINITY_LIST_SIZE];
+    cpu_set_t siblings;
+    if (fgets(list, sizeof(list), file))
+    {
+        list[strcspn(list, "\n")] = '\0';
+        if (parse_cpu_list(list, &siblings) > 0)
+            CPU_OR(set, set, &siblings);
+    }
+    fclose(file);
+}
+
+/**
+ * @brief format_cpu_list 将CPU集合格式化为列表 用于日志
+ */
+static void format_cpu_list(const cpu_set_t *set, char *buf, size_t size)
+{
+    size_t length = 0;
+    buf[0] = '\0';
+    for (int cpu = 0; cpu < CPU_SETSIZE && length < size; cpu++)
+        if (CPU_ISSET(cpu, set))
+            length += snprintf(buf + length, size - length, length ? ",%d" : "%d", cpu);
+}
+
+int init_affinity(AffinityConfig config)
+{
+    affinity.initialized = 0;
+    cpu_set_t online;
+    if (sched_getaffinity(0, sizeof(online), &online) < 0)
+    {
+        LOG(logger, LOG_WARNING, "Get process affinity failed");
+        return -1;
+    }
+
+    for (int role = 0; role < ROLE_NUM; role++)
+    {
+        affinity.sets[role] = online;
+        affinity.restricted[role] = config.cpus[role][0] != '\0';
+        if (!affinity.restricted[role])
+            continue;
+        cpu_set_t set;
+        if (parse_cpu_list(config.cpus[role], &set) <= 0)
+        {
+            LOG(logger, LOG_ERROR, "Invalid %s cpus `%s`", role_names[role], config.cpus[role]);
+            return -1;
+        }
+        CPU_AND(&affinity.sets[role], &set, &online);
+        if (CPU_COUNT(&affinity.sets[role]) == 0)
+        {
+            LOG(logger, LOG_ERROR, "No online cpu in %s cpus `%s`", role_names[role], config.cpus[role]);
+            return -1;
+        }
+    }
+
+    // 采集线程独占所在的物理核, 解码与编码线程避开其超线程兄弟
+    if (config.avoid_smt && affinity.restricted[ROLE_CAPTURE])
+    {
+        cpu_set_t excluded;
+        CPU_ZERO(&excluded);
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+            if (CPU_ISSET(cpu, &affinity.sets[ROLE_CAPTURE]))
+                add_siblings(cpu, &excluded);
+
+        ThreadRole roles[] = {ROLE_WORKER, ROLE_ENCODE};
+        for (unsigned int i = 0; i < sizeof(roles) / sizeof(roles[0]); i++)
+        {
+            cpu_set_t *set = &affinity.sets[roles[i]];
+            cpu_set_t rest;
+            CPU_XOR(&rest, set, &excluded);
+            CPU_AND(&rest, &rest, set);
+            if (CPU_COUNT(&rest) == 0)
+            {
+                LOG(logger, LOG_WARNING, "%s cpus only share cores with capture, keep them", role_names[roles[i]]);
+                continue;
+            }
+            *set = rest;
+            affinity.restricted[roles[i]] = 1;
+        }
+    }
+
+    affinity.capture_priority = config.capture_priority;
+    affinity.initialized = 1;
+
+    for (int role = 0; role < ROLE_NUM; role++)
+    {
+        char list[256];
+        format_cpu_list(&affinity.sets[role], list, sizeof(list));
+        LOG(logger, LOG_INFO, "Affinity %s: %s", role_names[role], affinity.restricted[role] ? list : "unrestricted");
+    }
+    return 0;
+}
+
+int apply_affinity(ThreadRole role)
+{
+    current_role = role;
+    if (!affinity.initialized)
+        return 0;
+
+    int ret = 0;
+    pthread_t thread = pthread_self();
+    if (pthread_setaffinity_np(thread, sizeof(cpu_set_t), &affinity.sets[role]) != 0)
+    {
+        LOG(logger, LOG_WARNING, "Set %s thread affinity failed", role_names[role]);
+        ret = -1;
+    }
+
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    int policy = SCHED_OTHER;
+    if (role == ROLE_CAPTURE && affinity.capture_priority > 0)
+    {
+        policy = SCHED_FIFO;
+        param.sched_priority = affinity.capture_priority;
+    }
+    int err = pthread_setschedparam(thread, policy, &param);
+    if (err != 0)
+    {
+        // 没有 CAP_SYS_NICE 或 RLIMIT_RTPRIO 时保持普通调度
+        LOG(logger, LOG_WARNING, "Set %s thread scheduling failed: %s", role_names[role], strerror(err));
+        ret = -1;
+    }
+    return ret;
+}
+
+ThreadRole get_thread_role(void)
+{
+    return current_role;
+}
@@ -0,0 +1,408 @@
+#include "../../include/settings.h"
+
+/**
+ * @brief default_camera 默认的相机设置
+ */
+static CameraSettings default_camera(unsigned int index)
+{
+    CameraSettings camera = {
+        .config = {1920, 1080, MJPEG, {1, 30}, 3600, 500000, 0, 1, 0, "", "auto", 0, 0, 0, 0},
+        .rate = {1, 0, 60, 500000, 2},
+        .governor = {0, 2, 2},
+        .motion = {0, 6, 0.1, 0.06},
+        .osd = {0, 16, 16, 0},
+        .mask = {MASK_PIXELATE, 16, 0, {{0}}},
+        .denoise = {0, 60, 12},
+        .snapshot = {0, "", 1000000, 0, 10000000},
+        .tap = {0, TAP_GRAY, 640, 4, ""},
+        .hls = {2000, 500, 6, ""},
+        .mode = {0, 0, 1000},
+        .hotplug = {1, FILL_NONE, 1000},
+    };
+    snprintf(camera.name, sizeof(camera.name), "cam%u", index);
+    snprintf(camera.device, sizeof(camera.device), "/dev/video%u", index);
+    return camera;
+}
+
+/**
+ * @brief trim 去除首尾空白
+ */
+static char *trim(char *str)
+{
+    while (*str == ' ' || *str == '\t')
+        str++;
+    size_t length = strlen(str);
+    while (length > 0 && strchr(" \t\r\n", str[length - 1]))
+        str[--length] = '\0';
+    return str;
+}
+
+/**
+ * @brief copy_value 复制字符串值, 超长时截断
+ */
+static void copy_value(char *dst, size_t size, const char *value)
+{
+    snprintf(dst, size, "%s", value);
+}
+
+/**
+ * @brief parse_global 解析 [global] 节的键
+ * @return 成功返回0, 未知的键或值返回-1
+ */
+static int parse_global(Settings *settings, const char *key, const char *value)
+{
+    if (strcmp(key, "workers") == 0)
+        settings->workers = strtoul(value, NULL, 10);
+    else if (strcmp(key, "chunk_size") == 0)
+        settings->sink.chunk_size = strtoul(value, NULL, 10);
+    else if (strcmp(key, "sync_interval") == 0)
+        settings->sink.sync_interval = strtoul(value, NULL, 10);
+    else if (strcmp(key, "sync_bytes") == 0)
+        settings->sink.sync_bytes = strtoll(value, NULL, 10);
+    else if (strcmp(key, "queue_depth") == 0)
+        settings->sink.queue_depth = strtoul(value, NULL, 10);
+    else if (strcmp(key, "capture_cpus") == 0)
+        copy_value(settings->affinity.cpus[ROLE_CAPTURE], AFFINITY_LIST_SIZE, value);
+    else if (strcmp(key, "worker_cpus") == 0)
+        copy_value(settings->affinity.cpus[ROLE_WORKER], AFFINITY_LIST_SIZE, value);
+    else if (strcmp(key, "encode_cpus") == 0)
+        copy_value(settings->affinity.cpus[ROLE_ENCODE], AFFINITY_LIST_SIZE, value);
+    else if (strcmp(key, "io_cpus") == 0)
+        copy_value(settings->affinity.cpus[ROLE_IO], AFFINITY_LIST_SIZE, value);
+    else if (strcmp(key, "capture_priority") == 0)
+        settings->affinity.capture_priority = atoi(value);
+    else if (strcmp(key, "avoid_smt") == 0)
+        settings->affinity.avoid_smt = atoi(value);
+    else if (strcmp(key, "archive_port") == 0)
+        settings->archive.port = strtoul(value, NULL, 10);
+    else if (strcmp(key, "archive_connections") == 0)
+        settings->archive.connections = strtoul(value, NULL, 10);
+    else if (strcmp(key, "archive_address") == 0)
+        copy_value(settings->archive.address, sizeof(settings->archive.address), value);
+    else if (strcmp(key, "archive_dir") == 0)
+        copy_value(settings->archive.dir, sizeof(settings->archive.dir), value);
+    else if (strcmp(key, "control") == 0)
+        copy_value(settings->control, sizeof(settings->control), value);
+    else if (strcmp(key, "caps_dir") == 0)
+        copy_value(settings->caps_dir, sizeof(settings->caps_dir), value);
+    else if (strcmp(key, "backend") == 0)
+    {
+        if (strcasecmp(value, "sync") == 0)
+            settings->sink.backend = AIO_SYNC;
+        else if (strcasecmp(value, "uring") == 0)
+            settings->sink.backend = AIO_URING;
+        else if (strcasecmp(value, "thread") == 0)
+            settings->sink.backend = AIO_THREAD;
+        else
+            return -1;
+    }
+    else
+        return -1;
+    return 0;
+}
+
+/**
+ * @brief parse_camera 解析 [camera] 节的键
+ * @return 成功返回0, 未知的键或值返回-1
+ */
+static int parse_camera(CameraSettings *camera, const char *key, const char *value)
+{
+    Config *config = &camera->config;
+    if (strcmp(key, "name") == 0)
+        copy_value(camera->name, sizeof(camera->name), value);
+    else if (strcmp(key, "device") == 0)
+        copy_value(camera->device, sizeof(camera->device), value);
+    else if (strcmp(key, "rtmp") == 0)
+        copy_value(camera->rtmp, sizeof(camera->rtmp), value);
+    else if (strcmp(key, "udp") == 0)
+        copy_value(camera->udp, sizeof(camera->udp), value);
+    else if (strcmp(key, "video_dir") == 0)
+        copy_value(camera->video_dir, sizeof(camera->video_dir), value);
+    else if (strcmp(key, "width") == 0)
+        config->width = strtoul(value, NULL, 10);
+    else if (strcmp(key, "height") == 0)
+        config->height = strtoul(value, NULL, 10);
+    else if (strcmp(key, "size") == 0)
+    {
+        // 宽高一起修改, 运行时切换分辨率不经过宽高混合的中间尺寸
+        unsigned int width, height;
+        if (sscanf(value, "%ux%u", &width, &height) != 2)
+            return -1;
+        config->width = width;
+        config->height = height;
+    }
+    else if (strcmp(key, "fps") == 0)
+    {
+        int fps = atoi(value);
+        if (fps <= 0)
+            return -1;
+        config->time_base = (AVRational){1, fps};
+    }
+    else if (strcmp(key, "format") == 0)
+    {
+        if (strcasecmp(value, "mjpeg") == 0)
+            config->pix_format = MJPEG;
+        else if (strcasecmp(value, "yuyv") == 0)
+            config->pix_format = YUYV;
+        else
+            return -1;
+    }
+    else if (strcmp(key, "capture_mode") == 0)
+    {
+        if (strcasecmp(value, "auto") == 0)
+            camera->mode.enabled = 1;
+        else if (strcasecmp(value, "fixed") == 0)
+            camera->mode.enabled = 0;
+        else
+            return -1;
+    }
+    else if (strcmp(key, "min_fps") == 0)
+        camera->mode.min_fps = strtoul(value, NULL, 10);
+    else if (strcmp(key, "mode_duration") == 0)
+    {
+        // 测量时长为0时无法计算帧率
+        camera->mode.duration = strtoul(value, NULL, 10);
+        if (camera->mode.duration == 0)
+            return -1;
+    }
+    else if (strcmp(key, "hotplug") == 0)
+        camera->hotplug.enable = atoi(value);
+    else if (strcmp(key, "hotplug_fill") == 0)
+    {
+        if (strcasecmp(value, "none") == 0)
+            camera->hotplug.fill = FILL_NONE;
+        else if (strcasecmp(value, "repeat") == 0)
+            camera->hotplug.fill = FILL_REPEAT;
+        else if (strcasecmp(value, "black") == 0)
+            camera->hotplug.fill = FILL_BLACK;
+        else
+            return -1;
+    }
+    else if (strcmp(key, "hotplug_retry") == 0)
+        camera->hotplug.retry = strtoul(value, NULL, 10);
+    else if (strcmp(key, "save_time") == 0)
+        config->save_time = strtoul(value, NULL, 10);
+    else if (strcmp(key, "bit_rate") == 0)
+        config->bit_rate = strtoll(value, NULL, 10);
+    else if (strcmp(key, "decode_threads") == 0)
+        config->decode_threads = strtoul(value, NULL, 10);
+    else if (strcmp(key, "encode_threads") == 0)
+        config->encode_threads = strtoul(value, NULL, 10);
+    else if (strcmp(key, "huge_pages") == 0)
+        config->huge_pages = atoi(value);
+    else if (strcmp(key, "preset") == 0)
+        copy_value(config->preset, sizeof(config->preset), value);
+    else if (strcmp(key, "encoder") == 0)
+        copy_value(config->encoder, sizeof(config->encoder), value);
+    else if (strcmp(key, "intra_refresh") == 0)
+        config->intra_refresh = atoi(value);
+    else if (strcmp(key, "slice_max_size") == 0)
+        config->slice_max_size = strtoul(value, NULL, 10);
+    else if (strcmp(key, "vbv_latency") == 0)
+        config->vbv_latency = strtoul(value, NULL, 10);
+    else if (strcmp(key, "cpu_budget") == 0)
+        camera->governor.budget = atof(value);
+    else if (strcmp(key, "max_decimate") == 0)
+        camera->governor.max_decimate = strtoul(value, NULL, 10);
+    else if (strcmp(key, "governor_steps") == 0)
+        camera->governor.scale_steps = strtoul(value, NULL, 10);
+    else if (strcmp(key, "roi") == 0)
+        camera->motion.enable = atoi(value);
+    else if (strcmp(key, "roi_threshold") == 0)
+        camera->motion.threshold = strtoul(value, NULL, 10);
+    else if (strcmp(key, "roi_static_qoffset") == 0)
+        camera->motion.static_qoffset = atof(value);
+    else if (strcmp(key, "roi_motion_qoffset") == 0)
+        camera->motion.motion_qoffset = atof(value);
+    else if (strcmp(key, "osd") == 0)
+        camera->osd.enable = atoi(value);
+    else if (strcmp(key, "osd_x") == 0)
+        camera->osd.x = atoi(value);
+    else if (strcmp(key, "osd_y") == 0)
+        camera->osd.y = atoi(value);
+    else if (strcmp(key, "osd_scale") == 0)
+        camera->osd.scale = strtoul(value, NULL, 10);
+    else if (strcmp(key, "mask") == 0)
+    {
+        // 每行添加一个遮挡区域
+        if (camera->mask.num == MASK_MAX_SHAPES || parse_mask_shape(&camera->mask.shapes[camera->mask.num], value) < 0)
+            return -1;
+        camera->mask.num++;
+    }
+    else if (strcmp(key, "mask_mode") == 0)
+    {
+        if (strcasecmp(value, "pixelate") == 0)
+            camera->mask.mode = MASK_PIXELATE;
+        else if (strcasecmp(value, "blur") == 0)
+            camera->mask.mode = MASK_BLUR;
+        else if (strcasecmp(value, "fill") == 0)
+            camera->mask.mode = MASK_FILL;
+        else
+            return -1;
+    }
+    else if (strcmp(key, "mask_block") == 0)
+        camera->mask.block = strtoul(value, NULL, 10);
+    else if (strcmp(key, "denoise") == 0)
+        camera->denoise.enable = atoi(value);
+    else if (strcmp(key, "denoise_strength") == 0)
+        camera->denoise.strength = strtoul(value, NULL, 10);
+    else if (strcmp(key, "denoise_threshold") == 0)
+        camera->denoise.threshold = strtoul(value, NULL, 10);
+    else if (strcmp(key, "snapshot") == 0)
+        camera->snapshot.enable = atoi(value);
+    else if (strcmp(key, "snapshot_dir") == 0)
+        copy_value(camera->snapshot.dir, sizeof(camera->snapshot.dir), value);
+    else if (strcmp(key, "snapshot_interval") == 0)
+        camera->snapshot.interval = strtoll(value, NULL, 10) * 1000;
+    else if (strcmp(key, "thumb_width") == 0)
+        camera->snapshot.thumb_width = strtoul(value, NULL, 10);
+    else if (strcmp(key, "thumb_interval") == 0)
+        camera->snapshot.thumb_interval = strtoll(value, NULL, 10) * 1000;
+    else if (strcmp(key, "tap") == 0)
+        camera->tap.enable = atoi(value);
+    else if (strcmp(key, "tap_name") == 0)
+        copy_value(camera->tap.name, sizeof(camera->tap.name), value);
+    else if (strcmp(key, "tap_format") == 0)
+    {
+        if (strcasecmp(value, "gray") == 0)
+            camera->tap.format = TAP_GRAY;
+        else if (strcasecmp(value, "rgb") == 0)
+            camera->tap.format = TAP_RGB;
+        else if (strcasecmp(value, "yuv420p") == 0)
+            camera->tap.format = TAP_YUV420P;
+        else
+            return -1;
+    }
+    else if (strcmp(key, "tap_width") == 0)
+        camera->tap.width = strtoul(value, NULL, 10);
+    else if (strcmp(key, "tap_slots") == 0)
+        camera->tap.slots = strtoul(value, NULL, 10);
+    else if (strcmp(key, "hls") == 0)
+        copy_value(camera->hls.dir, sizeof(camera->hls.dir), value);
+    else if (strcmp(key, "hls_segment") == 0)
+        camera->hls.segment = strtoul(value, NULL, 10);
+    else if (strcmp(key, "hls_part") == 0)
+        camera->hls.part = strtoul(value, NULL, 10);
+    else if (strcmp(key, "hls_window") == 0)
+        camera->hls.window = strtoul(value, NULL, 10);
+    else if (strcmp(key, "adaptive") == 0)
+        camera->rate.enable = atoi(value);
+    else if (strcmp(key, "min_bit_rate") == 0)
+        camera->rate.min_bit_rate = strtoll(value, NULL, 10);
+    else if (strcmp(key, "live_queue") == 0)
+    {
+        camera->rate.queue_size = strtoul(value, NULL, 10);
+        if (camera->rate.queue_size == 0)
+            return -1;
+    }
+    else if (strcmp(key, "max_latency") == 0)
+        camera->rate.max_latency = strtoll(value, NULL, 10) * 1000;
+    else if (strcmp(key, "scale_steps") == 0)
+        camera->rate.scale_steps = strtoul(value, NULL, 10);
+    else
+        return -1;
+    return 0;
+}
+
+Settings *load_settings(const char *path)
+{
+    Settings *settings = (Settings *)calloc(1, sizeof(Settings));
+    if (!settings)
+    {
+        LOG(logger, LOG_ERROR, "Memory allocation failed");
+        return NULL;
+    }
+    settings->sink = (SinkConfig){SINK_CHUNK_SIZE, 10, 64 << 20, AIO_URING, 4};
+    settings->affinity.avoid_smt = 1;
+    settings->archive = (ArchiveConfig){0, 4, "127.0.0.1", ""};
+    copy_value(settings->caps_dir, sizeof(settings->caps_dir), "/var/cache/wamera");
+    settings->cameras = create_array(sizeof(CameraSettings), 4);
+    if (!settings->cameras)
+    {
+        LOG(logger, LOG_ERROR, "Memory allocation failed");
+        free(settings);
+        return NULL;
+    }
+
+    // 没有设置文件时使用原先的单路相机设置
+    if (!path)
+    {
+        CameraSettings camera = default_camera(2);
+        copy_value(camera.rtmp, sizeof(camera.rtmp), "rtmp://0.0.0.0:1935/wd_video/123");
+        copy_value(camera.video_dir, sizeof(camera.video_dir), "/home/windlx/Work/Complex/Wamera/video");
+        append_array(settings->cameras, &camera);
+        return settings;
+    }
+
+    FILE *file = fopen(path, "r");
+    if (!file)
+    {
+        LOG(logger, LOG_ERROR, "Open settings `%s` failed", path);
+        free_settings(settings);
+        return NULL;
+    }
+
+    char buf[SETTINGS_LINE_SIZE];
+    int in_camera = 0;
+    unsigned int line = 0;
+    while (fgets(buf, sizeof(buf), file))
+    {
+        line++;
+        char *str = trim(buf);
+        if (*str == '\0' || *str == '#' || *str == ';')
+            continue;
+
+        if (*str == '[')
+        {
+            char *end = strchr(str, ']');
+            if (end)
+                *end = '\0';
+            str = trim(str + 1);
+            in_camera = strcmp(str, "camera") == 0;
+            if (in_camera)
+            {
+                CameraSettings camera = default_camera(settings->cameras->length);
+                append_array(settings->cameras, &camera);
+            }
+            else if (strcmp(str, "global") != 0)
+                LOG(logger, LOG_WARNING, "%s:%u unknown section `%s`", path, line, str);
+            continue;
+        }
+
+        char *eq = strchr(str, '=');
+        if (!eq)
+        {
+            LOG(logger, LOG_WARNING, "%s:%u missing `=`", path, line);
+            continue;
+        }
+        *eq = '\0';
+        char *key = trim(str);
+        char *value = trim(eq + 1);
+        int ret = in_camera
+                      ? parse_camera(ARRAY_GET(settings->cameras, CameraSettings, settings->cameras->length - 1), key, value)
+                      : parse_global(settings, key, value);
+        if (ret < 0)
+            LOG(logger, LOG_WARNING, "%s:%u ignore `%s = %s`", path, line, key, value);
+    }
+    fclose(file);
+
+    if (settings->cameras->length == 0)
+    {
+        LOG(logger, LOG_ERROR, "No camera in settings `%s`", path);
+        free_settings(settings);
+        return NULL;
+    }
+    LOG(logger, LOG_INFO, "Load %u cameras from `%s`", settings->cameras->length, path);
+    return settings;
+}
+
+int set_camera_setting(CameraSettings *camera, const char *key, const char *value)
+{
+    return parse_camera(camera, key, value);
+}
+
+void free_settings(Settings *settings)
+{
+    free_array(settings->cameras);
+    free(settings);
+}
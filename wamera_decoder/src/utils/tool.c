@@ -1,3 +1,7 @@
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
 #include "../../include/tool.h"
 
 void destroy_buf(BufType *buf)
@@ -14,99 +18,205 @@ unsigned int get_save_frame(Config config)
     return (unsigned int)av_q2d(av_inv_q(config.time_base)) * config.save_time;
 }
 
-LinkedList *create_linked_list()
+unsigned int get_cpu_count(void)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 0 ? (unsigned int)cpus : 1;
+}
+
+int64_t get_thread_cpu_time(void)
 {
-    LinkedList *list = (LinkedList *)malloc(sizeof(LinkedList));
-    if (list)
-        list->head = NULL;
-    return list;
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
 }
 
-void free_linked_list(LinkedList *list)
+Array *create_array(size_t elem_size, unsigned int capacity)
 {
-    Node *cur = list->head;
-    while (cur)
+    Array *array = (Array *)malloc(sizeof(Array));
+    if (!array)
+        return NULL;
+    if (capacity == 0)
+        capacity = 8;
+    array->data = malloc(elem_size * capacity);
+    if (!array->data)
     {
-        Node *temp = cur;
-        cur = cur->next;
-        free(temp->data);
-        free(temp);
+        free(array);
+        return NULL;
     }
-    free(list);
+    array->elem_size = elem_size;
+    array->length = 0;
+    array->capacity = capacity;
+    return array;
 }
 
-void append_linked_list(LinkedList *list, void *data)
+void free_array(Array *array)
 {
-    Node *new_node = (Node *)malloc(sizeof(Node));
-    if (new_node)
+    if (array)
     {
-        new_node->data = data;
-        new_node->next = NULL;
+        free(array->data);
+        free(array);
+    }
+}
 
-        if (!list->head)
-            list->head = new_node;
-        else
+int append_array(Array *array, const void *elem)
+{
+    if (array->length == array->capacity)
+    {
+        void *data = realloc(array->data, array->elem_size * array->capacity * 2);
+        if (!data)
         {
-            Node *current = list->head;
-            while (current->next)
-            {
-                current = current->next;
-            }
-            current->next = new_node;
+            LOG(logger, LOG_ERROR, "Memory allocation failed");
+            return -1;
         }
+        array->data = data;
+        array->capacity *= 2;
     }
+    memcpy((uint8_t *)array->data + array->elem_size * array->length, elem, array->elem_size);
+    array->length++;
+    return 0;
 }
 
-void foreach_linked_list(LinkedList *list, void (*func)(void *))
+void *get_array(Array *array, unsigned int index)
 {
-    Node *current = list->head;
-    while (current)
+    if (index >= array->length)
     {
-        func(current->data);
-        current = current->next;
+        LOG(logger, LOG_ERROR, "Index out of range: `%u`", index);
+        return NULL;
     }
+    return (uint8_t *)array->data + array->elem_size * index;
+}
+
+int remove_array(Array *array, unsigned int index)
+{
+    if (index >= array->length)
+        return -1;
+    uint8_t *elem = (uint8_t *)array->data + array->elem_size * index;
+    memmove(elem, elem + array->elem_size, array->elem_size * (array->length - index - 1));
+    array->length--;
+    return 0;
+}
+
+void foreach_array(Array *array, void (*func)(void *))
+{
+    for (unsigned int i = 0; i < array->length; i++)
+        func((uint8_t *)array->data + array->elem_size * i);
 }
 
-void *get_linked_list(LinkedList *list, unsigned int index)
+RingBuffer *create_ring_buffer(size_t elem_size, unsigned int capacity)
 {
-    unsigned int count = 0;
-    Node *current = list->head;
-    while (current)
+    RingBuffer *ring = (RingBuffer *)malloc(sizeof(RingBuffer));
+    if (!ring)
+        return NULL;
+    // 与数组一致, 容量为0时使用默认容量, 出入队不会对0取模
+    if (capacity == 0)
+        capacity = 8;
+    ring->data = malloc(elem_size * capacity);
+    if (!ring->data)
     {
-        if (count < index)
-        {
-            count++;
-            current = current->next;
-        }
-        else if (count == index)
-        {
-            return current->data;
-        }
+        free(ring);
+        return NULL;
     }
-    LOG(logger, LOG_ERROR, "Index out of range: `%d`", index);
-    return NULL;
+    ring->elem_size = elem_size;
+    ring->capacity = capacity;
+    ring->head = 0;
+    ring->length = 0;
+    return ring;
 }
 
-int remove_linked_list(LinkedList *list, unsigned int index)
+void free_ring_buffer(RingBuffer *ring)
 {
-    unsigned int count = 0;
-    Node *current = list->head;
-    while (current)
+    if (ring)
     {
-        if (count < index - 1)
-        {
-            count++;
-            current = current->next;
-        }
-        else if (count == index - 1)
-        {
-            Node *removed_item = current->next;
-            current->next = current->next->next;
-            removed_item->next = NULL;
-            free(removed_item->data);
-            free(removed_item);
-            return 0;
-        }
+        free(ring->data);
+        free(ring);
+    }
+}
+
+int push_ring_buffer(RingBuffer *ring, const void *elem)
+{
+    if (ring->length == ring->capacity)
+        return -1;
+    unsigned int tail = (ring->head + ring->length) % ring->capacity;
+    memcpy((uint8_t *)ring->data + ring->elem_size * tail, elem, ring->elem_size);
+    ring->length++;
+    return 0;
+}
+
+int pop_ring_buffer(RingBuffer *ring, void *elem)
+{
+    if (ring->length == 0)
+        return -1;
+    if (elem)
+        memcpy(elem, (uint8_t *)ring->data + ring->elem_size * ring->head, ring->elem_size);
+    ring->head = (ring->head + 1) % ring->capacity;
+    ring->length--;
+    return 0;
+}
+
+void *peek_ring_buffer(RingBuffer *ring, unsigned int index)
+{
+    if (index >= ring->length)
+        return NULL;
+    return (uint8_t *)ring->data + ring->elem_size * ((ring->head + index) % ring->capacity);
+}
+
+ObjectPool *create_object_pool(size_t elem_size, unsigned int capacity, void *storage)
+{
+    ObjectPool *pool = (ObjectPool *)malloc(sizeof(ObjectPool));
+    if (!pool)
+        return NULL;
+    pool->owned = storage == NULL;
+    pool->storage = pool->owned ? (uint8_t *)calloc(capacity, elem_size) : (uint8_t *)storage;
+    pool->free_list = (unsigned int *)malloc(sizeof(unsigned int) * capacity);
+    if (!pool->storage || !pool->free_list)
+    {
+        if (pool->owned)
+            free(pool->storage);
+        free(pool->free_list);
+        free(pool);
+        return NULL;
+    }
+    pool->elem_size = elem_size;
+    pool->capacity = capacity;
+    // 逆序入栈, 使对象按地址从低到高被取出
+    for (unsigned int i = 0; i < capacity; i++)
+        pool->free_list[i] = capacity - 1 - i;
+    pool->free_num = capacity;
+    return pool;
+}
+
+void free_object_pool(ObjectPool *pool)
+{
+    if (pool)
+    {
+        if (pool->owned)
+            free(pool->storage);
+        free(pool->free_list);
+        free(pool);
     }
-    return -1;
-}
\ No newline at end of file
+}
+
+void *acquire_object_pool(ObjectPool *pool)
+{
+    if (pool->free_num == 0)
+        return NULL;
+    return pool->storage + pool->elem_size * pool->free_list[--pool->free_num];
+}
+
+void release_object_pool(ObjectPool *pool, void *object)
+{
+    pool->free_list[pool->free_num++] = index_object_pool(pool, object);
+}
+
+unsigned int index_object_pool(ObjectPool *pool, const void *object)
+{
+    return ((const uint8_t *)object - pool->storage) / pool->elem_size;
+}
+
+void *get_object_pool(ObjectPool *pool, unsigned int index)
+{
+    if (index >= pool->capacity)
+        return NULL;
+    return pool->storage + pool->elem_size * index;
+}
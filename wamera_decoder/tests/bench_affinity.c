@@ -0,0 +1,209 @@
+#define _GNU_SOURCE
+
+#include <sched.h>
+#include <pthread.h>
+
+#include "../include/affinity.h"
+#include "../include/camera.h"
+
+// 默认的时长与帧率, 可由命令行参数覆盖
+#define BENCH_SECONDS 10
+#define BENCH_FPS 60
+// 每帧从驱动缓冲区复制出的字节数 即 1080p YUYV
+#define BENCH_FRAME_BYTES (1920 * 1080 * 2)
+// 实时优先级 与配置示例一致
+#define BENCH_PRIORITY 50
+
+/**
+ * @brief BenchCase 一种调度配置
+ * @property name 名称
+ * @property hog 是否运行占满CPU的线程
+ * @property affinity 绑核配置
+ */
+typedef struct BenchCase
+{
+    const char *name;
+    int hog;
+    AffinityConfig affinity;
+} BenchCase;
+
+/**
+ * @brief BenchCapture 模拟采集线程的参数与结果
+ * @property fps 帧率
+ * @property seconds 时长
+ * @property scheduled 调度策略是否设置成功
+ * @property frames 驱动产生的帧数
+ * @property dropped 驱动缓冲区已满而丢弃的帧数
+ * @property lates 每次唤醒相对于帧到达的延迟 单位:us
+ * @property num 唤醒次数
+ */
+typedef struct BenchCapture
+{
+    int fps;
+    int seconds;
+    int scheduled;
+    int64_t frames;
+    int64_t dropped;
+    int64_t *lates;
+    int num;
+} BenchCapture;
+
+static volatile int stop = 0;
+
+static int64_t now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int compare_late(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief run_hog 以解码与编码线程的角色空转
+ */
+static void *run_hog(void *arg)
+{
+    (void)arg;
+    apply_affinity(ROLE_WORKER);
+    volatile uint64_t counter = 0;
+    while (!stop)
+        counter++;
+    return NULL;
+}
+
+/**
+ * @brief run_capture 按帧间隔等待并复制一帧, 与事件循环取帧的代价相当
+ * @note 驱动持有 BUF_NUM 个缓冲区, 两次取帧之间到达的帧超过 BUF_NUM 个时多出的帧被丢弃
+ */
+static void *run_capture(void *arg)
+{
+    BenchCapture *capture = (BenchCapture *)arg;
+    capture->scheduled = apply_affinity(ROLE_CAPTURE) == 0;
+    uint8_t *source = (uint8_t *)malloc(BENCH_FRAME_BYTES);
+    uint8_t *frame = (uint8_t *)malloc(BENCH_FRAME_BYTES);
+    if (!source || !frame)
+    {
+        free(source);
+        free(frame);
+        return NULL;
+    }
+    memset(source, 0x80, BENCH_FRAME_BYTES);
+
+    int64_t interval = 1000000 / capture->fps;
+    int64_t start = now(), end = start + (int64_t)capture->seconds * 1000000, taken = 0;
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (1)
+    {
+        // 等待下一帧到达
+        next.tv_nsec += interval * 1000;
+        while (next.tv_nsec >= 1000000000)
+        {
+            next.tv_nsec -= 1000000000;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        int64_t wake = now();
+        if (wake >= end)
+            break;
+
+        int64_t arrived = (wake - start) / interval;
+        int64_t pending = arrived - taken;
+        if (pending > BUF_NUM)
+            capture->dropped += pending - BUF_NUM;
+        taken = arrived;
+        capture->lates[capture->num++] = wake - (start + arrived * interval);
+        for (int64_t i = 0; i < FFMIN(pending, BUF_NUM); i++)
+            memcpy(frame, source, BENCH_FRAME_BYTES);
+    }
+    capture->frames = taken;
+    free(source);
+    free(frame);
+    return NULL;
+}
+
+/**
+ * @brief run_case 以一种调度配置运行模拟采集
+ * @return 成功返回0, 失败返回-1
+ */
+static int run_case(const BenchCase *bench, int fps, int seconds, unsigned int hogs)
+{
+    if (init_affinity(bench->affinity) < 0)
+        return -1;
+    BenchCapture capture = {fps, seconds, 0, 0, 0, NULL, 0};
+    capture.lates = (int64_t *)calloc((size_t)fps * seconds + 1, sizeof(int64_t));
+    pthread_t *threads = (pthread_t *)calloc(hogs, sizeof(pthread_t));
+    if (!capture.lates || !threads)
+    {
+        free(capture.lates);
+        free(threads);
+        return -1;
+    }
+
+    stop = 0;
+    unsigned int started = 0;
+    for (; bench->hog && started < hogs; started++)
+        if (pthread_create(&threads[started], NULL, run_hog, NULL) != 0)
+            break;
+    pthread_t thread;
+    int ret = pthread_create(&thread, NULL, run_capture, &capture) == 0 ? 0 : -1;
+    if (ret == 0)
+        pthread_join(thread, NULL);
+    stop = 1;
+    for (unsigned int i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+
+    if (ret == 0 && capture.num > 0)
+    {
+        qsort(capture.lates, capture.num, sizeof(int64_t), compare_late);
+        int64_t total = capture.frames > 0 ? capture.frames : 1;
+        printf("%-14s %6u %5s %8lld %8lld %8.3f %10lld %10lld\n", bench->name, started,
+               bench->affinity.capture_priority > 0 ? (capture.scheduled ? "yes" : "denied") : "no",
+               (long long)capture.frames, (long long)capture.dropped, 100.0 * capture.dropped / total,
+               (long long)capture.lates[(size_t)((capture.num - 1) * 0.99)],
+               (long long)capture.lates[capture.num - 1]);
+    }
+    free(capture.lates);
+    free(threads);
+    return ret;
+}
+
+int main(int argc, char *argv[])
+{
+    // 参数: 时长 帧率 空转线程数
+    int seconds = argc > 1 ? atoi(argv[1]) : BENCH_SECONDS;
+    int fps = argc > 2 ? atoi(argv[2]) : BENCH_FPS;
+    unsigned int hogs = argc > 3 ? strtoul(argv[3], NULL, 10) : get_cpu_count() * 2;
+    if (seconds <= 0 || fps <= 0 || fps > 1000 || hogs == 0)
+    {
+        printf("Usage: %s [seconds] [fps] [hog threads]\n", argv[0]);
+        return 1;
+    }
+
+    logger = init_logger(NULL, LOG_ERROR);
+    // 采集绑定 CPU 0, 空转线程按线程池的角色避开其所在的物理核
+    BenchCase cases[] = {
+        {"idle", 0, {{""}, 0, 0}},
+        {"hog", 1, {{""}, 0, 0}},
+        {"hog pinned", 1, {{"0"}, 0, 1}},
+        {"hog pinned rt", 1, {{"0"}, BENCH_PRIORITY, 1}},
+    };
+    printf("%d s at %d fps, %d buffers, %d KB per frame, %u cpus\n", seconds, fps, BUF_NUM,
+           BENCH_FRAME_BYTES >> 10, get_cpu_count());
+    printf("%-14s %6s %5s %8s %8s %8s %10s %10s\n", "case", "hogs", "fifo", "frames", "dropped", "drop %",
+           "p99 us", "max us");
+    int ret = 0;
+    for (unsigned int i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+        if (run_case(&cases[i], fps, seconds, hogs) < 0)
+        {
+            printf("%-14s failed\n", cases[i].name);
+            ret = 1;
+        }
+    destroy_logger(logger);
+    return ret;
+}
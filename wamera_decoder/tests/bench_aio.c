@@ -0,0 +1,170 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../include/sink.h"
+
+// 默认的并发相机数与每路写入量, 可由命令行参数覆盖
+#define BENCH_CAMERAS 4
+#define BENCH_MEGABYTES 256
+// 与默认设置一致的缓冲区数量
+#define BENCH_QUEUE_DEPTH 4
+
+static const char *const backend_names[] = {"sync", "io_uring", "thread"};
+
+/**
+ * @brief BenchWriter 一路模拟录像的写入任务
+ * @property backend 期望的后端
+ * @property dir 写入目录
+ * @property index 相机序号
+ * @property chunks 写入块数
+ * @property stalls 每块获取与提交缓冲区时调用线程被阻塞的时长 单位:us
+ * @property actual 实际使用的后端
+ * @property error 是否出错
+ * @property thread 写入线程
+ */
+typedef struct BenchWriter
+{
+    AioBackend backend;
+    const char *dir;
+    unsigned int index;
+    unsigned int chunks;
+    int64_t *stalls;
+    AioBackend actual;
+    int error;
+    pthread_t thread;
+} BenchWriter;
+
+static int64_t now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int compare_stall(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief run_writer 像文件写入器一样按块写满一个文件, 关闭后同步落盘
+ * @note 阻塞时长只计获取与提交, 不计填充, 即编码任务在写入上等待的时间
+ */
+static void *run_writer(void *arg)
+{
+    BenchWriter *bench = (BenchWriter *)arg;
+    char path[512];
+    snprintf(path, sizeof(path), "%s/bench_aio_%u.bin", bench->dir, bench->index);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        bench->error = 1;
+        return NULL;
+    }
+    AioWriter *writer = open_aio_writer(fd, bench->backend, BENCH_QUEUE_DEPTH, SINK_CHUNK_SIZE);
+    if (!writer)
+    {
+        bench->error = 1;
+        close(fd);
+        unlink(path);
+        return NULL;
+    }
+    bench->actual = writer->backend;
+
+    for (unsigned int i = 0; i < bench->chunks; i++)
+    {
+        int64_t start = now();
+        uint8_t *buf = acquire_aio_buffer(writer);
+        int64_t stall = now() - start;
+        if (!buf)
+        {
+            bench->error = 1;
+            break;
+        }
+        memset(buf, (int)(i + bench->index), SINK_CHUNK_SIZE);
+        start = now();
+        if (submit_aio_buffer(writer, buf, SINK_CHUNK_SIZE, (int64_t)i * SINK_CHUNK_SIZE) < 0)
+            bench->error = 1;
+        bench->stalls[i] = stall + now() - start;
+    }
+    if (close_aio_writer(writer) < 0 || fdatasync(fd) < 0)
+        bench->error = 1;
+    close(fd);
+    unlink(path);
+    return NULL;
+}
+
+/**
+ * @brief run_backend 多路相机同时以一种后端写入, 输出总吞吐与阻塞时长的尾部
+ * @return 成功返回0, 失败返回-1
+ */
+static int run_backend(AioBackend backend, const char *dir, unsigned int cameras, unsigned int megabytes)
+{
+    unsigned int chunks = (unsigned int)(((int64_t)megabytes << 20) / SINK_CHUNK_SIZE);
+    BenchWriter *benches = (BenchWriter *)calloc(cameras, sizeof(BenchWriter));
+    int64_t *stalls = (int64_t *)calloc((size_t)cameras * chunks, sizeof(int64_t));
+    if (!benches || !stalls)
+    {
+        free(benches);
+        free(stalls);
+        return -1;
+    }
+
+    int64_t start = now();
+    for (unsigned int i = 0; i < cameras; i++)
+    {
+        benches[i] = (BenchWriter){backend, dir, i, chunks, stalls + (size_t)i * chunks, backend, 0, 0};
+        if (pthread_create(&benches[i].thread, NULL, run_writer, &benches[i]) != 0)
+            run_writer(&benches[i]);
+    }
+    int error = 0;
+    for (unsigned int i = 0; i < cameras; i++)
+    {
+        if (benches[i].thread)
+            pthread_join(benches[i].thread, NULL);
+        error |= benches[i].error;
+    }
+    int64_t elapsed = now() - start;
+
+    size_t num = (size_t)cameras * chunks;
+    qsort(stalls, num, sizeof(int64_t), compare_stall);
+    char name[32];
+    if (benches[0].actual != backend)
+        snprintf(name, sizeof(name), "%s>%s", backend_names[backend], backend_names[benches[0].actual]);
+    else
+        snprintf(name, sizeof(name), "%s", backend_names[backend]);
+    printf("%-16s %8u %10.1f %10lld %10lld%s\n", name, cameras,
+           elapsed > 0 ? ((double)cameras * chunks * SINK_CHUNK_SIZE / (1 << 20)) / (elapsed / 1e6) : 0.0,
+           num > 0 ? (long long)stalls[(size_t)((num - 1) * 0.99)] : 0LL, num > 0 ? (long long)stalls[num - 1] : 0LL,
+           error ? " (errors)" : "");
+
+    free(benches);
+    free(stalls);
+    return error ? -1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+    // 参数: 写入目录 相机数 每路写入的 MB 数
+    const char *dir = argc > 1 ? argv[1] : ".";
+    unsigned int cameras = argc > 2 ? strtoul(argv[2], NULL, 10) : BENCH_CAMERAS;
+    unsigned int megabytes = argc > 3 ? strtoul(argv[3], NULL, 10) : BENCH_MEGABYTES;
+    if (cameras == 0 || megabytes == 0)
+    {
+        printf("Usage: %s [dir] [cameras] [megabytes per camera]\n", argv[0]);
+        return 1;
+    }
+
+    logger = init_logger(NULL, LOG_WARNING);
+    printf("%u MB per camera in %u KB chunks, %u buffers, into `%s`\n", megabytes, SINK_CHUNK_SIZE >> 10,
+           BENCH_QUEUE_DEPTH, dir);
+    printf("%-16s %8s %10s %10s %10s\n", "backend", "cameras", "MB/s", "p99 us", "max us");
+    static const AioBackend backends[] = {AIO_SYNC, AIO_THREAD, AIO_URING};
+    int ret = 0;
+    for (unsigned int i = 0; i < sizeof(backends) / sizeof(backends[0]); i++)
+        if (run_backend(backends[i], dir, cameras, megabytes) < 0)
+            ret = 1;
+    destroy_logger(logger);
+    return ret;
+}
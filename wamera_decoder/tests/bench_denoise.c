@@ -0,0 +1,176 @@
+#include "../include/denoise.h"
+
+// 默认的分辨率与帧数, 可由命令行参数覆盖
+#define BENCH_WIDTH 1920
+#define BENCH_HEIGHT 1080
+#define BENCH_FRAMES 120
+// 低照度下的传感器噪声幅度
+#define BENCH_NOISE 6
+
+static int64_t now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static AVFrame *alloc_frame(int width, int height, enum AVPixelFormat format)
+{
+    AVFrame *frame = av_frame_alloc();
+    if (!frame)
+        return NULL;
+    frame->width = width;
+    frame->height = height;
+    frame->format = format;
+    if (av_frame_get_buffer(frame, 0) < 0)
+        av_frame_free(&frame);
+    return frame;
+}
+
+/**
+ * @brief fill_noisy 以静止的纹理为真值, 叠加均匀分布的噪声
+ * @param clean 不为NULL时写入真值
+ */
+static void fill_noisy(AVFrame *frame, AVFrame *clean, uint32_t *seed)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get((enum AVPixelFormat)frame->format);
+    for (int p = 0; p < 3; p++)
+    {
+        int w = p ? -((-frame->width) >> desc->log2_chroma_w) : frame->width;
+        int h = p ? -((-frame->height) >> desc->log2_chroma_h) : frame->height;
+        for (int y = 0; y < h; y++)
+        {
+            uint8_t *row = frame->data[p] + (ptrdiff_t)y * frame->linesize[p];
+            uint8_t *truth = clean ? clean->data[p] + (ptrdiff_t)y * clean->linesize[p] : NULL;
+            for (int x = 0; x < w; x++)
+            {
+                int value = p ? 128 + ((x >> 4) + (y >> 4)) % 16 : 48 + ((x >> 3) ^ (y >> 3)) % 64;
+                *seed = *seed * 1664525 + 1013904223;
+                int noise = (int)(*seed >> 24) % (2 * BENCH_NOISE + 1) - BENCH_NOISE;
+                row[x] = av_clip_uint8(value + noise);
+                if (truth)
+                    truth[x] = (uint8_t)value;
+            }
+        }
+    }
+}
+
+/**
+ * @brief luma_error 亮度与真值的平均绝对误差
+ */
+static double luma_error(const AVFrame *frame, const AVFrame *clean)
+{
+    int64_t sum = 0;
+    for (int y = 0; y < frame->height; y++)
+    {
+        const uint8_t *a = frame->data[0] + (ptrdiff_t)y * frame->linesize[0];
+        const uint8_t *b = clean->data[0] + (ptrdiff_t)y * clean->linesize[0];
+        for (int x = 0; x < frame->width; x++)
+            sum += a[x] > b[x] ? a[x] - b[x] : b[x] - a[x];
+    }
+    return (double)sum / ((int64_t)frame->width * frame->height);
+}
+
+/**
+ * @brief reference_denoise 与降噪器相同的逐像素混合, 作为向量化之前的对照
+ */
+static void reference_denoise(AVFrame *frame, uint8_t *history[3], const Denoiser *denoiser)
+{
+    for (int p = 0; p < 3; p++)
+        for (int y = 0; y < denoiser->plane_h[p]; y++)
+        {
+            uint8_t *cur = frame->data[p] + (ptrdiff_t)y * frame->linesize[p];
+            uint8_t *prev = history[p] + (size_t)y * denoiser->plane_w[p];
+            for (int x = 0; x < denoiser->plane_w[p]; x++)
+            {
+                int d = cur[x] - prev[x];
+                int w = FFMIN(denoiser->base + (d < 0 ? -d : d) * denoiser->slope, DENOISE_WEIGHT_ONE);
+                prev[x] = cur[x] = (uint8_t)(prev[x] + ((d * w + DENOISE_WEIGHT_ONE / 2) >> 7));
+            }
+        }
+}
+
+/**
+ * @brief run_format 以一种像素格式降噪一段静止画面
+ * @return 成功返回0, 失败返回-1
+ */
+static int run_format(enum AVPixelFormat format, const char *name, int width, int height, int frames)
+{
+    AVFrame *frame = alloc_frame(width, height, format);
+    AVFrame *clean = alloc_frame(width, height, format);
+    // 与默认设置一致
+    DenoiseConfig config = {1, 60, 12};
+    Denoiser *denoiser = open_denoiser(config);
+    if (!frame || !clean || !denoiser)
+        return -1;
+
+    uint32_t seed = 1;
+    int64_t elapsed = 0, reference = 0;
+    double before = 0, after = 0;
+    uint8_t *history[3] = {NULL, NULL, NULL};
+    for (int i = 0; i < frames; i++)
+    {
+        fill_noisy(frame, clean, &seed);
+        double error = luma_error(frame, clean);
+        int64_t start = now();
+        if (denoise_frame(denoiser, frame) < 0)
+            return -1;
+        // 首帧只作为历史, 不计入
+        if (i > 0)
+        {
+            elapsed += now() - start;
+            before += error;
+            after += luma_error(frame, clean);
+        }
+
+        // 对照实现使用自己的历史, 首帧从降噪器复制
+        if (i == 0)
+            for (int p = 0; p < 3; p++)
+            {
+                size_t size = (size_t)denoiser->plane_w[p] * denoiser->plane_h[p];
+                if (!(history[p] = (uint8_t *)malloc(size)))
+                    return -1;
+                memcpy(history[p], denoiser->history[p], size);
+            }
+        else
+        {
+            fill_noisy(frame, NULL, &seed);
+            start = now();
+            reference_denoise(frame, history, denoiser);
+            reference += now() - start;
+        }
+    }
+
+    int timed = frames - 1;
+    printf("%-10s %12.3f %12.3f %12.2f %12.2f\n", name, elapsed / 1e6 / timed, reference / 1e6 / timed,
+           before / timed, after / timed);
+    for (int p = 0; p < 3; p++)
+        free(history[p]);
+    close_denoiser(denoiser);
+    av_frame_free(&clean);
+    av_frame_free(&frame);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    // 参数: 宽 高 帧数
+    int width = argc > 1 ? atoi(argv[1]) : BENCH_WIDTH;
+    int height = argc > 2 ? atoi(argv[2]) : BENCH_HEIGHT;
+    int frames = argc > 3 ? atoi(argv[3]) : BENCH_FRAMES;
+    if (width <= 0 || height <= 0 || frames < 2)
+    {
+        printf("Usage: %s [width] [height] [frames >= 2]\n", argv[0]);
+        return 1;
+    }
+
+    logger = init_logger(NULL, LOG_WARNING);
+    printf("%dx%d, %d frames of static scene with +-%d noise\n", width, height, frames, BENCH_NOISE);
+    printf("%-10s %12s %12s %12s %12s\n", "format", "ms/frame", "scalar ms", "error in", "error out");
+    int ret = 0;
+    if (run_format(AV_PIX_FMT_YUV422P, "yuv422p", width, height, frames) < 0 ||
+        run_format(AV_PIX_FMT_YUV420P, "yuv420p", width, height, frames) < 0)
+        ret = 1;
+    destroy_logger(logger);
+    return ret;
+}
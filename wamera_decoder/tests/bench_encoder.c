@@ -0,0 +1,204 @@
+#include <math.h>
+
+#include "../include/encoder.h"
+
+// 默认的后端 分辨率与帧数, 可由命令行参数覆盖
+#define BENCH_ENCODER "libx264"
+#define BENCH_WIDTH 1920
+#define BENCH_HEIGHT 1080
+#define BENCH_FRAMES 300
+// 与默认设置一致的帧率与码率
+#define BENCH_FPS 30
+#define BENCH_BIT_RATE 500000
+// 低延迟模式的 VBV 时长 单位:ms 与 slice 大小 单位:字节
+#define BENCH_VBV_LATENCY 100
+#define BENCH_SLICE_SIZE 1200
+// 模拟上行链路的带宽与码率之比
+#define BENCH_LINK_RATIO 1.5
+
+/**
+ * @brief BenchMode 对比的编码模式
+ * @property name 名称
+ * @property intra_refresh 是否以帧内刷新代替关键帧
+ * @property slice_max_size slice 的最大字节数
+ * @property vbv_latency VBV 缓冲对应的时长 单位:ms
+ */
+typedef struct BenchMode
+{
+    const char *name;
+    int intra_refresh;
+    unsigned int slice_max_size;
+    unsigned int vbv_latency;
+} BenchMode;
+
+static int64_t now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int compare_int64(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief fill_frame 斜向移动的纹理叠加噪声, 迫使编码器做运动搜索并保留残差
+ */
+static void fill_frame(AVFrame *frame, int index, uint32_t *seed)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get((enum AVPixelFormat)frame->format);
+    for (int p = 0; p < 3; p++)
+    {
+        int w = p ? -((-frame->width) >> desc->log2_chroma_w) : frame->width;
+        int h = p ? -((-frame->height) >> desc->log2_chroma_h) : frame->height;
+        for (int y = 0; y < h; y++)
+        {
+            uint8_t *row = frame->data[p] + (ptrdiff_t)y * frame->linesize[p];
+            for (int x = 0; x < w; x++)
+            {
+                *seed = *seed * 1664525 + 1013904223;
+                int value = p ? 128 + ((x - y) >> 4) : (((x + index * 4) >> 4) ^ ((y + index * 2) >> 4)) * 8;
+                row[x] = (uint8_t)(value + ((*seed >> 24) & 7));
+            }
+        }
+    }
+}
+
+/**
+ * @brief run_mode 编码同一段合成画面, 输出包大小的波动与经受限上行链路的延迟
+ * @note 延迟为采集时刻到该帧最后一个字节离开链路的时间, 链路带宽为码率的
+ *       BENCH_LINK_RATIO 倍, 按包大小串行发送; 不含网络传播与接收端缓冲
+ * @return 成功返回0, 失败返回-1
+ */
+static int run_mode(const EncoderBackend *backend, Config config, BenchMode mode, int frames)
+{
+    config.intra_refresh = mode.intra_refresh;
+    config.slice_max_size = mode.slice_max_size;
+    config.vbv_latency = mode.vbv_latency;
+    AVCodecContext *ctx = open_encoder_context(backend, config);
+    AVFrame *frame = av_frame_alloc();
+    AVPacket *packet = av_packet_alloc();
+    int64_t *sizes = (int64_t *)calloc(frames, sizeof(int64_t));
+    int64_t *latencies = (int64_t *)calloc(frames, sizeof(int64_t));
+    int64_t *encodes = (int64_t *)calloc(frames, sizeof(int64_t));
+    int ret = -1;
+    if (!ctx || !frame || !packet || !sizes || !latencies || !encodes)
+        goto end;
+    frame->width = ctx->width;
+    frame->height = ctx->height;
+    frame->format = ctx->pix_fmt;
+    if (av_frame_get_buffer(frame, 0) < 0)
+        goto end;
+
+    int64_t interval = av_rescale_q(1, config.time_base, AV_TIME_BASE_Q);
+    double link_rate = config.bit_rate * BENCH_LINK_RATIO / 8 / 1e6; // 字节每微秒
+    int64_t link_free = 0, keys = 0;
+    int num = 0;
+    uint32_t seed = 1;
+    for (int i = 0; i < frames; i++)
+    {
+        if (av_frame_make_writable(frame) < 0)
+            goto end;
+        fill_frame(frame, i, &seed);
+        frame->pts = i;
+        int64_t start = now();
+        if (avcodec_send_frame(ctx, frame) < 0)
+            goto end;
+        int64_t size = 0;
+        while (avcodec_receive_packet(ctx, packet) == 0)
+        {
+            size += packet->size;
+            keys += (packet->flags & AV_PKT_FLAG_KEY) != 0;
+            av_packet_unref(packet);
+        }
+        int64_t encode = now() - start;
+        if (size == 0)
+            continue;
+
+        // 帧在采集时刻 i * interval 到达, 编码后排在链路上前一帧之后发送
+        int64_t ready = (int64_t)i * interval + encode;
+        link_free = FFMAX(link_free, ready) + (int64_t)(size / link_rate);
+        sizes[num] = size;
+        encodes[num] = encode;
+        latencies[num] = link_free - (int64_t)i * interval;
+        num++;
+    }
+    if (num == 0)
+        goto end;
+
+    double mean = 0, square = 0;
+    for (int i = 0; i < num; i++)
+    {
+        mean += sizes[i];
+        square += (double)sizes[i] * sizes[i];
+    }
+    mean /= num;
+    double stddev = sqrt(FFMAX(square / num - mean * mean, 0.0));
+    qsort(sizes, num, sizeof(int64_t), compare_int64);
+    qsort(encodes, num, sizeof(int64_t), compare_int64);
+    qsort(latencies, num, sizeof(int64_t), compare_int64);
+    size_t p99 = (size_t)((num - 1) * 0.99);
+    printf("%-12s %6lld %9.0f %9.0f %9lld %7.2f %10.2f %10.2f %10.2f\n", mode.name, (long long)keys, mean, stddev,
+           (long long)sizes[num - 1], sizes[num - 1] / mean, encodes[p99] / 1e3, latencies[p99] / 1e3,
+           latencies[num - 1] / 1e3);
+    ret = 0;
+
+end:
+    free(encodes);
+    free(latencies);
+    free(sizes);
+    av_packet_free(&packet);
+    av_frame_free(&frame);
+    avcodec_free_context(&ctx);
+    return ret;
+}
+
+int main(int argc, char *argv[])
+{
+    // 参数: 后端 宽 高 帧数
+    const char *encoder = argc > 1 ? argv[1] : BENCH_ENCODER;
+    int width = argc > 2 ? atoi(argv[2]) : BENCH_WIDTH;
+    int height = argc > 3 ? atoi(argv[3]) : BENCH_HEIGHT;
+    int frames = argc > 4 ? atoi(argv[4]) : BENCH_FRAMES;
+    if (width <= 0 || height <= 0 || frames <= 0)
+    {
+        printf("Usage: %s [encoder] [width] [height] [frames]\n", argv[0]);
+        return 1;
+    }
+
+    logger = init_logger(NULL, LOG_WARNING);
+    av_log_set_level(AV_LOG_ERROR);
+    const EncoderBackend *backend = find_encoder_backend(encoder);
+    if (!backend)
+    {
+        printf("Encoder `%s` not available\n", encoder);
+        return 1;
+    }
+
+    Config config = {0};
+    config.width = width;
+    config.height = height;
+    config.time_base = (AVRational){1, BENCH_FPS};
+    config.bit_rate = BENCH_BIT_RATE;
+    printf("%s %dx%d at %d fps, %d kbps, %d frames, uplink %.1fx bit rate\n", backend->name, width, height,
+           BENCH_FPS, BENCH_BIT_RATE / 1000, frames, BENCH_LINK_RATIO);
+    printf("%-12s %6s %9s %9s %9s %7s %10s %10s %10s\n", "mode", "keys", "mean B", "stddev B", "max B", "peak",
+           "p99 enc ms", "p99 e2e ms", "max e2e ms");
+    // 当前模式使用默认的关键帧间隔与一秒的 VBV
+    static const BenchMode modes[] = {
+        {"current", 0, 0, 0},
+        {"low-latency", 1, BENCH_SLICE_SIZE, BENCH_VBV_LATENCY},
+    };
+    int ret = 0;
+    for (unsigned int i = 0; i < sizeof(modes) / sizeof(modes[0]); i++)
+        if (run_mode(backend, config, modes[i], frames) < 0)
+        {
+            printf("%-12s failed\n", modes[i].name);
+            ret = 1;
+        }
+    destroy_logger(logger);
+    return ret;
+}
@@ -0,0 +1,109 @@
+#include "../include/mask.h"
+
+// 默认的分辨率与帧数, 可由命令行参数覆盖
+#define BENCH_WIDTH 1920
+#define BENCH_HEIGHT 1080
+#define BENCH_FRAMES 200
+
+static int64_t now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * @brief fill_frame 以纹理填满各平面, 每轮遮挡前重新填充
+ */
+static void fill_frame(AVFrame *frame)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get((enum AVPixelFormat)frame->format);
+    for (int p = 0; p < 3; p++)
+    {
+        int w = p ? -((-frame->width) >> desc->log2_chroma_w) : frame->width;
+        int h = p ? -((-frame->height) >> desc->log2_chroma_h) : frame->height;
+        for (int y = 0; y < h; y++)
+        {
+            uint8_t *row = frame->data[p] + (ptrdiff_t)y * frame->linesize[p];
+            for (int x = 0; x < w; x++)
+                row[x] = (uint8_t)((x * 7 + y * 13) ^ (x >> 2));
+        }
+    }
+}
+
+/**
+ * @brief run_mode 以一种遮挡方式处理同一组区域
+ * @return 成功返回0, 失败返回-1
+ */
+static int run_mode(AVFrame *frame, MaskConfig config, const char *name, int frames)
+{
+    PrivacyMask *mask = open_privacy_mask(config, frame->width, frame->height);
+    if (!mask)
+        return -1;
+    int64_t elapsed = 0;
+    for (int i = 0; i < frames; i++)
+    {
+        fill_frame(frame);
+        int64_t start = now();
+        if (apply_privacy_mask(mask, frame) < 0)
+        {
+            close_privacy_mask(mask);
+            return -1;
+        }
+        // 首帧包含栅格化, 不计时
+        if (i > 0)
+            elapsed += now() - start;
+    }
+    printf("%-10s %12.3f %14.1f\n", name, frames > 1 ? elapsed / 1e6 / (frames - 1) : 0.0,
+           100.0 * mask->pixels / ((int64_t)frame->width * frame->height));
+    close_privacy_mask(mask);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    // 参数: 宽 高 帧数
+    int width = argc > 1 ? atoi(argv[1]) : BENCH_WIDTH;
+    int height = argc > 2 ? atoi(argv[2]) : BENCH_HEIGHT;
+    int frames = argc > 3 ? atoi(argv[3]) : BENCH_FRAMES;
+    if (width < 64 || height < 64 || frames <= 0)
+    {
+        printf("Usage: %s [width >= 64] [height >= 64] [frames]\n", argv[0]);
+        return 1;
+    }
+
+    logger = init_logger(NULL, LOG_WARNING);
+    AVFrame *frame = av_frame_alloc();
+    if (!frame)
+        return 1;
+    frame->width = width;
+    frame->height = height;
+    frame->format = AV_PIX_FMT_YUV422P;
+    if (av_frame_get_buffer(frame, 0) < 0)
+        return 1;
+
+    // 一个占画面 1/4 的矩形与一个斜向的多边形, 与默认块大小一致
+    MaskConfig config = {MASK_PIXELATE, 16, 0, {{0}}};
+    char rect[64], polygon[128];
+    snprintf(rect, sizeof(rect), "%d,%d,%d,%d", width / 8, height / 8, width / 2, height / 2);
+    snprintf(polygon, sizeof(polygon), "%d,%d %d,%d %d,%d %d,%d", width * 5 / 8, height / 2, width * 7 / 8,
+             height * 5 / 8, width * 3 / 4, height * 15 / 16, width * 9 / 16, height * 13 / 16);
+    if (parse_mask_shape(&config.shapes[config.num++], rect) < 0 ||
+        parse_mask_shape(&config.shapes[config.num++], polygon) < 0)
+        return 1;
+
+    printf("%dx%d yuv422p, %d frames, %u regions, block %u\n", width, height, frames, config.num, config.block);
+    printf("%-10s %12s %14s\n", "mode", "ms/frame", "masked luma %");
+    static const MaskMode modes[] = {MASK_PIXELATE, MASK_BLUR, MASK_FILL};
+    static const char *const names[] = {"pixelate", "blur", "fill"};
+    int ret = 0;
+    for (unsigned int i = 0; i < sizeof(modes) / sizeof(modes[0]); i++)
+    {
+        config.mode = modes[i];
+        if (run_mode(frame, config, names[i], frames) < 0)
+            ret = 1;
+    }
+    av_frame_free(&frame);
+    destroy_logger(logger);
+    return ret;
+}
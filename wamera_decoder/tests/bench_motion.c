@@ -0,0 +1,132 @@
+#include "../include/motion.h"
+
+// 默认的分辨率与帧数, 可由命令行参数覆盖
+#define BENCH_WIDTH 1920
+#define BENCH_HEIGHT 1080
+#define BENCH_FRAMES 300
+// 预先生成的帧数, 循环使用, 避免计时包含生成
+#define BENCH_SOURCES 16
+// 传感器噪声幅度与运动物体的边长
+#define BENCH_NOISE 4
+#define BENCH_OBJECT 160
+
+static int64_t now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * @brief make_frame 静止的纹理背景加噪声, 一个方块沿对角线移动
+ * @return AVFrame* 失败返回NULL
+ */
+static AVFrame *make_frame(int width, int height, int index, uint32_t *seed)
+{
+    AVFrame *frame = av_frame_alloc();
+    if (!frame)
+        return NULL;
+    frame->width = width;
+    frame->height = height;
+    frame->format = AV_PIX_FMT_YUV420P;
+    if (av_frame_get_buffer(frame, 0) < 0)
+    {
+        av_frame_free(&frame);
+        return NULL;
+    }
+
+    int ox = (index * 24) % FFMAX(width - BENCH_OBJECT, 1), oy = (index * 12) % FFMAX(height - BENCH_OBJECT, 1);
+    for (int y = 0; y < height; y++)
+    {
+        uint8_t *row = frame->data[0] + (ptrdiff_t)y * frame->linesize[0];
+        for (int x = 0; x < width; x++)
+        {
+            *seed = *seed * 1664525 + 1013904223;
+            int noise = (int)(*seed >> 24) % (2 * BENCH_NOISE + 1) - BENCH_NOISE;
+            int inside = x >= ox && x < ox + BENCH_OBJECT && y >= oy && y < oy + BENCH_OBJECT;
+            int value = inside ? 220 : 64 + ((x >> 3) ^ (y >> 3)) % 96;
+            row[x] = (uint8_t)av_clip_uint8(value + noise);
+        }
+    }
+    for (int p = 1; p < 3; p++)
+        for (int y = 0; y < (height + 1) / 2; y++)
+            memset(frame->data[p] + (ptrdiff_t)y * frame->linesize[p], 128, (width + 1) / 2);
+    return frame;
+}
+
+/**
+ * @brief reference_sad 逐像素求整帧各块的差值, 作为向量化之前的对照
+ */
+static int64_t reference_sad(const AVFrame *cur, const AVFrame *prev)
+{
+    int64_t sum = 0;
+    for (int y = 0; y < cur->height; y++)
+    {
+        const uint8_t *a = cur->data[0] + (ptrdiff_t)y * cur->linesize[0];
+        const uint8_t *b = prev->data[0] + (ptrdiff_t)y * prev->linesize[0];
+        for (int x = 0; x < cur->width; x++)
+            sum += a[x] > b[x] ? a[x] - b[x] : b[x] - a[x];
+    }
+    return sum;
+}
+
+int main(int argc, char *argv[])
+{
+    // 参数: 宽 高 帧数
+    int width = argc > 1 ? atoi(argv[1]) : BENCH_WIDTH;
+    int height = argc > 2 ? atoi(argv[2]) : BENCH_HEIGHT;
+    int frames = argc > 3 ? atoi(argv[3]) : BENCH_FRAMES;
+    if (width < MOTION_BLOCK || height < MOTION_BLOCK || frames <= 0)
+    {
+        printf("Usage: %s [width] [height] [frames]\n", argv[0]);
+        return 1;
+    }
+
+    logger = init_logger(NULL, LOG_WARNING);
+    AVFrame *sources[BENCH_SOURCES];
+    uint32_t seed = 1;
+    for (int i = 0; i < BENCH_SOURCES; i++)
+        if (!(sources[i] = make_frame(width, height, i, &seed)))
+            return 1;
+
+    // 与默认设置一致
+    MotionConfig config = {1, 6, 0.1, 0.06};
+    MotionMap *map = open_motion_map(config);
+    if (!map)
+        return 1;
+    // 读取结果累加到 volatile 变量, 避免循环被优化掉
+    volatile int64_t sink = 0;
+    int64_t mark = 0, reference = 0, regions = 0;
+    for (int i = 0; i < frames; i++)
+    {
+        AVFrame *frame = sources[i % BENCH_SOURCES];
+        int64_t start = now();
+        if (mark_motion_map(map, frame) < 0)
+            return 1;
+        // 第一帧没有参考, 不计时
+        if (i > 0)
+            mark += now() - start;
+
+        start = now();
+        sink += reference_sad(frame, sources[(i + BENCH_SOURCES - 1) % BENCH_SOURCES]);
+        reference += now() - start;
+
+        AVFrameSideData *side = av_frame_get_side_data(frame, AV_FRAME_DATA_REGIONS_OF_INTEREST);
+        regions += side ? side->size / (int)sizeof(AVRegionOfInterest) : 0;
+    }
+
+    MotionStat stat = get_motion_map_stat(map);
+    printf("%dx%d, %d frames, %d blocks per frame\n", width, height, frames, map->cols * map->rows);
+    printf("%-16s %12s\n", "", "ms/frame");
+    printf("%-16s %12.3f\n", "mark_motion_map", frames > 1 ? mark / 1e6 / (frames - 1) : 0.0);
+    printf("%-16s %12.3f\n", "scalar SAD", reference / 1e6 / frames);
+    printf("active blocks %.1f%%, %.1f regions per frame\n",
+           stat.blocks > 0 ? 100.0 * stat.active / stat.blocks : 0.0, (double)regions / frames);
+    printf("checksum %lld\n", (long long)sink);
+
+    close_motion_map(map);
+    for (int i = 0; i < BENCH_SOURCES; i++)
+        av_frame_free(&sources[i]);
+    destroy_logger(logger);
+    return 0;
+}
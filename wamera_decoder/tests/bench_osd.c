@@ -0,0 +1,87 @@
+#include "../include/osd.h"
+
+// 默认的分辨率与帧数, 可由命令行参数覆盖
+#define BENCH_WIDTH 1920
+#define BENCH_HEIGHT 1080
+#define BENCH_FRAMES 900
+// 采集帧率 时间每 BENCH_FPS 帧变化一次
+#define BENCH_FPS 30
+
+static int64_t now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * @brief run_scale 以一种缩放叠加一段时间
+ * @return 成功返回0, 失败返回-1
+ */
+static int run_scale(AVFrame *frame, unsigned int scale, int frames)
+{
+    // 与默认位置一致
+    OsdConfig config = {1, 16, 16, scale};
+    Osd *osd = open_osd(config);
+    if (!osd)
+        return -1;
+
+    int64_t wall_time = (int64_t)time(NULL) * 1000000, elapsed = 0, worst = 0;
+    for (int i = 0; i < frames; i++)
+    {
+        int64_t start = now();
+        if (draw_osd(osd, frame, wall_time + (int64_t)i * 1000000 / BENCH_FPS) < 0)
+        {
+            close_osd(osd);
+            return -1;
+        }
+        // 首帧包含栅格化, 不计时
+        if (i == 0)
+            continue;
+        int64_t cost = now() - start;
+        elapsed += cost;
+        worst = FFMAX(worst, cost);
+    }
+    char name[16];
+    snprintf(name, sizeof(name), scale ? "%u" : "auto (%u)", osd->scale);
+    printf("%-10s %12.2f %12.2f %14.1f\n", name, frames > 1 ? elapsed / 1e3 / (frames - 1) : 0.0, worst / 1e3,
+           (double)osd->redrawn / FFMAX(frames / BENCH_FPS, 1));
+    close_osd(osd);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    // 参数: 宽 高 帧数
+    int width = argc > 1 ? atoi(argv[1]) : BENCH_WIDTH;
+    int height = argc > 2 ? atoi(argv[2]) : BENCH_HEIGHT;
+    int frames = argc > 3 ? atoi(argv[3]) : BENCH_FRAMES;
+    if (width <= 0 || height <= 0 || frames <= 0)
+    {
+        printf("Usage: %s [width] [height] [frames]\n", argv[0]);
+        return 1;
+    }
+
+    logger = init_logger(NULL, LOG_WARNING);
+    AVFrame *frame = av_frame_alloc();
+    if (!frame)
+        return 1;
+    frame->width = width;
+    frame->height = height;
+    frame->format = AV_PIX_FMT_YUV422P;
+    if (av_frame_get_buffer(frame, 0) < 0)
+        return 1;
+    for (int p = 0; p < 3; p++)
+        memset(frame->data[p], p ? 128 : 96, (size_t)frame->linesize[p] * height);
+
+    printf("%dx%d yuv422p, %d frames at %d fps\n", width, height, frames, BENCH_FPS);
+    printf("%-10s %12s %12s %14s\n", "scale", "us/frame", "max us", "redrawn/s");
+    static const unsigned int scales[] = {0, 2, 4, 8};
+    int ret = 0;
+    for (unsigned int i = 0; i < sizeof(scales) / sizeof(scales[0]); i++)
+        if (run_scale(frame, scales[i], frames) < 0)
+            ret = 1;
+    av_frame_free(&frame);
+    destroy_logger(logger);
+    return ret;
+}
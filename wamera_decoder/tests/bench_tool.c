@@ -0,0 +1,117 @@
+#include "../include/tool.h"
+
+// 每轮的元素数量, 与相机的格式列表和输出器数量相比已足够大
+#define BENCH_ELEMS 4096
+#define BENCH_ROUNDS 8
+
+/**
+ * @brief Node 被 Array 取代前的链表节点, 元素各自分配
+ */
+typedef struct Node
+{
+    void *data;
+    struct Node *next;
+} Node;
+
+typedef struct LinkedList
+{
+    Node *head;
+} LinkedList;
+
+static void append_linked_list(LinkedList *list, void *data)
+{
+    Node *new_node = (Node *)malloc(sizeof(Node));
+    if (!new_node)
+        return;
+    new_node->data = data;
+    new_node->next = NULL;
+    if (!list->head)
+        list->head = new_node;
+    else
+    {
+        Node *current = list->head;
+        while (current->next)
+            current = current->next;
+        current->next = new_node;
+    }
+}
+
+static void *get_linked_list(LinkedList *list, unsigned int index)
+{
+    Node *current = list->head;
+    for (unsigned int i = 0; current && i < index; i++)
+        current = current->next;
+    return current ? current->data : NULL;
+}
+
+static void free_linked_list(LinkedList *list)
+{
+    Node *current = list->head;
+    while (current)
+    {
+        Node *next = current->next;
+        free(current->data);
+        free(current);
+        current = next;
+    }
+    list->head = NULL;
+}
+
+static int64_t now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+int main(void)
+{
+    logger = init_logger(NULL, LOG_WARNING);
+    int64_t list_append = 0, list_get = 0, array_append = 0, array_get = 0;
+    // 读取结果累加到 volatile 变量, 避免循环被优化掉
+    volatile int64_t sink = 0;
+
+    for (int round = 0; round < BENCH_ROUNDS; round++)
+    {
+        LinkedList list = {NULL};
+        int64_t start = now();
+        for (int i = 0; i < BENCH_ELEMS; i++)
+        {
+            Config *config = (Config *)calloc(1, sizeof(Config));
+            if (config)
+                config->width = (unsigned int)i;
+            append_linked_list(&list, config);
+        }
+        list_append += now() - start;
+        start = now();
+        for (unsigned int i = 0; i < BENCH_ELEMS; i++)
+            sink += ((Config *)get_linked_list(&list, i))->width;
+        list_get += now() - start;
+        free_linked_list(&list);
+
+        Array *array = create_array(sizeof(Config), 0);
+        if (!array)
+            return 1;
+        start = now();
+        for (int i = 0; i < BENCH_ELEMS; i++)
+        {
+            Config config = {0};
+            config.width = (unsigned int)i;
+            append_array(array, &config);
+        }
+        array_append += now() - start;
+        start = now();
+        for (unsigned int i = 0; i < BENCH_ELEMS; i++)
+            sink += ARRAY_GET(array, Config, i)->width;
+        array_get += now() - start;
+        free_array(array);
+    }
+
+    int64_t ops = (int64_t)BENCH_ELEMS * BENCH_ROUNDS;
+    printf("%-12s %14s %14s\n", "", "append ns/op", "get ns/op");
+    printf("%-12s %14.1f %14.1f\n", "LinkedList", (double)list_append / ops, (double)list_get / ops);
+    printf("%-12s %14.1f %14.1f\n", "Array", (double)array_append / ops, (double)array_get / ops);
+    printf("checksum %lld\n", (long long)sink);
+    destroy_logger(logger);
+    return 0;
+}
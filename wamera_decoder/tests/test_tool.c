@@ -0,0 +1,150 @@
+#include "../include/tool.h"
+
+static int failures = 0;
+
+/**
+ * @brief CHECK 断言条件成立, 失败时记录位置并继续执行
+ */
+#define CHECK(cond)                                                         \
+    do                                                                      \
+    {                                                                       \
+        if (!(cond))                                                        \
+        {                                                                   \
+            printf("%s:%d: check `%s` failed\n", __FILE__, __LINE__, #cond); \
+            failures++;                                                     \
+        }                                                                   \
+    } while (0)
+
+typedef struct Item
+{
+    int id;
+    double value;
+} Item;
+
+/**
+ * @brief test_array_growth 超出初始容量后倍增, 已有元素保持不变
+ */
+static void test_array_growth(void)
+{
+    Array *array = create_array(sizeof(Item), 2);
+    CHECK(array != NULL);
+    for (int i = 0; i < 100; i++)
+    {
+        Item item = {i, i * 0.5};
+        CHECK(append_array(array, &item) == 0);
+    }
+    CHECK(array->length == 100);
+    CHECK(array->capacity == 128);
+    for (int i = 0; i < 100; i++)
+        CHECK(ARRAY_GET(array, Item, i)->id == i && ARRAY_GET(array, Item, i)->value == i * 0.5);
+    CHECK(get_array(array, 100) == NULL);
+
+    // 移除后其余元素保持顺序
+    CHECK(remove_array(array, 0) == 0);
+    CHECK(remove_array(array, 98) == 0);
+    CHECK(remove_array(array, 98) == -1);
+    CHECK(array->length == 98);
+    CHECK(ARRAY_GET(array, Item, 0)->id == 1 && ARRAY_GET(array, Item, 97)->id == 98);
+    free_array(array);
+
+    // 容量为0时使用默认容量
+    array = create_array(sizeof(int), 0);
+    CHECK(array != NULL && array->capacity > 0);
+    free_array(array);
+}
+
+/**
+ * @brief test_ring_buffer 满与空的边界, 以及队头越过存储末尾后的回绕
+ */
+static void test_ring_buffer(void)
+{
+    RingBuffer *ring = create_ring_buffer(sizeof(int), 4);
+    CHECK(ring != NULL);
+    int value = -1;
+    CHECK(pop_ring_buffer(ring, &value) == -1);
+    CHECK(peek_ring_buffer(ring, 0) == NULL);
+
+    for (int i = 0; i < 4; i++)
+        CHECK(push_ring_buffer(ring, &i) == 0);
+    int extra = 4;
+    CHECK(push_ring_buffer(ring, &extra) == -1);
+    CHECK(ring->length == 4);
+
+    // 交替出入队, 使队头多次越过存储末尾
+    int next = 4;
+    for (int i = 0; i < 10; i++)
+    {
+        CHECK(pop_ring_buffer(ring, &value) == 0 && value == i);
+        CHECK(push_ring_buffer(ring, &next) == 0);
+        next++;
+    }
+    CHECK(ring->head == 10 % 4);
+    for (unsigned int i = 0; i < 4; i++)
+        CHECK(*(int *)peek_ring_buffer(ring, i) == 10 + (int)i);
+    CHECK(peek_ring_buffer(ring, 4) == NULL);
+
+    for (int i = 10; i < 14; i++)
+        CHECK(pop_ring_buffer(ring, i % 2 ? &value : NULL) == 0 && (i % 2 == 0 || value == i));
+    CHECK(pop_ring_buffer(ring, &value) == -1);
+    CHECK(ring->length == 0);
+    free_ring_buffer(ring);
+
+    // 容量为0时使用默认容量
+    ring = create_ring_buffer(sizeof(int), 0);
+    CHECK(ring != NULL && ring->capacity > 0);
+    CHECK(ring && push_ring_buffer(ring, &extra) == 0 && pop_ring_buffer(ring, &value) == 0 && value == 4);
+    free_ring_buffer(ring);
+}
+
+/**
+ * @brief test_object_pool 耗尽后返回NULL, 归还的对象被优先复用
+ */
+static void test_object_pool(void)
+{
+    ObjectPool *pool = create_object_pool(sizeof(Item), 3, NULL);
+    CHECK(pool != NULL);
+    Item *items[3];
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        items[i] = POOL_ACQUIRE(pool, Item);
+        // 对象按地址从低到高取出
+        CHECK(items[i] == POOL_GET(pool, Item, i));
+        CHECK(index_object_pool(pool, items[i]) == i);
+        items[i]->id = (int)i;
+    }
+    CHECK(acquire_object_pool(pool) == NULL);
+    CHECK(POOL_GET(pool, Item, 3) == NULL);
+
+    release_object_pool(pool, items[1]);
+    Item *reused = POOL_ACQUIRE(pool, Item);
+    CHECK(reused == items[1] && reused->id == 1);
+    CHECK(acquire_object_pool(pool) == NULL);
+    for (unsigned int i = 0; i < 3; i++)
+        release_object_pool(pool, items[i]);
+    CHECK(pool->free_num == 3);
+    free_object_pool(pool);
+
+    // 外部提供的存储不由对象池释放
+    Item storage[2];
+    pool = create_object_pool(sizeof(Item), 2, storage);
+    CHECK(pool != NULL && !pool->owned);
+    CHECK(POOL_ACQUIRE(pool, Item) == &storage[0]);
+    CHECK(POOL_ACQUIRE(pool, Item) == &storage[1]);
+    free_object_pool(pool);
+}
+
+int main(void)
+{
+    logger = init_logger(NULL, LOG_WARNING);
+    test_array_growth();
+    test_ring_buffer();
+    test_object_pool();
+    destroy_logger(logger);
+    if (failures > 0)
+    {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
@@ -0,0 +1,100 @@
+#include <poll.h>
+
+#include "../include/udp.h"
+
+// 一帧的 TS 包数 约 100KB, 在一个发送时间窗内无法发完
+#define TEST_FRAME_PACKETS 512
+#define TEST_FRAMES 4
+#define TEST_PID 0x100
+
+static int failures = 0;
+
+/**
+ * @brief CHECK 断言条件成立, 失败时记录位置并继续执行
+ */
+#define CHECK(cond)                                                         \
+    do                                                                      \
+    {                                                                       \
+        if (!(cond))                                                        \
+        {                                                                   \
+            printf("%s:%d: check `%s` failed\n", __FILE__, __LINE__, #cond); \
+            failures++;                                                     \
+        }                                                                   \
+    } while (0)
+
+/**
+ * @brief open_loopback 绑定回环地址的任意端口
+ * @return int 套接字 失败返回-1
+ */
+static int open_loopback(char *address, size_t size)
+{
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    struct sockaddr_in in = {0};
+    in.sin_family = AF_INET;
+    in.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(in);
+    int buffer = 4 << 20;
+    if (fd < 0 || setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buffer, sizeof(buffer)) < 0 ||
+        bind(fd, (struct sockaddr *)&in, sizeof(in)) < 0 || getsockname(fd, (struct sockaddr *)&in, &length) < 0)
+        return -1;
+    snprintf(address, size, "127.0.0.1:%u", ntohs(in.sin_port));
+    return fd;
+}
+
+/**
+ * @brief test_drain 关闭发送线程前写入的最后一帧全部送达, 连续计数无缺口
+ */
+static void test_drain(void)
+{
+    char address[64];
+    int fd = open_loopback(address, sizeof(address));
+    CHECK(fd >= 0);
+    UdpSender *sender = open_udp_sender(address, (AVRational){1, 30});
+    CHECK(sender != NULL);
+    if (fd < 0 || !sender)
+        return;
+
+    uint8_t packet[188] = {0x47, TEST_PID >> 8, TEST_PID & 0xff, 0x10};
+    unsigned int total = TEST_FRAME_PACKETS * TEST_FRAMES;
+    for (unsigned int i = 0; i < total; i++)
+    {
+        packet[3] = 0x10 | (i & 0x0f);
+        avio_write(sender->pb, packet, sizeof(packet));
+    }
+    // 立即关闭, 积压的数据报须在关闭时发完
+    close_udp_sender(sender);
+
+    unsigned int received = 0, gaps = 0;
+    int last = -1;
+    uint8_t data[65536];
+    struct pollfd event = {fd, POLLIN, 0};
+    while (poll(&event, 1, 200) > 0)
+    {
+        ssize_t size = recv(fd, data, sizeof(data), 0);
+        for (ssize_t offset = 0; offset + 188 <= size; offset += 188)
+        {
+            int cc = data[offset + 3] & 0x0f;
+            if (last >= 0 && cc != ((last + 1) & 0x0f))
+                gaps++;
+            last = cc;
+            received++;
+        }
+    }
+    CHECK(received == total);
+    CHECK(gaps == 0);
+    close(fd);
+}
+
+int main(void)
+{
+    logger = init_logger(NULL, LOG_WARNING);
+    test_drain();
+    destroy_logger(logger);
+    if (failures > 0)
+    {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
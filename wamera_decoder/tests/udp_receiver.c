@@ -0,0 +1,228 @@
+#include <errno.h>
+#include <math.h>
+#include <netdb.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "../include/tool.h"
+
+// TS 包大小与空包的 PID
+#define TS_PACKET_SIZE 188
+#define TS_NULL_PID 0x1fff
+// 默认的监听地址与接收时长 单位:s
+#define RECEIVER_ADDRESS "127.0.0.1:5000"
+#define RECEIVER_SECONDS 10
+// 接收缓冲区 避免接收端自身丢包被算作发送端的丢失
+#define RECEIVER_BUFFER (4 << 20)
+
+static volatile sig_atomic_t stopped = 0;
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    stopped = 1;
+}
+
+/**
+ * @brief ReceiverStat 接收统计
+ * @property datagrams 收到的数据报数
+ * @property packets 收到的 TS 包数
+ * @property sync_errors 同步字节错误的 TS 包数
+ * @property cc_errors 连续计数不连续的次数
+ * @property lost 按连续计数推算丢失的 TS 包数
+ * @property duplicates 重复的 TS 包数
+ * @property gaps 数据报到达间隔 元素为 int64_t 单位:us
+ */
+typedef struct ReceiverStat
+{
+    int64_t datagrams;
+    int64_t packets;
+    int64_t sync_errors;
+    int64_t cc_errors;
+    int64_t lost;
+    int64_t duplicates;
+    Array *gaps;
+} ReceiverStat;
+
+static int64_t now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int compare_gap(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief open_receiver 绑定 host:port, IPv4 组播地址时加入组播
+ * @return int 套接字 失败返回-1
+ */
+static int open_receiver(const char *address)
+{
+    char host[256];
+    const char *colon = strrchr(address, ':');
+    if (!colon || (size_t)(colon - address) >= sizeof(host))
+        return -1;
+    // IPv6 地址写作 [addr]:port
+    const char *begin = address;
+    size_t length = colon - address;
+    if (length >= 2 && address[0] == '[' && colon[-1] == ']')
+    {
+        begin++;
+        length -= 2;
+    }
+    memcpy(host, begin, length);
+    host[length] = '\0';
+
+    struct addrinfo hints = {0};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags = AI_NUMERICSERV | AI_PASSIVE;
+    struct addrinfo *info = NULL;
+    if (getaddrinfo(host[0] ? host : NULL, colon + 1, &hints, &info) != 0)
+        return -1;
+    int fd = socket(info->ai_family, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    int size = RECEIVER_BUFFER, reuse = 1;
+    struct timeval timeout = {0, 100000};
+    if (fd >= 0)
+    {
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        if (bind(fd, info->ai_addr, info->ai_addrlen) < 0)
+        {
+            close(fd);
+            fd = -1;
+        }
+    }
+    if (fd >= 0 && info->ai_family == AF_INET)
+    {
+        struct sockaddr_in *in = (struct sockaddr_in *)info->ai_addr;
+        struct ip_mreq request = {in->sin_addr, {htonl(INADDR_ANY)}};
+        if (IN_MULTICAST(ntohl(in->sin_addr.s_addr)) &&
+            setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &request, sizeof(request)) < 0)
+            printf("Join multicast group failed: %s\n", strerror(errno));
+    }
+    freeaddrinfo(info);
+    return fd;
+}
+
+/**
+ * @brief check_packets 按 PID 检查一个数据报中 TS 包的连续计数
+ * @param last 各 PID 上一个带负载的包的连续计数 未出现过为-1
+ */
+static void check_packets(ReceiverStat *stat, int8_t *last, const uint8_t *data, ssize_t size)
+{
+    for (ssize_t offset = 0; offset + TS_PACKET_SIZE <= size; offset += TS_PACKET_SIZE)
+    {
+        const uint8_t *packet = data + offset;
+        stat->packets++;
+        if (packet[0] != 0x47)
+        {
+            stat->sync_errors++;
+            continue;
+        }
+        int pid = ((packet[1] & 0x1f) << 8) | packet[2];
+        int control = (packet[3] >> 4) & 3, cc = packet[3] & 0x0f;
+        // 只有带负载的包递增连续计数; 不连续标志之后重新计数
+        if (pid == TS_NULL_PID || !(control & 1))
+            continue;
+        if ((control & 2) && packet[4] > 0 && (packet[5] & 0x80))
+            last[pid] = -1;
+        if (last[pid] >= 0 && cc != ((last[pid] + 1) & 0x0f))
+        {
+            if (cc == last[pid])
+                stat->duplicates++;
+            else
+            {
+                stat->cc_errors++;
+                stat->lost += (cc - last[pid] - 1) & 0x0f;
+            }
+        }
+        last[pid] = (int8_t)cc;
+    }
+}
+
+/**
+ * @brief report 输出丢失与到达间隔的抖动
+ */
+static void report(ReceiverStat *stat, double seconds)
+{
+    printf("%lld datagrams, %lld TS packets in %.1f s\n", (long long)stat->datagrams, (long long)stat->packets,
+           seconds);
+    printf("loss: %lld cc errors, %lld packets lost (%.3f%%), %lld duplicates, %lld sync errors\n",
+           (long long)stat->cc_errors, (long long)stat->lost,
+           stat->packets + stat->lost > 0 ? 100.0 * stat->lost / (stat->packets + stat->lost) : 0.0,
+           (long long)stat->duplicates, (long long)stat->sync_errors);
+
+    unsigned int num = stat->gaps->length;
+    if (num == 0)
+        return;
+    int64_t *gaps = (int64_t *)stat->gaps->data;
+    double sum = 0, square = 0;
+    for (unsigned int i = 0; i < num; i++)
+    {
+        sum += gaps[i];
+        square += (double)gaps[i] * gaps[i];
+    }
+    double mean = sum / num;
+    qsort(gaps, num, sizeof(int64_t), compare_gap);
+    printf("inter-arrival: mean %.1f us, jitter (stddev) %.1f us, p50 %lld us, p99 %lld us, max %lld us\n", mean,
+           sqrt(FFMAX(square / num - mean * mean, 0.0)), (long long)gaps[num / 2],
+           (long long)gaps[(size_t)((num - 1) * 0.99)], (long long)gaps[num - 1]);
+}
+
+int main(int argc, char *argv[])
+{
+    // 参数: 监听地址 接收时长
+    const char *address = argc > 1 ? argv[1] : RECEIVER_ADDRESS;
+    int seconds = argc > 2 ? atoi(argv[2]) : RECEIVER_SECONDS;
+    logger = init_logger(NULL, LOG_WARNING);
+    int fd = open_receiver(address);
+    if (fd < 0 || seconds <= 0)
+    {
+        printf("Usage: %s [host:port] [seconds], bind `%s` failed\n", argv[0], address);
+        return 1;
+    }
+    signal(SIGINT, on_signal);
+
+    ReceiverStat stat = {0};
+    stat.gaps = create_array(sizeof(int64_t), 4096);
+    int8_t *last = (int8_t *)malloc(TS_NULL_PID + 1);
+    if (!stat.gaps || !last)
+        return 1;
+    memset(last, -1, TS_NULL_PID + 1);
+
+    printf("Listen on `%s` for %d s\n", address, seconds);
+    uint8_t data[65536];
+    int64_t start = now(), deadline = start + (int64_t)seconds * 1000000, previous = 0;
+    while (!stopped && now() < deadline)
+    {
+        ssize_t size = recv(fd, data, sizeof(data), 0);
+        if (size < 0)
+            continue;
+        int64_t arrival = now();
+        if (previous > 0)
+        {
+            int64_t gap = arrival - previous;
+            append_array(stat.gaps, &gap);
+        }
+        previous = arrival;
+        stat.datagrams++;
+        check_packets(&stat, last, data, size);
+    }
+    report(&stat, (now() - start) / 1e6);
+
+    free(last);
+    free_array(stat.gaps);
+    close(fd);
+    destroy_logger(logger);
+    return 0;
+}